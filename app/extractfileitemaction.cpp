@@ -24,6 +24,7 @@
 #include <QFileInfo>
 #include <QMenu>
 
+#include <KFileItem>
 #include <KPluginFactory>
 #include <KLocalizedString>
 #include <KRun>
@@ -48,8 +49,18 @@ QList<QAction*> ExtractFileItemAction::actions(const KFileItemListProperties& fi
     bool readOnlyParentDir = false;
     QList<QUrl> supportedUrls;
     // Filter URLs by supported mimetypes.
-    foreach (const QUrl &url, fileItemInfos.urlList()) {
-        const QMimeType mimeType = determineMimeType(url.fileName());
+    const KFileItemList items = fileItemInfos.items();
+    foreach (const KFileItem &item, items) {
+        const QUrl url = item.url();
+        // The menu is built on the GUI thread: only a single archive on a local, fast filesystem
+        // is recognised from its first bytes, the others by their name.
+        QMimeType mimeType;
+        if (items.size() == 1 && url.isLocalFile() && !item.isSlow()) {
+            mimeType = sniffMimeType(url.toLocalFile());
+        }
+        if (!mimeType.isValid()) {
+            mimeType = determineMimeType(url.fileName());
+        }
         if (m_pluginManager->preferredPluginsFor(mimeType).isEmpty()) {
             continue;
         }
@@ -26,6 +26,7 @@
 #include "mainwindow.h"
 #include "batchextract.h"
 #include "addtoarchive.h"
+#include "tracer.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
@@ -160,6 +161,15 @@ int main(int argc, char **argv)
                                         i18n("Automatically choose a filename, with the selected suffix (for example rar, tar.gz, zip or any other supported types)"),
                                         QStringLiteral("suffix")));
 
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("deduplicate"),
+                                        i18n("Store files with identical content only once, as links to the first one. Only supported by tar archives.")));
+
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("update"),
+                                        i18n("Only add the files which are not in the archive yet or which changed since they were added. Only supported by tar and zip archives.")));
+
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("freshen"),
+                                        i18n("Only add the files which are already in the archive and changed since they were added. Only supported by tar and zip archives.")));
+
     parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("b") << QStringLiteral("batch"),
                                         i18n("Use the batch interface instead of the usual dialog. This option is implied if more than one url is specified.")));
 
@@ -169,6 +179,10 @@ int main(int argc, char **argv)
     parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("a") << QStringLiteral("autosubfolder"),
                                         i18n("Archive contents will be read, and if detected to not be a single folder archive, a subfolder with the name of the archive will be created.")));
 
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("trace"),
+                                        i18n("Record a trace of archive operations to the given file, in Chrome trace event format."),
+                                        QStringLiteral("file")));
+
     aboutData.setupCommandLine(&parser);
 
     // Do the command line parsing.
@@ -177,6 +191,10 @@ int main(int argc, char **argv)
     // Handle standard options.
     aboutData.processCommandLine(&parser);
 
+    if (parser.isSet(QStringLiteral("trace"))) {
+        Kerfuffle::Tracer::start(parser.value(QStringLiteral("trace")));
+    }
+
     // This is needed to prevent Dolphin from freezing when opening an archive.
     KDBusService dbusService(KDBusService::Multiple | KDBusService::NoExitOnFailure);
 
@@ -209,6 +227,19 @@ int main(int argc, char **argv)
                 addToArchiveJob->setChangeToFirstPath(true);
             }
 
+            if (parser.isSet(QStringLiteral("deduplicate"))) {
+                qCDebug(ARK) << "Setting deduplicate";
+                addToArchiveJob->setDeduplicateFiles(true);
+            }
+
+            if (parser.isSet(QStringLiteral("freshen"))) {
+                qCDebug(ARK) << "Setting freshen";
+                addToArchiveJob->setUpdateMode(Kerfuffle::CompressionOptions::FreshenChangedFiles);
+            } else if (parser.isSet(QStringLiteral("update"))) {
+                qCDebug(ARK) << "Setting update";
+                addToArchiveJob->setUpdateMode(Kerfuffle::CompressionOptions::UpdateChangedFiles);
+            }
+
             if (parser.isSet(QStringLiteral("add-to"))) {
                 qCDebug(ARK) << "Setting filename to" << parser.value(QStringLiteral("add-to"));
                 addToArchiveJob->setFilename(QUrl::fromUserInput(parser.value(QStringLiteral("add-to")),
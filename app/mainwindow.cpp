@@ -248,6 +248,12 @@ void MainWindow::closeEvent(QCloseEvent *event)
     KParts::MainWindow::closeEvent(event);
 }
 
+bool MainWindow::queryClose()
+{
+    // The part writes its queued changes here, while its widget still exists.
+    return !m_part || m_part->closeUrl(true);
+}
+
 void MainWindow::quit()
 {
     close();
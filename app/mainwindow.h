@@ -50,6 +50,7 @@ public slots:
 
 protected:
     void closeEvent(QCloseEvent *event) override;
+    bool queryClose() override;
 
 private slots:
     void updateActions();
@@ -28,8 +28,16 @@
 #include "jobs.h"
 #include "testhelper.h"
 
+#include <QDateTime>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QSet>
+#include <QTemporaryDir>
 #include <QTest>
 
+#include <unistd.h>
+#include <utime.h>
+
 using namespace Kerfuffle;
 
 class AddTest : public AbstractAddTest
@@ -42,6 +50,14 @@ public:
 private Q_SLOTS:
     void testAdding_data();
     void testAdding();
+    void testFreshening_data();
+    void testFreshening();
+    void testKeepingUnchangedFiles_data();
+    void testKeepingUnchangedFiles();
+    void testStoringOnce_data();
+    void testStoringOnce();
+    void testRewritingLinks_data();
+    void testRewritingLinks();
 };
 
 QTEST_GUILESS_MAIN(AddTest)
@@ -182,4 +198,403 @@ void AddTest::testAdding()
     archive->deleteLater();
 }
 
+void AddTest::testFreshening_data()
+{
+    QTest::addColumn<QString>("archiveName");
+    QTest::addColumn<Plugin*>("plugin");
+    QTest::addColumn<bool>("addNewFiles");
+
+    // Only these plugins keep the unchanged entries.
+    QHash<QString, QString> pluginIds;
+    pluginIds.insert(QStringLiteral("tar.bz2"), QStringLiteral("kerfuffle_libarchive"));
+    pluginIds.insert(QStringLiteral("zip"), QStringLiteral("kerfuffle_libzip"));
+
+    for (auto it = pluginIds.constBegin(); it != pluginIds.constEnd(); ++it) {
+        const QString archiveName = QStringLiteral("test.") + it.key();
+        const auto mime = QMimeDatabase().mimeTypeForFile(archiveName, QMimeDatabase::MatchExtension);
+        foreach (Plugin *plugin, m_pluginManager.preferredWritePluginsFor(mime)) {
+            if (plugin->metaData().pluginId() == it.value()) {
+                QTest::newRow(qPrintable(QStringLiteral("freshen, %1 (%2)").arg(it.key(), it.value()))) << archiveName << plugin << false;
+                QTest::newRow(qPrintable(QStringLiteral("update, %1 (%2)").arg(it.key(), it.value()))) << archiveName << plugin << true;
+            }
+        }
+    }
+}
+
+void AddTest::testFreshening()
+{
+    QTemporaryDir temporaryDir;
+
+    QFETCH(QString, archiveName);
+    const QString archivePath = temporaryDir.path() + QLatin1Char('/') + archiveName;
+    QVERIFY(QFile::copy(QFINDTESTDATA(QStringLiteral("data/") + archiveName), archivePath));
+
+    // a.txt is already in the archive, textfile1.txt is not.
+    QTemporaryDir sourceDir;
+    foreach (const QString &name, QStringList({QStringLiteral("a.txt"), QStringLiteral("textfile1.txt")})) {
+        QFile file(sourceDir.path() + QLatin1Char('/') + name);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write("Changed content\n") > 0);
+    }
+
+    QFETCH(Plugin*, plugin);
+    auto loadJob = Archive::load(archivePath, plugin);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    const uint numberOfEntries = archive->numberOfEntries();
+
+    QFETCH(bool, addNewFiles);
+    CompressionOptions options;
+    options.setGlobalWorkDir(sourceDir.path());
+    options.setUpdateMode(addNewFiles ? CompressionOptions::UpdateChangedFiles : CompressionOptions::FreshenChangedFiles);
+    AddJob *addJob = archive->addFiles(QVector<Archive::Entry*> {
+                                           new Archive::Entry(this, QStringLiteral("a.txt")),
+                                           new Archive::Entry(this, QStringLiteral("textfile1.txt"))
+                                       }, new Archive::Entry(this), options);
+    TestHelper::startAndWaitForResult(addJob);
+
+    // The stored file was written again, the other one is only added when updating.
+    const QStringList paths = getEntryPaths(archive);
+    QVERIFY(paths.contains(QStringLiteral("a.txt")));
+    QCOMPARE(paths.contains(QStringLiteral("textfile1.txt")), addNewFiles);
+    QCOMPARE(archive->numberOfEntries(), numberOfEntries + (addNewFiles ? 1 : 0));
+
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+void AddTest::testKeepingUnchangedFiles_data()
+{
+    QTest::addColumn<QString>("archiveName");
+    QTest::addColumn<Plugin*>("plugin");
+    QTest::addColumn<bool>("touched");
+
+    QHash<QString, QString> pluginIds;
+    pluginIds.insert(QStringLiteral("tar.bz2"), QStringLiteral("kerfuffle_libarchive"));
+    pluginIds.insert(QStringLiteral("zip"), QStringLiteral("kerfuffle_libzip"));
+
+    for (auto it = pluginIds.constBegin(); it != pluginIds.constEnd(); ++it) {
+        const QString archiveName = QStringLiteral("test.") + it.key();
+        const auto mime = QMimeDatabase().mimeTypeForFile(archiveName, QMimeDatabase::MatchExtension);
+        foreach (Plugin *plugin, m_pluginManager.preferredWritePluginsFor(mime)) {
+            if (plugin->metaData().pluginId() != it.value()) {
+                continue;
+            }
+            QTest::newRow(qPrintable(QStringLiteral("same size and time, %1 (%2)").arg(it.key(), it.value()))) << archiveName << plugin << false;
+            // Only zip stores checksums.
+            if (it.key() == QLatin1String("zip")) {
+                QTest::newRow(qPrintable(QStringLiteral("touched, same checksum, %1 (%2)").arg(it.key(), it.value()))) << archiveName << plugin << true;
+            }
+        }
+    }
+}
+
+void AddTest::testKeepingUnchangedFiles()
+{
+    QTemporaryDir temporaryDir;
+
+    QFETCH(QString, archiveName);
+    const QString archivePath = temporaryDir.path() + QLatin1Char('/') + archiveName;
+    QVERIFY(QFile::copy(QFINDTESTDATA(QStringLiteral("data/") + archiveName), archivePath));
+
+    // An even time, since zip stores timestamps with a precision of two seconds.
+    const time_t storedTime = 1500000000;
+    QTemporaryDir sourceDir;
+    const QString fileName = sourceDir.path() + QLatin1String("/kept.txt");
+    auto writeSource = [&fileName](const QByteArray &content, time_t modificationTime) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size()) {
+            return false;
+        }
+        file.close();
+        struct utimbuf times;
+        times.actime = modificationTime;
+        times.modtime = modificationTime;
+        return utime(QFile::encodeName(fileName).constData(), &times) == 0;
+    };
+    QVERIFY(writeSource("Original content\n", storedTime));
+
+    QFETCH(Plugin*, plugin);
+    auto loadJob = Archive::load(archivePath, plugin);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    CompressionOptions options;
+    options.setGlobalWorkDir(sourceDir.path());
+    TestHelper::startAndWaitForResult(archive->addFiles(QVector<Archive::Entry*> {
+                                                            new Archive::Entry(this, QStringLiteral("kept.txt"))
+                                                        }, new Archive::Entry(this), options));
+    const uint numberOfEntries = archive->numberOfEntries();
+
+    QFETCH(bool, touched);
+    if (touched) {
+        // The content is the same, only the time differs.
+        QVERIFY(writeSource("Original content\n", storedTime + 100));
+        options.setCompareChecksums(true);
+    } else {
+        // The size and time are the same, so the file is taken as unchanged although its content is not.
+        QVERIFY(writeSource("Modified content\n", storedTime));
+    }
+
+    options.setUpdateMode(CompressionOptions::UpdateChangedFiles);
+    TestHelper::startAndWaitForResult(archive->addFiles(QVector<Archive::Entry*> {
+                                                            new Archive::Entry(this, QStringLiteral("kept.txt"))
+                                                        }, new Archive::Entry(this), options));
+    QCOMPARE(archive->numberOfEntries(), numberOfEntries);
+
+    // The stored entry was kept as is: same content and same time.
+    QDateTime timestamp;
+    auto reloadJob = Archive::load(archivePath, plugin);
+    connect(reloadJob, &Job::newEntry, this, [&timestamp](Archive::Entry *entry) {
+        if (entry->fullPath() == QLatin1String("kept.txt")) {
+            timestamp = entry->timestamp();
+        }
+    });
+    TestHelper::startAndWaitForResult(reloadJob);
+    QCOMPARE(timestamp.toTime_t(), uint(storedTime));
+
+    QTemporaryDir destDir;
+    auto extractionJob = archive->extractFiles(QVector<Archive::Entry*> {
+                                                   new Archive::Entry(this, QStringLiteral("kept.txt"))
+                                               }, destDir.path());
+    QVERIFY(extractionJob);
+    TestHelper::startAndWaitForResult(extractionJob);
+
+    QFile extracted(destDir.path() + QLatin1String("/kept.txt"));
+    QVERIFY(extracted.open(QIODevice::ReadOnly));
+    QCOMPARE(extracted.readAll(), QByteArray("Original content\n"));
+
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+void AddTest::testStoringOnce_data()
+{
+    QTest::addColumn<bool>("hardLink");
+    QTest::addColumn<bool>("deduplicate");
+    QTest::addColumn<int>("expectedDataEntries");
+
+    QTest::newRow("hard links") << true << false << 1;
+    QTest::newRow("identical files, deduplicated") << false << true << 1;
+    QTest::newRow("identical files") << false << false << 2;
+}
+
+void AddTest::testStoringOnce()
+{
+    Plugin *plugin = nullptr;
+    foreach (Plugin *writePlugin, m_pluginManager.availableWritePlugins()) {
+        if (writePlugin->metaData().pluginId() == QLatin1String("kerfuffle_libarchive")) {
+            plugin = writePlugin;
+        }
+    }
+    if (!plugin) {
+        QSKIP("The libarchive plugin is not available. Skipping test.", SkipSingle);
+    }
+
+    QTemporaryDir temporaryDir;
+    const QString archivePath = temporaryDir.path() + QLatin1String("/test.tar.bz2");
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/test.tar.bz2"), archivePath));
+
+    QByteArray content;
+    for (int i = 0; i < 64 * 1024; ++i) {
+        content.append(static_cast<char>(qrand()));
+    }
+
+    QTemporaryDir sourceDir;
+    const QString first = sourceDir.path() + QLatin1String("/first.bin");
+    const QString second = sourceDir.path() + QLatin1String("/second.bin");
+    QFile file(first);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(content), qint64(content.size()));
+    file.close();
+
+    QFETCH(bool, hardLink);
+    if (hardLink) {
+        QCOMPARE(::link(QFile::encodeName(first).constData(), QFile::encodeName(second).constData()), 0);
+    } else {
+        QVERIFY(QFile::copy(first, second));
+    }
+
+    auto loadJob = Archive::load(archivePath, plugin);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    QFETCH(bool, deduplicate);
+    CompressionOptions options;
+    options.setGlobalWorkDir(sourceDir.path());
+    options.setDeduplicateFiles(deduplicate);
+    AddJob *addJob = archive->addFiles(QVector<Archive::Entry*> {
+                                           new Archive::Entry(this, QStringLiteral("first.bin")),
+                                           new Archive::Entry(this, QStringLiteral("second.bin"))
+                                       }, new Archive::Entry(this), options);
+    TestHelper::startAndWaitForResult(addJob);
+
+    // The links are stored without data, so only the entries holding the content have its size.
+    QHash<QString, qulonglong> sizes;
+    auto reloadJob = Archive::load(archivePath, plugin);
+    connect(reloadJob, &Job::newEntry, this, [&sizes](Archive::Entry *entry) {
+        sizes.insert(entry->fullPath(), entry->size());
+    });
+    TestHelper::startAndWaitForResult(reloadJob);
+
+    QVERIFY(sizes.contains(QStringLiteral("first.bin")));
+    QVERIFY(sizes.contains(QStringLiteral("second.bin")));
+    QFETCH(int, expectedDataEntries);
+    const QList<qulonglong> storedSizes {sizes.value(QStringLiteral("first.bin")), sizes.value(QStringLiteral("second.bin"))};
+    QCOMPARE(storedSizes.count(qulonglong(content.size())), expectedDataEntries);
+    QCOMPARE(storedSizes.count(0), 2 - expectedDataEntries);
+
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+void AddTest::testRewritingLinks_data()
+{
+    QTest::addColumn<bool>("hardLink");
+    QTest::addColumn<bool>("moveTarget");
+    QTest::addColumn<bool>("useTransaction");
+
+    QTest::newRow("hard links, deleting the target") << true << false << false;
+    QTest::newRow("hard links, moving the target") << true << true << false;
+    QTest::newRow("deduplicated, deleting the target") << false << false << false;
+    QTest::newRow("deduplicated, moving the target") << false << true << false;
+    QTest::newRow("deduplicated, deleting the target in a transaction") << false << false << true;
+    QTest::newRow("deduplicated, moving the target in a transaction") << false << true << true;
+}
+
+void AddTest::testRewritingLinks()
+{
+    Plugin *plugin = nullptr;
+    foreach (Plugin *writePlugin, m_pluginManager.availableWritePlugins()) {
+        if (writePlugin->metaData().pluginId() == QLatin1String("kerfuffle_libarchive")) {
+            plugin = writePlugin;
+        }
+    }
+    if (!plugin) {
+        QSKIP("The libarchive plugin is not available. Skipping test.", SkipSingle);
+    }
+
+    QTemporaryDir temporaryDir;
+    const QString archivePath = temporaryDir.path() + QLatin1String("/test.tar.bz2");
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/test.tar.bz2"), archivePath));
+
+    const QByteArray content("Content stored once\n");
+    QTemporaryDir sourceDir;
+    const QString first = sourceDir.path() + QLatin1String("/first.bin");
+    const QString second = sourceDir.path() + QLatin1String("/second.bin");
+    QFile file(first);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(content), qint64(content.size()));
+    file.close();
+
+    QFETCH(bool, hardLink);
+    if (hardLink) {
+        QCOMPARE(::link(QFile::encodeName(first).constData(), QFile::encodeName(second).constData()), 0);
+    } else {
+        QVERIFY(QFile::copy(first, second));
+    }
+
+    // second.bin is stored as a link to first.bin.
+    auto loadJob = Archive::load(archivePath, plugin);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    CompressionOptions options;
+    options.setGlobalWorkDir(sourceDir.path());
+    options.setDeduplicateFiles(!hardLink);
+    TestHelper::startAndWaitForResult(archive->addFiles(QVector<Archive::Entry*> {
+                                                            new Archive::Entry(this, QStringLiteral("first.bin")),
+                                                            new Archive::Entry(this, QStringLiteral("second.bin"))
+                                                        }, new Archive::Entry(this), options));
+
+    // The links are found again when the archive is opened.
+    auto linkedJob = Archive::load(archivePath, plugin);
+    QVERIFY(linkedJob);
+    linkedJob->setAutoDelete(false);
+    TestHelper::startAndWaitForResult(linkedJob);
+    auto linkedArchive = linkedJob->archive();
+    QVERIFY(linkedArchive && linkedArchive->isValid());
+
+    QFETCH(bool, useTransaction);
+    if (useTransaction) {
+        QVERIFY(linkedArchive->beginTransaction());
+    }
+
+    const QVector<Archive::Entry*> targetEntries { new Archive::Entry(this, QStringLiteral("first.bin")) };
+    QFETCH(bool, moveTarget);
+    if (moveTarget) {
+        TestHelper::startAndWaitForResult(linkedArchive->moveFiles(targetEntries, new Archive::Entry(this, QStringLiteral("moved.bin"))));
+    } else {
+        TestHelper::startAndWaitForResult(linkedArchive->deleteFiles(targetEntries));
+    }
+
+    if (useTransaction) {
+        TestHelper::startAndWaitForResult(linkedArchive->commitTransaction());
+    }
+
+    QSet<QString> paths;
+    auto reloadJob = Archive::load(archivePath, plugin);
+    QVERIFY(reloadJob);
+    reloadJob->setAutoDelete(false);
+    connect(reloadJob, &Job::newEntry, this, [&paths](Archive::Entry *entry) {
+        paths.insert(entry->fullPath());
+    });
+    TestHelper::startAndWaitForResult(reloadJob);
+    QVERIFY(!paths.contains(QStringLiteral("first.bin")));
+    QVERIFY(paths.contains(QStringLiteral("second.bin")));
+    QCOMPARE(paths.contains(QStringLiteral("moved.bin")), moveTarget);
+
+    // The link keeps the content, even when extracted without the entry holding it.
+    QTemporaryDir destDir;
+    auto extractionJob = reloadJob->archive()->extractFiles(QVector<Archive::Entry*> {
+                                                                new Archive::Entry(this, QStringLiteral("second.bin"))
+                                                            }, destDir.path());
+    QVERIFY(extractionJob);
+    TestHelper::startAndWaitForResult(extractionJob);
+
+    QFile extracted(destDir.path() + QLatin1String("/second.bin"));
+    QVERIFY(extracted.open(QIODevice::ReadOnly));
+    QCOMPARE(extracted.readAll(), content);
+    QVERIFY(!QFile::exists(destDir.path() + QLatin1String("/moved.bin")));
+
+    reloadJob->archive()->deleteLater();
+    reloadJob->deleteLater();
+    linkedJob->deleteLater();
+    linkedArchive->deleteLater();
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
 #include "addtest.moc"
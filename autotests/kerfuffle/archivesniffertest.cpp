@@ -0,0 +1,79 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archivesniffer.h"
+
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class ArchiveSnifferTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testSniffing_data();
+    void testSniffing();
+};
+
+QTEST_GUILESS_MAIN(ArchiveSnifferTest)
+
+void ArchiveSnifferTest::testSniffing_data()
+{
+    QTest::addColumn<QString>("archiveName");
+    QTest::addColumn<QString>("expectedMimeType");
+
+    QTest::newRow("zip") << QFINDTESTDATA("data/test.zip") << QStringLiteral("application/zip");
+    QTest::newRow("zip with wrong extension") << QFINDTESTDATA("data/zip_with_wrong_extension.rar") << QStringLiteral("application/zip");
+    QTest::newRow("OpenDocument") << QFINDTESTDATA("data/test.odt") << QStringLiteral("application/zip");
+    QTest::newRow("7z") << QFINDTESTDATA("data/test.7z") << QStringLiteral("application/x-7z-compressed");
+    QTest::newRow("rar") << QFINDTESTDATA("data/test.rar") << QStringLiteral("application/x-rar");
+    QTest::newRow("xar") << QFINDTESTDATA("data/simplearchive.xar") << QStringLiteral("application/x-xar");
+    QTest::newRow("deb") << QFINDTESTDATA("data/smallarchive.deb") << QStringLiteral("application/x-deb");
+    QTest::newRow("rpm") << QFINDTESTDATA("data/wget.rpm") << QStringLiteral("application/x-rpm");
+    QTest::newRow("tar-v7") << QFINDTESTDATA("data/tar-v7.tar") << QStringLiteral("application/x-tar");
+    QTest::newRow("tar.gz") << QFINDTESTDATA("data/simplearchive.tar.gz") << QStringLiteral("application/x-compressed-tar");
+    QTest::newRow("tar downloaded by wget") << QFINDTESTDATA("data/wget-download.tar.gz.1") << QStringLiteral("application/x-compressed-tar");
+    QTest::newRow("tar.xz") << QFINDTESTDATA("data/simplearchive.tar.xz") << QStringLiteral("application/x-xz-compressed-tar");
+    QTest::newRow("tar.Z") << QFINDTESTDATA("data/simplearchive.tar.Z") << QStringLiteral("application/x-tarz");
+
+    // The inner tarball of lrzip streams can't be checked without running lrzip.
+    QTest::newRow("tar.lrz") << QFINDTESTDATA("data/simplearchive.tar.lrz") << QString();
+    QTest::newRow("text file") << QFINDTESTDATA("data/textfile1.txt") << QString();
+    QTest::newRow("missing file") << QStringLiteral("/nonexistent/archive.zip") << QString();
+}
+
+void ArchiveSnifferTest::testSniffing()
+{
+    QFETCH(QString, archiveName);
+    QFETCH(QString, expectedMimeType);
+
+    QCOMPARE(ArchiveSniffer::mimeTypeNameForFile(archiveName), expectedMimeType);
+}
+
+#include "archivesniffertest.moc"
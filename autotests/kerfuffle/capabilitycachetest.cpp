@@ -0,0 +1,176 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "capabilitycache.h"
+#include "pluginmanager.h"
+
+#include <QFile>
+#include <QMimeDatabase>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <utime.h>
+
+using namespace Kerfuffle;
+
+class CapabilityCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testSavedExecutables();
+    void testStalePath();
+    void testClear();
+    void testPluginManagerCaches();
+
+private:
+    void setPathTime(time_t time);
+
+    QTemporaryDir m_dir;
+    QString m_executable;
+    QByteArray m_path;
+};
+
+QTEST_GUILESS_MAIN(CapabilityCacheTest)
+
+void CapabilityCacheTest::setPathTime(time_t time)
+{
+    // The cache compares the modification times of the $PATH directories.
+    struct utimbuf times;
+    times.actime = time;
+    times.modtime = time;
+    QCOMPARE(utime(QFile::encodeName(m_dir.path()).constData(), &times), 0);
+}
+
+void CapabilityCacheTest::initTestCase()
+{
+    // Keep the saved results away from the user's cache directory.
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_dir.isValid());
+    m_executable = QStringLiteral("ark-capabilitycachetest-tool");
+    m_path = qgetenv("PATH");
+}
+
+void CapabilityCacheTest::init()
+{
+    CapabilityCache().clear(true);
+
+    QFile executable(m_dir.path() + QLatin1Char('/') + m_executable);
+    QVERIFY(executable.open(QIODevice::WriteOnly));
+    QVERIFY(executable.write("#!/bin/sh\n") > 0);
+    executable.close();
+    QVERIFY(executable.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner));
+    setPathTime(1500000000);
+
+    qputenv("PATH", QFile::encodeName(m_dir.path()));
+}
+
+void CapabilityCacheTest::cleanup()
+{
+    qputenv("PATH", m_path);
+    QFile::remove(m_dir.path() + QLatin1Char('/') + m_executable);
+}
+
+void CapabilityCacheTest::testSavedExecutables()
+{
+    CapabilityCache first;
+    QVERIFY(first.hasExecutable(m_executable));
+    QVERIFY(!first.hasExecutable(QStringLiteral("ark-capabilitycachetest-missing")));
+
+    // Without changing the time of the directory, the executable is still known as found.
+    QVERIFY(QFile::remove(m_dir.path() + QLatin1Char('/') + m_executable));
+    setPathTime(1500000000);
+    QVERIFY(first.hasExecutable(m_executable));
+
+    CapabilityCache second;
+    QVERIFY(second.hasExecutable(m_executable));
+    QVERIFY(!second.hasExecutable(QStringLiteral("ark-capabilitycachetest-missing")));
+}
+
+void CapabilityCacheTest::testStalePath()
+{
+    QVERIFY(CapabilityCache().hasExecutable(m_executable));
+
+    QVERIFY(QFile::remove(m_dir.path() + QLatin1Char('/') + m_executable));
+    setPathTime(1500000001);
+    QVERIFY(!CapabilityCache().hasExecutable(m_executable));
+}
+
+void CapabilityCacheTest::testClear()
+{
+    CapabilityCache cache;
+    QVERIFY(cache.hasExecutable(m_executable));
+
+    QVERIFY(QFile::remove(m_dir.path() + QLatin1Char('/') + m_executable));
+    setPathTime(1500000000);
+
+    // The results are loaded again from the cache directory.
+    cache.clear();
+    QVERIFY(cache.hasExecutable(m_executable));
+
+    cache.clear(true);
+    QVERIFY(!cache.hasExecutable(m_executable));
+}
+
+void CapabilityCacheTest::testPluginManagerCaches()
+{
+    qputenv("PATH", m_path);
+
+    PluginManager pluginManager;
+    const QVector<Plugin*> plugins = pluginManager.availablePlugins();
+    if (plugins.isEmpty()) {
+        QSKIP("No plugin is available.");
+    }
+
+    QStringList mimeTypes = pluginManager.supportedMimeTypes();
+    QVERIFY(!mimeTypes.isEmpty());
+    const QMimeType mimeType = QMimeDatabase().mimeTypeForName(plugins.first()->metaData().mimeTypes().first());
+    QVERIFY(!pluginManager.preferredPluginsFor(mimeType).isEmpty());
+
+    // Enabling or disabling a plugin clears the supported mimetypes.
+    foreach (Plugin *plugin, plugins) {
+        plugin->setEnabled(false);
+    }
+    QVERIFY(pluginManager.supportedMimeTypes().isEmpty());
+    QVERIFY(pluginManager.preferredPluginsFor(mimeType).isEmpty());
+
+    foreach (Plugin *plugin, plugins) {
+        plugin->setEnabled(true);
+    }
+    QStringList enabledMimeTypes = pluginManager.supportedMimeTypes();
+    mimeTypes.sort();
+    enabledMimeTypes.sort();
+    QCOMPARE(enabledMimeTypes, mimeTypes);
+    QVERIFY(!pluginManager.preferredPluginsFor(mimeType).isEmpty());
+}
+
+#include "capabilitycachetest.moc"
@@ -0,0 +1,117 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archiveentry.h"
+#include "entryarena.h"
+
+#include <QPointer>
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class EntryArenaTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testCreate();
+    void testRecycle();
+    void testSharedString();
+    void testClear();
+};
+
+QTEST_GUILESS_MAIN(EntryArenaTest)
+
+void EntryArenaTest::testCreate()
+{
+    EntryArena arena;
+    QCOMPARE(arena.count(), 0);
+
+    // Enough entries to need several blocks.
+    QVector<Archive::Entry*> entries;
+    for (int i = 0; i < 3000; ++i) {
+        Archive::Entry *entry = arena.create();
+        entry->setProperty("fullPath", QStringLiteral("file%1").arg(i));
+        entries << entry;
+    }
+
+    QCOMPARE(arena.count(), 3000);
+    for (int i = 0; i < entries.size(); ++i) {
+        QVERIFY(arena.contains(entries.at(i)));
+        QCOMPARE(entries.at(i)->name(), QStringLiteral("file%1").arg(i));
+        QVERIFY(!entries.at(i)->parent());
+    }
+
+    Archive::Entry heapEntry;
+    QVERIFY(!arena.contains(&heapEntry));
+}
+
+void EntryArenaTest::testRecycle()
+{
+    EntryArena arena;
+    Archive::Entry *entry = arena.create();
+    entry->setProperty("fullPath", QStringLiteral("a/b/"));
+    entry->setProperty("isDirectory", true);
+
+    arena.recycle(entry);
+    QCOMPARE(arena.count(), 0);
+
+    Archive::Entry *reused = arena.create();
+    QCOMPARE(reused, entry);
+    QVERIFY(reused->fullPath().isEmpty());
+    QVERIFY(!reused->isDir());
+    QCOMPARE(arena.count(), 1);
+}
+
+void EntryArenaTest::testSharedString()
+{
+    EntryArena arena;
+    const QString first = arena.sharedString(QStringLiteral("root").toUpper());
+    const QString second = arena.sharedString(QStringLiteral("root").toUpper());
+
+    QCOMPARE(second, QStringLiteral("ROOT"));
+    QCOMPARE(second.constData(), first.constData());
+}
+
+void EntryArenaTest::testClear()
+{
+    EntryArena arena;
+    Archive::Entry *dir = arena.create();
+    dir->setProperty("isDirectory", true);
+
+    // Entries created by the model below the listed folders go along with them.
+    QPointer<Archive::Entry> child = new Archive::Entry(dir);
+    QPointer<Archive::Entry> entry = arena.create();
+
+    arena.clear();
+    QCOMPARE(arena.count(), 0);
+    QVERIFY(!child);
+    QVERIFY(!entry);
+}
+
+#include "entryarenatest.moc"
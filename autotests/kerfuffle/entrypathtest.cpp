@@ -0,0 +1,94 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "entrypath.h"
+
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class EntryPathTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testPath_data();
+    void testPath();
+};
+
+QTEST_GUILESS_MAIN(EntryPathTest)
+
+void EntryPathTest::testPath_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("isSkipped");
+    QTest::addColumn<QStringList>("pieces");
+    QTest::addColumn<QString>("cleanPath");
+    QTest::addColumn<QString>("normalizedPath");
+
+    QTest::newRow("file") << QStringLiteral("a/b/file.txt") << false
+                          << QStringList {QStringLiteral("a"), QStringLiteral("b"), QStringLiteral("file.txt")}
+                          << QStringLiteral("a/b/file.txt") << QStringLiteral("a/b/file.txt");
+    QTest::newRow("folder") << QStringLiteral("a/b/") << false
+                            << QStringList {QStringLiteral("a"), QStringLiteral("b")}
+                            << QStringLiteral("a/b/") << QStringLiteral("a/b/");
+    QTest::newRow("dot slash prefix") << QStringLiteral("./a/file") << false
+                                      << QStringList {QStringLiteral("a"), QStringLiteral("file")}
+                                      << QStringLiteral("a/file") << QStringLiteral("a/file");
+    QTest::newRow("absolute") << QStringLiteral("/usr/bin/") << false
+                              << QStringList {QStringLiteral("usr"), QStringLiteral("bin")}
+                              << QStringLiteral("/usr/bin/") << QStringLiteral("usr/bin/");
+    QTest::newRow("double slash") << QStringLiteral("a//file") << false
+                                  << QStringList {QStringLiteral("a"), QStringLiteral("file")}
+                                  << QStringLiteral("a//file") << QStringLiteral("a/file");
+    QTest::newRow("slash") << QStringLiteral("/") << true << QStringList() << QStringLiteral("/") << QString();
+    QTest::newRow("two slashes") << QStringLiteral("//") << true << QStringList() << QStringLiteral("//") << QString();
+    QTest::newRow("dot") << QStringLiteral(".") << true << QStringList {QStringLiteral(".")} << QStringLiteral(".") << QStringLiteral(".");
+    QTest::newRow("dot slash") << QStringLiteral("./") << true << QStringList() << QString() << QString();
+}
+
+void EntryPathTest::testPath()
+{
+    QFETCH(QString, path);
+    QFETCH(bool, isSkipped);
+    QFETCH(QStringList, pieces);
+    QFETCH(QString, cleanPath);
+    QFETCH(QString, normalizedPath);
+
+    const EntryPath entryPath(path);
+    QCOMPARE(entryPath.isSkipped(), isSkipped);
+    QCOMPARE(entryPath.count(), pieces.size());
+    for (int i = 0; i < pieces.size(); ++i) {
+        QCOMPARE(entryPath.at(i).toString(), pieces.at(i));
+    }
+    QCOMPARE(entryPath.name().toString(), pieces.isEmpty() ? QString() : pieces.last());
+    QCOMPARE(entryPath.cleanPath(), cleanPath);
+    QCOMPARE(entryPath.normalizedPath(), normalizedPath);
+}
+
+#include "entrypathtest.moc"
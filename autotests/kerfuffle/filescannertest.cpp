@@ -0,0 +1,171 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "filescanner.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class FileScannerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void initTestCase();
+    void testManifest_data();
+    void testManifest();
+    void testMetadata();
+    void testSymlinks();
+    void testMissingPath();
+
+private:
+    void createFile(const QString &name, const QByteArray &content);
+
+    QTemporaryDir m_dir;
+};
+
+QTEST_GUILESS_MAIN(FileScannerTest)
+
+void FileScannerTest::createFile(const QString &name, const QByteArray &content)
+{
+    QFile file(m_dir.path() + QLatin1Char('/') + name);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(content), qint64(content.size()));
+}
+
+void FileScannerTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    QDir dir(m_dir.path());
+    QVERIFY(dir.mkpath(QStringLiteral("tree/sub/deeper")));
+    QVERIFY(dir.mkpath(QStringLiteral("tree/empty")));
+    createFile(QStringLiteral("tree/b.txt"), "bb");
+    createFile(QStringLiteral("tree/a.txt"), "a");
+    createFile(QStringLiteral("tree/.hidden"), "hidden");
+    createFile(QStringLiteral("tree/sub/c.txt"), "ccc");
+    createFile(QStringLiteral("tree/sub/deeper/d.txt"), "dddd");
+    createFile(QStringLiteral("single.txt"), "single");
+}
+
+void FileScannerTest::testManifest_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("one thread") << 1;
+    QTest::newRow("four threads") << 4;
+}
+
+void FileScannerTest::testManifest()
+{
+    QFETCH(int, threadCount);
+
+    const QString root = m_dir.path() + QLatin1Char('/');
+    const FileManifest manifest = FileScanner::scan(QStringList {root + QStringLiteral("tree/"), root + QStringLiteral("single.txt")}, threadCount);
+
+    // Folders come before their content, siblings are sorted by name and the scanned paths keep their order.
+    QStringList paths;
+    foreach (const FileScanner::ScannedFile &file, manifest) {
+        paths << file.path.mid(root.size());
+    }
+    QCOMPARE(paths, QStringList({QStringLiteral("tree/"),
+                                 QStringLiteral("tree/.hidden"),
+                                 QStringLiteral("tree/a.txt"),
+                                 QStringLiteral("tree/b.txt"),
+                                 QStringLiteral("tree/empty"),
+                                 QStringLiteral("tree/sub"),
+                                 QStringLiteral("tree/sub/c.txt"),
+                                 QStringLiteral("tree/sub/deeper"),
+                                 QStringLiteral("tree/sub/deeper/d.txt"),
+                                 QStringLiteral("single.txt")}));
+}
+
+void FileScannerTest::testMetadata()
+{
+    const QString root = m_dir.path() + QLatin1Char('/');
+    const FileManifest manifest = FileScanner::scan(QStringList {root + QStringLiteral("tree/sub")});
+    QCOMPARE(manifest.size(), 4);
+
+    QCOMPARE(manifest.at(0).type, FileScanner::Directory);
+    QVERIFY(manifest.at(0).isDir());
+
+    const FileScanner::ScannedFile &file = manifest.at(1);
+    QCOMPARE(file.path, root + QStringLiteral("tree/sub/c.txt"));
+    QCOMPARE(file.type, FileScanner::File);
+    QCOMPARE(file.size, qint64(3));
+    QCOMPARE(file.modificationTime, QFileInfo(file.path).lastModified().toMSecsSinceEpoch() / 1000);
+    QVERIFY(file.linkTarget.isEmpty());
+}
+
+void FileScannerTest::testSymlinks()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("Symlinks are only tested on Unix.", SkipAll);
+#endif
+
+    QTemporaryDir dir;
+    QVERIFY(QDir(dir.path()).mkpath(QStringLiteral("links/target")));
+    const QString links = dir.path() + QStringLiteral("/links");
+    QFile target(links + QStringLiteral("/target/file.txt"));
+    QVERIFY(target.open(QIODevice::WriteOnly));
+    target.close();
+    QVERIFY(QFile::link(QStringLiteral("target"), links + QStringLiteral("/folder-link")));
+    QVERIFY(QFile::link(QStringLiteral("missing"), links + QStringLiteral("/broken-link")));
+
+    // Symlinks inside the scanned folders are not followed, broken ones are skipped.
+    FileManifest manifest = FileScanner::scan(QStringList {links});
+    QCOMPARE(manifest.size(), 4);
+    QCOMPARE(manifest.at(1).path, links + QStringLiteral("/folder-link"));
+    QCOMPARE(manifest.at(1).type, FileScanner::SymLink);
+    QCOMPARE(manifest.at(1).linkTarget, QStringLiteral("target"));
+    QCOMPARE(manifest.at(2).path, links + QStringLiteral("/target"));
+    QCOMPARE(manifest.at(3).path, links + QStringLiteral("/target/file.txt"));
+
+    // Scanned symlinks to folders are followed.
+    manifest = FileScanner::scan(QStringList {links + QStringLiteral("/folder-link")});
+    QCOMPARE(manifest.size(), 2);
+    QCOMPARE(manifest.at(0).type, FileScanner::SymLink);
+    QCOMPARE(manifest.at(1).path, links + QStringLiteral("/folder-link/file.txt"));
+}
+
+void FileScannerTest::testMissingPath()
+{
+    const QString path = m_dir.path() + QStringLiteral("/missing.txt");
+    const FileManifest manifest = FileScanner::scan(QStringList {path});
+    QCOMPARE(manifest.size(), 1);
+    QCOMPARE(manifest.at(0).path, path);
+    QCOMPARE(manifest.at(0).type, FileScanner::Other);
+}
+
+#include "filescannertest.moc"
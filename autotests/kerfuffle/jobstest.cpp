@@ -54,6 +54,7 @@ private Q_SLOTS:
     // ExtractJob-related tests
     void testExtractJobAccessors();
     void testTempExtractJob();
+    void testExtractJobProgress();
 
     // DeleteJob-related tests
     void testRemoveEntries_data();
@@ -269,6 +270,32 @@ void JobsTest::testTempExtractJob()
     delete job;
 }
 
+void JobsTest::testExtractJobProgress()
+{
+    JSONArchiveInterface *iface = createArchiveInterface(QFINDTESTDATA("data/archive002.json"));
+    QVERIFY(iface);
+    const QVector<Archive::Entry*> entries = listEntries(iface);
+    QCOMPARE(entries.size(), 4);
+
+    int progressSignals = 0;
+    connect(iface, &ReadOnlyArchiveInterface::progress, this, [&progressSignals]() {
+        progressSignals++;
+    });
+
+    ExtractJob *job = new ExtractJob(entries, QStringLiteral("/tmp/some-dir"), ExtractionOptions(), iface);
+    job->setAutoDelete(false);
+    startAndWaitForResult(job);
+
+    // The counters of the interface are sampled by the job, no signal is needed.
+    QCOMPARE(progressSignals, 0);
+    QCOMPARE(job->processedAmount(KJob::Files), qulonglong(entries.size()));
+    QCOMPARE(job->totalAmount(KJob::Bytes), qulonglong(45959));
+    QCOMPARE(job->processedAmount(KJob::Bytes), job->totalAmount(KJob::Bytes));
+    QCOMPARE(job->percent(), 100ul);
+
+    delete job;
+}
+
 void JobsTest::testRemoveEntries_data()
 {
     QTest::addColumn<QString>("jsonArchive");
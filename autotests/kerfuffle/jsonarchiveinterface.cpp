@@ -104,10 +104,21 @@ bool JSONArchiveInterface::copyFiles(const QVector<Kerfuffle::Archive::Entry*>&
 
 bool JSONArchiveInterface::extractFiles(const QVector<Kerfuffle::Archive::Entry*>& files, const QString &destinationDirectory, const Kerfuffle::ExtractionOptions& options)
 {
-    Q_UNUSED(files)
     Q_UNUSED(destinationDirectory)
     Q_UNUSED(options)
 
+    // Nothing is written, but the progress is reported like the plugins do.
+    qulonglong totalSize = 0;
+    foreach (const Kerfuffle::Archive::Entry *entry, files) {
+        totalSize += entry->size();
+    }
+    setTotalBytes(totalSize);
+
+    foreach (const Kerfuffle::Archive::Entry *entry, files) {
+        addProcessedBytes(entry->size());
+        addProcessedEntries();
+    }
+
     return true;
 }
 
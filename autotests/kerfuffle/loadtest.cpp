@@ -25,7 +25,9 @@
  */
 
 #include "archive_kerfuffle.h"
+#include "archiveentry.h"
 #include "jobs.h"
+#include "mimetypes.h"
 #include "pluginmanager.h"
 #include "testhelper.h"
 
@@ -41,6 +43,12 @@ class LoadTest : public QObject
 private Q_SLOTS:
     void testProperties_data();
     void testProperties();
+    void testStatisticsOnly_data();
+    void testStatisticsOnly();
+    void testSplitVolumes_data();
+    void testSplitVolumes();
+    void testEncryptedReader_data();
+    void testEncryptedReader();
 };
 
 QTEST_GUILESS_MAIN(LoadTest)
@@ -91,6 +99,12 @@ void LoadTest::testProperties_data()
             << false << true << true << false << false << 0 << Archive::Encrypted
             << QStringLiteral("archivetest_encrypted");
 
+    QTest::newRow("encrypted 7z, single entry")
+            << QFINDTESTDATA("data/archivetest_encrypted.7z")
+            << QStringLiteral("archivetest_encrypted")
+            << false << true << true << false << false << 0 << Archive::Encrypted
+            << QStringLiteral("archivetest_encrypted");
+
     QTest::newRow("simple zip, one unencrypted entry")
             << QFINDTESTDATA("data/archivetest_unencrypted.zip")
             << QStringLiteral("archivetest_unencrypted")
@@ -195,6 +209,18 @@ void LoadTest::testProperties_data()
             << true << false << false << false << true << 3 << Archive::Unencrypted
             << QStringLiteral("archive-multivolume");
 
+    QTest::newRow("tar multivolume")
+            << QFINDTESTDATA("data/archive-multivolume.tar.001")
+            << QStringLiteral("archive-multivolume")
+            << true << false << false << false << true << 3 << Archive::Unencrypted
+            << QStringLiteral("archive-multivolume");
+
+    QTest::newRow("zip multivolume")
+            << QFINDTESTDATA("data/archive-multivolume.zip.001")
+            << QStringLiteral("archive-multivolume")
+            << true << false << false << false << true << 3 << Archive::Unencrypted
+            << QStringLiteral("archive-multivolume");
+
     QTest::newRow("zip with only an empty folder")
             << QFINDTESTDATA("data/single-empty-folder.zip")
             << QStringLiteral("single-empty-folder")
@@ -259,5 +285,137 @@ void LoadTest::testProperties()
     archive->deleteLater();
 }
 
+void LoadTest::testStatisticsOnly_data()
+{
+    testProperties_data();
+}
+
+void LoadTest::testStatisticsOnly()
+{
+    QFETCH(QString, archivePath);
+    auto loadJob = Archive::load(archivePath, this);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+    loadJob->setStatisticsOnly(true);
+
+    int entriesCount = 0;
+    connect(loadJob, &Job::newEntry, this, [&entriesCount]() {
+        entriesCount++;
+    });
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    // The archive properties must not depend on the listing mode.
+    QCOMPARE(entriesCount, 0);
+    QVERIFY(!archive->interface()->isStatisticsOnlyListing());
+
+    QFETCH(bool, isSingleFolder);
+    QCOMPARE(archive->isSingleFolder(), isSingleFolder);
+
+    QFETCH(Archive::EncryptionType, expectedEncryptionType);
+    QCOMPARE(archive->encryptionType(), expectedEncryptionType);
+
+    QFETCH(QString, expectedSubfolderName);
+    QCOMPARE(archive->subfolderName(), expectedSubfolderName);
+
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+void LoadTest::testSplitVolumes_data()
+{
+    QTest::addColumn<QString>("archivePath");
+    QTest::addColumn<QString>("expectedReader");
+    QTest::addColumn<QStringList>("expectedFiles");
+
+    const QStringList largeFiles = {QStringLiteral("file1-10kb"), QStringLiteral("file2-10kb"), QStringLiteral("file3-10kb")};
+    const QStringList smallFiles = {QStringLiteral("a.txt"), QStringLiteral("testdir/testfile1.txt"), QStringLiteral("testdir/testfile2.txt")};
+
+    // The volumes are joined by libarchive, not by the plugin handling the single archives.
+    QTest::newRow("7z") << QFINDTESTDATA("data/archive-multivolume.7z.001") << QStringLiteral("ReadOnlyLibarchivePlugin") << largeFiles;
+    QTest::newRow("rar") << QFINDTESTDATA("data/archive-multivolume.part1.rar") << QStringLiteral("ReadOnlyLibarchivePlugin") << largeFiles;
+    QTest::newRow("zip") << QFINDTESTDATA("data/archive-multivolume.zip.001") << QStringLiteral("ReadOnlyLibarchivePlugin") << smallFiles;
+    QTest::newRow("tar") << QFINDTESTDATA("data/archive-multivolume.tar.001") << QStringLiteral("ReadWriteLibarchivePlugin") << smallFiles;
+}
+
+void LoadTest::testSplitVolumes()
+{
+    QFETCH(QString, archivePath);
+    auto loadJob = Archive::load(archivePath, this);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+
+    QStringList paths;
+    connect(loadJob, &Job::newEntry, this, [&paths](Archive::Entry *entry) {
+        if (!entry->isDir()) {
+            paths << entry->fullPath();
+        }
+    });
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    QFETCH(QString, expectedReader);
+    QCOMPARE(QString::fromLatin1(archive->interface()->metaObject()->className()), expectedReader);
+
+    // The entries of every volume are listed.
+    QFETCH(QStringList, expectedFiles);
+    paths.sort();
+    QCOMPARE(paths, expectedFiles);
+    QCOMPARE(archive->numberOfVolumes(), 3);
+
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+void LoadTest::testEncryptedReader_data()
+{
+    QTest::addColumn<QString>("archivePath");
+    QTest::addColumn<int>("numberOfVolumes");
+
+    QTest::newRow("7z") << QFINDTESTDATA("data/archivetest_encrypted.7z") << 0;
+    QTest::newRow("split 7z") << QFINDTESTDATA("data/archive-multivolume-encrypted.7z.001") << 3;
+}
+
+void LoadTest::testEncryptedReader()
+{
+    QFETCH(QString, archivePath);
+    const QVector<Plugin*> offers = PluginManager().preferredPluginsFor(determineMimeType(archivePath));
+    if (offers.size() < 2) {
+        QSKIP("Only one plugin can read 7z archives. Skipping test.", SkipSingle);
+    }
+
+    auto loadJob = Archive::load(archivePath, this);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive);
+    QVERIFY(archive->isValid());
+
+    // libarchive cannot ask for the password, so the archive is read by the next plugin.
+    QVERIFY(QString::fromLatin1(archive->interface()->metaObject()->className()) != QLatin1String("ReadOnlyLibarchivePlugin"));
+    QCOMPARE(archive->encryptionType(), Archive::Encrypted);
+
+    QFETCH(int, numberOfVolumes);
+    QCOMPARE(archive->numberOfVolumes(), numberOfVolumes);
+
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
 
 #include "loadtest.moc"
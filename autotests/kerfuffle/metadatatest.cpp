@@ -23,9 +23,12 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "plugin.h"
+
 #include <KPluginLoader>
 #include <KPluginMetaData>
 
+#include <QJsonObject>
 #include <QTest>
 
 class MetaDataTest : public QObject
@@ -37,6 +40,7 @@ private Q_SLOTS:
     void initTestCase();
     void testPluginLoading();
     void testPluginMetadata();
+    void testOperationPriorities();
 
 private:
 
@@ -76,7 +80,56 @@ void MetaDataTest::testPluginMetadata()
             QVERIFY(json.keys().contains(QStringLiteral("X-KDE-Kerfuffle-ReadWrite")));
             QVERIFY(json[QStringLiteral("X-KDE-Kerfuffle-ReadWrite")].toBool());
         }
+
+        const QStringList priorityKeys = {QStringLiteral("X-KDE-Kerfuffle-ReadPriority"), QStringLiteral("X-KDE-Kerfuffle-WritePriority")};
+        foreach (const QString &key, priorityKeys) {
+            if (json.keys().contains(key)) {
+                QVERIFY(json[key].isDouble());
+            }
+        }
+    }
+}
+
+void MetaDataTest::testOperationPriorities()
+{
+    QJsonObject json;
+    json[QStringLiteral("X-KDE-Priority")] = 100;
+    json[QStringLiteral("X-KDE-Kerfuffle-WritePriority")] = 150;
+
+    Kerfuffle::Plugin plugin(nullptr, KPluginMetaData(json, QString()));
+    QCOMPARE(plugin.priority(), 100);
+    QCOMPARE(plugin.readPriority(), 100);
+    QCOMPARE(plugin.writePriority(), 150);
+
+    // 7z archives are read in-process and modified by the 7z executable.
+    const QString mimeType = QStringLiteral("application/x-7z-compressed");
+    QStringList pluginIds;
+    QString reader;
+    QString writer;
+    int readPriority = -1;
+    int writePriority = -1;
+    foreach (const KPluginMetaData &metaData, m_plugins) {
+        if (!metaData.mimeTypes().contains(mimeType)) {
+            continue;
+        }
+
+        pluginIds << metaData.pluginId();
+        Kerfuffle::Plugin shippedPlugin(nullptr, metaData);
+        if (shippedPlugin.readPriority() > readPriority) {
+            readPriority = shippedPlugin.readPriority();
+            reader = metaData.pluginId();
+        }
+        if (metaData.rawData()[QStringLiteral("X-KDE-Kerfuffle-ReadWrite")].toBool() && shippedPlugin.writePriority() > writePriority) {
+            writePriority = shippedPlugin.writePriority();
+            writer = metaData.pluginId();
+        }
+    }
+
+    if (!pluginIds.contains(QStringLiteral("kerfuffle_libarchive_readonly")) || !pluginIds.contains(QStringLiteral("kerfuffle_cli7z"))) {
+        QSKIP("The libarchive and cli7z plugins are not both installed. Skipping test.", SkipSingle);
     }
+    QCOMPARE(reader, QStringLiteral("kerfuffle_libarchive_readonly"));
+    QCOMPARE(writer, QStringLiteral("kerfuffle_cli7z"));
 }
 
 QTEST_GUILESS_MAIN(MetaDataTest)
@@ -0,0 +1,237 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "archiveentry.h"
+#include "jobs.h"
+#include "pluginmanager.h"
+#include "testhelper.h"
+
+#include <QCryptographicHash>
+#include <QMimeDatabase>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class TransactionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testTransaction_data();
+    void testTransaction();
+    void testChangedFile();
+
+private:
+    PluginManager m_pluginManager;
+};
+
+QTEST_GUILESS_MAIN(TransactionTest)
+
+static QByteArray fileHash(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+void TransactionTest::testTransaction_data()
+{
+    QTest::addColumn<QString>("archiveName");
+    QTest::addColumn<Plugin*>("plugin");
+    QTest::addColumn<bool>("supportsTransactions");
+
+    const auto formats = QStringList {
+        QStringLiteral("tar.bz2"),
+        QStringLiteral("zip")
+    };
+
+    foreach (const QString &format, formats) {
+        const QString filename = QStringLiteral("test.%1").arg(format);
+        const auto mime = QMimeDatabase().mimeTypeForFile(filename, QMimeDatabase::MatchExtension);
+
+        const auto plugins = m_pluginManager.preferredWritePluginsFor(mime);
+        foreach (const auto plugin, plugins) {
+            QTest::newRow(qPrintable(QStringLiteral("%1, %2").arg(format, plugin->metaData().pluginId())))
+                << filename
+                << plugin
+                // Only libarchive queues the changes, the other plugins write them right away.
+                << (plugin->metaData().pluginId() == QLatin1String("kerfuffle_libarchive"));
+        }
+    }
+}
+
+void TransactionTest::testTransaction()
+{
+    QTemporaryDir temporaryDir;
+
+    QFETCH(QString, archiveName);
+    const QString archivePath = QStringLiteral("%1/%2").arg(temporaryDir.path(), archiveName);
+    QVERIFY(QFile::copy(QFINDTESTDATA(QStringLiteral("data/%1").arg(archiveName)), archivePath));
+
+    QFETCH(Plugin*, plugin);
+    QVERIFY(plugin);
+
+    auto loadJob = Archive::load(archivePath, plugin);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive);
+
+    if (!archive->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    QFETCH(bool, supportsTransactions);
+    QCOMPARE(archive->beginTransaction(), supportsTransactions);
+
+    QCOMPARE(archive->numberOfEntries(), 13u);
+    const QByteArray originalHash = fileHash(archivePath);
+
+    QVector<Archive::Entry*> deletedEntries { new Archive::Entry(this, QStringLiteral("a.txt")) };
+    TestHelper::startAndWaitForResult(archive->deleteFiles(deletedEntries));
+    QCOMPARE(archive->numberOfEntries(), 12u);
+
+    const QVector<Archive::Entry*> renamedEntries { new Archive::Entry(this, QStringLiteral("b.txt")) };
+    TestHelper::startAndWaitForResult(archive->moveFiles(renamedEntries, new Archive::Entry(this, QStringLiteral("c.txt"))));
+    QCOMPARE(archive->numberOfEntries(), 12u);
+
+    const QVector<Archive::Entry*> copiedEntries { new Archive::Entry(this, QStringLiteral("dir1/a.txt")) };
+    TestHelper::startAndWaitForResult(archive->copyFiles(copiedEntries, new Archive::Entry(this, QStringLiteral("dir2/"))));
+    QCOMPARE(archive->numberOfEntries(), 13u);
+
+    if (supportsTransactions) {
+        // Nothing is written until the transaction is committed.
+        QVERIFY(archive->hasPendingChanges());
+        QCOMPARE(fileHash(archivePath), originalHash);
+
+        auto commitJob = archive->commitTransaction();
+        QVERIFY(commitJob);
+        TestHelper::startAndWaitForResult(commitJob);
+    } else {
+        QVERIFY(!archive->hasPendingChanges());
+    }
+    QVERIFY(!archive->isInTransaction());
+    QVERIFY(fileHash(archivePath) != originalHash);
+
+    // Reload the archive to check what has been written.
+    auto reloadJob = Archive::load(archivePath, plugin);
+    QVERIFY(reloadJob);
+    reloadJob->setAutoDelete(false);
+
+    QStringList paths;
+    connect(reloadJob, &Job::newEntry, this, [&paths](Archive::Entry *entry) {
+        paths << entry->fullPath();
+    });
+    TestHelper::startAndWaitForResult(reloadJob);
+    paths.sort();
+
+    const QStringList expectedPaths {
+        QStringLiteral("c.txt"),
+        QStringLiteral("dir1/"),
+        QStringLiteral("dir1/a.txt"),
+        QStringLiteral("dir1/b.txt"),
+        QStringLiteral("dir1/dir/"),
+        QStringLiteral("dir1/dir/a.txt"),
+        QStringLiteral("dir1/dir/b.txt"),
+        QStringLiteral("dir2/"),
+        QStringLiteral("dir2/a.txt"),
+        QStringLiteral("dir2/dir/"),
+        QStringLiteral("dir2/dir/a.txt"),
+        QStringLiteral("dir2/dir/b.txt"),
+        QStringLiteral("empty_dir/")
+    };
+    QCOMPARE(paths, expectedPaths);
+
+    reloadJob->archive()->deleteLater();
+    reloadJob->deleteLater();
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+void TransactionTest::testChangedFile()
+{
+    QTemporaryDir temporaryDir;
+    const QString archivePath = temporaryDir.path() + QStringLiteral("/test.tar.bz2");
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/test.tar.bz2"), archivePath));
+
+    Plugin *plugin = nullptr;
+    const auto mime = QMimeDatabase().mimeTypeForFile(archivePath, QMimeDatabase::MatchExtension);
+    foreach (Plugin *writePlugin, m_pluginManager.preferredWritePluginsFor(mime)) {
+        if (writePlugin->metaData().pluginId() == QLatin1String("kerfuffle_libarchive")) {
+            plugin = writePlugin;
+        }
+    }
+    if (!plugin) {
+        QSKIP("The libarchive plugin is not available. Skipping test.", SkipSingle);
+    }
+
+    auto loadJob = Archive::load(archivePath, plugin);
+    QVERIFY(loadJob);
+    loadJob->setAutoDelete(false);
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive && archive->isValid());
+    QVERIFY(archive->beginTransaction());
+
+    QFile file(temporaryDir.path() + QStringLiteral("/added.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QVERIFY(file.write("Queued content\n") > 0);
+    file.close();
+
+    CompressionOptions options;
+    options.setGlobalWorkDir(temporaryDir.path());
+    TestHelper::startAndWaitForResult(archive->addFiles({new Archive::Entry(this, QStringLiteral("added.txt"))}, nullptr, options));
+    QVERIFY(archive->hasPendingChanges());
+
+    // The file changes before the transaction is committed.
+    QVERIFY(file.open(QIODevice::Append));
+    QVERIFY(file.write("Changed content\n") > 0);
+    file.close();
+
+    const QByteArray originalHash = fileHash(archivePath);
+    auto commitJob = archive->commitTransaction();
+    QVERIFY(commitJob);
+    commitJob->setAutoDelete(false);
+    TestHelper::startAndWaitForResult(commitJob);
+    QVERIFY(commitJob->error());
+    QCOMPARE(fileHash(archivePath), originalHash);
+
+    commitJob->deleteLater();
+    loadJob->deleteLater();
+    archive->deleteLater();
+}
+
+#include "transactiontest.moc"
@@ -0,0 +1,107 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "zipextractionplanner.h"
+
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class ZipExtractionPlannerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testCentralDirectory();
+    void testOrder();
+    void testRanges();
+    void testInvalidArchive_data();
+    void testInvalidArchive();
+};
+
+QTEST_GUILESS_MAIN(ZipExtractionPlannerTest)
+
+void ZipExtractionPlannerTest::testCentralDirectory()
+{
+    ZipExtractionPlanner planner(QFINDTESTDATA("data/test.zip"));
+    QVERIFY(planner.isValid());
+    QCOMPARE(planner.memberCount(), 13);
+
+    QCOMPARE(planner.indexOf(QStringLiteral("a.txt")), 0);
+    QCOMPARE(planner.indexOf(QStringLiteral("dir1/")), 2);
+    QCOMPARE(planner.indexOf(QStringLiteral("empty_dir/")), 12);
+    QCOMPARE(planner.indexOf(QStringLiteral("missing.txt")), -1);
+
+    QCOMPARE(planner.offset(0), qint64(0));
+    QCOMPARE(planner.offset(1), qint64(55));
+    QCOMPARE(planner.offset(planner.indexOf(QStringLiteral("dir2/dir/b.txt"))), qint64(570));
+}
+
+void ZipExtractionPlannerTest::testOrder()
+{
+    ZipExtractionPlanner planner(QFINDTESTDATA("data/test.zip"));
+    QVERIFY(planner.isValid());
+
+    const QVector<int> selection = {11, 0, 6, 3};
+    QCOMPARE(planner.sortedByOffset(selection), QVector<int>({0, 3, 6, 11}));
+}
+
+void ZipExtractionPlannerTest::testRanges()
+{
+    ZipExtractionPlanner planner(QFINDTESTDATA("data/test.zip"));
+    QVERIFY(planner.isValid());
+
+    // The members of a small archive are close enough to be read in one go.
+    const QVector<ZipExtractionPlanner::Range> ranges = planner.ranges({12, 1, 4});
+    QCOMPARE(ranges.size(), 1);
+    QCOMPARE(ranges.first().begin, qint64(55));
+    QCOMPARE(ranges.first().members, QVector<int>({1, 4, 12}));
+    QVERIFY(ranges.first().end > planner.offset(12));
+
+    QVERIFY(planner.ranges(QVector<int>()).isEmpty());
+}
+
+void ZipExtractionPlannerTest::testInvalidArchive_data()
+{
+    QTest::addColumn<QString>("archiveName");
+
+    QTest::newRow("7z") << QFINDTESTDATA("data/test.7z");
+    QTest::newRow("tar.gz") << QFINDTESTDATA("data/simplearchive.tar.gz");
+    QTest::newRow("missing file") << QStringLiteral("/nonexistent/archive.zip");
+}
+
+void ZipExtractionPlannerTest::testInvalidArchive()
+{
+    QFETCH(QString, archiveName);
+
+    ZipExtractionPlanner planner(archiveName);
+    QVERIFY(!planner.isValid());
+    QCOMPARE(planner.memberCount(), 0);
+}
+
+#include "zipextractionplannertest.moc"
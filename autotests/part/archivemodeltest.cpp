@@ -0,0 +1,372 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archivemodel.h"
+#include "jobs.h"
+#include "testhelper.h"
+
+#include <KJob>
+
+#include <QDir>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class ArchiveModelTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void testTotals();
+    void testTotalsAfterDelete();
+    void testCleanupEmptyDirs_data();
+    void testCleanupEmptyDirs();
+    void testNeverExpandedFolders_data();
+    void testNeverExpandedFolders();
+    void testFetchingChildren();
+
+private:
+    ArchiveModel *loadModel(const QString &archivePath);
+    bool deleteFiles(ArchiveModel *model, const QStringList &paths);
+    bool addFile(ArchiveModel *model, const QString &destination);
+    static void fetchAll(ArchiveModel *model, const QModelIndex &parent = QModelIndex());
+    static QModelIndex topLevelIndex(ArchiveModel *model, const QString &path);
+    static QStringList fetchChildren(ArchiveModel *model, const QString &path);
+    static const Archive::Entry *entryAt(const ArchiveModel *model, const QString &path);
+    static QString totals(const ArchiveModel *model, const QString &path);
+    static QStringList describe(const ArchiveModel *model);
+
+    QTemporaryDir *m_tempDir = nullptr;
+    QString m_archivePath;
+    ArchiveModel *m_model = nullptr;
+};
+
+QTEST_GUILESS_MAIN(ArchiveModelTest)
+
+void ArchiveModelTest::init()
+{
+    // Only "explicit/" is listed, the other folders are created for their entries.
+    m_tempDir = new QTemporaryDir;
+    m_archivePath = m_tempDir->path() + QLatin1String("/nested.tar.gz");
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/nested.tar.gz"), m_archivePath));
+
+    m_model = loadModel(m_archivePath);
+    if (!m_model) {
+        QSKIP("Could not load the archive, the libarchive plugin is probably missing. Skipping test.", SkipSingle);
+    }
+}
+
+void ArchiveModelTest::cleanup()
+{
+    delete m_model;
+    m_model = nullptr;
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+ArchiveModel *ArchiveModelTest::loadModel(const QString &archivePath)
+{
+    ArchiveModel *model = new ArchiveModel(QStringLiteral("/ArchiveModelTest"), this);
+    KJob *loadJob = model->loadArchive(archivePath, QString(), model);
+    if (!loadJob) {
+        delete model;
+        return nullptr;
+    }
+    TestHelper::startAndWaitForResult(loadJob);
+    if (loadJob->error()) {
+        delete model;
+        return nullptr;
+    }
+    return model;
+}
+
+bool ArchiveModelTest::deleteFiles(ArchiveModel *model, const QStringList &paths)
+{
+    QVector<Archive::Entry*> entries;
+    foreach (const QString &path, paths) {
+        entries << new Archive::Entry(model, path);
+    }
+
+    KJob *deleteJob = model->deleteFiles(entries);
+    if (!deleteJob) {
+        return false;
+    }
+    TestHelper::startAndWaitForResult(deleteJob);
+    return !deleteJob->error();
+}
+
+bool ArchiveModelTest::addFile(ArchiveModel *model, const QString &destination)
+{
+    const QString sourceDir = m_tempDir->path() + QLatin1String("/source");
+    QFile file(sourceDir + QLatin1String("/new.txt"));
+    if (!QDir().mkpath(sourceDir) || !file.open(QIODevice::WriteOnly) || file.write("new file") != 8) {
+        return false;
+    }
+    file.close();
+
+    QVector<Archive::Entry*> entries {new Archive::Entry(model, QStringLiteral("new.txt"))};
+    CompressionOptions options;
+    options.setGlobalWorkDir(sourceDir);
+    KJob *addJob = model->addFiles(entries, new Archive::Entry(model, destination), options);
+    if (!addJob) {
+        return false;
+    }
+    TestHelper::startAndWaitForResult(addJob);
+    return !addJob->error();
+}
+
+void ArchiveModelTest::fetchAll(ArchiveModel *model, const QModelIndex &parent)
+{
+    if (model->canFetchMore(parent)) {
+        model->fetchMore(parent);
+    }
+    for (int row = 0; row < model->rowCount(parent); ++row) {
+        fetchAll(model, model->index(row, 0, parent));
+    }
+}
+
+QModelIndex ArchiveModelTest::topLevelIndex(ArchiveModel *model, const QString &path)
+{
+    for (int row = 0; row < model->rowCount(); ++row) {
+        if (model->entryForIndex(model->index(row, 0))->fullPath() == path) {
+            return model->index(row, 0);
+        }
+    }
+    return QModelIndex();
+}
+
+QStringList ArchiveModelTest::fetchChildren(ArchiveModel *model, const QString &path)
+{
+    // The same walk as Part::addChildren(), which collects the entries to extract or delete.
+    QModelIndexList indexes {topLevelIndex(model, path)};
+    if (!indexes.first().isValid()) {
+        return QStringList();
+    }
+
+    QStringList paths;
+    for (int i = 0; i < indexes.size(); ++i) {
+        const QModelIndex index = indexes.at(i);
+        paths << model->entryForIndex(index)->fullPath();
+        if (model->canFetchMore(index)) {
+            model->fetchMore(index);
+        }
+        for (int row = 0; row < model->rowCount(index); ++row) {
+            indexes << model->index(row, 0, index);
+        }
+    }
+    paths.sort();
+    return paths;
+}
+
+const Archive::Entry *ArchiveModelTest::entryAt(const ArchiveModel *model, const QString &path)
+{
+    foreach (const Archive::Entry *entry, model->allEntries()) {
+        if (entry->fullPath() == path) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+QString ArchiveModelTest::totals(const ArchiveModel *model, const QString &path)
+{
+    const Archive::Entry *dir = path.isEmpty() ? nullptr : entryAt(model, path);
+    if (!path.isEmpty() && !dir) {
+        return QStringLiteral("<missing>");
+    }
+
+    const ArchiveModel::DirectoryAggregate aggregate = model->aggregateFor(dir);
+    return QStringLiteral("children=%1+%2 dirs=%3 files=%4 size=%5")
+           .arg(aggregate.childDirs).arg(aggregate.childFiles)
+           .arg(aggregate.dirs).arg(aggregate.files).arg(aggregate.size);
+}
+
+QStringList ArchiveModelTest::describe(const ArchiveModel *model)
+{
+    // The order of the entries depends on which folders were fetched, so it is not compared.
+    QStringList lines;
+    foreach (const Archive::Entry *entry, model->allEntries()) {
+        if (entry->isDir()) {
+            lines << entry->fullPath() + QLatin1Char(' ') + totals(model, entry->fullPath());
+        } else {
+            lines << entry->fullPath() + QStringLiteral(" size=%1").arg(entry->size());
+        }
+    }
+    lines.sort();
+
+    lines.prepend(QStringLiteral("archive dirs=%1 files=%2 size=%3")
+                  .arg(model->numberOfFolders()).arg(model->numberOfFiles()).arg(model->uncompressedSize()));
+    return lines;
+}
+
+void ArchiveModelTest::testTotals()
+{
+    QCOMPARE(m_model->numberOfFiles(), qulonglong(6));
+    QCOMPARE(m_model->numberOfFolders(), qulonglong(5));
+    QCOMPARE(m_model->uncompressedSize(), qulonglong(315));
+
+    QCOMPARE(totals(m_model, QString()), QStringLiteral("children=3+1 dirs=5 files=6 size=315"));
+    QCOMPARE(totals(m_model, QStringLiteral("top/")), QStringLiteral("children=1+1 dirs=2 files=3 size=70"));
+    QCOMPARE(totals(m_model, QStringLiteral("top/sub/")), QStringLiteral("children=1+1 dirs=1 files=2 size=60"));
+    QCOMPARE(totals(m_model, QStringLiteral("top/sub/deep/")), QStringLiteral("children=0+1 dirs=0 files=1 size=40"));
+    QCOMPARE(totals(m_model, QStringLiteral("explicit/")), QStringLiteral("children=0+1 dirs=0 files=1 size=160"));
+}
+
+void ArchiveModelTest::testTotalsAfterDelete()
+{
+    QVERIFY(deleteFiles(m_model, QStringList({QStringLiteral("a.txt"), QStringLiteral("top/sub/c.txt")})));
+
+    QCOMPARE(m_model->numberOfFiles(), qulonglong(4));
+    QCOMPARE(m_model->numberOfFolders(), qulonglong(5));
+    QCOMPARE(m_model->uncompressedSize(), qulonglong(290));
+    QCOMPARE(totals(m_model, QStringLiteral("top/")), QStringLiteral("children=1+1 dirs=2 files=2 size=50"));
+    QCOMPARE(totals(m_model, QStringLiteral("top/sub/")), QStringLiteral("children=1+0 dirs=1 files=1 size=40"));
+
+    // The totals kept up-to-date are those computed when listing the modified archive.
+    QScopedPointer<ArchiveModel> relisted(loadModel(m_archivePath));
+    QVERIFY(relisted);
+    QCOMPARE(describe(m_model), describe(relisted.data()));
+}
+
+void ArchiveModelTest::testCleanupEmptyDirs_data()
+{
+    QTest::addColumn<QStringList>("deletedPaths");
+    QTest::addColumn<QStringList>("removedDirs");
+    QTest::addColumn<QStringList>("keptDirs");
+
+    QTest::newRow("implicit folder")
+            << QStringList {QStringLiteral("other/e.txt")}
+            << QStringList {QStringLiteral("other/")}
+            << QStringList {QStringLiteral("top/"), QStringLiteral("explicit/")};
+    QTest::newRow("nested implicit folder")
+            << QStringList {QStringLiteral("top/sub/deep/d.txt")}
+            << QStringList {QStringLiteral("top/sub/deep/")}
+            << QStringList {QStringLiteral("top/"), QStringLiteral("top/sub/")};
+    QTest::newRow("implicit folders emptied up to the top")
+            << QStringList {QStringLiteral("top/b.txt"), QStringLiteral("top/sub/c.txt"), QStringLiteral("top/sub/deep/d.txt")}
+            << QStringList {QStringLiteral("top/"), QStringLiteral("top/sub/"), QStringLiteral("top/sub/deep/")}
+            << QStringList {QStringLiteral("other/")};
+    QTest::newRow("listed folder")
+            << QStringList {QStringLiteral("explicit/f.txt")}
+            << QStringList()
+            << QStringList {QStringLiteral("explicit/")};
+}
+
+void ArchiveModelTest::testCleanupEmptyDirs()
+{
+    QFETCH(QStringList, deletedPaths);
+    QFETCH(QStringList, removedDirs);
+    QFETCH(QStringList, keptDirs);
+
+    QVERIFY(deleteFiles(m_model, deletedPaths));
+
+    foreach (const QString &path, removedDirs) {
+        QVERIFY2(!entryAt(m_model, path), qPrintable(path));
+    }
+    foreach (const QString &path, keptDirs) {
+        QVERIFY2(entryAt(m_model, path), qPrintable(path));
+    }
+
+    // The folders which are not in the archive anymore are not listed either.
+    QScopedPointer<ArchiveModel> relisted(loadModel(m_archivePath));
+    QVERIFY(relisted);
+    QCOMPARE(describe(m_model), describe(relisted.data()));
+}
+
+void ArchiveModelTest::testNeverExpandedFolders_data()
+{
+    QTest::addColumn<QStringList>("deletedPaths");
+    QTest::addColumn<QString>("addDestination");
+
+    QTest::newRow("delete in unfetched folder")
+            << QStringList {QStringLiteral("top/sub/deep/d.txt")} << QString();
+    QTest::newRow("delete unfetched folder")
+            << QStringList {QStringLiteral("explicit/"), QStringLiteral("explicit/f.txt")} << QString();
+    QTest::newRow("delete whole unfetched tree")
+            << QStringList {QStringLiteral("top/b.txt"), QStringLiteral("top/sub/c.txt"), QStringLiteral("top/sub/deep/d.txt")}
+            << QString();
+    QTest::newRow("add to unfetched folder")
+            << QStringList() << QStringLiteral("top/sub/");
+    QTest::newRow("add to new folder in unfetched folder")
+            << QStringList() << QStringLiteral("other/more/");
+    QTest::newRow("add to removed folder")
+            << QStringList {QStringLiteral("top/sub/deep/d.txt")} << QStringLiteral("top/sub/deep/");
+}
+
+void ArchiveModelTest::testNeverExpandedFolders()
+{
+    QFETCH(QStringList, deletedPaths);
+    QFETCH(QString, addDestination);
+
+    // The same changes are made to a fully built tree, in a copy of the archive.
+    const QString expandedPath = m_tempDir->path() + QLatin1String("/expanded.tar.gz");
+    QVERIFY(QFile::copy(m_archivePath, expandedPath));
+    QScopedPointer<ArchiveModel> expanded(loadModel(expandedPath));
+    QVERIFY(expanded);
+    fetchAll(expanded.data());
+    QVERIFY(m_model->canFetchMore(topLevelIndex(m_model, QStringLiteral("top/"))));
+    QVERIFY(!expanded->canFetchMore(topLevelIndex(expanded.data(), QStringLiteral("top/"))));
+    QCOMPARE(describe(m_model), describe(expanded.data()));
+
+    foreach (ArchiveModel *model, QVector<ArchiveModel*>({m_model, expanded.data()})) {
+        if (!deletedPaths.isEmpty()) {
+            QVERIFY(deleteFiles(model, deletedPaths));
+        }
+        if (!addDestination.isEmpty()) {
+            QVERIFY(addFile(model, addDestination));
+        }
+    }
+
+    QCOMPARE(describe(m_model), describe(expanded.data()));
+
+    QScopedPointer<ArchiveModel> relisted(loadModel(m_archivePath));
+    QVERIFY(relisted);
+    QCOMPARE(describe(m_model), describe(relisted.data()));
+
+    // Fetching the remaining folders does not change the tree either.
+    fetchAll(m_model);
+    QCOMPARE(describe(m_model), describe(expanded.data()));
+}
+
+void ArchiveModelTest::testFetchingChildren()
+{
+    const QStringList expectedPaths {QStringLiteral("top/"), QStringLiteral("top/b.txt"), QStringLiteral("top/sub/"),
+                                     QStringLiteral("top/sub/c.txt"), QStringLiteral("top/sub/deep/"), QStringLiteral("top/sub/deep/d.txt")};
+
+    QVERIFY(m_model->canFetchMore(topLevelIndex(m_model, QStringLiteral("top/"))));
+    QCOMPARE(fetchChildren(m_model, QStringLiteral("top/")), expectedPaths);
+
+    QScopedPointer<ArchiveModel> expanded(loadModel(m_archivePath));
+    QVERIFY(expanded);
+    fetchAll(expanded.data());
+    QCOMPARE(fetchChildren(expanded.data(), QStringLiteral("top/")), expectedPaths);
+}
+
+#include "archivemodeltest.moc"
@@ -0,0 +1,184 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archivemodel.h"
+#include "flatentrymodel.h"
+#include "testhelper.h"
+
+#include <KJob>
+
+#include <QSignalSpy>
+#include <QTest>
+
+class FlatEntryModelTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void testSort_data();
+    void testSort();
+    void testSearch();
+    void testMapToSource();
+
+private:
+    QStringList shownPaths() const;
+    int sizeColumn() const;
+
+    ArchiveModel *m_model = nullptr;
+    FlatEntryModel *m_flatModel = nullptr;
+};
+
+QTEST_GUILESS_MAIN(FlatEntryModelTest)
+
+void FlatEntryModelTest::init()
+{
+    m_model = new ArchiveModel(QStringLiteral("/FlatEntryModelTest"), this);
+    m_flatModel = new FlatEntryModel(m_model, this);
+
+    KJob *loadJob = m_model->loadArchive(QFINDTESTDATA("data/flatlist.tar.gz"), QString(), m_model);
+    QVERIFY(loadJob);
+    TestHelper::startAndWaitForResult(loadJob);
+    if (loadJob->error()) {
+        QSKIP("Could not load the archive, the libarchive plugin is probably missing. Skipping test.", SkipSingle);
+    }
+
+    // The list is built in another thread.
+    m_flatModel->setActive(true);
+    QTRY_COMPARE(m_flatModel->rowCount(), 5);
+    QTRY_VERIFY(!m_flatModel->isBuildPending());
+}
+
+void FlatEntryModelTest::cleanup()
+{
+    delete m_flatModel;
+    m_flatModel = nullptr;
+    delete m_model;
+    m_model = nullptr;
+}
+
+QStringList FlatEntryModelTest::shownPaths() const
+{
+    QStringList paths;
+    for (int row = 0; row < m_flatModel->rowCount(); ++row) {
+        paths << m_flatModel->index(row, 0).data().toString();
+    }
+    return paths;
+}
+
+int FlatEntryModelTest::sizeColumn() const
+{
+    for (int column = 0; column < m_flatModel->columnCount(); ++column) {
+        if (m_flatModel->headerData(column, Qt::Horizontal).toString() == m_model->headerData(m_model->shownColumns().indexOf(Size), Qt::Horizontal).toString()) {
+            return column;
+        }
+    }
+    return -1;
+}
+
+void FlatEntryModelTest::testSort_data()
+{
+    QTest::addColumn<bool>("bySize");
+    QTest::addColumn<bool>("descending");
+    QTest::addColumn<QStringList>("expectedPaths");
+
+    // Paths are sorted like the tree: case-insensitively, with numbers in their numeric order.
+    QTest::newRow("path, ascending")
+            << false << false
+            << QStringList {QStringLiteral("a.txt"), QStringLiteral("B.txt"), QStringLiteral("dir/c.txt"), QStringLiteral("file2.txt"), QStringLiteral("file10.txt")};
+    QTest::newRow("path, descending")
+            << false << true
+            << QStringList {QStringLiteral("file10.txt"), QStringLiteral("file2.txt"), QStringLiteral("dir/c.txt"), QStringLiteral("B.txt"), QStringLiteral("a.txt")};
+    QTest::newRow("size, descending")
+            << true << true
+            << QStringList {QStringLiteral("B.txt"), QStringLiteral("file10.txt"), QStringLiteral("dir/c.txt"), QStringLiteral("file2.txt"), QStringLiteral("a.txt")};
+}
+
+void FlatEntryModelTest::testSort()
+{
+    QFETCH(bool, bySize);
+    QFETCH(bool, descending);
+
+    const int column = bySize ? sizeColumn() : 0;
+    QVERIFY(column >= 0);
+
+    m_flatModel->sort(column, descending ? Qt::DescendingOrder : Qt::AscendingOrder);
+    QVERIFY(!m_flatModel->isSortPending());
+
+    QFETCH(QStringList, expectedPaths);
+    QCOMPARE(shownPaths(), expectedPaths);
+}
+
+void FlatEntryModelTest::testSearch()
+{
+    m_flatModel->sort(0, Qt::AscendingOrder);
+
+    QSet<const Archive::Entry*> results;
+    foreach (const Archive::Entry *entry, m_model->allEntries()) {
+        if (entry->fullPath().startsWith(QLatin1String("file"))) {
+            results.insert(entry);
+        }
+    }
+    QCOMPARE(results.size(), 2);
+
+    // The views keep their state: rows are removed and inserted rather than reset.
+    QSignalSpy resetSpy(m_flatModel, &QAbstractItemModel::modelReset);
+    QSignalSpy removedSpy(m_flatModel, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy insertedSpy(m_flatModel, &QAbstractItemModel::rowsInserted);
+
+    QPersistentModelIndex selected(m_flatModel->index(3, 0));
+    QCOMPARE(selected.data().toString(), QStringLiteral("file2.txt"));
+
+    m_flatModel->setSearchResults(results);
+    QCOMPARE(shownPaths(), QStringList({QStringLiteral("file2.txt"), QStringLiteral("file10.txt")}));
+    QVERIFY(removedSpy.count() > 0);
+    QCOMPARE(selected.row(), 0);
+
+    m_flatModel->clearSearchResults();
+    QCOMPARE(shownPaths(), QStringList({QStringLiteral("a.txt"), QStringLiteral("B.txt"), QStringLiteral("dir/c.txt"),
+                                        QStringLiteral("file2.txt"), QStringLiteral("file10.txt")}));
+    QVERIFY(insertedSpy.count() > 0);
+    QCOMPARE(selected.row(), 3);
+    QCOMPARE(resetSpy.count(), 0);
+}
+
+void FlatEntryModelTest::testMapToSource()
+{
+    for (int row = 0; row < m_flatModel->rowCount(); ++row) {
+        const QModelIndex index = m_flatModel->index(row, 0);
+        const QModelIndex sourceIndex = m_flatModel->mapToSource(index);
+        QVERIFY(sourceIndex.isValid());
+
+        // The parent folders of the file were fetched so that the index is valid.
+        const Archive::Entry *entry = m_model->entryForIndex(sourceIndex);
+        QVERIFY(entry);
+        QCOMPARE(entry->fullPath(), index.data().toString());
+    }
+}
+
+#include "flatentrymodeltest.moc"
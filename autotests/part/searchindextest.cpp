@@ -0,0 +1,228 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archivemodel.h"
+#include "searchindex.h"
+#include "testhelper.h"
+
+#include <KJob>
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Kerfuffle;
+
+Q_DECLARE_METATYPE(QSet<const Kerfuffle::Archive::Entry*>)
+
+class SearchIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void testSearch_data();
+    void testSearch();
+    void testNarrowing();
+    void testRebuildAfterRemoval();
+
+private:
+    QStringList search(const QString &text, SearchIndex::QueryType type);
+    QStringList paths(const QSet<const Archive::Entry*> &entries) const;
+
+    QTemporaryDir *m_tempDir = nullptr;
+    ArchiveModel *m_model = nullptr;
+    SearchIndex *m_index = nullptr;
+};
+
+QTEST_GUILESS_MAIN(SearchIndexTest)
+
+void SearchIndexTest::init()
+{
+    qRegisterMetaType<QSet<const Archive::Entry*> >();
+
+    // The archive is modified by some tests.
+    m_tempDir = new QTemporaryDir;
+    const QString archivePath = m_tempDir->path() + QLatin1String("/flatlist.tar.gz");
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/flatlist.tar.gz"), archivePath));
+
+    m_model = new ArchiveModel(QStringLiteral("/SearchIndexTest"), this);
+    m_index = new SearchIndex(m_model, this);
+
+    KJob *loadJob = m_model->loadArchive(archivePath, QString(), m_model);
+    QVERIFY(loadJob);
+    TestHelper::startAndWaitForResult(loadJob);
+    if (loadJob->error()) {
+        QSKIP("Could not load the archive, the libarchive plugin is probably missing. Skipping test.", SkipSingle);
+    }
+}
+
+void SearchIndexTest::cleanup()
+{
+    delete m_index;
+    m_index = nullptr;
+    delete m_model;
+    m_model = nullptr;
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QStringList SearchIndexTest::search(const QString &text, SearchIndex::QueryType type)
+{
+    QSignalSpy spy(m_index, &SearchIndex::resultsReady);
+    m_index->search(text, type);
+    if (!spy.wait()) {
+        return QStringList(QStringLiteral("<no results reported>"));
+    }
+    return paths(spy.last().at(0).value<QSet<const Archive::Entry*> >());
+}
+
+QStringList SearchIndexTest::paths(const QSet<const Archive::Entry*> &entries) const
+{
+    // Only entries still in the model are looked at, removed ones might have been deleted.
+    QStringList paths;
+    foreach (const Archive::Entry *entry, m_model->allEntries()) {
+        if (entries.contains(entry)) {
+            paths << entry->fullPath();
+        }
+    }
+    if (paths.size() != entries.size()) {
+        paths << QStringLiteral("<removed entry>");
+    }
+    paths.sort();
+    return paths;
+}
+
+void SearchIndexTest::testSearch_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("type");
+    QTest::addColumn<QStringList>("expectedPaths");
+
+    // The parent folders of the matches are reported too.
+    QTest::newRow("substring")
+            << QStringLiteral("file") << int(SearchIndex::Substring)
+            << QStringList {QStringLiteral("file10.txt"), QStringLiteral("file2.txt")};
+    QTest::newRow("substring, other case")
+            << QStringLiteral("b.TXT") << int(SearchIndex::Substring)
+            << QStringList {QStringLiteral("B.txt")};
+    QTest::newRow("substring, names only")
+            << QStringLiteral("dir") << int(SearchIndex::Substring)
+            << QStringList {QStringLiteral("dir/")};
+    QTest::newRow("substring, full path")
+            << QStringLiteral("dir/c") << int(SearchIndex::Substring)
+            << QStringList {QStringLiteral("dir/"), QStringLiteral("dir/c.txt")};
+    QTest::newRow("substring, shorter than a trigram")
+            << QStringLiteral("c.") << int(SearchIndex::Substring)
+            << QStringList {QStringLiteral("dir/"), QStringLiteral("dir/c.txt")};
+    QTest::newRow("substring, no match")
+            << QStringLiteral("zzz") << int(SearchIndex::Substring)
+            << QStringList();
+    QTest::newRow("wildcard")
+            << QStringLiteral("file*.txt") << int(SearchIndex::Wildcard)
+            << QStringList {QStringLiteral("file10.txt"), QStringLiteral("file2.txt")};
+    QTest::newRow("wildcard, single character")
+            << QStringLiteral("?.txt") << int(SearchIndex::Wildcard)
+            << QStringList {QStringLiteral("B.txt"), QStringLiteral("a.txt"), QStringLiteral("dir/"), QStringLiteral("dir/c.txt")};
+    QTest::newRow("wildcard, character set")
+            << QStringLiteral("[ab].txt") << int(SearchIndex::Wildcard)
+            << QStringList {QStringLiteral("B.txt"), QStringLiteral("a.txt")};
+    QTest::newRow("regular expression")
+            << QStringLiteral("^file\\d{2}") << int(SearchIndex::RegularExpression)
+            << QStringList {QStringLiteral("file10.txt")};
+    QTest::newRow("invalid regular expression")
+            << QStringLiteral("file[") << int(SearchIndex::RegularExpression)
+            << QStringList();
+}
+
+void SearchIndexTest::testSearch()
+{
+    QFETCH(QString, text);
+    QFETCH(int, type);
+    QFETCH(QStringList, expectedPaths);
+
+    QCOMPARE(search(text, static_cast<SearchIndex::QueryType>(type)), expectedPaths);
+}
+
+void SearchIndexTest::testNarrowing()
+{
+    // Longer substrings only look at the previous matches, which must not lose any.
+    QCOMPARE(search(QStringLiteral("f"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file10.txt"), QStringLiteral("file2.txt")}));
+    QCOMPARE(search(QStringLiteral("fil"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file10.txt"), QStringLiteral("file2.txt")}));
+    QCOMPARE(search(QStringLiteral("file1"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file10.txt")}));
+
+    // Shorter or different texts search the whole index again.
+    QCOMPARE(search(QStringLiteral("file"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file10.txt"), QStringLiteral("file2.txt")}));
+    QCOMPARE(search(QStringLiteral("ile2"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file2.txt")}));
+
+    // Names and full paths are not narrowed down from each other.
+    QCOMPARE(search(QStringLiteral("c"), SearchIndex::Substring),
+             QStringList({QStringLiteral("dir/"), QStringLiteral("dir/c.txt")}));
+    QCOMPARE(search(QStringLiteral("dir/c"), SearchIndex::Substring),
+             QStringList({QStringLiteral("dir/"), QStringLiteral("dir/c.txt")}));
+
+    // Neither are the other query types.
+    QCOMPARE(search(QStringLiteral("file"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file10.txt"), QStringLiteral("file2.txt")}));
+    QCOMPARE(search(QStringLiteral("*.txt"), SearchIndex::Wildcard),
+             QStringList({QStringLiteral("B.txt"), QStringLiteral("a.txt"), QStringLiteral("dir/"),
+                          QStringLiteral("dir/c.txt"), QStringLiteral("file10.txt"), QStringLiteral("file2.txt")}));
+}
+
+void SearchIndexTest::testRebuildAfterRemoval()
+{
+    QCOMPARE(search(QStringLiteral("file"), SearchIndex::Substring),
+             QStringList({QStringLiteral("file10.txt"), QStringLiteral("file2.txt")}));
+
+    Archive::Entry *removedEntry = nullptr;
+    for (int row = 0; row < m_model->rowCount(); ++row) {
+        Archive::Entry *entry = m_model->entryForIndex(m_model->index(row, 0));
+        if (entry && entry->fullPath() == QLatin1String("file2.txt")) {
+            removedEntry = entry;
+        }
+    }
+    QVERIFY(removedEntry);
+
+    // The current search is answered again once the index is rebuilt without the removed rows.
+    QSignalSpy spy(m_index, &SearchIndex::resultsReady);
+    KJob *deleteJob = m_model->deleteFiles(QVector<Archive::Entry*> {removedEntry});
+    QVERIFY(deleteJob);
+    TestHelper::startAndWaitForResult(deleteJob);
+    QVERIFY(!deleteJob->error());
+
+    QTRY_VERIFY(spy.count() > 0);
+    QCOMPARE(paths(spy.last().at(0).value<QSet<const Archive::Entry*> >()), QStringList({QStringLiteral("file10.txt")}));
+    QCOMPARE(search(QStringLiteral("file2"), SearchIndex::Substring), QStringList());
+}
+
+#include "searchindextest.moc"
@@ -30,10 +30,15 @@
 #include "testhelper.h"
 
 #include <QFile>
+#include <QProcess>
 #include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QTextStream>
+#include <QThread>
 
+#include <KIO/RenameDialog>
 #include <KPluginLoader>
 
 QTEST_GUILESS_MAIN(Cli7zTest)
@@ -238,6 +243,38 @@ void Cli7zTest::testList()
     plugin->deleteLater();
 }
 
+void Cli7zTest::testSolid_data()
+{
+    QTest::addColumn<QString>("outputTextFile");
+    QTest::addColumn<bool>("isSolid");
+
+    QTest::newRow("solid-7z")
+            << QFINDTESTDATA("data/archive-encrypted-1602.txt") << true;
+
+    QTest::newRow("zip")
+            << QFINDTESTDATA("data/archive-zip-AES256-1602.txt") << false;
+}
+
+void Cli7zTest::testSolid()
+{
+    CliPlugin *plugin = new CliPlugin(this, {QStringLiteral("dummy.7z"),
+                                             QVariant::fromValue(m_plugin->metaData())});
+
+    QFETCH(QString, outputTextFile);
+    QFile outputText(outputTextFile);
+    QVERIFY(outputText.open(QIODevice::ReadOnly));
+
+    QTextStream outputStream(&outputText);
+    while (!outputStream.atEnd()) {
+        QVERIFY(plugin->readListLine(outputStream.readLine()));
+    }
+
+    QFETCH(bool, isSolid);
+    QCOMPARE(plugin->isSolid(), isSolid);
+
+    plugin->deleteLater();
+}
+
 void Cli7zTest::testListArgs_data()
 {
     QTest::addColumn<QString>("archiveName");
@@ -475,3 +512,78 @@ void Cli7zTest::testExtractArgs()
     plugin->deleteLater();
 }
 
+void Cli7zTest::testParallelOverwrite()
+{
+    if (!m_plugin->isValid()) {
+        QSKIP("cli7z plugin not available. Skipping test.", SkipSingle);
+    }
+    if (QThread::idealThreadCount() < 2) {
+        QSKIP("The files are only extracted by several processes on several cores. Skipping test.", SkipSingle);
+    }
+
+    QTemporaryDir sourceDir;
+    QTemporaryDir destDir;
+    QVERIFY(sourceDir.isValid());
+    QVERIFY(destDir.isValid());
+
+    // Two files large enough to be extracted by two processes.
+    const QStringList fileNames = {QStringLiteral("a.bin"), QStringLiteral("b.bin")};
+    foreach (const QString &fileName, fileNames) {
+        QFile file(sourceDir.path() + QLatin1Char('/') + fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QByteArray block(1024 * 1024, 0);
+        for (int i = 0; i < 9; ++i) {
+            for (int j = 0; j < block.size(); ++j) {
+                block[j] = static_cast<char>(qrand());
+            }
+            QVERIFY(file.write(block) == block.size());
+        }
+
+        QFile existingFile(destDir.path() + QLatin1Char('/') + fileName);
+        QVERIFY(existingFile.open(QIODevice::WriteOnly));
+        existingFile.write(QByteArrayLiteral("existing"));
+    }
+
+    // A non-solid archive, so that the files can be extracted in parallel.
+    const QString archivePath = sourceDir.path() + QLatin1String("/archive.7z");
+    QProcess archiver;
+    archiver.setWorkingDirectory(sourceDir.path());
+    archiver.start(QStandardPaths::findExecutable(QStringLiteral("7z")), QStringList {QStringLiteral("a"), QStringLiteral("-ms=off"), archivePath} + fileNames);
+    QVERIFY(archiver.waitForFinished());
+    QCOMPARE(archiver.exitCode(), 0);
+
+    auto loadJob = Archive::load(archivePath, m_plugin, this);
+    QVERIFY(loadJob);
+    QVector<Archive::Entry*> entries;
+    connect(loadJob, &Job::newEntry, this, [&entries](Archive::Entry *entry) {
+        entries << entry;
+    });
+    TestHelper::startAndWaitForResult(loadJob);
+    auto archive = loadJob->archive();
+    QVERIFY(archive && archive->isValid());
+    QCOMPARE(entries.size(), fileNames.size());
+
+    // Each process asks for its own file, which is skipped.
+    QStringList askedFiles;
+    auto extractJob = archive->extractFiles(entries, destDir.path(), ExtractionOptions());
+    QVERIFY(extractJob);
+    connect(extractJob, &Job::userQuery, this, [&askedFiles](Query *query) {
+        auto overwriteQuery = dynamic_cast<OverwriteQuery*>(query);
+        QVERIFY(overwriteQuery);
+        askedFiles << QFileInfo(overwriteQuery->filename()).fileName();
+        overwriteQuery->setResponse(KIO::R_SKIP);
+    });
+    TestHelper::startAndWaitForResult(extractJob);
+    QVERIFY(!extractJob->error());
+
+    askedFiles.sort();
+    QCOMPARE(askedFiles, fileNames);
+    foreach (const QString &fileName, fileNames) {
+        QFile existingFile(destDir.path() + QLatin1Char('/') + fileName);
+        QVERIFY(existingFile.open(QIODevice::ReadOnly));
+        QCOMPARE(existingFile.readAll(), QByteArrayLiteral("existing"));
+    }
+
+    qDeleteAll(entries);
+    archive->deleteLater();
+}
@@ -40,12 +40,15 @@ private Q_SLOTS:
     void testArchive();
     void testList_data();
     void testList();
+    void testSolid_data();
+    void testSolid();
     void testListArgs_data();
     void testListArgs();
     void testAddArgs_data();
     void testAddArgs();
     void testExtractArgs_data();
     void testExtractArgs();
+    void testParallelOverwrite();
 
 private:
     PluginManager m_pluginManger;
@@ -0,0 +1,276 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "archivebenchmark.h"
+#include "jobs.h"
+#include "plugin.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+using namespace Kerfuffle;
+
+ArchiveBenchmark::ArchiveBenchmark(const QString &workDir, QObject *parent)
+    : QObject(parent)
+    , m_workDir(workDir)
+{
+}
+
+qint64 ArchiveBenchmark::startAndMeasure(KJob *job, QString *errorString)
+{
+    QEventLoop eventLoop;
+    QElapsedTimer timer;
+    bool failed = false;
+
+    // The job deletes itself once finished, so read its outcome in the result slot.
+    QObject::connect(job, &KJob::result, &eventLoop, [&](KJob *finishedJob) {
+        failed = finishedJob->error() != KJob::NoError;
+        if (failed && errorString) {
+            *errorString = finishedJob->errorString();
+        }
+        eventLoop.quit();
+    });
+
+    timer.start();
+    job->start();
+    eventLoop.exec(); // krazy:exclude=crashy
+    const qint64 elapsed = timer.elapsed();
+
+    return failed ? -1 : elapsed;
+}
+
+void ArchiveBenchmark::setContext(const QString &corpus, const QString &archivePath, Plugin *plugin)
+{
+    m_context = QJsonObject {
+        {QStringLiteral("corpus"), corpus},
+        {QStringLiteral("archive"), QFileInfo(archivePath).fileName()},
+        {QStringLiteral("plugin"), plugin->metaData().pluginId()}
+    };
+}
+
+QJsonObject ArchiveBenchmark::measure(const QString &operation, KJob *job)
+{
+    if (!job) {
+        return unsupported(operation);
+    }
+
+    QString errorString;
+    const qint64 elapsed = startAndMeasure(job, &errorString);
+
+    QJsonObject result = m_context;
+    result.insert(QStringLiteral("operation"), operation);
+    result.insert(QStringLiteral("success"), elapsed >= 0);
+    if (elapsed >= 0) {
+        result.insert(QStringLiteral("milliseconds"), elapsed);
+    } else {
+        result.insert(QStringLiteral("error"), errorString);
+    }
+
+    // The progress goes to the standard error, so that the JSON results can be redirected.
+    QTextStream progress(stderr);
+    progress << m_context.value(QStringLiteral("archive")).toString() << ' '
+             << m_context.value(QStringLiteral("plugin")).toString() << ' ' << operation << ' ';
+    if (elapsed >= 0) {
+        progress << elapsed << " ms" << endl;
+    } else {
+        progress << "failed: " << errorString << endl;
+    }
+    return result;
+}
+
+QJsonObject ArchiveBenchmark::unsupported(const QString &operation)
+{
+    QJsonObject result = m_context;
+    result.insert(QStringLiteral("operation"), operation);
+    result.insert(QStringLiteral("success"), false);
+    result.insert(QStringLiteral("error"), QStringLiteral("unsupported"));
+    return result;
+}
+
+QJsonArray ArchiveBenchmark::runCreate(const QString &corpus, const QString &corpusDir, const QString &archivePath, Plugin *plugin)
+{
+    QJsonArray results;
+    setContext(corpus, archivePath, plugin);
+
+    QFile::remove(archivePath);
+    timeAdd(corpusDir, archivePath, plugin, results);
+
+    return results;
+}
+
+QJsonArray ArchiveBenchmark::runReadWrite(const QString &corpus, const QString &corpusDir, const QString &archivePath, Plugin *plugin)
+{
+    QJsonArray results;
+    setContext(corpus, archivePath, plugin);
+
+    QFile::remove(archivePath);
+    timeAdd(corpusDir, archivePath, plugin, results);
+    if (!QFileInfo::exists(archivePath)) {
+        return results;
+    }
+
+    QVector<Archive::Entry*> entries;
+    Archive *archive = timeList(archivePath, plugin, entries, results);
+    if (!archive) {
+        return results;
+    }
+
+    timeReadOperations(archive, entries, results);
+    timeWriteOperations(archive, entries, results);
+
+    delete archive;
+    return results;
+}
+
+QJsonArray ArchiveBenchmark::runReadOnly(const QString &corpus, const QString &archivePath, Plugin *plugin)
+{
+    QJsonArray results;
+    setContext(corpus, archivePath, plugin);
+
+    QVector<Archive::Entry*> entries;
+    Archive *archive = timeList(archivePath, plugin, entries, results);
+    if (!archive) {
+        return results;
+    }
+
+    timeReadOperations(archive, entries, results);
+
+    delete archive;
+    return results;
+}
+
+void ArchiveBenchmark::timeAdd(const QString &corpusDir, const QString &archivePath, Plugin *plugin, QJsonArray &results)
+{
+    // Loading a non-existent file gives us an empty archive handled by the given plugin.
+    auto loadJob = Archive::load(archivePath, plugin);
+    Archive *archive = loadJob->archive();
+    delete loadJob;
+
+    if (!archive->isValid() || archive->isReadOnly()) {
+        results.append(unsupported(QStringLiteral("add")));
+        delete archive;
+        return;
+    }
+
+    QVector<Archive::Entry*> entries;
+    const auto fileInfos = QDir(corpusDir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+    for (const QFileInfo &info : fileInfos) {
+        entries << new Archive::Entry(archive, info.isDir() ? info.fileName() + QLatin1Char('/') : info.fileName());
+    }
+
+    CompressionOptions options;
+    options.setGlobalWorkDir(corpusDir);
+    Archive::Entry destination(archive);
+    results.append(measure(QStringLiteral("add"), archive->addFiles(entries, &destination, options)));
+
+    delete archive;
+}
+
+Archive *ArchiveBenchmark::timeList(const QString &archivePath, Plugin *plugin, QVector<Archive::Entry*> &entries, QJsonArray &results)
+{
+    auto loadJob = Archive::load(archivePath, plugin);
+    Archive *archive = loadJob->archive();
+    connect(loadJob, &Job::newEntry, this, [&entries](Archive::Entry *entry) {
+        entries << entry;
+    });
+
+    QJsonObject result = measure(QStringLiteral("list"), loadJob);
+    result.insert(QStringLiteral("entries"), entries.count());
+    results.append(result);
+
+    if (!result.value(QStringLiteral("success")).toBool()) {
+        delete archive;
+        return nullptr;
+    }
+
+    return archive;
+}
+
+void ArchiveBenchmark::timeReadOperations(Archive *archive, const QVector<Archive::Entry*> &entries, QJsonArray &results)
+{
+    results.append(measure(QStringLiteral("test"), archive->testArchive()));
+
+    {
+        QTemporaryDir destination(m_workDir + QStringLiteral("/extract-XXXXXX"));
+        results.append(measure(QStringLiteral("extract-all"), archive->extractFiles({}, destination.path())));
+    }
+
+    // Every tenth file.
+    QVector<Archive::Entry*> selection;
+    for (int i = 0; i < entries.count(); i += 10) {
+        if (!entries.at(i)->isDir()) {
+            selection << entries.at(i);
+        }
+    }
+
+    QTemporaryDir destination(m_workDir + QStringLiteral("/extract-XXXXXX"));
+    QJsonObject result = measure(QStringLiteral("extract-selective"), archive->extractFiles(selection, destination.path()));
+    result.insert(QStringLiteral("entries"), selection.count());
+    results.append(result);
+}
+
+void ArchiveBenchmark::timeWriteOperations(Archive *archive, const QVector<Archive::Entry*> &entries, QJsonArray &results)
+{
+    if (archive->isReadOnly()) {
+        results.append(unsupported(QStringLiteral("move")));
+        results.append(unsupported(QStringLiteral("delete")));
+        return;
+    }
+
+    Archive::Entry *renamedEntry = nullptr;
+    foreach (Archive::Entry *entry, entries) {
+        if (!entry->isDir()) {
+            renamedEntry = entry;
+            break;
+        }
+    }
+
+    if (renamedEntry) {
+        Archive::Entry destination(archive, renamedEntry->fullPath() + QStringLiteral(".renamed"));
+        results.append(measure(QStringLiteral("move"), archive->moveFiles({renamedEntry}, &destination)));
+    } else {
+        results.append(unsupported(QStringLiteral("move")));
+    }
+
+    // Every tenth file, skipping the renamed one.
+    QVector<Archive::Entry*> selection;
+    for (int i = 5; i < entries.count(); i += 10) {
+        if (!entries.at(i)->isDir() && entries.at(i) != renamedEntry) {
+            selection << entries.at(i);
+        }
+    }
+
+    QJsonObject result = measure(QStringLiteral("delete"), archive->deleteFiles(selection));
+    result.insert(QStringLiteral("entries"), selection.count());
+    results.append(result);
+}
@@ -0,0 +1,92 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ARCHIVEBENCHMARK_H
+#define ARCHIVEBENCHMARK_H
+
+#include "archive_kerfuffle.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+class KJob;
+
+namespace Kerfuffle
+{
+class Plugin;
+}
+
+/**
+ * Times the kerfuffle jobs on an archive created from a corpus.
+ * Every timed operation produces a JSON object with its duration and outcome.
+ */
+class ArchiveBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ArchiveBenchmark(const QString &workDir, QObject *parent = nullptr);
+
+    /**
+     * Time the creation of the archive @p archivePath from @p corpusDir with @p plugin.
+     */
+    QJsonArray runCreate(const QString &corpus, const QString &corpusDir, const QString &archivePath, Kerfuffle::Plugin *plugin);
+
+    /**
+     * Create the archive @p archivePath from @p corpusDir with @p plugin,
+     * then time all the read and write operations on it.
+     */
+    QJsonArray runReadWrite(const QString &corpus, const QString &corpusDir, const QString &archivePath, Kerfuffle::Plugin *plugin);
+
+    /**
+     * Time the read operations on the existing archive @p archivePath, opened with @p plugin.
+     */
+    QJsonArray runReadOnly(const QString &corpus, const QString &archivePath, Kerfuffle::Plugin *plugin);
+
+    /**
+     * Start @p job and wait for its result.
+     * @return The duration of the job in milliseconds, or -1 if the job failed.
+     */
+    static qint64 startAndMeasure(KJob *job, QString *errorString = nullptr);
+
+private:
+
+    void setContext(const QString &corpus, const QString &archivePath, Kerfuffle::Plugin *plugin);
+    QJsonObject measure(const QString &operation, KJob *job);
+    QJsonObject unsupported(const QString &operation);
+
+    void timeAdd(const QString &corpusDir, const QString &archivePath, Kerfuffle::Plugin *plugin, QJsonArray &results);
+    Kerfuffle::Archive *timeList(const QString &archivePath, Kerfuffle::Plugin *plugin, QVector<Kerfuffle::Archive::Entry*> &entries, QJsonArray &results);
+    void timeReadOperations(Kerfuffle::Archive *archive, const QVector<Kerfuffle::Archive::Entry*> &entries, QJsonArray &results);
+    void timeWriteOperations(Kerfuffle::Archive *archive, const QVector<Kerfuffle::Archive::Entry*> &entries, QJsonArray &results);
+
+    QString m_workDir;
+    QJsonObject m_context;
+};
+
+#endif // ARCHIVEBENCHMARK_H
@@ -0,0 +1,93 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "capabilitybenchmark.h"
+#include "capabilitycache.h"
+#include "pluginmanager.h"
+
+#include <QElapsedTimer>
+#include <QMimeDatabase>
+
+#include <algorithm>
+
+using namespace Kerfuffle;
+
+namespace
+{
+
+double median(QVector<qint64> nanoseconds)
+{
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+    return nanoseconds.at(nanoseconds.size() / 2) / 1e3;
+}
+
+}
+
+QJsonObject CapabilityBenchmark::run(int iterations)
+{
+    QVector<qint64> coldTimes;
+    QVector<qint64> savedTimes;
+    QVector<qint64> warmTimes;
+    QVector<qint64> preferredTimes;
+    int mimeTypesCount = 0;
+
+    const QMimeType mimeType = QMimeDatabase().mimeTypeForName(QStringLiteral("application/x-compressed-tar"));
+    QElapsedTimer timer;
+
+    for (int i = 0; i < iterations; ++i) {
+        // The plugins are loaded before timing, only the queries are measured.
+        CapabilityCache::self()->clear(true);
+        PluginManager coldManager;
+        timer.start();
+        mimeTypesCount = coldManager.supportedMimeTypes().size();
+        coldTimes << timer.nsecsElapsed();
+
+        // What the next process does, with the capabilities saved in the cache directory.
+        CapabilityCache::self()->clear();
+        PluginManager savedManager;
+        timer.start();
+        savedManager.supportedMimeTypes();
+        savedTimes << timer.nsecsElapsed();
+
+        timer.start();
+        savedManager.supportedMimeTypes();
+        warmTimes << timer.nsecsElapsed();
+
+        timer.start();
+        savedManager.preferredPluginsFor(mimeType);
+        preferredTimes << timer.nsecsElapsed();
+    }
+
+    return QJsonObject {
+        {QStringLiteral("iterations"), iterations},
+        {QStringLiteral("mimeTypes"), mimeTypesCount},
+        {QStringLiteral("coldMicroseconds"), median(coldTimes)},
+        {QStringLiteral("savedMicroseconds"), median(savedTimes)},
+        {QStringLiteral("warmMicroseconds"), median(warmTimes)},
+        {QStringLiteral("preferredPluginsMicroseconds"), median(preferredTimes)}
+    };
+}
@@ -0,0 +1,225 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "corpusgenerator.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    const QString tinyFiles = QStringLiteral("tiny-files");
+    const QString hugeFiles = QStringLiteral("huge-files");
+    const QString deepTree = QStringLiteral("deep-tree");
+    const QString flatDir = QStringLiteral("flat-dir");
+    const QString incompressible = QStringLiteral("incompressible");
+}
+
+CorpusGenerator::CorpusGenerator(double scale)
+    : m_scale(scale)
+    , m_seed(0)
+{
+}
+
+QStringList CorpusGenerator::availableCorpora()
+{
+    return {tinyFiles, hugeFiles, deepTree, flatDir, incompressible};
+}
+
+bool CorpusGenerator::generate(const QString &name, const QString &directory)
+{
+    // Same seed for the same corpus, so that the generated data does not depend on the generation order.
+    m_seed = qHash(name);
+    m_entriesCount = 0;
+    m_bytesCount = 0;
+
+    if (name == tinyFiles) {
+        return generateTinyFiles(directory);
+    } else if (name == hugeFiles) {
+        return generateHugeFiles(directory);
+    } else if (name == deepTree) {
+        return generateDeepTree(directory);
+    } else if (name == flatDir) {
+        return generateFlatDir(directory);
+    } else if (name == incompressible) {
+        return generateIncompressible(directory);
+    }
+
+    qWarning() << "Unknown corpus:" << name;
+    return false;
+}
+
+qulonglong CorpusGenerator::entriesCount() const
+{
+    return m_entriesCount;
+}
+
+qulonglong CorpusGenerator::bytesCount() const
+{
+    return m_bytesCount;
+}
+
+int CorpusGenerator::scaled(int count) const
+{
+    return qMax(1, static_cast<int>(count * m_scale));
+}
+
+bool CorpusGenerator::makeDir(const QString &path)
+{
+    if (!QDir().mkpath(path)) {
+        qWarning() << "Could not create directory" << path;
+        return false;
+    }
+
+    m_entriesCount++;
+    return true;
+}
+
+bool CorpusGenerator::writeFile(const QString &path, qint64 size, bool compressible)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not create file" << path;
+        return false;
+    }
+
+    static const char *words[] = {"archive ", "entry ", "folder ", "kerfuffle ", "lorem ", "ipsum ", "ark ", "\n"};
+
+    std::mt19937 generator(m_seed++);
+    QByteArray chunk;
+    chunk.reserve(64 * 1024);
+
+    qint64 remaining = size;
+    while (remaining > 0) {
+        chunk.clear();
+        const int chunkSize = static_cast<int>(qMin<qint64>(remaining, 64 * 1024));
+        if (compressible) {
+            while (chunk.size() < chunkSize) {
+                chunk.append(words[generator() % 8]);
+            }
+            chunk.truncate(chunkSize);
+        } else {
+            chunk.resize(chunkSize);
+            std::generate(chunk.begin(), chunk.end(), [&generator]() {
+                return static_cast<char>(generator());
+            });
+        }
+
+        if (file.write(chunk) != chunk.size()) {
+            qWarning() << "Could not write to file" << path;
+            return false;
+        }
+        remaining -= chunkSize;
+    }
+
+    m_entriesCount++;
+    m_bytesCount += size;
+    return true;
+}
+
+bool CorpusGenerator::generateTinyFiles(const QString &directory)
+{
+    // Many files between 0 and 512 bytes, spread over a few folders.
+    const int dirs = scaled(100);
+    const int filesPerDir = 100;
+    for (int i = 0; i < dirs; i++) {
+        const QString dir = QStringLiteral("%1/dir%2").arg(directory).arg(i);
+        if (!makeDir(dir)) {
+            return false;
+        }
+        for (int j = 0; j < filesPerDir; j++) {
+            if (!writeFile(QStringLiteral("%1/file%2.txt").arg(dir).arg(j), (i * filesPerDir + j) % 513, true)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool CorpusGenerator::generateHugeFiles(const QString &directory)
+{
+    const qint64 size = static_cast<qint64>(128 * 1024 * 1024 * m_scale);
+    for (int i = 0; i < 4; i++) {
+        if (!writeFile(QStringLiteral("%1/huge%2.dat").arg(directory).arg(i), size, true)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CorpusGenerator::generateDeepTree(const QString &directory)
+{
+    // A few branches, each of them nested 100 levels deep with a small file on every level.
+    const int branches = scaled(10);
+    for (int i = 0; i < branches; i++) {
+        QString dir = QStringLiteral("%1/branch%2").arg(directory).arg(i);
+        for (int level = 0; level < 100; level++) {
+            dir += QStringLiteral("/level%1").arg(level);
+            if (!makeDir(dir) || !writeFile(dir + QStringLiteral("/file.txt"), 1024, true)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool CorpusGenerator::generateFlatDir(const QString &directory)
+{
+    const QString dir = directory + QStringLiteral("/flat");
+    if (!makeDir(dir)) {
+        return false;
+    }
+
+    const int files = scaled(500000);
+    for (int i = 0; i < files; i++) {
+        if (!writeFile(QStringLiteral("%1/entry%2").arg(dir).arg(i, 6, 10, QLatin1Char('0')), 16, true)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CorpusGenerator::generateIncompressible(const QString &directory)
+{
+    const qint64 size = static_cast<qint64>(16 * 1024 * 1024 * m_scale);
+    for (int i = 0; i < 16; i++) {
+        if (!writeFile(QStringLiteral("%1/random%2.bin").arg(directory).arg(i), size, false)) {
+            return false;
+        }
+    }
+
+    return true;
+}
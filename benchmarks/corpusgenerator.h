@@ -0,0 +1,87 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Generates the synthetic file trees that ark-bench archives.
+ * The generated data only depends on the corpus name and scale, so results are comparable between runs.
+ */
+class CorpusGenerator
+{
+public:
+
+    /**
+     * @param scale Multiplier applied to the number and size of the generated files.
+     */
+    explicit CorpusGenerator(double scale = 1.0);
+
+    /**
+     * @return The names of all the available corpora.
+     */
+    static QStringList availableCorpora();
+
+    /**
+     * Generate the corpus @p name inside @p directory, which must exist.
+     * @return Whether the corpus has been generated successfully.
+     */
+    bool generate(const QString &name, const QString &directory);
+
+    /**
+     * @return The number of files and folders written by the last generate() call.
+     */
+    qulonglong entriesCount() const;
+
+    /**
+     * @return The number of bytes written by the last generate() call.
+     */
+    qulonglong bytesCount() const;
+
+private:
+
+    int scaled(int count) const;
+    bool writeFile(const QString &path, qint64 size, bool compressible);
+    bool makeDir(const QString &path);
+
+    bool generateTinyFiles(const QString &directory);
+    bool generateHugeFiles(const QString &directory);
+    bool generateDeepTree(const QString &directory);
+    bool generateFlatDir(const QString &directory);
+    bool generateIncompressible(const QString &directory);
+
+    double m_scale;
+    quint32 m_seed;
+    qulonglong m_entriesCount = 0;
+    qulonglong m_bytesCount = 0;
+};
+
+#endif // CORPUSGENERATOR_H
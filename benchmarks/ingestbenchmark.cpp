@@ -0,0 +1,182 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ingestbenchmark.h"
+#include "archiveinterface.h"
+#include "archivemodel.h"
+#include "entrypath.h"
+#include "jobs.h"
+#include "listingstatistics.h"
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+
+using namespace Kerfuffle;
+
+namespace
+{
+
+double entriesPerSecond(int entriesCount, qint64 nanoseconds)
+{
+    return nanoseconds > 0 ? entriesCount * 1e9 / nanoseconds : 0;
+}
+
+// Lists the given paths like a plugin lists the entries of an archive.
+class SyntheticArchiveInterface : public ReadOnlyArchiveInterface
+{
+public:
+    explicit SyntheticArchiveInterface(const QStringList &listing)
+        : ReadOnlyArchiveInterface(nullptr, {QStringLiteral("synthetic.tar"), QVariant::fromValue(KPluginMetaData())})
+        , m_listing(listing)
+    {
+    }
+
+    bool list() override
+    {
+        qulonglong size = 0;
+        foreach (const QString &path, m_listing) {
+            Archive::Entry *e = createEntry();
+            e->setProperty("fullPath", path);
+            e->setProperty("isDirectory", path.endsWith(QLatin1Char('/')));
+            e->setProperty("size", ++size % 65536);
+            emit entry(e);
+        }
+        return true;
+    }
+
+    bool testArchive() override
+    {
+        return true;
+    }
+
+    bool extractFiles(const QVector<Archive::Entry*> &files, const QString &destinationDirectory, const ExtractionOptions &options) override
+    {
+        Q_UNUSED(files)
+        Q_UNUSED(destinationDirectory)
+        Q_UNUSED(options)
+        return false;
+    }
+
+private:
+    const QStringList m_listing;
+};
+
+}
+
+QJsonObject IngestBenchmark::run(int entriesCount)
+{
+    const QStringList listing = generateListing(entriesCount);
+
+    QElapsedTimer timer;
+
+    // What the model does with the path of each listed entry.
+    timer.start();
+    int skipped = 0;
+    qint64 pieces = 0;
+    foreach (const QString &path, listing) {
+        const EntryPath entryPath(path);
+        if (entryPath.isSkipped()) {
+            skipped++;
+            continue;
+        }
+        pieces += entryPath.count();
+        const QString key = entryPath.normalizedPath();
+        Q_UNUSED(key)
+    }
+    const qint64 pathTime = timer.nsecsElapsed();
+
+    // What LoadJob does with each listed entry.
+    timer.restart();
+    ListingStatistics statistics;
+    foreach (const QString &path, listing) {
+        statistics.addEntry(path, path.endsWith(QLatin1Char('/')), 0, false);
+    }
+    const qint64 statisticsTime = timer.nsecsElapsed();
+
+    // Everything done for each entry from the plugin to the tree shown by the part.
+    qulonglong modelFiles = 0;
+    const qint64 modelTime = loadIntoModel(listing, &modelFiles);
+
+    return QJsonObject {
+        {QStringLiteral("entries"), entriesCount},
+        {QStringLiteral("skippedEntries"), skipped},
+        {QStringLiteral("pieces"), pieces},
+        {QStringLiteral("modelFiles"), static_cast<qint64>(modelFiles)},
+        {QStringLiteral("pathEntriesPerSecond"), entriesPerSecond(entriesCount, pathTime)},
+        {QStringLiteral("statisticsEntriesPerSecond"), entriesPerSecond(entriesCount, statisticsTime)},
+        {QStringLiteral("modelEntriesPerSecond"), entriesPerSecond(entriesCount, modelTime)},
+        {QStringLiteral("entriesPerSecond"), entriesPerSecond(entriesCount, pathTime + statisticsTime)}
+    };
+}
+
+qint64 IngestBenchmark::loadIntoModel(const QStringList &listing, qulonglong *files)
+{
+    // The interface owns the entries, so it must outlive the model.
+    SyntheticArchiveInterface iface(listing);
+    ArchiveModel model(QStringLiteral("/ArkBench"));
+
+    QEventLoop eventLoop;
+    bool failed = false;
+    KJob *job = model.loadArchive(new LoadJob(&iface));
+    job->setAutoDelete(false);
+    // Connected after the model, so the tree is built when this runs.
+    QObject::connect(job, &KJob::result, &eventLoop, [&](KJob *finishedJob) {
+        failed = finishedJob->error() != KJob::NoError;
+        eventLoop.quit();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    job->start();
+    eventLoop.exec(); // krazy:exclude=crashy
+    const qint64 elapsed = timer.nsecsElapsed();
+    delete job;
+
+    *files = model.numberOfFiles();
+    return failed ? -1 : elapsed;
+}
+
+QStringList IngestBenchmark::generateListing(int entriesCount)
+{
+    // Mostly plain paths, with some folders, "./" prefixes and doubled slashes like real listings have.
+    QStringList listing;
+    listing.reserve(entriesCount);
+    for (int i = 0; i < entriesCount; ++i) {
+        const QString dir = QStringLiteral("project/module%1/src%2/").arg(i % 97).arg(i % 13);
+        if (i % 50 == 0) {
+            listing << dir;
+        } else if (i % 20 == 0) {
+            listing << QStringLiteral("./") + dir + QStringLiteral("file%1.cpp").arg(i);
+        } else if (i % 1000 == 1) {
+            listing << QStringLiteral("project//orphan%1.txt").arg(i);
+        } else {
+            listing << dir + QStringLiteral("file%1.cpp").arg(i);
+        }
+    }
+    return listing;
+}
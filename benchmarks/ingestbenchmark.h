@@ -0,0 +1,62 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef INGESTBENCHMARK_H
+#define INGESTBENCHMARK_H
+
+#include <QJsonObject>
+#include <QStringList>
+
+/**
+ * Times the per-entry work done while an archive is listed, on synthetic paths:
+ * splitting and normalizing the path, the listing statistics, and the whole
+ * listing of the entries by a LoadJob into the part's ArchiveModel.
+ * No archive is involved, the entries are emitted by a synthetic interface.
+ */
+class IngestBenchmark
+{
+public:
+
+    /**
+     * Generate a listing of @p entriesCount paths, and ingest it.
+     * @return The JSON object with the ingest rates, in entries per second.
+     */
+    QJsonObject run(int entriesCount);
+
+private:
+
+    static QStringList generateListing(int entriesCount);
+
+    /**
+     * List @p listing into a new ArchiveModel, and build its tree.
+     * @return The elapsed nanoseconds, or -1 if the listing failed.
+     */
+    static qint64 loadIntoModel(const QStringList &listing, qulonglong *files);
+};
+
+#endif // INGESTBENCHMARK_H
@@ -0,0 +1,231 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ark_version.h"
+#include "archivebenchmark.h"
+#include "capabilitybenchmark.h"
+#include "corpusgenerator.h"
+#include "ingestbenchmark.h"
+#include "modelbenchmark.h"
+#include "pluginmanager.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QMimeDatabase>
+#include <QTemporaryDir>
+
+#include <iostream>
+
+using namespace Kerfuffle;
+
+static int writeReport(const QCommandLineParser &parser, const QJsonObject &report)
+{
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(QStringLiteral("output"))) {
+        QFile output(parser.value(QStringLiteral("output")));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(json) != json.size()) {
+            qCritical() << "Could not write the results to" << output.fileName();
+            return 1;
+        }
+    } else {
+        std::cout << json.constData();
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    QApplication application(argc, argv);
+    application.setApplicationName(QStringLiteral("ark-bench"));
+    application.setApplicationVersion(QStringLiteral(ARK_VERSION_STRING));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Times the kerfuffle jobs on synthetic corpora, for every installed plugin and format."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {{QStringLiteral("o"), QStringLiteral("output")}, QStringLiteral("Write the JSON results to <file> instead of the standard output."), QStringLiteral("file")},
+        {{QStringLiteral("w"), QStringLiteral("workdir")}, QStringLiteral("Generate corpora and archives in <dir> instead of a temporary folder."), QStringLiteral("dir")},
+        {{QStringLiteral("s"), QStringLiteral("scale")}, QStringLiteral("Scale the size of the corpora by <factor> (default: 1)."), QStringLiteral("factor"), QStringLiteral("1")},
+        {{QStringLiteral("c"), QStringLiteral("corpora")}, QStringLiteral("Comma-separated list of corpora (default: all of %1).").arg(CorpusGenerator::availableCorpora().join(QLatin1Char(','))), QStringLiteral("names")},
+        {{QStringLiteral("f"), QStringLiteral("formats")}, QStringLiteral("Comma-separated list of archive extensions (default: tar,tar.gz,tar.bz2,tar.xz,zip,7z,rar)."), QStringLiteral("extensions")},
+        {{QStringLiteral("p"), QStringLiteral("plugins")}, QStringLiteral("Comma-separated list of plugin ids (default: all the available plugins)."), QStringLiteral("ids")},
+        {{QStringLiteral("m"), QStringLiteral("model")}, QStringLiteral("Time the loading and sorting of the ArchiveModel instead of the archive operations.")},
+        {{QStringLiteral("i"), QStringLiteral("ingest")}, QStringLiteral("Time the listing of <count> synthetic entries into the model instead of the archive operations."), QStringLiteral("count")},
+        {{QStringLiteral("k"), QStringLiteral("capabilities")}, QStringLiteral("Time the supported mimetypes queries <count> times, with and without cached capabilities, instead of the archive operations."), QStringLiteral("count")}
+    });
+    parser.process(application);
+
+    bool ok = false;
+    const double scale = parser.value(QStringLiteral("scale")).toDouble(&ok);
+    if (!ok || scale <= 0) {
+        qCritical() << "Invalid scale factor:" << parser.value(QStringLiteral("scale"));
+        return 1;
+    }
+
+    const QStringList corpora = parser.isSet(QStringLiteral("corpora"))
+            ? parser.value(QStringLiteral("corpora")).split(QLatin1Char(','), QString::SkipEmptyParts)
+            : CorpusGenerator::availableCorpora();
+    const QStringList formats = parser.isSet(QStringLiteral("formats"))
+            ? parser.value(QStringLiteral("formats")).split(QLatin1Char(','), QString::SkipEmptyParts)
+            : QStringList {QStringLiteral("tar"), QStringLiteral("tar.gz"), QStringLiteral("tar.bz2"), QStringLiteral("tar.xz"),
+                           QStringLiteral("zip"), QStringLiteral("7z"), QStringLiteral("rar")};
+    const QStringList pluginIds = parser.value(QStringLiteral("plugins")).split(QLatin1Char(','), QString::SkipEmptyParts);
+    const bool modelMode = parser.isSet(QStringLiteral("model"));
+
+    if (parser.isSet(QStringLiteral("ingest"))) {
+        const int entriesCount = parser.value(QStringLiteral("ingest")).toInt(&ok);
+        if (!ok || entriesCount <= 0) {
+            qCritical() << "Invalid number of entries:" << parser.value(QStringLiteral("ingest"));
+            return 1;
+        }
+
+        const QJsonObject report {
+            {QStringLiteral("version"), QStringLiteral(ARK_VERSION_STRING)},
+            {QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+            {QStringLiteral("mode"), QStringLiteral("ingest")},
+            {QStringLiteral("results"), QJsonArray {IngestBenchmark().run(entriesCount)}}
+        };
+        return writeReport(parser, report);
+    }
+
+    if (parser.isSet(QStringLiteral("capabilities"))) {
+        const int iterations = parser.value(QStringLiteral("capabilities")).toInt(&ok);
+        if (!ok || iterations <= 0) {
+            qCritical() << "Invalid number of iterations:" << parser.value(QStringLiteral("capabilities"));
+            return 1;
+        }
+
+        const QJsonObject report {
+            {QStringLiteral("version"), QStringLiteral(ARK_VERSION_STRING)},
+            {QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+            {QStringLiteral("mode"), QStringLiteral("capabilities")},
+            {QStringLiteral("results"), QJsonArray {CapabilityBenchmark().run(iterations)}}
+        };
+        return writeReport(parser, report);
+    }
+
+    QTemporaryDir temporaryDir;
+    const QString workDir = parser.isSet(QStringLiteral("workdir")) ? parser.value(QStringLiteral("workdir")) : temporaryDir.path();
+    if (!QDir().mkpath(workDir)) {
+        qCritical() << "Could not create the work directory" << workDir;
+        return 1;
+    }
+
+    PluginManager pluginManager;
+    auto isSelected = [&pluginIds](Plugin *plugin) {
+        return pluginIds.isEmpty() || pluginIds.contains(plugin->metaData().pluginId());
+    };
+
+    CorpusGenerator generator(scale);
+    ArchiveBenchmark archiveBenchmark(workDir);
+    ModelBenchmark modelBenchmark;
+    QJsonArray corporaResults;
+    QJsonArray results;
+
+    foreach (const QString &corpus, corpora) {
+        const QString corpusDir = QStringLiteral("%1/corpus-%2").arg(workDir, corpus);
+        QDir(corpusDir).removeRecursively();
+        if (!QDir().mkpath(corpusDir) || !generator.generate(corpus, corpusDir)) {
+            qCritical() << "Could not generate corpus" << corpus;
+            return 1;
+        }
+
+        corporaResults.append(QJsonObject {
+            {QStringLiteral("name"), corpus},
+            {QStringLiteral("entries"), static_cast<qint64>(generator.entriesCount())},
+            {QStringLiteral("bytes"), static_cast<qint64>(generator.bytesCount())}
+        });
+
+        foreach (const QString &format, formats) {
+            const auto mimeType = QMimeDatabase().mimeTypeForFile(QStringLiteral("corpus.") + format, QMimeDatabase::MatchExtension);
+            QString referenceArchive;
+
+            // Every read-write plugin creates its own archive, and times all the operations on it.
+            foreach (Plugin *plugin, pluginManager.preferredWritePluginsFor(mimeType)) {
+                if (!isSelected(plugin)) {
+                    continue;
+                }
+
+                const QString archivePath = QStringLiteral("%1/%2-%3.%4").arg(workDir, corpus, plugin->metaData().pluginId(), format);
+                if (modelMode) {
+                    const QJsonArray createResults = archiveBenchmark.runCreate(corpus, corpusDir, archivePath, plugin);
+                    if (createResults.isEmpty() || !createResults.first().toObject().value(QStringLiteral("success")).toBool()) {
+                        qCritical() << "Could not create" << archivePath << "with" << plugin->metaData().pluginId();
+                        return 1;
+                    }
+                    results.append(modelBenchmark.run(corpus, archivePath));
+                    // The model always uses the preferred plugin, no need to load the archive again.
+                    break;
+                }
+
+                foreach (const QJsonValue &result, archiveBenchmark.runReadWrite(corpus, corpusDir, archivePath, plugin)) {
+                    results.append(result);
+                }
+                if (referenceArchive.isEmpty() && QFileInfo::exists(archivePath)) {
+                    referenceArchive = archivePath;
+                }
+            }
+
+            if (modelMode || referenceArchive.isEmpty()) {
+                continue;
+            }
+
+            // Read-only plugins can only be timed on an archive created by another plugin.
+            foreach (Plugin *plugin, pluginManager.preferredPluginsFor(mimeType)) {
+                if (!isSelected(plugin) || plugin->isReadWrite()) {
+                    continue;
+                }
+
+                foreach (const QJsonValue &result, archiveBenchmark.runReadOnly(corpus, referenceArchive, plugin)) {
+                    results.append(result);
+                }
+            }
+        }
+
+        QDir(corpusDir).removeRecursively();
+    }
+
+    const QJsonObject report {
+        {QStringLiteral("version"), QStringLiteral(ARK_VERSION_STRING)},
+        {QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+        {QStringLiteral("mode"), modelMode ? QStringLiteral("model") : QStringLiteral("archive")},
+        {QStringLiteral("scale"), scale},
+        {QStringLiteral("corpora"), corporaResults},
+        {QStringLiteral("results"), results}
+    };
+    return writeReport(parser, report);
+}
@@ -0,0 +1,104 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "modelbenchmark.h"
+#include "archivebenchmark.h"
+#include "archivemodel.h"
+#include "archivesortfiltermodel.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+QJsonObject ModelBenchmark::run(const QString &corpus, const QString &archivePath)
+{
+    QJsonObject result {
+        {QStringLiteral("corpus"), corpus},
+        {QStringLiteral("archive"), QFileInfo(archivePath).fileName()}
+    };
+
+    ArchiveModel model(QStringLiteral("/ArkBench"));
+    const qint64 loadTime = ArchiveBenchmark::startAndMeasure(model.loadArchive(archivePath, QString(), &model));
+    result.insert(QStringLiteral("success"), loadTime >= 0);
+    if (loadTime < 0) {
+        return result;
+    }
+    result.insert(QStringLiteral("loadMilliseconds"), loadTime);
+
+    QElapsedTimer timer;
+    timer.start();
+    // The totals are maintained while loading, so this only measures reading them.
+    const ArchiveModel::DirectoryAggregate totals = model.aggregateFor(nullptr);
+    result.insert(QStringLiteral("countMilliseconds"), timer.elapsed());
+    result.insert(QStringLiteral("files"), static_cast<qint64>(totals.files));
+    result.insert(QStringLiteral("folders"), static_cast<qint64>(totals.dirs));
+
+    ArchiveSortFilterModel filterModel;
+    filterModel.setSourceModel(&model);
+
+    // The proxy only sorts the rows it has mapped, so visit all of them like an expanded view would.
+    const struct {
+        QString name;
+        int column;
+        Qt::SortOrder order;
+    } sortings[] = {
+        {QStringLiteral("sortByNameMilliseconds"), model.shownColumns().indexOf(FullPath), Qt::AscendingOrder},
+        {QStringLiteral("sortBySizeMilliseconds"), model.shownColumns().indexOf(Size), Qt::DescendingOrder}
+    };
+
+    for (const auto &sorting : sortings) {
+        if (sorting.column < 0) {
+            continue;
+        }
+        timer.restart();
+        filterModel.sort(sorting.column, sorting.order);
+        while (filterModel.isSortPending()) {
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        visitAll(&filterModel);
+        result.insert(sorting.name, timer.elapsed());
+    }
+
+    return result;
+}
+
+qulonglong ModelBenchmark::visitAll(QAbstractItemModel *model, const QModelIndex &parent)
+{
+    if (model->canFetchMore(parent)) {
+        model->fetchMore(parent);
+    }
+
+    qulonglong count = 0;
+    const int rows = model->rowCount(parent);
+    for (int row = 0; row < rows; row++) {
+        const QModelIndex index = model->index(row, 0, parent);
+        count += 1 + visitAll(model, index);
+    }
+
+    return count;
+}
@@ -0,0 +1,60 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef MODELBENCHMARK_H
+#define MODELBENCHMARK_H
+
+#include <QJsonObject>
+#include <QModelIndex>
+
+class QAbstractItemModel;
+
+/**
+ * Times the loading of an archive into the part's ArchiveModel,
+ * and the sorting of the model through the ArchiveSortFilterModel.
+ */
+class ModelBenchmark
+{
+public:
+
+    /**
+     * Load @p archivePath into a new model and sort it by name and by size.
+     * @return The JSON object with the timings.
+     */
+    QJsonObject run(const QString &corpus, const QString &archivePath);
+
+private:
+
+    /**
+     * Visit all the rows of @p model below @p parent, as a fully expanded view would do.
+     * @return The number of visited rows.
+     */
+    static qulonglong visitAll(QAbstractItemModel *model, const QModelIndex &parent = QModelIndex());
+};
+
+#endif // MODELBENCHMARK_H
@@ -68,6 +68,16 @@ void AddToArchive::setChangeToFirstPath(bool value)
     m_changeToFirstPath = value;
 }
 
+void AddToArchive::setDeduplicateFiles(bool value)
+{
+    m_options.setDeduplicateFiles(value);
+}
+
+void AddToArchive::setUpdateMode(CompressionOptions::UpdateMode mode)
+{
+    m_options.setUpdateMode(mode);
+}
+
 void AddToArchive::setFilename(const QUrl &path)
 {
     m_filename = path.toLocalFile();
@@ -61,6 +61,8 @@ public:
     bool showAddDialog();
     void setPreservePaths(bool value);
     void setChangeToFirstPath(bool value);
+    void setDeduplicateFiles(bool value);
+    void setUpdateMode(CompressionOptions::UpdateMode mode);
     QString detectBaseName(const QVector<Archive::Entry*> &entries) const;
 
 public slots:
@@ -32,17 +32,28 @@
 #include "jobs.h"
 #include "mimetypes.h"
 #include "pluginmanager.h"
+#include "tracer.h"
 
 #include <KLocalizedString>
 #include <KPluginFactory>
 #include <KPluginLoader>
 
+#include <QFileInfo>
 #include <QMimeDatabase>
 #include <QRegularExpression>
 
+#include <algorithm>
+
 namespace Kerfuffle
 {
 
+// Split archives are named name.ext.001, name.ext.002... and RAR volumes name.part1.rar, name.part2.rar...
+static bool isSplitVolume(const QString &fileName)
+{
+    static const QRegularExpression splitVolume(QStringLiteral("\\.(\\d{3,}|part\\d+\\.rar)$"), QRegularExpression::CaseInsensitiveOption);
+    return splitVolume.match(fileName).hasMatch();
+}
+
 Archive *Archive::create(const QString &fileName, QObject *parent)
 {
     return create(fileName, QString(), parent);
@@ -51,26 +62,84 @@ Archive *Archive::create(const QString &fileName, QObject *parent)
 Archive *Archive::create(const QString &fileName, const QString &fixedMimeType, QObject *parent)
 {
     qCDebug(ARK) << "Going to create archive" << fileName;
+    ARK_TRACE_SCOPE("select-plugin", "archive");
 
     PluginManager pluginManager;
     const QMimeType mimeType = fixedMimeType.isEmpty() ? determineMimeType(fileName) : QMimeDatabase().mimeTypeForName(fixedMimeType);
 
-    const QVector<Plugin*> offers = pluginManager.preferredPluginsFor(mimeType);
+    QVector<Plugin*> offers = pluginManager.preferredPluginsFor(mimeType);
     if (offers.isEmpty()) {
         qCCritical(ARK) << "Could not find a plugin to handle" << fileName;
         return new Archive(NoPlugin, parent);
     }
 
+    // The offers are sorted by priority, which stays the tie-breaker between equal read priorities.
+    std::stable_sort(offers.begin(), offers.end(), [](Plugin *p1, Plugin *p2) {
+        return p1->readPriority() > p2->readPriority();
+    });
+
+    // Split volumes are first offered to the plugins joining them, whatever their priority for single files.
+    // The other plugins stay behind them for the sets those cannot read, e.g. encrypted ones.
+    if (isSplitVolume(fileName)) {
+        QVector<Plugin*> splitOffers;
+        foreach (Plugin *plugin, pluginManager.availablePlugins()) {
+            if (plugin->isEnabled() && plugin->splitVolumeMimeTypes().contains(mimeType.name())) {
+                splitOffers << plugin;
+                offers.removeAll(plugin);
+            }
+        }
+        std::stable_sort(splitOffers.begin(), splitOffers.end(), [](Plugin *p1, Plugin *p2) {
+            return p1->readPriority() > p2->readPriority();
+        });
+        offers = splitOffers + offers;
+    }
+
     Archive *archive = nullptr;
+    Plugin *readPlugin = nullptr;
+    const bool exists = QFileInfo::exists(fileName);
     foreach (Plugin *plugin, offers) {
         archive = create(fileName, plugin, parent);
         // Use the first valid plugin, according to the priority sorting.
-        if (archive->isValid()) {
-            return archive;
+        if (!archive->isValid()) {
+            continue;
+        }
+
+        // A faster reader may not handle every archive of its formats, e.g. encrypted ones, which are left to the next plugins.
+        if (exists && plugin != offers.last() && !archive->interface()->canReadArchive()) {
+            qCDebug(ARK) << "Plugin" << plugin->metaData().pluginId() << "cannot read" << fileName << "- trying the next one";
+            delete archive;
+            archive = nullptr;
+            continue;
+        }
+
+        readPlugin = plugin;
+        break;
+    }
+
+    if (!readPlugin) {
+        qCCritical(ARK) << "Failed to find a usable plugin for" << fileName;
+        return archive;
+    }
+
+    // Another plugin may be preferred for modifying the archive, e.g. a CLI tool behind an in-process reader.
+    QVector<Plugin*> writeOffers = pluginManager.preferredWritePluginsFor(mimeType);
+    std::stable_sort(writeOffers.begin(), writeOffers.end(), [](Plugin *p1, Plugin *p2) {
+        return p1->writePriority() > p2->writePriority();
+    });
+
+    foreach (Plugin *plugin, writeOffers) {
+        if (plugin == readPlugin) {
+            break;
+        }
+
+        ReadOnlyArchiveInterface *writeIface = createInterface(fileName, plugin);
+        if (writeIface) {
+            qCDebug(ARK) << "Modifying the archive with plugin" << plugin->metaData().pluginId();
+            archive->setWriteInterface(writeIface, !plugin->isReadWrite());
+            break;
         }
     }
 
-    qCCritical(ARK) << "Failed to find a usable plugin for" << fileName;
     return archive;
 }
 
@@ -78,12 +147,23 @@ Archive *Archive::create(const QString &fileName, Plugin *plugin, QObject *paren
 {
     Q_ASSERT(plugin);
 
+    ReadOnlyArchiveInterface *iface = createInterface(fileName, plugin);
+    if (!iface) {
+        return new Archive(FailedPlugin, parent);
+    }
+
+    return new Archive(iface, !plugin->isReadWrite(), parent);
+}
+
+ReadOnlyArchiveInterface *Archive::createInterface(const QString &fileName, Plugin *plugin)
+{
     qCDebug(ARK) << "Checking plugin" << plugin->metaData().pluginId();
+    ARK_TRACE_SCOPE("load-plugin", "archive");
 
     KPluginFactory *factory = KPluginLoader(plugin->metaData().fileName()).factory();
     if (!factory) {
         qCWarning(ARK) << "Invalid plugin factory for" << plugin->metaData().pluginId();
-        return new Archive(FailedPlugin, parent);
+        return nullptr;
     }
 
     const QVariantList args = {QVariant(QFileInfo(fileName).absoluteFilePath()),
@@ -91,16 +171,17 @@ Archive *Archive::create(const QString &fileName, Plugin *plugin, QObject *paren
     ReadOnlyArchiveInterface *iface = factory->create<ReadOnlyArchiveInterface>(nullptr, args);
     if (!iface) {
         qCWarning(ARK) << "Could not create plugin instance" << plugin->metaData().pluginId();
-        return new Archive(FailedPlugin, parent);
+        return nullptr;
     }
 
     if (!plugin->isValid()) {
         qCDebug(ARK) << "Cannot use plugin" << plugin->metaData().pluginId() << "- check whether" << plugin->readOnlyExecutables() << "are installed.";
-        return new Archive(FailedPlugin, parent);
+        delete iface;
+        return nullptr;
     }
 
     qCDebug(ARK) << "Successfully loaded plugin" << plugin->metaData().pluginId();
-    return new Archive(iface, !plugin->isReadWrite(), parent);
+    return iface;
 }
 
 BatchExtractJob *Archive::batchExtract(const QString &fileName, const QString &destination, bool autoSubfolder, bool preservePaths, QObject *parent)
@@ -151,6 +232,7 @@ LoadJob *Archive::load(const QString &fileName, Plugin *plugin, QObject *parent)
 Archive::Archive(ArchiveError errorCode, QObject *parent)
         : QObject(parent)
         , m_iface(nullptr)
+        , m_writeIface(nullptr)
         , m_error(errorCode)
 {
     qCDebug(ARK) << "Created archive instance with error";
@@ -159,6 +241,7 @@ Archive::Archive(ArchiveError errorCode, QObject *parent)
 Archive::Archive(ReadOnlyArchiveInterface *archiveInterface, bool isReadOnly, QObject *parent)
         : QObject(parent)
         , m_iface(archiveInterface)
+        , m_writeIface(archiveInterface)
         , m_isReadOnly(isReadOnly)
         , m_isSingleFolder(false)
         , m_isMultiVolume(false)
@@ -175,6 +258,35 @@ Archive::Archive(ReadOnlyArchiveInterface *archiveInterface, bool isReadOnly, QO
     connect(m_iface, &ReadOnlyArchiveInterface::encryptionMethodFound, this, &Archive::onEncryptionMethodFound);
 }
 
+void Archive::setWriteInterface(ReadOnlyArchiveInterface *writeInterface, bool isReadOnly)
+{
+    Q_ASSERT(writeInterface && m_writeIface == m_iface);
+
+    m_writeIface = writeInterface;
+    m_writeIface->setParent(this);
+    m_isReadOnly = isReadOnly;
+
+    connect(m_writeIface, &ReadOnlyArchiveInterface::compressionMethodFound, this, &Archive::onCompressionMethodFound);
+    connect(m_writeIface, &ReadOnlyArchiveInterface::encryptionMethodFound, this, &Archive::onEncryptionMethodFound);
+}
+
+ReadWriteArchiveInterface *Archive::writeInterface()
+{
+    if (m_writeIface != m_iface) {
+        m_writeIface->copyArchiveState(m_iface);
+    }
+
+    return static_cast<ReadWriteArchiveInterface*>(m_writeIface);
+}
+
+void Archive::onWriteFinished()
+{
+    // The entries emitted by the write interface are the ones the reading one would list.
+    if (m_writeIface != m_iface) {
+        m_iface->copyArchiveState(m_writeIface);
+    }
+}
+
 void Archive::onCompressionMethodFound(const QString &method)
 {
     QStringList methods = property("compressionMethods").toStringList();
@@ -247,7 +359,8 @@ CommentJob* Archive::addComment(const QString &comment)
 
     qCDebug(ARK) << "Going to add comment:" << comment;
     Q_ASSERT(!isReadOnly());
-    CommentJob *job = new CommentJob(comment, static_cast<ReadWriteArchiveInterface*>(m_iface));
+    CommentJob *job = new CommentJob(comment, writeInterface());
+    connect(job, &KJob::result, this, &Archive::onWriteFinished);
     return job;
 }
 
@@ -283,7 +396,7 @@ bool Archive::isEmpty() const
 
 bool Archive::isReadOnly() const
 {
-    return isValid() ? (m_iface->isReadOnly() || m_isReadOnly ||
+    return isValid() ? (m_writeIface->isReadOnly() || m_isReadOnly ||
                         (isMultiVolume() && (numberOfEntries() > 0))) : false;
 }
 
@@ -319,6 +432,7 @@ bool Archive::isMultiVolume() const
 void Archive::setMultiVolume(bool value)
 {
     m_iface->setMultiVolume(value);
+    m_writeIface->setMultiVolume(value);
 }
 
 int Archive::numberOfVolumes() const
@@ -390,10 +504,11 @@ DeleteJob* Archive::deleteFiles(QVector<Archive::Entry*> &entries)
 
     qCDebug(ARK) << "Going to delete" << entries.size() << "entries";
 
-    if (m_iface->isReadOnly()) {
+    if (m_writeIface->isReadOnly()) {
         return nullptr;
     }
-    DeleteJob *newJob = new DeleteJob(entries, static_cast<ReadWriteArchiveInterface*>(m_iface));
+    DeleteJob *newJob = new DeleteJob(entries, writeInterface());
+    connect(newJob, &KJob::result, this, &Archive::onWriteFinished);
 
     return newJob;
 }
@@ -410,10 +525,11 @@ AddJob* Archive::addFiles(const QVector<Archive::Entry*> &files, const Archive::
     }
 
     qCDebug(ARK) << "Going to add files" << files << "with options" << newOptions;
-    Q_ASSERT(!m_iface->isReadOnly());
+    Q_ASSERT(!m_writeIface->isReadOnly());
 
-    AddJob *newJob = new AddJob(files, destination, newOptions, static_cast<ReadWriteArchiveInterface*>(m_iface));
+    AddJob *newJob = new AddJob(files, destination, newOptions, writeInterface());
     connect(newJob, &AddJob::result, this, &Archive::onAddFinished);
+    connect(newJob, &KJob::result, this, &Archive::onWriteFinished);
     return newJob;
 }
 
@@ -429,9 +545,10 @@ MoveJob* Archive::moveFiles(const QVector<Archive::Entry*> &files, Archive::Entr
     }
 
     qCDebug(ARK) << "Going to move files" << files << "to destinatian" << destination << "with options" << newOptions;
-    Q_ASSERT(!m_iface->isReadOnly());
+    Q_ASSERT(!m_writeIface->isReadOnly());
 
-    MoveJob *newJob = new MoveJob(files, destination, newOptions, static_cast<ReadWriteArchiveInterface*>(m_iface));
+    MoveJob *newJob = new MoveJob(files, destination, newOptions, writeInterface());
+    connect(newJob, &KJob::result, this, &Archive::onWriteFinished);
     return newJob;
 }
 
@@ -447,9 +564,54 @@ CopyJob* Archive::copyFiles(const QVector<Archive::Entry*> &files, Archive::Entr
     }
 
     qCDebug(ARK) << "Going to copy files" << files << "with options" << newOptions;
-    Q_ASSERT(!m_iface->isReadOnly());
+    Q_ASSERT(!m_writeIface->isReadOnly());
+
+    CopyJob *newJob = new CopyJob(files, destination, newOptions, writeInterface());
+    connect(newJob, &KJob::result, this, &Archive::onWriteFinished);
+    return newJob;
+}
+
+bool Archive::beginTransaction()
+{
+    if (!isValid() || m_writeIface->isReadOnly()) {
+        return false;
+    }
+
+    // Extracting or previewing with the reader would miss the queued changes.
+    if (m_writeIface != m_iface) {
+        qCDebug(ARK) << "No transaction, the archive is read and modified by different plugins";
+        return false;
+    }
+
+    auto iface = writeInterface();
+    iface->beginTransaction();
+    return iface->isInTransaction();
+}
+
+bool Archive::isInTransaction() const
+{
+    if (!isValid() || m_writeIface->isReadOnly()) {
+        return false;
+    }
+
+    return static_cast<ReadWriteArchiveInterface*>(m_writeIface)->isInTransaction();
+}
+
+bool Archive::hasPendingChanges() const
+{
+    return isInTransaction() && static_cast<ReadWriteArchiveInterface*>(m_writeIface)->hasPendingChanges();
+}
+
+CommitJob* Archive::commitTransaction()
+{
+    if (!isInTransaction()) {
+        return nullptr;
+    }
+
+    qCDebug(ARK) << "Going to commit the pending changes";
 
-    CopyJob *newJob = new CopyJob(files, destination, newOptions, static_cast<ReadWriteArchiveInterface*>(m_iface));
+    CommitJob *newJob = new CommitJob(writeInterface());
+    connect(newJob, &KJob::result, this, &Archive::onWriteFinished);
     return newJob;
 }
 
@@ -506,6 +668,8 @@ void Archive::encrypt(const QString &password, bool encryptHeader)
 
     m_iface->setPassword(password);
     m_iface->setHeaderEncryptionEnabled(encryptHeader);
+    m_writeIface->setPassword(password);
+    m_writeIface->setHeaderEncryptionEnabled(encryptHeader);
     m_encryptionType = encryptHeader ? HeaderEncrypted : Encrypted;
 }
 
@@ -49,6 +49,7 @@ class AddJob;
 class MoveJob;
 class CopyJob;
 class CommentJob;
+class CommitJob;
 class TestJob;
 class OpenJob;
 class OpenWithJob;
@@ -56,6 +57,7 @@ class Plugin;
 class PreviewJob;
 class Query;
 class ReadOnlyArchiveInterface;
+class ReadWriteArchiveInterface;
 
 enum ArchiveError {
     NoError = 0,
@@ -203,6 +205,23 @@ public:
      */
     CopyJob* copyFiles(const QVector<Archive::Entry*> &files, Archive::Entry *destination, const CompressionOptions& options = CompressionOptions());
 
+    /**
+     * Queue the following add, move, copy and delete jobs instead of rewriting the archive for each of them.
+     * The queued changes are written by the job returned by commitTransaction().
+     * Archives modified by another plugin than the one reading them do not support transactions,
+     * since the reading plugin would not see the queued changes.
+     *
+     * @return Whether the archive supports transactions.
+     */
+    bool beginTransaction();
+    bool isInTransaction() const;
+    bool hasPendingChanges() const;
+
+    /**
+     * @return Job to write the changes queued since beginTransaction(), or nullptr if there is no transaction.
+     */
+    CommitJob* commitTransaction();
+
     ExtractJob* extractFiles(const QVector<Archive::Entry*> &files, const QString &destinationDir, const ExtractionOptions &options = ExtractionOptions());
 
     PreviewJob* preview(Archive::Entry *entry);
@@ -220,6 +239,7 @@ private slots:
     void onUserQuery(Kerfuffle::Query*);
     void onCompressionMethodFound(const QString &method);
     void onEncryptionMethodFound(const QString &method);
+    void onWriteFinished();
 
 private:
     Archive(ReadOnlyArchiveInterface *archiveInterface, bool isReadOnly, QObject *parent = nullptr);
@@ -234,7 +254,26 @@ private:
      * @return A valid archive if the plugin could be loaded, an invalid one otherwise (with the FailedPlugin error set).
      */
     static Archive *create(const QString &fileName, Plugin *plugin, QObject *parent = nullptr);
+
+    /**
+     * @return An interface of @p plugin for @p fileName, or nullptr if the plugin could not be loaded.
+     */
+    static ReadOnlyArchiveInterface *createInterface(const QString &fileName, Plugin *plugin);
+
+    /**
+     * Lets another plugin than the one listing the archive modify it.
+     */
+    void setWriteInterface(ReadOnlyArchiveInterface *writeInterface, bool isReadOnly);
+
+    /**
+     * @return The interface modifying the archive, made aware of what the listing interface found out.
+     */
+    ReadWriteArchiveInterface *writeInterface();
+
+    // Lists, extracts and tests the archive.
     ReadOnlyArchiveInterface *m_iface;
+    // Modifies the archive. This is m_iface unless another plugin has a higher write priority.
+    ReadOnlyArchiveInterface *m_writeIface;
     bool m_isReadOnly;
     bool m_isSingleFolder;
     bool m_isMultiVolume;
@@ -106,8 +106,18 @@ void Archive::Entry::setParent(Archive::Entry *parent)
 void Archive::Entry::setFullPath(const QString &fullPath)
 {
     m_fullPath = fullPath;
-    const QStringList pieces = m_fullPath.split(QLatin1Char('/'), QString::SkipEmptyParts);
-    m_name = pieces.isEmpty() ? QString() : pieces.last();
+
+    // The name is the last non-empty piece of the path.
+    int end = m_fullPath.size();
+    while (end > 0 && m_fullPath.at(end - 1) == QLatin1Char('/')) {
+        end--;
+    }
+    if (end == 0) {
+        m_name.clear();
+        return;
+    }
+    const int start = m_fullPath.lastIndexOf(QLatin1Char('/'), end - 1) + 1;
+    m_name = (start == 0 && end == m_fullPath.size()) ? m_fullPath : m_fullPath.mid(start, end - start);
 }
 
 QString Archive::Entry::fullPath(PathFormat format) const
@@ -134,6 +144,26 @@ bool Archive::Entry::isDir() const
     return m_isDirectory;
 }
 
+qulonglong Archive::Entry::size() const
+{
+    return m_size;
+}
+
+qulonglong Archive::Entry::compressedSize() const
+{
+    return m_compressedSize;
+}
+
+QDateTime Archive::Entry::timestamp() const
+{
+    return m_timestamp;
+}
+
+QString Archive::Entry::crc() const
+{
+    return m_CRC;
+}
+
 int Archive::Entry::row() const
 {
     if (getParent()) {
@@ -152,6 +182,16 @@ Archive::Entry *Archive::Entry::find(const QString &name) const
     return nullptr;
 }
 
+Archive::Entry *Archive::Entry::find(const QStringRef &name) const
+{
+    foreach (Entry *entry, m_entries) {
+        if (entry && (entry->name() == name)) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
 Archive::Entry *Archive::Entry::findByPath(const QStringList &pieces, int index) const
 {
     if (index == pieces.count()) {
@@ -88,8 +88,15 @@ public:
     QString name() const;
     void setIsDirectory(const bool isDirectory);
     bool isDir() const;
+
+    // Typed access to the properties read for every entry, without going through QVariant.
+    qulonglong size() const;
+    qulonglong compressedSize() const;
+    QDateTime timestamp() const;
+    QString crc() const;
     int row() const;
     Entry *find(const QString &name) const;
+    Entry *find(const QStringRef &name) const;
     Entry *findByPath(const QStringList & pieces, int index = 0) const;
 
     /**
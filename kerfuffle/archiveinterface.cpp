@@ -44,6 +44,11 @@ ReadOnlyArchiveInterface::ReadOnlyArchiveInterface(QObject *parent, const QVaria
         , m_isHeaderEncryptionEnabled(false)
         , m_isCorrupt(false)
         , m_isMultiVolume(false)
+        , m_isStatisticsOnlyListing(false)
+        , m_processedBytes(0)
+        , m_totalBytes(0)
+        , m_processedEntries(0)
+        , m_processedPermille(-1)
 {
     Q_ASSERT(args.size() >= 2);
 
@@ -60,7 +65,26 @@ ReadOnlyArchiveInterface::~ReadOnlyArchiveInterface()
 
 void ReadOnlyArchiveInterface::onEntry(Archive::Entry *archiveEntry)
 {
-    Q_UNUSED(archiveEntry)
+    if (isStatisticsOnlyListing()) {
+        // Plugins that cannot avoid creating entries (e.g. the CLI-based ones) end up here.
+        // Jobs ignore the entry in this mode, so nobody else holds a reference to it.
+        addEntryStatistics(archiveEntry->fullPath(),
+                           archiveEntry->isDir(),
+                           archiveEntry->property("size").toLongLong(),
+                           archiveEntry->property("isPasswordProtected").toBool());
+        // The other slots connected to entry() still read the entry, so the previous one is reused instead.
+        if (m_statisticsEntry) {
+            m_entryArena.recycle(m_statisticsEntry);
+            m_statisticsEntry = nullptr;
+        }
+        if (m_entryArena.contains(archiveEntry)) {
+            m_statisticsEntry = archiveEntry;
+        } else {
+            archiveEntry->deleteLater();
+        }
+        return;
+    }
+
     m_numberOfEntries++;
 }
 
@@ -84,6 +108,11 @@ bool ReadOnlyArchiveInterface::open()
     return true;
 }
 
+bool ReadOnlyArchiveInterface::canReadArchive()
+{
+    return true;
+}
+
 void ReadOnlyArchiveInterface::setPassword(const QString &password)
 {
     m_password = password;
@@ -142,6 +171,18 @@ int ReadOnlyArchiveInterface::numberOfVolumes() const
     return m_numberOfVolumes;
 }
 
+void ReadOnlyArchiveInterface::copyArchiveState(const ReadOnlyArchiveInterface *other)
+{
+    Q_ASSERT(other);
+
+    m_password = other->m_password;
+    m_isHeaderEncryptionEnabled = other->m_isHeaderEncryptionEnabled;
+    m_comment = other->m_comment;
+    m_numberOfEntries = other->m_numberOfEntries;
+    m_numberOfVolumes = other->m_numberOfVolumes;
+    m_isMultiVolume = other->m_isMultiVolume;
+}
+
 QString ReadOnlyArchiveInterface::multiVolumeName() const
 {
     return filename();
@@ -267,6 +308,99 @@ bool ReadOnlyArchiveInterface::hasBatchExtractionProgress() const
     return false;
 }
 
+void ReadOnlyArchiveInterface::setStatisticsOnlyListing(bool enabled)
+{
+    m_isStatisticsOnlyListing = enabled;
+    if (enabled) {
+        m_listingStatistics.reset();
+    }
+}
+
+bool ReadOnlyArchiveInterface::isStatisticsOnlyListing() const
+{
+    return m_isStatisticsOnlyListing;
+}
+
+ListingStatistics ReadOnlyArchiveInterface::listingStatistics() const
+{
+    return m_listingStatistics;
+}
+
+Archive::Entry *ReadOnlyArchiveInterface::createEntry()
+{
+    return m_entryArena.create();
+}
+
+void ReadOnlyArchiveInterface::discardEntry(Archive::Entry *entry)
+{
+    m_entryArena.recycle(entry);
+}
+
+QString ReadOnlyArchiveInterface::sharedString(const QString &text)
+{
+    return m_entryArena.sharedString(text);
+}
+
+void ReadOnlyArchiveInterface::addEntryStatistics(const QString &fullPath, bool isDirectory, qlonglong size, bool isPasswordProtected)
+{
+    m_listingStatistics.addEntry(fullPath, isDirectory, size, isPasswordProtected);
+    m_numberOfEntries++;
+}
+
+qulonglong ReadOnlyArchiveInterface::processedBytes() const
+{
+    return m_processedBytes.load();
+}
+
+qulonglong ReadOnlyArchiveInterface::totalBytes() const
+{
+    return m_totalBytes.load();
+}
+
+qulonglong ReadOnlyArchiveInterface::processedEntries() const
+{
+    return m_processedEntries.load();
+}
+
+double ReadOnlyArchiveInterface::processedFraction() const
+{
+    const int permille = m_processedPermille.load();
+    return (permille < 0) ? -1 : permille / 1000.0;
+}
+
+void ReadOnlyArchiveInterface::resetProgressCounters()
+{
+    m_processedBytes.store(0);
+    m_totalBytes.store(0);
+    m_processedEntries.store(0);
+    m_processedPermille.store(-1);
+}
+
+void ReadOnlyArchiveInterface::setTotalBytes(qulonglong bytes)
+{
+    m_totalBytes.store(bytes);
+}
+
+void ReadOnlyArchiveInterface::setProcessedBytes(qulonglong bytes)
+{
+    m_processedBytes.store(bytes);
+}
+
+void ReadOnlyArchiveInterface::addProcessedBytes(qulonglong bytes)
+{
+    m_processedBytes.fetchAndAddRelaxed(bytes);
+}
+
+void ReadOnlyArchiveInterface::addProcessedEntries(qulonglong count)
+{
+    m_processedEntries.fetchAndAddRelaxed(count);
+}
+
+void ReadOnlyArchiveInterface::setProcessedFraction(double fraction)
+{
+    m_processedPermille.store(qBound(0, static_cast<int>(1000 * fraction), 1000));
+}
+
 bool ReadWriteArchiveInterface::isReadOnly() const
 {
     // We set corrupt archives to read-only to avoid add/delete actions, that
@@ -283,6 +417,62 @@ bool ReadWriteArchiveInterface::isReadOnly() const
     }
 }
 
+bool ReadWriteArchiveInterface::supportsTransactions() const
+{
+    return false;
+}
+
+void ReadWriteArchiveInterface::beginTransaction()
+{
+    m_isInTransaction = supportsTransactions();
+}
+
+bool ReadWriteArchiveInterface::isInTransaction() const
+{
+    return m_isInTransaction;
+}
+
+bool ReadWriteArchiveInterface::hasPendingChanges() const
+{
+    return false;
+}
+
+bool ReadWriteArchiveInterface::commitTransaction()
+{
+    m_isInTransaction = false;
+    return true;
+}
+
+void ReadWriteArchiveInterface::setScannedFiles(const FileManifest &files)
+{
+    m_scannedFiles = files;
+}
+
+FileManifest ReadWriteArchiveInterface::takeScannedFiles(const QVector<Archive::Entry*> &entries)
+{
+    if (!m_scannedFiles.isEmpty()) {
+        FileManifest files;
+        files.swap(m_scannedFiles);
+        return files;
+    }
+
+    QStringList paths;
+    paths.reserve(entries.size());
+    foreach (const Archive::Entry *entry, entries) {
+        paths << entry->fullPath();
+    }
+    return FileScanner::scan(paths);
+}
+
+bool ReadWriteArchiveInterface::isUnchanged(const FileScanner::ScannedFile &file, qint64 size, qint64 modificationTime, int timePrecision)
+{
+    if (file.type != FileScanner::File || file.size != size) {
+        return false;
+    }
+
+    return qAbs(file.modificationTime - modificationTime) < timePrecision;
+}
+
 uint ReadOnlyArchiveInterface::numberOfEntries() const
 {
     return m_numberOfEntries;
@@ -32,7 +32,11 @@
 #include "archive_kerfuffle.h"
 #include "kerfuffle_export.h"
 #include "archiveentry.h"
+#include "entryarena.h"
+#include "filescanner.h"
+#include "listingstatistics.h"
 
+#include <QAtomicInteger>
 #include <QObject>
 #include <QStringList>
 #include <QString>
@@ -77,6 +81,14 @@ public:
 
     virtual bool open();
 
+    /**
+     * Checks whether the plugin can list and extract the existing archive, before it is listed.
+     * This must be cheap, e.g. only read the first header.
+     * @return @c false if another plugin should handle the archive, e.g. because the plugin
+     * cannot decrypt it. The default implementation returns @c true.
+     */
+    virtual bool canReadArchive();
+
     /**
      * List archive contents.
      * This runs the process of reading archive contents.
@@ -158,11 +170,46 @@ public:
     uint numberOfEntries() const;
     QMimeType mimetype() const;
 
+    /**
+     * Copies what is known about the archive (password, comment, number of entries and volumes)
+     * from @p other, which handles the same file with another plugin.
+     */
+    void copyArchiveState(const ReadOnlyArchiveInterface *other);
+
     /**
      * @return Whether the interface supports progress reporting for BatchExtractJobs.
      */
     virtual bool hasBatchExtractionProgress() const;
 
+    /**
+     * Set whether list() should only gather the listingStatistics() of the archive.
+     * In this mode no entry() signal is emitted, so that headless jobs can list
+     * huge archives in constant memory.
+     */
+    void setStatisticsOnlyListing(bool enabled);
+    bool isStatisticsOnlyListing() const;
+
+    /**
+     * @return The statistics gathered by the last list() run in statistics-only mode.
+     */
+    ListingStatistics listingStatistics() const;
+
+    /**
+     * Progress counters of the current operation.
+     * They are updated by the plugin from its own thread and periodically sampled by the running Job,
+     * which is much cheaper than emitting progress() for every chunk of data.
+     * If totalBytes() is zero, the Job uses processedFraction(), then the progress() signal.
+     */
+    qulonglong processedBytes() const;
+    qulonglong totalBytes() const;
+    qulonglong processedEntries() const;
+
+    /**
+     * @return The processed part of the operation from 0 to 1, or -1 if the plugin only knows bytes or nothing.
+     */
+    double processedFraction() const;
+    void resetProgressCounters();
+
 signals:
     void cancelled();
     void error(const QString &message, const QString &details = QString());
@@ -189,6 +236,42 @@ protected:
 
     void setCorrupt(bool isCorrupt);
     bool isCorrupt() const;
+
+    /**
+     * Record an entry in the listing statistics.
+     * Plugins call this instead of emitting entry() when isStatisticsOnlyListing() is true.
+     */
+    void addEntryStatistics(const QString &fullPath, bool isDirectory, qlonglong size, bool isPasswordProtected);
+
+    /**
+     * @return A new entry to be emitted by entry().
+     * The entry belongs to the interface and must not be deleted: all the entries
+     * are released at once when the interface, and so the Archive, is destroyed.
+     */
+    Archive::Entry *createEntry();
+
+    /**
+     * Gives back an entry of createEntry() which was not emitted.
+     */
+    void discardEntry(Archive::Entry *entry);
+
+    /**
+     * @return @p text sharing its data with equal strings of the previous entries.
+     * Meant for the metadata repeated by most entries, such as owners or methods.
+     */
+    QString sharedString(const QString &text);
+
+    void setTotalBytes(qulonglong bytes);
+    void setProcessedBytes(qulonglong bytes);
+    void addProcessedBytes(qulonglong bytes);
+    void addProcessedEntries(qulonglong count = 1);
+
+    /**
+     * For plugins which know how much of the operation is done, but not in bytes,
+     * e.g. from the number of entries or from the percentage printed by a program.
+     */
+    void setProcessedFraction(double fraction);
+
     QString m_comment;
     int m_numberOfVolumes;
     uint m_numberOfEntries;
@@ -202,6 +285,14 @@ private:
     bool m_isHeaderEncryptionEnabled;
     bool m_isCorrupt;
     bool m_isMultiVolume;
+    bool m_isStatisticsOnlyListing;
+    ListingStatistics m_listingStatistics;
+    EntryArena m_entryArena;
+    Archive::Entry *m_statisticsEntry = nullptr;
+    QAtomicInteger<qulonglong> m_processedBytes;
+    QAtomicInteger<qulonglong> m_totalBytes;
+    QAtomicInteger<qulonglong> m_processedEntries;
+    QAtomicInt m_processedPermille;
 
 private slots:
     void onEntry(Archive::Entry *archiveEntry);
@@ -226,11 +317,61 @@ public:
     virtual bool deleteFiles(const QVector<Archive::Entry*> &files) = 0;
     virtual bool addComment(const QString &comment) = 0;
 
+    /**
+     * @return Whether add, move, copy and delete operations can be queued and written with a single rewrite of the archive.
+     */
+    virtual bool supportsTransactions() const;
+
+    /**
+     * Start queueing the add, move, copy and delete operations instead of writing them right away.
+     * Queued operations still emit entry() and entryRemoved(), so that views are updated immediately.
+     * Does nothing if supportsTransactions() returns false.
+     */
+    void beginTransaction();
+    bool isInTransaction() const;
+
+    /**
+     * @return Whether there are queued operations that have not been written yet.
+     */
+    virtual bool hasPendingChanges() const;
+
+    /**
+     * Write all the queued operations to the archive and end the transaction.
+     * Implementations must call the base implementation when done.
+     *
+     * @return bool indicating whether the operation was successful.
+     */
+    virtual bool commitTransaction();
+
+    /**
+     * Sets the files found by scanning the entries passed to the next addFiles() call,
+     * so that the plugin does not walk the folders again.
+     */
+    void setScannedFiles(const FileManifest &files);
+
+protected:
+    /**
+     * @return The files set by setScannedFiles(), or the result of scanning @p entries if none were set.
+     * The set files are only used once.
+     */
+    FileManifest takeScannedFiles(const QVector<Archive::Entry*> &entries);
+
+    /**
+     * @return Whether the scanned @p file still has the @p size and the @p modificationTime (in seconds
+     * since the epoch) of the entry it was stored as. Formats storing coarser timestamps pass their
+     * precision in seconds. Only regular files can be unchanged.
+     */
+    static bool isUnchanged(const FileScanner::ScannedFile &file, qint64 size, qint64 modificationTime, int timePrecision = 1);
+
 signals:
     void entryRemoved(const QString &path);
 
 private slots:
     void onEntryRemoved(const QString &path);
+
+private:
+    bool m_isInTransaction = false;
+    FileManifest m_scannedFiles;
 };
 
 } // namespace Kerfuffle
@@ -0,0 +1,241 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archivesniffer.h"
+#include "ark_debug.h"
+
+#include <QFile>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <cstring>
+
+namespace Kerfuffle
+{
+
+namespace
+{
+
+const int s_tarBlockSize = 512;
+
+struct Signature
+{
+    const char *bytes;
+    int size;
+    const char *mimeType;
+};
+
+// Formats recognised from their magic number alone.
+const Signature s_containers[] = {
+    {"PK\x03\x04", 4, "application/zip"},
+    {"PK\x05\x06", 4, "application/zip"},
+    {"7z\xBC\xAF\x27\x1C", 6, "application/x-7z-compressed"},
+    {"Rar!\x1A\x07", 6, "application/x-rar"},
+    {"xar!", 4, "application/x-xar"},
+    {"MSCF\0\0\0\0", 8, "application/vnd.ms-cab-compressed"},
+    {"070701", 6, "application/x-cpio"},
+    {"070702", 6, "application/x-cpio"},
+    {"070707", 6, "application/x-cpio"},
+};
+
+struct Compressor
+{
+    const char *bytes;
+    int size;
+    int (*supportFilter)(struct archive *);
+    const char *tarMimeType;
+    const char *mimeType;
+};
+
+// Streams which may contain a tarball.
+const Compressor s_compressors[] = {
+    {"\x1F\x8B", 2, archive_read_support_filter_gzip, "application/x-compressed-tar", "application/gzip"},
+    {"BZh", 3, archive_read_support_filter_bzip2, "application/x-bzip-compressed-tar", "application/x-bzip"},
+    {"\xFD" "7zXZ\0", 6, archive_read_support_filter_xz, "application/x-xz-compressed-tar", "application/x-xz"},
+    {"\x5D\0\0", 3, archive_read_support_filter_lzma, "application/x-lzma-compressed-tar", "application/x-lzma"},
+    {"\x1F\x9D", 2, archive_read_support_filter_compress, "application/x-tarz", "application/x-compress"},
+    {"LZIP", 4, archive_read_support_filter_lzip, "application/x-lzip-compressed-tar", "application/x-lzip"},
+    {"\x89LZO\0\r\n\x1A\n", 9, archive_read_support_filter_lzop, "application/x-tzo", "application/x-lzop"},
+    {"\x04\x22\x4D\x18", 4, archive_read_support_filter_lz4, "application/x-lz4-compressed-tar", "application/x-lz4"},
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+    {"\x28\xB5\x2F\xFD", 4, archive_read_support_filter_zstd, "application/x-zstd-compressed-tar", "application/zstd"},
+#endif
+};
+
+bool matches(const QByteArray &data, int offset, const char *bytes, int size)
+{
+    return data.size() >= offset + size && std::memcmp(data.constData() + offset, bytes, size) == 0;
+}
+
+/**
+ * @return Whether @p block is a tar header, checked with its checksum since v7 headers have no magic number.
+ */
+bool isTarHeader(const QByteArray &block)
+{
+    if (block.size() < s_tarBlockSize) {
+        return false;
+    }
+
+    // The checksum is stored as octal digits, optionally preceded by spaces and terminated by a NUL or a space.
+    const int checksumOffset = 148;
+    const int checksumSize = 8;
+    int storedChecksum = 0;
+    bool hasDigits = false;
+    for (int i = checksumOffset; i < checksumOffset + checksumSize; ++i) {
+        const char c = block.at(i);
+        if (c >= '0' && c <= '7') {
+            storedChecksum = storedChecksum * 8 + (c - '0');
+            hasDigits = true;
+        } else if (c == ' ' || c == '\0') {
+            if (hasDigits) {
+                break;
+            }
+        } else {
+            return false;
+        }
+    }
+    if (!hasDigits) {
+        return false;
+    }
+
+    // The checksum is computed with spaces in place of the checksum field. Some old tar
+    // implementations summed signed chars, so both sums are accepted.
+    int unsignedSum = 0;
+    int signedSum = 0;
+    for (int i = 0; i < s_tarBlockSize; ++i) {
+        const char c = (i >= checksumOffset && i < checksumOffset + checksumSize) ? ' ' : block.at(i);
+        unsignedSum += static_cast<unsigned char>(c);
+        signedSum += static_cast<signed char>(c);
+    }
+
+    return storedChecksum == unsignedSum || storedChecksum == signedSum;
+}
+
+enum TarDetection {
+    IsTar,
+    IsNotTar,
+    Unknown
+};
+
+/**
+ * Decompresses the first tar block of @p data, a truncated stream of @p compressor.
+ */
+TarDetection detectCompressedTar(const QByteArray &data, const Compressor &compressor)
+{
+    struct archive *reader = archive_read_new();
+    TarDetection detection = Unknown;
+
+    // Filters which would have to run an external program are not worth it here.
+    if (compressor.supportFilter(reader) == ARCHIVE_OK &&
+        archive_read_support_format_raw(reader) == ARCHIVE_OK &&
+        archive_read_open_memory(reader, data.constData(), data.size()) == ARCHIVE_OK) {
+
+        struct archive_entry *entry;
+        // The stream might merely start like one of the compressor.
+        if (archive_read_next_header(reader, &entry) == ARCHIVE_OK && archive_filter_count(reader) > 1) {
+            QByteArray block(s_tarBlockSize, '\0');
+            int size = 0;
+            while (size < s_tarBlockSize) {
+                const auto read = archive_read_data(reader, block.data() + size, s_tarBlockSize - size);
+                if (read < 0) {
+                    // The stream is cut before the end of the first block.
+                    break;
+                }
+                if (read == 0) {
+                    detection = IsNotTar;
+                    break;
+                }
+                size += read;
+            }
+
+            if (size == s_tarBlockSize) {
+                detection = isTarHeader(block) ? IsTar : IsNotTar;
+            }
+        }
+    }
+
+    archive_read_free(reader);
+    return detection;
+}
+
+}
+
+QString ArchiveSniffer::mimeTypeName(const QByteArray &header)
+{
+    for (const Signature &signature : s_containers) {
+        if (matches(header, 0, signature.bytes, signature.size)) {
+            return QLatin1String(signature.mimeType);
+        }
+    }
+
+    if (matches(header, 0, "!<arch>\n", 8)) {
+        // Debian packages are ar archives whose first member is the format version.
+        return matches(header, 8, "debian-binary", 13) ? QStringLiteral("application/x-deb") : QStringLiteral("application/x-archive");
+    }
+
+    if (matches(header, 0, "\xED\xAB\xEE\xDB", 4)) {
+        // The big-endian package type follows the magic number and the version.
+        const bool isSource = header.size() > 7 && header.at(7) == 1;
+        return isSource ? QStringLiteral("application/x-source-rpm") : QStringLiteral("application/x-rpm");
+    }
+
+    for (const Compressor &compressor : s_compressors) {
+        if (!matches(header, 0, compressor.bytes, compressor.size)) {
+            continue;
+        }
+
+        switch (detectCompressedTar(header, compressor)) {
+        case IsTar:
+            return QLatin1String(compressor.tarMimeType);
+        case IsNotTar:
+            return QLatin1String(compressor.mimeType);
+        case Unknown:
+            return QString();
+        }
+    }
+
+    if (isTarHeader(header.left(s_tarBlockSize))) {
+        return QStringLiteral("application/x-tar");
+    }
+
+    return QString();
+}
+
+QString ArchiveSniffer::mimeTypeNameForFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    const QString mimeType = mimeTypeName(file.read(headerSize));
+    qCDebug(ARK) << "Sniffed mimetype of" << fileName << ":" << mimeType;
+    return mimeType;
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVESNIFFER_H
+#define ARCHIVESNIFFER_H
+
+#include "kerfuffle_export.h"
+
+#include <QByteArray>
+#include <QString>
+
+namespace Kerfuffle
+{
+
+/**
+ * Recognises the archive formats supported by Ark from the first bytes of a file.
+ *
+ * Only the magic numbers of the archive formats are compared, which is much cheaper than matching
+ * a file against the whole mimetype database. Streams of the usual compressors are decompressed
+ * just enough to tell compressed tarballs from single compressed files.
+ */
+class KERFUFFLE_EXPORT ArchiveSniffer
+{
+public:
+
+    /**
+     * The number of bytes read from the beginning of a file.
+     */
+    static const int headerSize = 16384;
+
+    /**
+     * @return The name of the mimetype of a file beginning with @p header,
+     * or an empty string if the format is not recognised.
+     */
+    static QString mimeTypeName(const QByteArray &header);
+
+    /**
+     * @return The name of the mimetype of @p fileName, or an empty string
+     * if the file cannot be read or its format is not recognised.
+     */
+    static QString mimeTypeNameForFile(const QString &fileName);
+};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "capabilitycache.h"
+#include "ark_debug.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QStringList>
+
+namespace Kerfuffle
+{
+
+Q_GLOBAL_STATIC(CapabilityCache, s_capabilityCache)
+
+namespace
+{
+
+KConfigGroup cacheGroup(const QString &name)
+{
+    return KSharedConfig::openConfig(QStringLiteral("arkcapabilitiesrc"), KConfig::SimpleConfig, QStandardPaths::GenericCacheLocation)->group(name);
+}
+
+QString fileStamp(const QString &path)
+{
+    const QFileInfo info(path);
+    return path + QLatin1Char('@') + (info.exists() ? QString::number(info.lastModified().toMSecsSinceEpoch()) : QString());
+}
+
+// Changes whenever an executable is added to or removed from $PATH.
+QString pathStamp()
+{
+    QStringList stamps;
+    foreach (const QString &dir, QString::fromLocal8Bit(qgetenv("PATH")).split(QDir::listSeparator(), QString::SkipEmptyParts)) {
+        stamps << fileStamp(dir);
+    }
+    return stamps.join(QDir::listSeparator());
+}
+
+QString libarchivePluginPath()
+{
+    foreach (const QString &path, QCoreApplication::libraryPaths()) {
+        const QString pluginPath = QStringLiteral("%1/kerfuffle/kerfuffle_libarchive.so").arg(path);
+        if (QFileInfo::exists(pluginPath)) {
+            return pluginPath;
+        }
+    }
+
+    return QString();
+}
+
+bool probeLibarchiveLzo(const QString &pluginPath, QString *libraryPath)
+{
+    if (pluginPath.isEmpty()) {
+        return false;
+    }
+
+    // ldd the libarchive plugin, which is built against libarchive, to figure out the absolute libarchive path.
+    QProcess ldd;
+    ldd.start(QStringLiteral("ldd"), {pluginPath});
+    ldd.waitForFinished();
+    const QString output = QString::fromUtf8(ldd.readAllStandardOutput());
+    QRegularExpression regex(QStringLiteral("/.*/libarchive.so"));
+    const QRegularExpressionMatch match = regex.match(output);
+    if (!match.hasMatch()) {
+        return false;
+    }
+
+    // Check whether libarchive links against liblzo.
+    *libraryPath = match.captured(0);
+    ldd.start(QStringLiteral("ldd"), {*libraryPath});
+    ldd.waitForFinished();
+    return ldd.readAllStandardOutput().contains(QByteArrayLiteral("lzo"));
+}
+
+}
+
+CapabilityCache::CapabilityCache()
+{
+}
+
+CapabilityCache *CapabilityCache::self()
+{
+    return s_capabilityCache();
+}
+
+bool CapabilityCache::hasExecutable(const QString &executable)
+{
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    const auto it = m_executables.constFind(executable);
+    if (it != m_executables.constEnd()) {
+        return it.value();
+    }
+
+    const bool found = !QStandardPaths::findExecutable(executable).isEmpty();
+    m_executables.insert(executable, found);
+    saveExecutables();
+
+    return found;
+}
+
+bool CapabilityCache::libarchiveHasLzo()
+{
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    if (m_libarchiveHasLzo < 0) {
+        const QString pluginPath = libarchivePluginPath();
+        QString libraryPath;
+        const bool hasLzo = probeLibarchiveLzo(pluginPath, &libraryPath);
+        qCDebug(ARK) << "libarchive linked against liblzo:" << hasLzo;
+        m_libarchiveHasLzo = hasLzo ? 1 : 0;
+
+        KConfigGroup group = cacheGroup(QStringLiteral("Libarchive"));
+        group.writeEntry("PluginStamp", fileStamp(pluginPath));
+        group.writeEntry("LibraryPath", libraryPath);
+        group.writeEntry("LibraryStamp", fileStamp(libraryPath));
+        group.writeEntry("HasLzo", hasLzo);
+        group.sync();
+    }
+
+    return m_libarchiveHasLzo == 1;
+}
+
+void CapabilityCache::clear(bool savedResults)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isLoaded = false;
+    m_executables.clear();
+    m_libarchiveHasLzo = -1;
+
+    if (savedResults) {
+        foreach (const QString &name, QStringList({QStringLiteral("Executables"), QStringLiteral("Libarchive")})) {
+            KConfigGroup group = cacheGroup(name);
+            group.deleteGroup();
+            group.sync();
+        }
+    }
+}
+
+void CapabilityCache::load()
+{
+    if (m_isLoaded) {
+        return;
+    }
+    m_isLoaded = true;
+    m_pathStamp = pathStamp();
+
+    // The saved results are only used as long as the files they were computed from did not change.
+    const KConfigGroup executables = cacheGroup(QStringLiteral("Executables"));
+    if (executables.readEntry("PathStamp", QString()) == m_pathStamp) {
+        foreach (const QString &key, executables.keyList()) {
+            if (key != QLatin1String("PathStamp")) {
+                m_executables.insert(key, executables.readEntry(key, false));
+            }
+        }
+    }
+
+    const KConfigGroup libarchive = cacheGroup(QStringLiteral("Libarchive"));
+    if (libarchive.hasKey("HasLzo") &&
+        libarchive.readEntry("PluginStamp", QString()) == fileStamp(libarchivePluginPath()) &&
+        libarchive.readEntry("LibraryStamp", QString()) == fileStamp(libarchive.readEntry("LibraryPath", QString()))) {
+        m_libarchiveHasLzo = libarchive.readEntry("HasLzo", false) ? 1 : 0;
+    }
+}
+
+void CapabilityCache::saveExecutables()
+{
+    KConfigGroup group = cacheGroup(QStringLiteral("Executables"));
+    group.deleteGroup();
+    group.writeEntry("PathStamp", m_pathStamp);
+    for (auto it = m_executables.constBegin(); it != m_executables.constEnd(); ++it) {
+        group.writeEntry(it.key(), it.value());
+    }
+    group.sync();
+}
+
+}
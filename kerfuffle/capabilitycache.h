@@ -0,0 +1,88 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CAPABILITYCACHE_H
+#define CAPABILITYCACHE_H
+
+#include "kerfuffle_export.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+namespace Kerfuffle
+{
+
+/**
+ * Process-wide cache of the system capabilities the plugins depend on.
+ *
+ * Executables are looked up and libarchive is inspected once per process, and the results
+ * are saved in the cache directory for the next processes. Executables are looked up again
+ * when a directory of $PATH changes, libarchive is inspected again when it or its plugin change.
+ */
+class KERFUFFLE_EXPORT CapabilityCache
+{
+public:
+
+    CapabilityCache();
+
+    static CapabilityCache *self();
+
+    /**
+     * @return Whether @p executable is found in $PATH.
+     */
+    bool hasExecutable(const QString &executable);
+
+    /**
+     * @return Whether libarchive is linked against liblzo.
+     * Workaround for libarchive >= 3.3 not linking against liblzo.
+     */
+    bool libarchiveHasLzo();
+
+    /**
+     * Forget the results, so that they are loaded from the cache directory or computed again.
+     * @param savedResults Whether to delete the results saved in the cache directory too.
+     */
+    void clear(bool savedResults = false);
+
+private:
+
+    Q_DISABLE_COPY(CapabilityCache)
+
+    void load();
+    void saveExecutables();
+
+    QMutex m_mutex;
+    bool m_isLoaded = false;
+    QString m_pathStamp;
+    QHash<QString, bool> m_executables;
+    int m_libarchiveHasLzo = -1;
+};
+
+}
+
+#endif
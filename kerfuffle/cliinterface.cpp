@@ -30,6 +30,8 @@
 #include "cliinterface.h"
 #include "ark_debug.h"
 #include "queries.h"
+#include "tracer.h"
+#include "zipextractionplanner.h"
 
 #ifdef Q_OS_WIN
 # include <KProcess>
@@ -45,11 +47,16 @@
 #include <QDebug>
 #include <QDir>
 #include <QDirIterator>
+#include <QElapsedTimer>
 #include <QEventLoop>
 #include <QFile>
+#include <QMetaMethod>
 #include <QMimeDatabase>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QSemaphore>
+#include <QSet>
+#include <QSharedPointer>
 #include <QStandardPaths>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
@@ -57,8 +64,28 @@
 #include <QTimer>
 #include <QUrl>
 
+#include <algorithm>
+
 namespace Kerfuffle
 {
+
+namespace
+{
+
+// Below this, starting more processes costs more than it saves.
+const qulonglong s_minimumShardSize = 8 * 1024 * 1024;
+const int s_maximumShardCount = 4;
+
+// How long all the killed processes are waited for, together.
+const int s_killTimeout = 1000;
+
+qulonglong entrySize(const Archive::Entry *entry)
+{
+    return entry->property("size").toULongLong();
+}
+
+}
+
 CliInterface::CliInterface(QObject *parent, const QVariantList & args)
     : ReadWriteArchiveInterface(parent, args)
 {
@@ -73,7 +100,35 @@ CliInterface::CliInterface(QObject *parent, const QVariantList & args)
 
 CliInterface::~CliInterface()
 {
-    Q_ASSERT(!m_process);
+    // Only the parsing of CliInterface itself is left at this point.
+    stopProcessThread();
+}
+
+void CliInterface::stopProcessThread()
+{
+    if (!m_processThread) {
+        return;
+    }
+
+    m_abortingOperation = true;
+    cancelPendingQuery();
+
+    // A killed process might not have reported its end yet.
+    // It is deleted by its thread, without parsing anything else.
+    foreach (KProcess *process, m_processes) {
+        disconnect(process, &QProcess::readyReadStandardOutput, process, nullptr);
+        disconnect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), process, nullptr);
+        process->deleteLater();
+    }
+    m_processes.clear();
+    m_process = nullptr;
+    m_outputProcess = nullptr;
+
+    // Waits for the output being parsed, if any.
+    m_processThread->quit();
+    m_processThread->wait();
+    delete m_processThread;
+    m_processThread = nullptr;
 }
 
 void CliInterface::setListEmptyLines(bool emptyLines)
@@ -91,10 +146,12 @@ bool CliInterface::list()
     resetParsing();
     m_operationMode = List;
     m_numberOfEntries = 0;
+    setSolid(false);
 
     // To compute progress.
     m_archiveSizeOnDisk = static_cast<qulonglong>(QFileInfo(filename()).size());
-    connect(this, &ReadOnlyArchiveInterface::entry, this, &CliInterface::onEntry);
+    setTotalBytes(m_archiveSizeOnDisk);
+    connect(this, &ReadOnlyArchiveInterface::entry, this, &CliInterface::onEntry, Qt::UniqueConnection);
 
     return runProcess(m_cliProps->property("listProgram").toString(), m_cliProps->listArgs(filename(), password()));
 }
@@ -137,11 +194,41 @@ bool CliInterface::extractFiles(const QVector<Archive::Entry*> &files, const QSt
         QDir::setCurrent(destDir.adjusted(QUrl::RemoveScheme).url());
     }
 
-    return runProcess(m_cliProps->property("extractProgram").toString(),
-                    m_cliProps->extractArgs(filename(),
-                                            extractFilesList(files),
-                                            options.preservePaths(),
-                                            password()));
+    const QVector<QVector<Archive::Entry*> > shards = extractionShards(files);
+    if (shards.isEmpty()) {
+        return runProcess(m_cliProps->property("extractProgram").toString(),
+                        m_cliProps->extractArgs(filename(),
+                                                extractFilesList(files),
+                                                options.preservePaths(),
+                                                password()));
+    }
+
+    qCDebug(ARK) << "Extracting with" << shards.size() << "processes";
+
+    QVector<QStringList> argumentLists;
+    QVector<double> weights;
+    qulonglong totalSize = 0;
+    foreach (const QVector<Archive::Entry*> &shard, shards) {
+        argumentLists << m_cliProps->extractArgs(filename(), extractFilesList(shard), options.preservePaths(), password());
+
+        qulonglong shardSize = 0;
+        foreach (const Archive::Entry *entry, shard) {
+            shardSize += entrySize(entry);
+
+            // The processes would race to create the same folders.
+            const QString folder = entry->isDir() ? entry->fullPath(NoTrailingSlash) : entry->fullPath().section(QLatin1Char('/'), 0, -2);
+            if (options.preservePaths() && !folder.isEmpty()) {
+                QDir::current().mkpath(folder);
+            }
+        }
+        weights << shardSize;
+        totalSize += shardSize;
+    }
+    for (int i = 0; i < weights.size(); ++i) {
+        weights[i] /= totalSize;
+    }
+
+    return runProcesses(m_cliProps->property("extractProgram").toString(), argumentLists, weights);
 }
 
 bool CliInterface::addFiles(const QVector<Archive::Entry*> &files, const Archive::Entry *destination, const CompressionOptions& options, uint numberOfEntriesToAdd)
@@ -264,8 +351,14 @@ bool CliInterface::testArchive()
 }
 
 bool CliInterface::runProcess(const QString& programName, const QStringList& arguments)
+{
+    return runProcesses(programName, QVector<QStringList>{arguments});
+}
+
+bool CliInterface::runProcesses(const QString &programName, const QVector<QStringList> &argumentLists, const QVector<double> &weights)
 {
     Q_ASSERT(!m_process);
+    Q_ASSERT(!argumentLists.isEmpty());
 
     QString programPath = QStandardPaths::findExecutable(programName);
     if (programPath.isEmpty()) {
@@ -274,47 +367,250 @@ bool CliInterface::runProcess(const QString& programName, const QStringList& arg
         return false;
     }
 
-    qCDebug(ARK) << "Executing" << programPath << arguments << "within directory" << QDir::currentPath();
+    if (!m_processThread) {
+        m_processThread = new QThread(this);
+        m_processThread->start();
+    }
+
+    const int count = argumentLists.size();
+    m_processes.clear();
+    m_processOutputs = QVector<QByteArray>(count);
+    m_processWeights = weights.isEmpty() ? QVector<double>(count, 1.0 / count) : weights;
+    m_processProgress = QVector<double>(count, 0.0);
+    m_runningProcesses = count;
+    m_processesExitCode = 0;
+    m_processesExitStatus = QProcess::NormalExit;
+    m_fileExistsResponseForAll.clear();
+    m_storedFileNames.clear();
+    m_stdOutData.clear();
+    m_abortingOperation = false;
+
+    foreach (const QStringList &arguments, argumentLists) {
+        qCDebug(ARK) << "Executing" << programPath << arguments << "within directory" << QDir::currentPath();
 
 #ifdef Q_OS_WIN
-    m_process = new KProcess;
+        auto process = new KProcess;
 #else
-    m_process = new KPtyProcess;
-    m_process->setPtyChannels(KPtyProcess::StdinChannel);
+        auto process = new KPtyProcess;
+        process->setPtyChannels(KPtyProcess::StdinChannel);
 #endif
 
-    m_process->setOutputChannelMode(KProcess::MergedChannels);
-    m_process->setNextOpenMode(QIODevice::ReadWrite | QIODevice::Unbuffered | QIODevice::Text);
-    m_process->setProgram(programPath, arguments);
+        process->setOutputChannelMode(KProcess::MergedChannels);
+        process->setNextOpenMode(QIODevice::ReadWrite | QIODevice::Unbuffered | QIODevice::Text);
+        process->setProgram(programPath, arguments);
+
+        // The output is parsed in the thread of the process, see the class documentation.
+        connect(process, &QProcess::readyReadStandardOutput, process, [=]() {
+            readProcessOutput(process, false);
+            flushEntries();
+        });
+        connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), process, [=](int exitCode, QProcess::ExitStatus exitStatus) {
+            onProcessExited(process, exitCode, exitStatus);
+        });
+
+        process->moveToThread(m_processThread);
+        m_processes << process;
+        if (!m_process) {
+            m_process = process;
+        }
+    }
+
+    Tracer::asyncBegin("process", "cli", this, programName);
+    foreach (KProcess *process, m_processes) {
+        QTimer::singleShot(0, process, [process]() {
+            process->start();
+        });
+    }
+
+    return true;
+}
+
+void CliInterface::readProcessOutput(KProcess *process, bool handleAll)
+{
+    const int index = m_processes.indexOf(process);
+    Q_ASSERT(index >= 0);
 
-    connect(m_process, &QProcess::readyReadStandardOutput, this, [=]() {
-        readStdout();
+    // The parsing state is shared, but each process has its own incomplete last line.
+    // Killing the processes while parsing handles the output of the others, hence the restore.
+    KProcess *parsedProcess = m_outputProcess;
+    m_outputProcess = process;
+    m_stdOutData.swap(m_processOutputs[index]);
+
+    readStdout(handleAll);
+
+    m_stdOutData.swap(m_processOutputs[index]);
+    m_outputProcess = parsedProcess;
+}
+
+void CliInterface::onProcessExited(KProcess *process, int exitCode, QProcess::ExitStatus exitStatus)
+{
+    //handle all the remaining data in the process
+    readProcessOutput(process, true);
+    flushEntries();
+
+    // The first failure is the one reported.
+    if (m_processesExitCode == 0) {
+        m_processesExitCode = exitCode;
+    }
+    if (exitStatus != QProcess::NormalExit) {
+        m_processesExitStatus = exitStatus;
+    }
+
+    if (--m_runningProcesses > 0) {
+        return;
+    }
+
+    // Queued after the entries, so that they are all emitted before finished().
+    // Extraction jobs need a dedicated post-processing function.
+    QMetaObject::invokeMethod(this, (m_operationMode == Extract) ? "extractProcessFinished" : "processFinished", Qt::QueuedConnection,
+                              Q_ARG(int, m_processesExitCode), Q_ARG(QProcess::ExitStatus, m_processesExitStatus));
+}
+
+double CliInterface::overallProgress(double progress)
+{
+    const int index = m_processes.indexOf(m_outputProcess);
+    if (m_processes.size() < 2 || index < 0) {
+        return progress;
+    }
+
+    m_processProgress[index] = progress;
+
+    double overall = 0;
+    for (int i = 0; i < m_processProgress.size(); ++i) {
+        overall += m_processWeights.at(i) * m_processProgress.at(i);
+    }
+    return overall;
+}
+
+QVector<QVector<Archive::Entry*> > CliInterface::contiguousShards(QVector<QPair<qulonglong, Archive::Entry*> > entries, qulonglong totalSize,
+                                                                  int count, const ZipExtractionPlanner &planner)
+{
+    // Folders which are not stored as members come first.
+    QHash<const Archive::Entry*, qint64> offsets;
+    offsets.reserve(entries.size());
+    foreach (const auto &entry, entries) {
+        const int index = planner.indexOf(entry.second->fullPath());
+        offsets.insert(entry.second, (index < 0) ? -1 : planner.offset(index));
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [&offsets](const QPair<qulonglong, Archive::Entry*> &a, const QPair<qulonglong, Archive::Entry*> &b) {
+        return offsets.value(a.second) < offsets.value(b.second);
     });
 
-    if (m_operationMode == Extract) {
-        // Extraction jobs need a dedicated post-processing function.
-        connect(m_process, static_cast<void (KPtyProcess::*)(int, QProcess::ExitStatus)>(&KPtyProcess::finished), this, &CliInterface::extractProcessFinished);
-    } else {
-        connect(m_process, static_cast<void (KPtyProcess::*)(int, QProcess::ExitStatus)>(&KPtyProcess::finished), this, &CliInterface::processFinished);
+    // Each shard is closed once it holds its share of what is left.
+    QVector<QVector<Archive::Entry*> > shards(count);
+    int shard = 0;
+    qulonglong load = 0;
+    qulonglong remainingSize = totalSize;
+    foreach (const auto &entry, entries) {
+        if (shard < count - 1 && load > 0 && load >= remainingSize / (count - shard)) {
+            remainingSize -= load;
+            load = 0;
+            ++shard;
+        }
+        shards[shard] << entry.second;
+        load += entry.first;
     }
 
-    m_stdOutData.clear();
+    shards.resize(shard + 1);
+    if (shards.size() < 2) {
+        shards.clear();
+    }
 
-    m_process->start();
+    return shards;
+}
 
-    return true;
+QVector<QVector<Archive::Entry*> > CliInterface::extractionShards(const QVector<Archive::Entry*> &files) const
+{
+    QVector<QVector<Archive::Entry*> > shards;
+
+    // The files of solid archives can only be decompressed one after another.
+    if (!m_cliProps->property("parallelExtraction").toBool() || isSolid() || isMultiVolume()) {
+        return shards;
+    }
+
+    // Extracting the whole archive passes no file list. Splitting it would put every entry
+    // on the command lines, which can exceed the system limit for large archives.
+    if (files.isEmpty()) {
+        return shards;
+    }
+
+    // Each process would ask for the password.
+    if (password().isEmpty()) {
+        foreach (const Archive::Entry *entry, files) {
+            if (entry->property("isPasswordProtected").toBool()) {
+                return shards;
+            }
+        }
+    }
+
+    // Extracting a folder extracts all its files, so the requested folders are left to the
+    // processes extracting their requested files, unless none of them was requested.
+    QSet<QString> parentFolders;
+    foreach (const Archive::Entry *entry, files) {
+        QString path = entry->fullPath(NoTrailingSlash);
+        int slash;
+        while ((slash = path.lastIndexOf(QLatin1Char('/'))) > 0) {
+            path.truncate(slash);
+            if (parentFolders.contains(path)) {
+                break;
+            }
+            parentFolders.insert(path);
+        }
+    }
+
+    QVector<QPair<qulonglong, Archive::Entry*> > entries;
+    qulonglong totalSize = 0;
+    foreach (Archive::Entry *entry, files) {
+        if (entry->isDir() && parentFolders.contains(entry->fullPath(NoTrailingSlash))) {
+            continue;
+        }
+        entries << qMakePair(entrySize(entry), entry);
+        totalSize += entries.last().first;
+    }
+
+    const qulonglong count = qMin(qMin<qulonglong>(qMin(QThread::idealThreadCount(), s_maximumShardCount), entries.size()),
+                                  totalSize / s_minimumShardSize);
+    if (count < 2) {
+        return shards;
+    }
+
+    // Zip members can be read in stored order, so each process gets a contiguous part of the archive.
+    if (mimetype().inherits(QStringLiteral("application/zip"))) {
+        const ZipExtractionPlanner planner(filename());
+        if (planner.isValid()) {
+            return contiguousShards(entries, totalSize, static_cast<int>(count), planner);
+        }
+    }
+
+    // Largest files first, each one going to the least loaded process.
+    std::sort(entries.begin(), entries.end(), [](const QPair<qulonglong, Archive::Entry*> &a, const QPair<qulonglong, Archive::Entry*> &b) {
+        return a.first > b.first;
+    });
+
+    shards.resize(static_cast<int>(count));
+    QVector<qulonglong> loads(static_cast<int>(count), 0);
+    for (int i = 0; i < entries.size(); ++i) {
+        const int shard = std::min_element(loads.constBegin(), loads.constEnd()) - loads.constBegin();
+        shards[shard] << entries.at(i).second;
+        loads[shard] += entries.at(i).first;
+    }
+
+    return shards;
 }
 
 void CliInterface::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
     m_exitCode = exitCode;
     qCDebug(ARK) << "Process finished, exitcode:" << exitCode << "exitstatus:" << exitStatus;
+    Tracer::asyncEnd("process", "cli", this);
 
     if (m_process) {
-        //handle all the remaining data in the process
-        readStdout(true);
-
-        delete m_process;
+        // The remaining data was handled in the thread of the processes.
+        foreach (KProcess *process, m_processes) {
+            process->deleteLater();
+        }
+        m_processes.clear();
         m_process = nullptr;
     }
 
@@ -344,11 +640,11 @@ void CliInterface::processFinished(int exitCode, QProcess::ExitStatus exitStatus
             emit cancelled();
             emit finished(false);
         } else {
-            emit progress(1.0);
+            setProcessedFraction(1.0);
             emit finished(true);
         }
     } else  {
-        emit progress(1.0);
+        setProcessedFraction(1.0);
         emit finished(true);
     }
 }
@@ -359,12 +655,14 @@ void CliInterface::extractProcessFinished(int exitCode, QProcess::ExitStatus exi
 
     m_exitCode = exitCode;
     qCDebug(ARK) << "Extraction process finished, exitcode:" << exitCode << "exitstatus:" << exitStatus;
+    Tracer::asyncEnd("process", "cli", this);
 
     if (m_process) {
-        // Handle all the remaining data in the process.
-        readStdout(true);
-
-        delete m_process;
+        // The remaining data was handled in the thread of the processes.
+        foreach (KProcess *process, m_processes) {
+            process->deleteLater();
+        }
+        m_processes.clear();
         m_process = nullptr;
     }
 
@@ -419,7 +717,7 @@ void CliInterface::extractProcessFinished(int exitCode, QProcess::ExitStatus exi
         cleanUpExtracting();
     }
 
-    emit progress(1.0);
+    setProcessedFraction(1.0);
     emit finished(true);
 }
 
@@ -544,7 +842,7 @@ void CliInterface::cleanUpExtracting()
 void CliInterface::finishCopying(bool result)
 {
     disconnect(this, &CliInterface::finished, this, &CliInterface::continueCopying);
-    emit progress(1.0);
+    setProcessedFraction(1.0);
     emit finished(result);
     cleanUp();
 }
@@ -690,17 +988,39 @@ void CliInterface::killProcess(bool emitFinished)
         return;
     }
 
-    m_abortingOperation = !emitFinished;
+    if (m_process->thread() != QThread::currentThread()) {
+        if (!emitFinished) {
+            m_abortingOperation = true;
+            cancelPendingQuery();
+        }
 
-    // Give some time for the application to finish gracefully
-    if (!m_process->waitForFinished(5)) {
-        m_process->kill();
+        // The process can only be waited for from its own thread. That thread might be
+        // blocked by a user query though, so do not wait for longer than the kill itself.
+        QSharedPointer<QSemaphore> killed(new QSemaphore);
+        QTimer::singleShot(0, m_process, [=]() {
+            killProcess(emitFinished);
+            killed->release();
+        });
+        killed->tryAcquire(1, s_killTimeout + 500);
+        return;
+    }
 
-        // It takes a few hundred ms for the process to be killed.
-        m_process->waitForFinished(1000);
+    // Reset by the next runProcess(), once processFinished() has seen it.
+    m_abortingOperation = !emitFinished;
+
+    // Give some time for the applications to finish gracefully, then kill all of them at once.
+    foreach (KProcess *process, m_processes) {
+        if (!process->waitForFinished(5)) {
+            process->kill();
+        }
     }
 
-    m_abortingOperation = false;
+    // It takes a few hundred ms for a process to be killed, so they are waited for in parallel.
+    QElapsedTimer timer;
+    timer.start();
+    foreach (KProcess *process, m_processes) {
+        process->waitForFinished(static_cast<int>(qMax<qint64>(0, s_killTimeout - timer.elapsed())));
+    }
 }
 
 bool CliInterface::passwordQuery()
@@ -741,14 +1061,16 @@ void CliInterface::readStdout(bool handleAll)
     if (m_abortingOperation)
         return;
 
-    Q_ASSERT(m_process);
+    Q_ASSERT(m_outputProcess);
 
-    if (!m_process->bytesAvailable()) {
+    if (!m_outputProcess->bytesAvailable()) {
         //if process has no more data, we can just bail out
         return;
     }
 
-    QByteArray dd = m_process->readAllStandardOutput();
+    ARK_TRACE_SCOPE("read-stdout", "cli");
+
+    QByteArray dd = m_outputProcess->readAllStandardOutput();
     m_stdOutData += dd;
 
     QList<QByteArray> lines = m_stdOutData.split('\n');
@@ -830,7 +1152,7 @@ bool CliInterface::handleLine(const QString& line)
         int pos = line.indexOf(QLatin1Char( '%' ));
         if (pos > 1) {
             int percentage = line.midRef(pos - 2, 2).toInt();
-            emit progress(float(percentage) / 100);
+            setProcessedFraction(overallProgress(float(percentage) / 100));
             return true;
         }
     }
@@ -841,7 +1163,7 @@ bool CliInterface::handleLine(const QString& line)
             qCDebug(ARK) << "Found a password prompt";
 
             Kerfuffle::PasswordNeededQuery query(filename());
-            query.execute();
+            executeQuery(&query);
 
             if (query.responseCancelled()) {
                 emit cancelled();
@@ -881,7 +1203,7 @@ bool CliInterface::handleLine(const QString& line)
             qCDebug(ARK) << "Found a password prompt";
 
             Kerfuffle::PasswordNeededQuery query(filename());
-            query.execute();
+            executeQuery(&query);
 
             if (query.responseCancelled()) {
                 emit cancelled();
@@ -954,8 +1276,8 @@ bool CliInterface::handleFileExistsMessage(const QString& line)
         const QRegularExpressionMatch rxMatch = rxFileNamePattern.match(line);
 
         if (rxMatch.hasMatch()) {
-            m_storedFileName = rxMatch.captured(1);
-            qCWarning(ARK) << "Detected existing file:" << m_storedFileName;
+            m_storedFileNames[m_outputProcess] = rxMatch.captured(1);
+            qCWarning(ARK) << "Detected existing file:" << rxMatch.captured(1);
         }
     }
 
@@ -963,9 +1285,15 @@ bool CliInterface::handleFileExistsMessage(const QString& line)
         return false;
     }
 
-    Kerfuffle::OverwriteQuery query(QDir::current().path() + QLatin1Char( '/' ) + m_storedFileName);
+    // Another process of the same extraction was told to do the same for all the files.
+    if (!m_fileExistsResponseForAll.isEmpty()) {
+        writeToProcess(m_fileExistsResponseForAll.toLocal8Bit());
+        return true;
+    }
+
+    Kerfuffle::OverwriteQuery query(QDir::current().path() + QLatin1Char( '/' ) + m_storedFileNames.value(m_outputProcess));
     query.setNoRenameMode(true);
-    query.execute();
+    executeQuery(&query);
 
     QString responseToProcess;
     const QStringList choices = m_cliProps->property("fileExistsInput").toStringList();
@@ -979,6 +1307,12 @@ bool CliInterface::handleFileExistsMessage(const QString& line)
     } else if (query.responseAutoSkip()) {
         responseToProcess = choices.at(3);
     } else if (query.responseCancelled()) {
+        if (m_processes.size() > 1) {
+            // The other processes would keep extracting their files.
+            emit cancelled();
+            killProcess();
+            return true;
+        }
         if (choices.count() < 5) { // If the program has no way to cancel the extraction, we resort to killing it
             return doKill();
         }
@@ -989,6 +1323,10 @@ bool CliInterface::handleFileExistsMessage(const QString& line)
 
     responseToProcess += QLatin1Char( '\n' );
 
+    if (m_processes.size() > 1 && (query.responseOverwriteAll() || query.responseAutoSkip())) {
+        m_fileExistsResponseForAll = responseToProcess;
+    }
+
     writeToProcess(responseToProcess.toLocal8Bit());
 
     return true;
@@ -1034,15 +1372,15 @@ QStringList CliInterface::entryPathDestinationPairs(const QVector<Archive::Entry
 
 void CliInterface::writeToProcess(const QByteArray& data)
 {
-    Q_ASSERT(m_process);
+    Q_ASSERT(m_outputProcess);
     Q_ASSERT(!data.isNull());
 
     qCDebug(ARK) << "Writing" << data << "to the process";
 
 #ifdef Q_OS_WIN
-    m_process->write(data);
+    m_outputProcess->write(data);
 #else
-    m_process->pty()->write(data);
+    static_cast<KPtyProcess*>(m_outputProcess)->pty()->write(data);
 #endif
 }
 
@@ -1090,17 +1428,120 @@ CliProperties *CliInterface::cliProperties() const
     return m_cliProps;
 }
 
+void CliInterface::setSolid(bool isSolid)
+{
+    m_isSolid = isSolid;
+}
+
+bool CliInterface::isSolid() const
+{
+    return m_isSolid;
+}
+
+void CliInterface::emitEntry(Archive::Entry *archiveEntry)
+{
+    if (QThread::currentThread() == thread()) {
+        emit entry(archiveEntry);
+        return;
+    }
+
+    // Sent by flushEntries() once the current chunk of output has been parsed.
+    m_entryBatch << archiveEntry;
+}
+
+void CliInterface::flushEntries()
+{
+    if (m_entryBatch.isEmpty()) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_flushedEntriesMutex);
+        m_flushedEntries += m_entryBatch;
+    }
+    m_entryBatch.clear();
+
+    QMetaObject::invokeMethod(this, "emitFlushedEntries", Qt::QueuedConnection);
+}
+
+void CliInterface::emitFlushedEntries()
+{
+    QVector<Archive::Entry*> entries;
+    {
+        QMutexLocker locker(&m_flushedEntriesMutex);
+        entries.swap(m_flushedEntries);
+    }
+
+    foreach (Archive::Entry *e, entries) {
+        emit entry(e);
+    }
+}
+
+void CliInterface::executeQuery(Query *query)
+{
+    if (QThread::currentThread() == thread()) {
+        query->execute();
+        return;
+    }
+
+    // The entries found so far are emitted before the query is shown.
+    flushEntries();
+
+    {
+        QMutexLocker locker(&m_pendingQueryMutex);
+        if (m_abortingOperation) {
+            query->cancel();
+            return;
+        }
+        m_pendingQuery = query;
+    }
+
+    QMetaObject::invokeMethod(this, "showPendingQuery", Qt::QueuedConnection);
+    query->waitForResponse();
+
+    QMutexLocker locker(&m_pendingQueryMutex);
+    m_pendingQuery = nullptr;
+}
+
+void CliInterface::showPendingQuery()
+{
+    Query *query;
+    {
+        // Once taken, the query can only be answered by its handler.
+        QMutexLocker locker(&m_pendingQueryMutex);
+        query = m_pendingQuery;
+        m_pendingQuery = nullptr;
+    }
+
+    if (!query) {
+        return;
+    }
+
+    if (!isSignalConnected(QMetaMethod::fromSignal(&ReadOnlyArchiveInterface::userQuery))) {
+        qCWarning(ARK) << "No handler for the query of the process, cancelling it";
+        query->cancel();
+        return;
+    }
+
+    emit userQuery(query);
+}
+
+void CliInterface::cancelPendingQuery()
+{
+    QMutexLocker locker(&m_pendingQueryMutex);
+    if (m_pendingQuery) {
+        m_pendingQuery->cancel();
+        m_pendingQuery = nullptr;
+    }
+}
+
 void CliInterface::onEntry(Archive::Entry *archiveEntry)
 {
+    // The Job samples the listed size, which may exceed the archive size on disk.
     if (archiveEntry->compressedSizeIsSet) {
-        m_listedSize += archiveEntry->property("compressedSize").toULongLong();
-        if (m_listedSize <= m_archiveSizeOnDisk) {
-            emit progress(float(m_listedSize)/float(m_archiveSizeOnDisk));
-        } else {
-            // In case summed compressed size exceeds archive size on disk.
-            emit progress(1);
-        }
+        addProcessedBytes(archiveEntry->property("compressedSize").toULongLong());
     }
+    addProcessedEntries();
 }
 
 }
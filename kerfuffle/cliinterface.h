@@ -34,6 +34,9 @@
 #include "cliproperties.h"
 #include "kerfuffle_export.h"
 
+#include <QAtomicInt>
+#include <QMutex>
+#include <QPair>
 #include <QProcess>
 #include <QRegularExpression>
 
@@ -43,10 +46,30 @@ class KPtyProcess;
 class QDir;
 class QTemporaryDir;
 class QTemporaryFile;
+class QThread;
 
 namespace Kerfuffle
 {
 
+class ZipExtractionPlanner;
+
+/**
+ * Base class of the plugins which run an external archiver.
+ *
+ * The operations are started from the GUI thread, but the process lives in a thread
+ * owned by the interface: its output is read there, so readStdout(), handleLine(),
+ * readListLine(), readExtractLine() and readDeleteLine() are called from that thread.
+ * These functions must only touch the state of the current operation, emit the entries
+ * with emitEntry() and ask the user with executeQuery(). Everything else, including
+ * processFinished(), runs on the GUI thread.
+ *
+ * Plugins setting the parallelExtraction property can extract the files of non-solid
+ * archives with several processes at once. Their output is parsed by the same thread,
+ * one line at a time, and processFinished() is only called once all of them are done.
+ *
+ * Since the parsing functions are virtual, the destructor of every plugin must call
+ * stopProcessThread() before its own members are destroyed.
+ */
 class KERFUFFLE_EXPORT CliInterface : public ReadWriteArchiveInterface
 {
     Q_OBJECT
@@ -101,6 +124,11 @@ public:
 
     QString multiVolumeName() const override;
 
+    /**
+     * Solid archives are always extracted by a single process.
+     */
+    bool isSolid() const;
+
     CliProperties *cliProperties() const;
 
 protected:
@@ -138,6 +166,25 @@ protected:
 
     void cleanUp();
 
+    /**
+     * Emits @p archiveEntry. Entries found while parsing are sent to the GUI thread in batches.
+     */
+    void emitEntry(Archive::Entry *archiveEntry);
+
+    /**
+     * Executes @p query on the GUI thread and waits for the response.
+     * The query is cancelled if nobody handles it or if the operation is aborted.
+     */
+    void executeQuery(Query *query);
+
+    /**
+     * Stops the thread parsing the output of the processes, which are killed.
+     * To be called by the destructors of the plugins, no output is parsed afterwards.
+     */
+    void stopProcessThread();
+
+    void setSolid(bool isSolid);
+
     CliProperties *m_cliProps = nullptr;
     QString m_oldWorkingDir;
     QScopedPointer<QTemporaryDir> m_tempWorkingDir;
@@ -154,7 +201,8 @@ protected:
     KPtyProcess *m_process = nullptr;
 #endif
 
-    bool m_abortingOperation = false;
+    // Also read by the thread parsing the output.
+    QAtomicInt m_abortingOperation = 0;
 
 protected slots:
     virtual void readStdout(bool handleAll = false);
@@ -200,6 +248,70 @@ private:
 
     void finishCopying(bool result);
 
+    /**
+     * Runs @p programName once for each of the @p argumentLists, see runProcess().
+     * The progress reported by each process is weighted according to @p weights.
+     */
+    bool runProcesses(const QString &programName, const QVector<QStringList> &argumentLists, const QVector<double> &weights = QVector<double>());
+
+    /**
+     * Splits @p files into groups of similar size to be extracted in parallel.
+     * @return No group at all if the files should be extracted by a single process,
+     * which is always the case when the whole archive is extracted (@p files is empty).
+     */
+    QVector<QVector<Archive::Entry*> > extractionShards(const QVector<Archive::Entry*> &files) const;
+
+    /**
+     * Splits the sized @p entries into @p count groups of members stored next to each other in a zip archive.
+     */
+    static QVector<QVector<Archive::Entry*> > contiguousShards(QVector<QPair<qulonglong, Archive::Entry*> > entries, qulonglong totalSize,
+                                                               int count, const ZipExtractionPlanner &planner);
+
+    /**
+     * Parses the output of @p process, whose pending data is kept apart from the other processes.
+     */
+    void readProcessOutput(KProcess *process, bool handleAll);
+
+    /**
+     * Handles the end of the process in its thread, then lets the GUI thread finish the operation
+     * once all the processes are done.
+     */
+    void onProcessExited(KProcess *process, int exitCode, QProcess::ExitStatus exitStatus);
+
+    /**
+     * @return The overall progress, once the process being parsed reached @p progress.
+     */
+    double overallProgress(double progress);
+
+    /**
+     * Sends the entries found by the parsing thread to the GUI thread.
+     */
+    void flushEntries();
+
+    /**
+     * Cancels the query waited for by the parsing thread, unless it is already shown.
+     */
+    void cancelPendingQuery();
+
+    QThread *m_processThread = nullptr;
+    Query *m_pendingQuery = nullptr;
+    QMutex m_pendingQueryMutex;
+
+    // All the processes of the current operation, m_process being the first one.
+    QVector<KProcess*> m_processes;
+    KProcess *m_outputProcess = nullptr;    // The process whose output is being parsed.
+    QVector<QByteArray> m_processOutputs;
+    QVector<double> m_processWeights;
+    QVector<double> m_processProgress;
+    int m_runningProcesses = 0;
+    int m_processesExitCode = 0;
+    QProcess::ExitStatus m_processesExitStatus = QProcess::NormalExit;
+    QString m_fileExistsResponseForAll;
+    bool m_isSolid = false;
+    QVector<Archive::Entry*> m_entryBatch;
+    QVector<Archive::Entry*> m_flushedEntries;
+    QMutex m_flushedEntriesMutex;
+
     QByteArray m_stdOutData;
     QRegularExpression m_passwordPromptPattern;
     QHash<int, QList<QRegularExpression> > m_patternCache;
@@ -208,7 +320,8 @@ private:
     QVector<Archive::Entry*> m_newMovedFiles;
     int m_exitCode = 0;
     bool m_listEmptyLines = false;
-    QString m_storedFileName;
+    // The processes are parsed one line at a time, each one naming its own existing files.
+    QHash<KProcess*, QString> m_storedFileNames;
 
     ExtractionOptions m_extractionOptions;
     QString m_extractDestDir;
@@ -216,15 +329,16 @@ private:
     QScopedPointer<QTemporaryFile> m_commentTempFile;
     QVector<Archive::Entry*> m_extractedFiles;
     qulonglong m_archiveSizeOnDisk = 0;
-    qulonglong m_listedSize = 0;
 
 protected slots:
     virtual void processFinished(int exitCode, QProcess::ExitStatus exitStatus);
 
 private slots:
+    void showPendingQuery();
     void extractProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void continueCopying(bool result);
     void onEntry(Archive::Entry *archiveEntry);
+    void emitFlushedEntries();
 };
 }
 
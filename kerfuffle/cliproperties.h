@@ -74,6 +74,7 @@ class KERFUFFLE_EXPORT CliProperties: public QObject
     Q_PROPERTY(QStringList multiVolumeSuffix MEMBER m_multiVolumeSuffix)
 
     Q_PROPERTY(bool captureProgress MEMBER m_captureProgress)
+    Q_PROPERTY(bool parallelExtraction MEMBER m_parallelExtraction)
 
 public:
     explicit CliProperties(QObject *parent, const KPluginMetaData &metaData, const QMimeType &archiveType);
@@ -144,6 +145,7 @@ private:
     QStringList m_multiVolumeSuffix;
 
     bool m_captureProgress = false;
+    bool m_parallelExtraction = false;
 
     QMimeType m_mimeType;
     KPluginMetaData m_metaData;
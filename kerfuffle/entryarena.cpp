@@ -0,0 +1,138 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "entryarena.h"
+#include "archiveentry.h"
+
+#include <new>
+
+namespace Kerfuffle
+{
+
+// Number of entries allocated at once.
+static const int s_blockSize = 1024;
+
+EntryArena::EntryArena()
+{
+}
+
+EntryArena::~EntryArena()
+{
+    clear();
+}
+
+Archive::Entry *EntryArena::create()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_recycled.isEmpty()) {
+        return m_recycled.takeLast();
+    }
+
+    if (m_blocks.isEmpty() || m_lastBlockCount == s_blockSize) {
+        m_blocks << static_cast<Archive::Entry*>(::operator new(sizeof(Archive::Entry) * s_blockSize));
+        m_lastBlockCount = 0;
+    }
+
+    Archive::Entry *entry = m_blocks.last() + m_lastBlockCount;
+    new (entry) Archive::Entry();
+    m_lastBlockCount++;
+
+    return entry;
+}
+
+void EntryArena::recycle(Archive::Entry *entry)
+{
+    Q_ASSERT(contains(entry));
+
+    // The slot always holds a constructed entry, so that clear() can destroy all of them.
+    entry->~Entry();
+    new (entry) Archive::Entry();
+
+    QMutexLocker locker(&m_mutex);
+    m_recycled << entry;
+}
+
+bool EntryArena::contains(const Archive::Entry *entry) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Recently created entries are the most likely to be looked up.
+    for (int i = m_blocks.size() - 1; i >= 0; --i) {
+        const Archive::Entry *block = m_blocks.at(i);
+        const int blockCount = (i == m_blocks.size() - 1) ? m_lastBlockCount : s_blockSize;
+        if (entry >= block && entry < block + blockCount) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+QString EntryArena::sharedString(const QString &text)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const auto it = m_strings.constFind(text);
+    if (it != m_strings.constEnd()) {
+        return *it;
+    }
+
+    m_strings.insert(text);
+    return text;
+}
+
+void EntryArena::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < m_blocks.size(); ++i) {
+        Archive::Entry *block = m_blocks.at(i);
+        const int blockCount = (i == m_blocks.size() - 1) ? m_lastBlockCount : s_blockSize;
+        for (int j = 0; j < blockCount; ++j) {
+            block[j].~Entry();
+        }
+        ::operator delete(block);
+    }
+
+    m_blocks.clear();
+    m_lastBlockCount = 0;
+    m_recycled.clear();
+    m_strings.clear();
+}
+
+int EntryArena::count() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_blocks.isEmpty()) {
+        return 0;
+    }
+    return (m_blocks.size() - 1) * s_blockSize + m_lastBlockCount - m_recycled.size();
+}
+
+}
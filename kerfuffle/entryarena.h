@@ -0,0 +1,100 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ENTRYARENA_H
+#define ENTRYARENA_H
+
+#include "archive_kerfuffle.h"
+#include "kerfuffle_export.h"
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+namespace Kerfuffle
+{
+
+/**
+ * Storage for the entries emitted by an archive interface.
+ *
+ * Entries are constructed in large blocks and all destroyed at once by clear(),
+ * so closing an archive does not schedule one deletion per entry.
+ * The entries have no QObject parent and must never be deleted by their users:
+ * plugins create them, jobs pass them on and the model only links them together.
+ *
+ * Strings repeated by many entries, such as owners or compression methods,
+ * can be shared through sharedString().
+ */
+class KERFUFFLE_EXPORT EntryArena
+{
+public:
+
+    EntryArena();
+    ~EntryArena();
+
+    /**
+     * @return A new empty entry, valid until clear() is called.
+     */
+    Archive::Entry *create();
+
+    /**
+     * Resets @p entry, whose memory is reused by the next call to create().
+     */
+    void recycle(Archive::Entry *entry);
+
+    /**
+     * @return Whether @p entry was created by this arena.
+     */
+    bool contains(const Archive::Entry *entry) const;
+
+    /**
+     * @return A string equal to @p text, sharing its data with the previous equal strings.
+     */
+    QString sharedString(const QString &text);
+
+    /**
+     * Destroys all the entries and releases their memory.
+     */
+    void clear();
+
+    int count() const;
+
+private:
+
+    Q_DISABLE_COPY(EntryArena)
+
+    mutable QMutex m_mutex;
+    QVector<Archive::Entry*> m_blocks;
+    int m_lastBlockCount = 0;
+    QVector<Archive::Entry*> m_recycled;
+    QSet<QString> m_strings;
+};
+
+}
+
+#endif
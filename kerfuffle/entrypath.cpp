@@ -0,0 +1,123 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "entrypath.h"
+
+namespace Kerfuffle
+{
+
+EntryPath::EntryPath(const QString &path)
+    : m_path(path)
+    , m_start(path.startsWith(QLatin1String("./")) ? 2 : 0)
+    , m_isNormalized(true)
+{
+    const QChar *data = m_path.constData();
+    const int size = m_path.size();
+
+    int pieceStart = m_start;
+    for (int i = m_start; i <= size; ++i) {
+        if (i < size && data[i] != QLatin1Char('/')) {
+            continue;
+        }
+
+        if (i > pieceStart) {
+            m_bounds.append(pieceStart);
+            m_bounds.append(i);
+        } else if (i < size) {
+            // A leading slash, or two slashes in a row.
+            m_isNormalized = false;
+        }
+        pieceStart = i + 1;
+    }
+}
+
+bool EntryPath::isSkipped() const
+{
+    // #241967: Entries called "/" should be ignored
+    // #355839: Entries called "//" should be ignored
+    // "." is present in ISO files.
+    return m_bounds.isEmpty() || (m_start == 0 && m_path == QLatin1String("."));
+}
+
+bool EntryPath::hasDotSlashPrefix() const
+{
+    return m_start > 0;
+}
+
+bool EntryPath::isNormalized() const
+{
+    return m_isNormalized;
+}
+
+bool EntryPath::hasTrailingSlash() const
+{
+    return m_path.endsWith(QLatin1Char('/'));
+}
+
+int EntryPath::count() const
+{
+    return m_bounds.size() / 2;
+}
+
+QStringRef EntryPath::at(int index) const
+{
+    const int start = m_bounds.at(2 * index);
+    return m_path.midRef(start, m_bounds.at(2 * index + 1) - start);
+}
+
+QStringRef EntryPath::name() const
+{
+    return m_bounds.isEmpty() ? QStringRef() : at(count() - 1);
+}
+
+QString EntryPath::cleanPath() const
+{
+    return m_start > 0 ? m_path.mid(m_start) : m_path;
+}
+
+QString EntryPath::normalizedPath() const
+{
+    if (m_isNormalized) {
+        return cleanPath();
+    }
+
+    QString normalized;
+    normalized.reserve(m_path.size());
+    for (int i = 0; i < count(); ++i) {
+        if (i > 0) {
+            normalized += QLatin1Char('/');
+        }
+        normalized += at(i);
+    }
+    if (hasTrailingSlash() && !normalized.isEmpty()) {
+        normalized += QLatin1Char('/');
+    }
+    return normalized;
+}
+
+}
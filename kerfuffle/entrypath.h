@@ -0,0 +1,104 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef ENTRYPATH_H
+#define ENTRYPATH_H
+
+#include "kerfuffle_export.h"
+
+#include <QString>
+#include <QStringRef>
+#include <QVarLengthArray>
+
+namespace Kerfuffle
+{
+
+/**
+ * The path of an archive entry, split into its pieces once.
+ *
+ * The pieces are references into the path: no string is allocated,
+ * unless the path has to be rewritten, which is rare.
+ */
+class KERFUFFLE_EXPORT EntryPath
+{
+public:
+
+    explicit EntryPath(const QString &path);
+
+    /**
+     * @return Whether the path doesn't name an entry, such as "/", "//", "." or "./".
+     */
+    bool isSkipped() const;
+
+    /**
+     * @return Whether the path starts with "./", which cleanPath() removes.
+     */
+    bool hasDotSlashPrefix() const;
+
+    /**
+     * @return Whether the path neither starts with a slash nor contains empty pieces.
+     */
+    bool isNormalized() const;
+
+    bool hasTrailingSlash() const;
+
+    /**
+     * @return The number of pieces, empty pieces excluded.
+     */
+    int count() const;
+    QStringRef at(int index) const;
+
+    /**
+     * @return The last piece, or an empty reference.
+     */
+    QStringRef name() const;
+
+    /**
+     * @return The path without its "./" prefix (see bug 194241).
+     */
+    QString cleanPath() const;
+
+    /**
+     * @return The pieces of the path joined by single slashes, keeping the trailing slash.
+     * For instance, "/usr//bin/" becomes "usr/bin/".
+     */
+    QString normalizedPath() const;
+
+private:
+
+    QString m_path;
+    int m_start;
+    bool m_isNormalized;
+
+    // Start and end of each piece in m_path.
+    QVarLengthArray<int, 32> m_bounds;
+};
+
+}
+
+#endif
@@ -0,0 +1,333 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "filescanner.h"
+#include "ark_debug.h"
+#include "tracer.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFileInfo>
+#endif
+
+namespace Kerfuffle
+{
+
+namespace
+{
+
+struct Node
+{
+    FileScanner::ScannedFile file;
+    QVector<int> children;
+};
+
+/**
+ * The files found so far and the folders still to be read, shared by the scanning threads.
+ */
+struct ScanState
+{
+    QMutex mutex;
+    QWaitCondition foldersChanged;
+    QVector<Node> nodes;
+    QVector<int> pendingFolders;
+    int readingThreads = 0;
+    QThread *caller = nullptr;
+};
+
+#ifdef Q_OS_UNIX
+
+FileScanner::ScannedFile fileFromStat(const QString &path, const struct stat &st)
+{
+    FileScanner::ScannedFile file;
+    file.path = path;
+    if (S_ISDIR(st.st_mode)) {
+        file.type = FileScanner::Directory;
+    } else if (S_ISLNK(st.st_mode)) {
+        file.type = FileScanner::SymLink;
+    } else if (S_ISREG(st.st_mode)) {
+        file.type = FileScanner::File;
+    } else {
+        file.type = FileScanner::Other;
+    }
+    file.size = st.st_size;
+    file.modificationTime = st.st_mtime;
+    file.device = st.st_dev;
+    file.inode = st.st_ino;
+    return file;
+}
+
+QString linkTarget(int folderFd, const char *name, qint64 size)
+{
+    // Some file systems report a size of 0 for symlinks.
+    QByteArray target(size > 0 ? int(size) : PATH_MAX, Qt::Uninitialized);
+    const ssize_t length = readlinkat(folderFd, name, target.data(), target.size());
+    if (length < 0) {
+        return QString();
+    }
+    target.truncate(int(length));
+    return QFile::decodeName(target);
+}
+
+/**
+ * Fills @p file with the metadata of @p path.
+ * @return Whether @p path is a folder, or a symlink to a folder, whose content must be read.
+ */
+bool scanPath(const QString &path, FileScanner::ScannedFile *file)
+{
+    const QByteArray encodedPath = QFile::encodeName(path);
+    struct stat st;
+    if (lstat(encodedPath.constData(), &st) != 0) {
+        qCWarning(ARK) << "Could not read" << path;
+        file->path = path;
+        file->type = FileScanner::Other;
+        file->size = 0;
+        file->modificationTime = 0;
+        file->device = 0;
+        file->inode = 0;
+        return false;
+    }
+
+    *file = fileFromStat(path, st);
+    if (file->type == FileScanner::SymLink) {
+        file->linkTarget = linkTarget(AT_FDCWD, encodedPath.constData(), st.st_size);
+        struct stat target;
+        return stat(encodedPath.constData(), &target) == 0 && S_ISDIR(target.st_mode);
+    }
+
+    return file->isDir();
+}
+
+QVector<FileScanner::ScannedFile> readFolder(const QString &path)
+{
+    QVector<FileScanner::ScannedFile> files;
+
+    DIR *folder = opendir(QFile::encodeName(path).constData());
+    if (!folder) {
+        qCWarning(ARK) << "Could not read folder" << path;
+        return files;
+    }
+
+    const int folderFd = dirfd(folder);
+    const QString prefix = path.endsWith(QLatin1Char('/')) ? path : path + QLatin1Char('/');
+
+    // The names come from getdents64() in large batches, and the metadata is read relative to the open folder.
+    struct dirent *entry;
+    while ((entry = readdir(folder))) {
+        const char *name = entry->d_name;
+        if (qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (fstatat(folderFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+
+        const bool isSymLink = S_ISLNK(st.st_mode);
+        if (!isSymLink && !S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        // Symlinks are checked through, which skips the broken ones too.
+        if ((isSymLink || !(st.st_mode & S_IROTH)) && faccessat(folderFd, name, R_OK, 0) != 0) {
+            continue;
+        }
+
+        FileScanner::ScannedFile file = fileFromStat(prefix + QFile::decodeName(name), st);
+        if (isSymLink) {
+            file.linkTarget = linkTarget(folderFd, name, st.st_size);
+        }
+        files << file;
+    }
+
+    closedir(folder);
+    return files;
+}
+
+#else
+
+FileScanner::ScannedFile fileFromInfo(const QString &path, const QFileInfo &info)
+{
+    FileScanner::ScannedFile file;
+    file.path = path;
+    if (info.isSymLink()) {
+        file.type = FileScanner::SymLink;
+        file.linkTarget = info.symLinkTarget();
+    } else if (info.isDir()) {
+        file.type = FileScanner::Directory;
+    } else if (info.isFile()) {
+        file.type = FileScanner::File;
+    } else {
+        file.type = FileScanner::Other;
+    }
+    file.size = info.size();
+    file.modificationTime = info.lastModified().toMSecsSinceEpoch() / 1000;
+    file.device = 0;
+    file.inode = 0;
+    return file;
+}
+
+bool scanPath(const QString &path, FileScanner::ScannedFile *file)
+{
+    const QFileInfo info(path);
+    *file = fileFromInfo(path, info);
+    return info.isDir();
+}
+
+QVector<FileScanner::ScannedFile> readFolder(const QString &path)
+{
+    QVector<FileScanner::ScannedFile> files;
+
+    const QString prefix = path.endsWith(QLatin1Char('/')) ? path : path + QLatin1Char('/');
+    QDirIterator it(path, QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        files << fileFromInfo(prefix + it.fileName(), it.fileInfo());
+    }
+
+    return files;
+}
+
+#endif
+
+void scanFolders(ScanState *state)
+{
+    QMutexLocker locker(&state->mutex);
+
+    forever {
+        while (state->pendingFolders.isEmpty() && state->readingThreads > 0 && !state->caller->isInterruptionRequested()) {
+            state->foldersChanged.wait(&state->mutex);
+        }
+        if (state->pendingFolders.isEmpty() || state->caller->isInterruptionRequested()) {
+            state->foldersChanged.wakeAll();
+            return;
+        }
+
+        // The last folder found is likely a neighbour of the previous one, still in the caches.
+        const int folder = state->pendingFolders.takeLast();
+        const QString path = state->nodes.at(folder).file.path;
+        state->readingThreads++;
+
+        locker.unlock();
+        const QVector<FileScanner::ScannedFile> files = readFolder(path);
+        locker.relock();
+
+        QVector<int> children;
+        children.reserve(files.size());
+        foreach (const FileScanner::ScannedFile &file, files) {
+            const int index = state->nodes.size();
+            children << index;
+            if (file.isDir()) {
+                state->pendingFolders << index;
+            }
+            Node node;
+            node.file = file;
+            state->nodes << node;
+        }
+        state->nodes[folder].children = children;
+
+        state->readingThreads--;
+        state->foldersChanged.wakeAll();
+    }
+}
+
+}
+
+QVector<FileScanner::ScannedFile> FileScanner::scan(const QStringList &paths, int threadCount)
+{
+    ARK_TRACE_SCOPE("scan-files", "job");
+
+    ScanState state;
+    state.caller = QThread::currentThread();
+
+    QVector<int> roots;
+    roots.reserve(paths.size());
+    foreach (const QString &path, paths) {
+        Node node;
+        if (scanPath(path, &node.file)) {
+            state.pendingFolders << state.nodes.size();
+        }
+        roots << state.nodes.size();
+        state.nodes << node;
+    }
+
+    if (!state.pendingFolders.isEmpty()) {
+        if (threadCount <= 0) {
+            threadCount = qMax(1, QThread::idealThreadCount());
+        }
+
+        // The threads finish once no folder is left and none is being read.
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        for (int i = 0; i < threadCount; ++i) {
+            QtConcurrent::run(&pool, scanFolders, &state);
+        }
+        pool.waitForDone();
+    }
+
+    // The folders were read in any order, the manifest lists them depth-first.
+    QVector<ScannedFile> manifest;
+    manifest.reserve(state.nodes.size());
+    QVector<int> stack;
+    for (int i = roots.size() - 1; i >= 0; --i) {
+        stack << roots.at(i);
+    }
+    while (!stack.isEmpty()) {
+        const Node &node = state.nodes.at(stack.takeLast());
+        manifest << node.file;
+
+        QVector<int> children = node.children;
+        std::sort(children.begin(), children.end(), [&state](int a, int b) {
+            return state.nodes.at(a).file.path < state.nodes.at(b).file.path;
+        });
+        for (int i = children.size() - 1; i >= 0; --i) {
+            stack << children.at(i);
+        }
+    }
+
+    qCDebug(ARK) << "Scanned" << manifest.size() << "files from" << paths.size() << "paths";
+    return manifest;
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FILESCANNER_H
+#define FILESCANNER_H
+
+#include "kerfuffle_export.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace Kerfuffle
+{
+
+/**
+ * Walks the files to be added to an archive, once for the whole add operation.
+ *
+ * Folders are read by several threads at a time: each idle thread picks up the next
+ * folder found by the others. The resulting manifest lists each scanned path followed
+ * by its content, folders before their own content and siblings sorted by name.
+ *
+ * Like QDirIterator with QDir::AllEntries | QDir::Readable | QDir::Hidden, the content
+ * of folders skips unreadable files, broken symlinks and special files, and symlinks
+ * to folders are not followed. The scanned paths themselves are always listed, and
+ * are followed if they are symlinks to folders.
+ */
+class KERFUFFLE_EXPORT FileScanner
+{
+public:
+
+    enum FileType {
+        File,
+        Directory,
+        SymLink,
+        Other       // Special files, and scanned paths which could not be read.
+    };
+
+    struct ScannedFile
+    {
+        QString path;       // As scanned for the scanned paths, joined with a slash for their content.
+        FileType type;
+        qint64 size;
+        qint64 modificationTime;    // Seconds since the epoch.
+        quint64 device;
+        quint64 inode;
+        QString linkTarget; // Only set for symlinks.
+
+        bool isDir() const
+        {
+            return type == Directory;
+        }
+    };
+
+    /**
+     * Scans @p paths and the content of the folders among them. Relative paths are resolved
+     * against the current directory. The scan stops early if the calling thread is interrupted.
+     *
+     * @param threadCount The number of threads reading folders, or 0 for the ideal thread count.
+     */
+    static QVector<ScannedFile> scan(const QStringList &paths, int threadCount = 0);
+};
+
+typedef QVector<FileScanner::ScannedFile> FileManifest;
+
+}
+
+#endif // FILESCANNER_H
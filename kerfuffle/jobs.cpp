@@ -29,11 +29,11 @@
 #include "jobs.h"
 #include "archiveentry.h"
 #include "ark_debug.h"
+#include "tracer.h"
 
 #include <QDir>
-#include <QDirIterator>
 #include <QFileInfo>
-#include <QRegularExpression>
+#include <QMetaMethod>
 #include <QThread>
 #include <QTimer>
 #include <QUrl>
@@ -73,6 +73,15 @@ Job::Job(Archive *archive, ReadOnlyArchiveInterface *interface)
     , d(new Private(this))
 {
     setCapabilities(KJob::Killable);
+
+    // Sample the progress counters at 10 Hz, which is enough for a smooth progress bar
+    // without flooding the event loop.
+    m_progressTimer.setInterval(100);
+    connect(&m_progressTimer, &QTimer::timeout, this, &Job::sampleProgress);
+
+    connect(this, &KJob::finished, this, [this]() {
+        Tracer::asyncEnd(metaObject()->className(), "job", this);
+    });
 }
 
 Job::Job(Archive *archive)
@@ -85,9 +94,6 @@ Job::Job(ReadOnlyArchiveInterface *interface)
 
 Job::~Job()
 {
-    qDeleteAll(m_archiveEntries);
-    m_archiveEntries.clear();
-
     if (d->isRunning()) {
         d->wait();
     }
@@ -133,6 +139,7 @@ QString Job::errorString() const
 void Job::start()
 {
     jobTimer.start();
+    Tracer::asyncBegin(metaObject()->className(), "job", this);
 
     // We have an archive but it's not valid, nothing to do.
     if (archive() && !archive()->isValid()) {
@@ -142,6 +149,12 @@ void Job::start()
         return;
     }
 
+    if (m_isProgressSamplingEnabled) {
+        archiveInterface()->resetProgressCounters();
+        m_speedTimer.start();
+        m_progressTimer.start();
+    }
+
     if (archiveInterface()->waitForFinishedSignal()) {
         // CLI-based interfaces run a QProcess, no need to use threads.
         QTimer::singleShot(0, this, &Job::doWork);
@@ -184,12 +197,57 @@ void Job::onError(const QString & message, const QString & details)
 
 void Job::onEntry(Archive::Entry *entry)
 {
+    if (archiveInterface()->isStatisticsOnlyListing()) {
+        // The interface already accounted for this entry and will delete it.
+        return;
+    }
+
     emit newEntry(entry);
 }
 
 void Job::onProgress(double value)
 {
-    setPercent(static_cast<unsigned long>(100.0*value));
+    // Applied by the next sampleProgress().
+    m_lastProgress = value;
+}
+
+void Job::setProgressSamplingEnabled(bool enabled)
+{
+    m_isProgressSamplingEnabled = enabled;
+}
+
+void Job::sampleProgress()
+{
+    if (!archiveInterface()) {
+        return;
+    }
+
+    const qulonglong total = archiveInterface()->totalBytes();
+    const qulonglong processed = qMin(archiveInterface()->processedBytes(), total);
+
+    if (total > 0) {
+        // KJob updates the percentage and lets the job tracker compute the remaining time.
+        setTotalAmount(KJob::Bytes, total);
+        setProcessedAmount(KJob::Bytes, processed);
+
+        const qint64 elapsed = m_speedTimer.restart();
+        if (elapsed > 0 && processed >= m_lastProcessedBytes) {
+            const double currentSpeed = 1000.0 * (processed - m_lastProcessedBytes) / elapsed;
+            // Exponential moving average, so that the speed does not jump around on each sample.
+            m_speed = (m_speed > 0) ? 0.7 * m_speed + 0.3 * currentSpeed : currentSpeed;
+            emitSpeed(static_cast<unsigned long>(m_speed));
+        }
+        m_lastProcessedBytes = processed;
+    } else if (archiveInterface()->processedFraction() >= 0) {
+        setPercent(static_cast<unsigned long>(100.0*archiveInterface()->processedFraction()));
+    } else if (m_lastProgress >= 0) {
+        setPercent(static_cast<unsigned long>(100.0*m_lastProgress));
+    }
+
+    const qulonglong entries = archiveInterface()->processedEntries();
+    if (entries > 0) {
+        setProcessedAmount(KJob::Files, entries);
+    }
 }
 
 void Job::onInfo(const QString& info)
@@ -206,6 +264,11 @@ void Job::onFinished(bool result)
 {
     qCDebug(ARK) << "Job finished, result:" << result << ", time:" << jobTimer.elapsed() << "ms";
 
+    if (m_progressTimer.isActive()) {
+        m_progressTimer.stop();
+        sampleProgress();
+    }
+
     if (archive() && !archive()->isValid()) {
         setError(KJob::UserDefinedError);
     }
@@ -215,8 +278,10 @@ void Job::onFinished(bool result)
 
 void Job::onUserQuery(Query *query)
 {
-    if (archiveInterface()->waitForFinishedSignal()) {
-        qCWarning(ARK) << "Plugins run from the main thread should call directly query->execute()";
+    if (!isSignalConnected(QMetaMethod::fromSignal(&Job::userQuery))) {
+        qCWarning(ARK) << "No handler for the query, cancelling it";
+        query->cancel();
+        return;
     }
 
     emit userQuery(query);
@@ -238,11 +303,6 @@ bool Job::doKill()
 
 LoadJob::LoadJob(Archive *archive, ReadOnlyArchiveInterface *interface)
     : Job(archive, interface)
-    , m_isSingleFolderArchive(true)
-    , m_isPasswordProtected(false)
-    , m_extractedFilesSize(0)
-    , m_dirCount(0)
-    , m_filesCount(0)
 {
     qCDebug(ARK) << "LoadJob created";
     connect(this, &LoadJob::newEntry, this, &LoadJob::onNewEntry);
@@ -261,7 +321,12 @@ void LoadJob::doWork()
     emit description(this, i18n("Loading archive"), qMakePair(i18n("Archive"), archiveInterface()->filename()));
     connectToArchiveInterfaceSignals();
 
-    bool ret = archiveInterface()->list();
+    archiveInterface()->setStatisticsOnlyListing(m_statisticsOnly);
+    bool ret;
+    {
+        ARK_TRACE_SCOPE("list", "job");
+        ret = archiveInterface()->list();
+    }
 
     if (!archiveInterface()->waitForFinishedSignal()) {
         // onFinished() needs to be called after onNewEntry(), because the former reads members set in the latter.
@@ -274,6 +339,12 @@ void LoadJob::doWork()
 
 void LoadJob::onFinished(bool result)
 {
+    // The interface is null if the archive could not be loaded.
+    if (m_statisticsOnly && archiveInterface()) {
+        m_statistics = archiveInterface()->listingStatistics();
+        archiveInterface()->setStatisticsOnlyListing(false);
+    }
+
     if (archive()) {
         archive()->setProperty("unpackedSize", extractedFilesSize());
         archive()->setProperty("isSingleFolder", isSingleFolderArchive());
@@ -289,58 +360,35 @@ void LoadJob::onFinished(bool result)
 
 qlonglong LoadJob::extractedFilesSize() const
 {
-    return m_extractedFilesSize;
+    return m_statistics.extractedFilesSize();
 }
 
 bool LoadJob::isPasswordProtected() const
 {
-    return m_isPasswordProtected;
+    return m_statistics.isPasswordProtected();
 }
 
 bool LoadJob::isSingleFolderArchive() const
 {
-    if (m_filesCount == 1 && m_dirCount == 0) {
-        return false;
-    }
-
-    return m_isSingleFolderArchive;
+    return m_statistics.isSingleFolderArchive();
 }
 
 void LoadJob::onNewEntry(const Archive::Entry *entry)
 {
-    m_extractedFilesSize += entry->property("size").toLongLong();
-    m_isPasswordProtected |= entry->property("isPasswordProtected").toBool();
-
-    if (entry->isDir()) {
-        m_dirCount++;
-    } else {
-        m_filesCount++;
-    }
-
-    if (m_isSingleFolderArchive) {
-        // RPM filenames have the ./ prefix, and "." would be detected as the subfolder name, so we remove it.
-        const QString fullPath = entry->fullPath().replace(QRegularExpression(QStringLiteral("^\\./")), QString());
-        const QString basePath = fullPath.split(QLatin1Char('/')).at(0);
-
-        if (m_basePath.isEmpty()) {
-            m_basePath = basePath;
-            m_subfolderName = basePath;
-        } else {
-            if (m_basePath != basePath) {
-                m_isSingleFolderArchive = false;
-                m_subfolderName.clear();
-            }
-        }
-    }
+    m_statistics.addEntry(entry->fullPath(),
+                          entry->isDir(),
+                          entry->property("size").toLongLong(),
+                          entry->property("isPasswordProtected").toBool());
 }
 
 QString LoadJob::subfolderName() const
 {
-    if (!isSingleFolderArchive()) {
-        return QString();
-    }
+    return m_statistics.subfolderName();
+}
 
-    return m_subfolderName;
+void LoadJob::setStatisticsOnly(bool statisticsOnly)
+{
+    m_statisticsOnly = statisticsOnly;
 }
 
 BatchExtractJob::BatchExtractJob(LoadJob *loadJob, const QString &destination, bool autoSubfolder, bool preservePaths)
@@ -351,19 +399,24 @@ BatchExtractJob::BatchExtractJob(LoadJob *loadJob, const QString &destination, b
     , m_preservePaths(preservePaths)
 {
     qCDebug(ARK) << "BatchExtractJob created";
+
+    // Progress is forwarded from the LoadJob and the ExtractJob.
+    setProgressSamplingEnabled(false);
 }
 
 void BatchExtractJob::doWork()
 {
     connect(m_loadJob, &KJob::result, this, &BatchExtractJob::slotLoadingFinished);
     if (archiveInterface()->hasBatchExtractionProgress()) {
-        // progress() will be actually emitted by the LoadJob, but the archiveInterface() is the same.
-        connect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotLoadingProgress);
+        connect(m_loadJob, &KJob::percent, this, &BatchExtractJob::slotLoadingProgress);
     }
 
     // Forward LoadJob's signals.
     connect(m_loadJob, &Kerfuffle::Job::newEntry, this, &BatchExtractJob::newEntry);
     connect(m_loadJob, &Kerfuffle::Job::userQuery, this, &BatchExtractJob::userQuery);
+
+    // We only need the archive properties to set up the destination, so don't build the entries.
+    m_loadJob->setStatisticsOnly(true);
     m_loadJob->start();
 }
 
@@ -376,17 +429,21 @@ bool BatchExtractJob::doKill()
     return m_extractJob->kill();
 }
 
-void BatchExtractJob::slotLoadingProgress(double progress)
+void BatchExtractJob::slotLoadingProgress(KJob *job, unsigned long percent)
 {
+    Q_UNUSED(job)
+
     // Progress from LoadJob counts only for 50% of the BatchExtractJob's duration.
-    m_lastPercentage = static_cast<unsigned long>(50.0*progress);
+    m_lastPercentage = percent / 2;
     setPercent(m_lastPercentage);
 }
 
-void BatchExtractJob::slotExtractProgress(double progress)
+void BatchExtractJob::slotExtractProgress(KJob *job, unsigned long percent)
 {
+    Q_UNUSED(job)
+
     // The 2nd 50% of the BatchExtractJob's duration comes from the ExtractJob.
-    setPercent(m_lastPercentage + static_cast<unsigned long>(50.0*progress));
+    setPercent(m_lastPercentage + percent / 2);
 }
 
 void BatchExtractJob::slotLoadingFinished(KJob *job)
@@ -408,10 +465,12 @@ void BatchExtractJob::slotLoadingFinished(KJob *job)
     if (m_extractJob) {
         connect(m_extractJob, &KJob::result, this, &BatchExtractJob::emitResult);
         connect(m_extractJob, &Kerfuffle::Job::userQuery, this, &BatchExtractJob::userQuery);
+        connect(m_extractJob, &KJob::speed, this, [=](KJob *, unsigned long speed) {
+            emitSpeed(speed);
+        });
         if (archiveInterface()->hasBatchExtractionProgress()) {
-            // The LoadJob is done, change slot and start setting the percentage from m_lastPercentage on.
-            disconnect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotLoadingProgress);
-            connect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotExtractProgress);
+            // The LoadJob is done, start setting the percentage from m_lastPercentage on.
+            connect(m_extractJob, &KJob::percent, this, &BatchExtractJob::slotExtractProgress);
         }
         m_step = Extracting;
         m_extractJob->start();
@@ -452,6 +511,9 @@ CreateJob::CreateJob(Archive *archive, const QVector<Archive::Entry*> &entries,
     , m_options(options)
 {
     qCDebug(ARK) << "CreateJob created";
+
+    // The archive interface is driven by the AddJob.
+    setProgressSamplingEnabled(false);
 }
 
 void CreateJob::enableEncryption(const QString &password, bool encryptHeader)
@@ -519,7 +581,11 @@ void ExtractJob::doWork()
              << "Destination dir:" << m_destinationDir
              << "Options:" << m_options;
 
-    bool ret = archiveInterface()->extractFiles(m_entries, m_destinationDir, m_options);
+    bool ret;
+    {
+        ARK_TRACE_SCOPE("extract", "job");
+        ret = archiveInterface()->extractFiles(m_entries, m_destinationDir, m_options);
+    }
 
     if (!archiveInterface()->waitForFinishedSignal()) {
         onFinished(ret);
@@ -631,32 +697,14 @@ void AddJob::doWork()
         QDir::setCurrent(globalWorkDir);
     }
 
-    // Count total number of entries to be added.
-    uint totalCount = 0;
-    QElapsedTimer timer;
-    timer.start();
-    foreach (const Archive::Entry* entry, m_entries) {
-        totalCount++;
-        if (QFileInfo(entry->fullPath()).isDir()) {
-            QDirIterator it(entry->fullPath(), QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-            while (it.hasNext()) {
-                it.next();
-                totalCount++;
-            }
-        }
-    }
-
-    qCDebug(ARK) << "AddJob: going to add" << totalCount << "entries, counted in" << timer.elapsed() << "ms";
-
-    const QString desc = i18np("Compressing a file", "Compressing %1 files", totalCount);
-    emit description(this, desc, qMakePair(i18n("Archive"), archiveInterface()->filename()));
-
     ReadWriteArchiveInterface *m_writeInterface =
         qobject_cast<ReadWriteArchiveInterface*>(archiveInterface());
 
     Q_ASSERT(m_writeInterface);
 
     // The file paths must be relative to GlobalWorkDir.
+    QStringList paths;
+    paths.reserve(m_entries.size());
     foreach (Archive::Entry *entry, m_entries) {
         // #191821: workDir must be used instead of QDir::current()
         //          so that symlinks aren't resolved automatically
@@ -668,10 +716,31 @@ void AddJob::doWork()
         }
 
         entry->setFullPath(relativePath);
+        paths << relativePath;
     }
 
+    // Scan the files once: the plugin writes them from the same manifest.
+    QElapsedTimer timer;
+    timer.start();
+    const FileManifest files = FileScanner::scan(paths);
+    const uint totalCount = files.size();
+
+    qCDebug(ARK) << "AddJob: going to add" << totalCount << "entries, scanned in" << timer.elapsed() << "ms";
+
+    // In update modes the files are only candidates, the unchanged ones are skipped by the plugin.
+    const QString desc = (m_options.updateMode() == CompressionOptions::AddAllFiles)
+                         ? i18np("Compressing a file", "Compressing %1 files", totalCount)
+                         : i18np("Updating a file", "Updating from %1 files", totalCount);
+    emit description(this, desc, qMakePair(i18n("Archive"), archiveInterface()->filename()));
+
+    m_writeInterface->setScannedFiles(files);
+
     connectToArchiveInterfaceSignals();
-    bool ret = m_writeInterface->addFiles(m_entries, m_destination, m_options, totalCount);
+    bool ret;
+    {
+        ARK_TRACE_SCOPE("add", "job");
+        ret = m_writeInterface->addFiles(m_entries, m_destination, m_options, totalCount);
+    }
 
     if (!archiveInterface()->waitForFinishedSignal()) {
         onFinished(ret);
@@ -810,6 +879,32 @@ void CommentJob::doWork()
     }
 }
 
+CommitJob::CommitJob(ReadWriteArchiveInterface *interface)
+    : Job(interface)
+{
+}
+
+void CommitJob::doWork()
+{
+    emit description(this, i18n("Applying changes"), qMakePair(i18n("Archive"), archiveInterface()->filename()));
+
+    ReadWriteArchiveInterface *m_writeInterface =
+        qobject_cast<ReadWriteArchiveInterface*>(archiveInterface());
+
+    Q_ASSERT(m_writeInterface);
+
+    connectToArchiveInterfaceSignals();
+    bool ret;
+    {
+        ARK_TRACE_SCOPE("commit", "job");
+        ret = m_writeInterface->commitTransaction();
+    }
+
+    if (!archiveInterface()->waitForFinishedSignal()) {
+        onFinished(ret);
+    }
+}
+
 TestJob::TestJob(ReadOnlyArchiveInterface *interface)
     : Job(interface)
 {
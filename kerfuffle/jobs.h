@@ -39,6 +39,7 @@
 
 #include <QElapsedTimer>
 #include <QTemporaryDir>
+#include <QTimer>
 
 namespace Kerfuffle
 {
@@ -65,10 +66,15 @@ protected:
     bool doKill() override;
 
     ReadOnlyArchiveInterface *archiveInterface();
-    QVector<Archive::Entry*> m_archiveEntries;
 
     void connectToArchiveInterfaceSignals();
 
+    /**
+     * Whether the job should periodically sample the progress counters of its archive interface.
+     * Jobs that only wrap other jobs should disable this and forward the progress of the wrapped jobs.
+     */
+    void setProgressSamplingEnabled(bool enabled);
+
 public slots:
     virtual void doWork() = 0;
 
@@ -82,6 +88,9 @@ protected slots:
     virtual void onFinished(bool result);
     virtual void onUserQuery(Query *query);
 
+private slots:
+    void sampleProgress();
+
 signals:
     void entryRemoved(const QString & entry);
     void newEntry(Archive::Entry*);
@@ -91,6 +100,12 @@ private:
     Archive *m_archive;
     ReadOnlyArchiveInterface *m_archiveInterface;
     QElapsedTimer jobTimer;
+    QTimer m_progressTimer;
+    QElapsedTimer m_speedTimer;
+    bool m_isProgressSamplingEnabled = true;
+    double m_lastProgress = -1;
+    qulonglong m_lastProcessedBytes = 0;
+    double m_speed = 0;
 
     class Private;
     Private * const d;
@@ -126,6 +141,12 @@ public:
     bool isSingleFolderArchive() const;
     QString subfolderName() const;
 
+    /**
+     * Whether the job should only compute the archive properties, without emitting newEntry().
+     * @see ReadOnlyArchiveInterface::setStatisticsOnlyListing()
+     */
+    void setStatisticsOnly(bool statisticsOnly);
+
 public slots:
     void doWork() override;
 
@@ -135,13 +156,8 @@ protected slots:
 private:
     explicit LoadJob(Archive *archive, ReadOnlyArchiveInterface *interface);
 
-    bool m_isSingleFolderArchive;
-    bool m_isPasswordProtected;
-    QString m_subfolderName;
-    QString m_basePath;
-    qlonglong m_extractedFilesSize;
-    qlonglong m_dirCount;
-    qlonglong m_filesCount;
+    ListingStatistics m_statistics;
+    bool m_statisticsOnly = false;
 
 private slots:
     void onNewEntry(const Archive::Entry*);
@@ -170,8 +186,8 @@ protected:
     bool doKill() override;
 
 private slots:
-    void slotLoadingProgress(double progress);
-    void slotExtractProgress(double progress);
+    void slotLoadingProgress(KJob *job, unsigned long percent);
+    void slotExtractProgress(KJob *job, unsigned long percent);
     void slotLoadingFinished(KJob *job);
 
 private:
@@ -410,6 +426,20 @@ private:
     QString m_comment;
 };
 
+/**
+ * Writes the operations queued since ReadWriteArchiveInterface::beginTransaction().
+ */
+class KERFUFFLE_EXPORT CommitJob : public Job
+{
+    Q_OBJECT
+
+public:
+    explicit CommitJob(ReadWriteArchiveInterface *interface);
+
+public slots:
+    void doWork() override;
+};
+
 class KERFUFFLE_EXPORT TestJob : public Job
 {
     Q_OBJECT
@@ -0,0 +1,110 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "listingstatistics.h"
+
+namespace Kerfuffle
+{
+
+void ListingStatistics::addEntry(const QString &fullPath, bool isDirectory, qlonglong size, bool isPasswordProtected)
+{
+    m_extractedFilesSize += size;
+    m_isPasswordProtected |= isPasswordProtected;
+
+    if (isDirectory) {
+        m_dirsCount++;
+    } else {
+        m_filesCount++;
+    }
+
+    if (!m_isSingleFolderArchive) {
+        return;
+    }
+
+    // RPM filenames have the ./ prefix, and "." would be detected as the subfolder name, so we skip it.
+    const int start = fullPath.startsWith(QLatin1String("./")) ? 2 : 0;
+    const int slash = fullPath.indexOf(QLatin1Char('/'), start);
+    const QStringRef basePath = fullPath.midRef(start, slash == -1 ? -1 : slash - start);
+
+    if (m_basePath.isEmpty()) {
+        m_basePath = basePath.toString();
+    } else if (basePath != m_basePath) {
+        m_isSingleFolderArchive = false;
+        m_basePath.clear();
+    }
+}
+
+void ListingStatistics::reset()
+{
+    *this = ListingStatistics();
+}
+
+qlonglong ListingStatistics::entriesCount() const
+{
+    return m_filesCount + m_dirsCount;
+}
+
+qlonglong ListingStatistics::filesCount() const
+{
+    return m_filesCount;
+}
+
+qlonglong ListingStatistics::dirsCount() const
+{
+    return m_dirsCount;
+}
+
+qlonglong ListingStatistics::extractedFilesSize() const
+{
+    return m_extractedFilesSize;
+}
+
+bool ListingStatistics::isPasswordProtected() const
+{
+    return m_isPasswordProtected;
+}
+
+bool ListingStatistics::isSingleFolderArchive() const
+{
+    if (m_filesCount == 1 && m_dirsCount == 0) {
+        return false;
+    }
+
+    return m_isSingleFolderArchive;
+}
+
+QString ListingStatistics::subfolderName() const
+{
+    if (!isSingleFolderArchive()) {
+        return QString();
+    }
+
+    return m_basePath;
+}
+
+}
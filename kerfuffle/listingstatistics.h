@@ -0,0 +1,81 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef LISTINGSTATISTICS_H
+#define LISTINGSTATISTICS_H
+
+#include "kerfuffle_export.h"
+
+#include <QString>
+
+namespace Kerfuffle
+{
+
+/**
+ * Aggregate facts about the entries of an archive, accumulated while listing it.
+ *
+ * This is all a headless job such as BatchExtractJob needs to know about an archive,
+ * so plugins can feed these statistics instead of creating an Archive::Entry for every entry.
+ */
+class KERFUFFLE_EXPORT ListingStatistics
+{
+public:
+
+    void addEntry(const QString &fullPath, bool isDirectory, qlonglong size, bool isPasswordProtected);
+    void reset();
+
+    qlonglong entriesCount() const;
+    qlonglong filesCount() const;
+    qlonglong dirsCount() const;
+    qlonglong extractedFilesSize() const;
+    bool isPasswordProtected() const;
+
+    /**
+     * @return Whether all the entries are contained in a single top-level folder.
+     * An archive with only one file is not considered a single-folder archive.
+     */
+    bool isSingleFolderArchive() const;
+
+    /**
+     * @return The name of the top-level folder, or an empty string if this is not a single-folder archive.
+     */
+    QString subfolderName() const;
+
+private:
+
+    qlonglong m_filesCount = 0;
+    qlonglong m_dirsCount = 0;
+    qlonglong m_extractedFilesSize = 0;
+    bool m_isPasswordProtected = false;
+    bool m_isSingleFolderArchive = true;
+    QString m_basePath;
+};
+
+}
+
+#endif
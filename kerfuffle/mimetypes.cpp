@@ -24,6 +24,7 @@
  */
 
 #include "mimetypes.h"
+#include "archivesniffer.h"
 #include "ark_debug.h"
 
 #include <QFileInfo>
@@ -36,6 +37,26 @@
 namespace Kerfuffle
 {
 
+/**
+ * @return The more precise of @p sniffedMime and @p mimeFromExtension.
+ * Formats based on archives are only told apart by their extension, e.g. OpenDocument files are zip archives.
+ */
+static QMimeType refinedMimeType(const QMimeType &sniffedMime, const QMimeType &mimeFromExtension)
+{
+    return mimeFromExtension.inherits(sniffedMime.name()) ? mimeFromExtension : sniffedMime;
+}
+
+QMimeType sniffMimeType(const QString& filename)
+{
+    QMimeDatabase db;
+    const QMimeType sniffedMime = db.mimeTypeForName(ArchiveSniffer::mimeTypeNameForFile(filename));
+    if (!sniffedMime.isValid()) {
+        return sniffedMime;
+    }
+
+    return refinedMimeType(sniffedMime, db.mimeTypeForFile(filename, QMimeDatabase::MatchExtension));
+}
+
 QMimeType determineMimeType(const QString& filename)
 {
     QMimeDatabase db;
@@ -82,14 +103,21 @@ QMimeType determineMimeType(const QString& filename)
     }
 
     QMimeType mimeFromExtension = db.mimeTypeForFile(inputFile, QMimeDatabase::MatchExtension);
-    QMimeType mimeFromContent = db.mimeTypeForFile(filename, QMimeDatabase::MatchContent);
 
-    // mimeFromContent will be "application/octet-stream" when file is
-    // unreadable, so use extension.
+    // Content can't be detected when file is unreadable, so use extension.
     if (!fileinfo.isReadable()) {
         return mimeFromExtension;
     }
 
+    // Most archives are recognised from their first bytes, without matching
+    // the content against the whole mimetype database.
+    const QMimeType sniffedMime = db.mimeTypeForName(ArchiveSniffer::mimeTypeNameForFile(filename));
+    if (sniffedMime.isValid()) {
+        return refinedMimeType(sniffedMime, mimeFromExtension);
+    }
+
+    QMimeType mimeFromContent = db.mimeTypeForFile(filename, QMimeDatabase::MatchContent);
+
     // Compressed tar-archives are detected as single compressed files when
     // detecting by content. The following code fixes detection of tar.gz, tar.bz2, tar.xz,
     // tar.lzo, tar.lz and tar.lrz.
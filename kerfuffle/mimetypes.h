@@ -33,6 +33,12 @@
 namespace Kerfuffle
 {
     KERFUFFLE_EXPORT QMimeType determineMimeType(const QString& filename);
+
+    /**
+     * @return The mimetype of @p filename recognised by ArchiveSniffer, or an invalid mimetype.
+     * Unlike determineMimeType(), this never matches the content against the whole mimetype database.
+     */
+    KERFUFFLE_EXPORT QMimeType sniffMimeType(const QString& filename);
 }
 
 #endif // MIMETYPES_H
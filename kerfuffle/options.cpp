@@ -130,6 +130,36 @@ void CompressionOptions::setGlobalWorkDir(const QString &workDir)
     m_globalWorkDir = workDir;
 }
 
+bool CompressionOptions::deduplicateFiles() const
+{
+    return m_deduplicateFiles;
+}
+
+void CompressionOptions::setDeduplicateFiles(bool deduplicate)
+{
+    m_deduplicateFiles = deduplicate;
+}
+
+CompressionOptions::UpdateMode CompressionOptions::updateMode() const
+{
+    return m_updateMode;
+}
+
+void CompressionOptions::setUpdateMode(UpdateMode mode)
+{
+    m_updateMode = mode;
+}
+
+bool CompressionOptions::compareChecksums() const
+{
+    return m_compareChecksums;
+}
+
+void CompressionOptions::setCompareChecksums(bool compare)
+{
+    m_compareChecksums = compare;
+}
+
 QDebug operator<<(QDebug d, const CompressionOptions &options)
 {
     d.nospace() << "(encryption hint: " << options.encryptedArchiveHint();
@@ -144,6 +174,15 @@ QDebug operator<<(QDebug d, const CompressionOptions &options)
     }
     d.nospace() << ", compression level: " << options.compressionLevel();
     d.nospace() << ", volume size: " << options.volumeSize();
+    if (options.deduplicateFiles()) {
+        d.nospace() << ", deduplicate files";
+    }
+    if (options.updateMode() != CompressionOptions::AddAllFiles) {
+        d.nospace() << ", update mode: " << options.updateMode();
+    }
+    if (options.compareChecksums()) {
+        d.nospace() << ", compare checksums";
+    }
     d.nospace() << ")";
     return d.space();
 }
@@ -51,6 +51,12 @@ class KERFUFFLE_EXPORT CompressionOptions : public Options
 {
 public:
 
+    enum UpdateMode {
+        AddAllFiles,        ///< Every file is written, replacing the entries with the same name.
+        UpdateChangedFiles, ///< Only new files and the files which changed since they were stored are written.
+        FreshenChangedFiles ///< Only the files which changed since they were stored are written, new files are skipped.
+    };
+
     /**
      * @return Whether a custom compression level has been set in the options.
      * If false, the default level from the ArchiveFormat should be used instead.
@@ -76,12 +82,36 @@ public:
     QString globalWorkDir() const;
     void setGlobalWorkDir(const QString &workDir);
 
+    /**
+     * Whether files with the same content should be stored only once, as links to the first one.
+     * This is only honored by formats which can store hard links.
+     */
+    bool deduplicateFiles() const;
+    void setDeduplicateFiles(bool deduplicate);
+
+    /**
+     * Files are unchanged if their size and modification time match the entry stored under the same name.
+     * This is only honored by formats whose entries can be kept as they are.
+     */
+    UpdateMode updateMode() const;
+    void setUpdateMode(UpdateMode mode);
+
+    /**
+     * Whether files whose modification time changed should be compared to the checksum of the
+     * stored entry, if the format stores one, before being written again.
+     */
+    bool compareChecksums() const;
+    void setCompareChecksums(bool compare);
+
 private:
     int m_compressionLevel = -1;
     ulong m_volumeSize = 0;
     QString m_compressionMethod;
     QString m_encryptionMethod;
     QString m_globalWorkDir;
+    bool m_deduplicateFiles = false;
+    UpdateMode m_updateMode = AddAllFiles;
+    bool m_compareChecksums = false;
 };
 
 class KERFUFFLE_EXPORT ExtractionOptions : public Options
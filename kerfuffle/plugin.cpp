@@ -27,9 +27,9 @@
 
 #include "plugin.h"
 #include "ark_debug.h"
+#include "capabilitycache.h"
 
 #include <QJsonArray>
-#include <QStandardPaths>
 
 namespace Kerfuffle
 {
@@ -47,6 +47,16 @@ int Plugin::priority() const
     return (priority > 0 ? priority : 0);
 }
 
+int Plugin::readPriority() const
+{
+    return priority(QStringLiteral("X-KDE-Kerfuffle-ReadPriority"));
+}
+
+int Plugin::writePriority() const
+{
+    return priority(QStringLiteral("X-KDE-Kerfuffle-WritePriority"));
+}
+
 bool Plugin::isEnabled() const
 {
     return m_enabled;
@@ -88,6 +98,18 @@ QStringList Plugin::readWriteExecutables() const
     return readWriteExecutables;
 }
 
+QStringList Plugin::splitVolumeMimeTypes() const
+{
+    QStringList mimeTypes;
+
+    const QJsonArray array = m_metaData.rawData()[QStringLiteral("X-KDE-Kerfuffle-SplitVolumeMimeTypes")].toArray();
+    foreach (const QJsonValue &value, array) {
+        mimeTypes << value.toString();
+    }
+
+    return mimeTypes;
+}
+
 KPluginMetaData Plugin::metaData() const
 {
     return m_metaData;
@@ -103,6 +125,17 @@ bool Plugin::isValid() const
     return isEnabled() && m_metaData.isValid() && hasRequiredExecutables();
 }
 
+int Plugin::priority(const QString &key) const
+{
+    const QJsonValue value = m_metaData.rawData()[key];
+    if (value.isUndefined()) {
+        return priority();
+    }
+
+    const int priority = value.toInt();
+    return (priority > 0 ? priority : 0);
+}
+
 bool Plugin::findExecutables(const QStringList &executables)
 {
     foreach (const QString &executable, executables) {
@@ -110,7 +143,7 @@ bool Plugin::findExecutables(const QStringList &executables)
             continue;
         }
 
-        if (QStandardPaths::findExecutable(executable).isEmpty()) {
+        if (!CapabilityCache::self()->hasExecutable(executable)) {
             return false;
         }
     }
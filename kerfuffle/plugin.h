@@ -46,6 +46,16 @@ class KERFUFFLE_EXPORT Plugin : public QObject
      */
     Q_PROPERTY(int priority READ priority CONSTANT)
 
+    /**
+     * The priority of the plugin for listing, extracting and previewing. Defaults to priority.
+     */
+    Q_PROPERTY(int readPriority READ readPriority CONSTANT)
+
+    /**
+     * The priority of the plugin for adding, deleting, moving and commenting. Defaults to priority.
+     */
+    Q_PROPERTY(int writePriority READ writePriority CONSTANT)
+
     /**
      * Whether the plugin has been enabled in the settings.
      */
@@ -68,6 +78,12 @@ class KERFUFFLE_EXPORT Plugin : public QObject
      */
     Q_PROPERTY(QStringList readWriteExecutables READ readWriteExecutables CONSTANT)
 
+    /**
+     * The mimetypes whose split volumes (name.ext.001, name.partN.rar) the plugin reads as one archive.
+     * These may be missing from the plugin's mimetypes, when it only reads them split.
+     */
+    Q_PROPERTY(QStringList splitVolumeMimeTypes READ splitVolumeMimeTypes CONSTANT)
+
     /**
      * The plugin's JSON metadata. This provides easy access to the supported mimetypes list.
      */
@@ -78,11 +94,14 @@ public:
 
 
     int priority() const;
+    int readPriority() const;
+    int writePriority() const;
     bool isEnabled() const;
     void setEnabled(bool enabled);
     bool isReadWrite() const;
     QStringList readOnlyExecutables() const;
     QStringList readWriteExecutables() const;
+    QStringList splitVolumeMimeTypes() const;
     KPluginMetaData metaData() const;
 
     /**
@@ -104,7 +123,12 @@ signals:
 private:
 
     /**
-     * @return Whether all the given executables are found in $PATH.
+     * @return The value of the priority @p key, or priority() if the plugin does not declare it.
+     */
+    int priority(const QString &key) const;
+
+    /**
+     * @return Whether all the given executables are found in $PATH, see CapabilityCache.
      */
     static bool findExecutables(const QStringList &executables);
 
@@ -27,17 +27,14 @@
 
 #include "pluginmanager.h"
 #include "ark_debug.h"
+#include "capabilitycache.h"
 #include "settings.h"
 
 #include <KConfigGroup>
 #include <KPluginLoader>
 #include <KSharedConfig>
 
-#include <QFileInfo>
 #include <QMimeDatabase>
-#include <QProcess>
-#include <QRegularExpression>
-#include <QSet>
 
 #include <algorithm>
 
@@ -121,75 +118,25 @@ Plugin *PluginManager::preferredWritePluginFor(const QMimeType &mimeType) const
 
 QStringList PluginManager::supportedMimeTypes(MimeSortingMode mode) const
 {
-    QSet<QString> supported;
-    QMimeDatabase db;
-    foreach (Plugin *plugin, availablePlugins()) {
-        foreach (const auto& mimeType, plugin->metaData().mimeTypes()) {
-            if (db.mimeTypeForName(mimeType).isValid()) {
-                supported.insert(mimeType);
-            }
-        }
-    }
-
-    // Remove entry for lrzipped tar if lrzip executable not found in path.
-    if (QStandardPaths::findExecutable(QStringLiteral("lrzip")).isEmpty()) {
-        supported.remove(QStringLiteral("application/x-lrzip-compressed-tar"));
-    }
-
-    // Remove entry for lz4-compressed tar if lz4 executable not found in path.
-    if (QStandardPaths::findExecutable(QStringLiteral("lz4")).isEmpty()) {
-        supported.remove(QStringLiteral("application/x-lz4-compressed-tar"));
-    }
-
-    // Remove entry for lzo-compressed tar if libarchive not linked against lzo and lzop executable not found in path.
-    if (!libarchiveHasLzo() && QStandardPaths::findExecutable(QStringLiteral("lzop")).isEmpty()) {
-        supported.remove(QStringLiteral("application/x-tzo"));
-    }
-
     if (mode == SortByComment) {
-        return sortByComment(supported);
+        return sortByComment(supportedMimeTypeSet(false));
     }
 
-    return supported.toList();
+    return supportedMimeTypeSet(false).toList();
 }
 
 QStringList PluginManager::supportedWriteMimeTypes(MimeSortingMode mode) const
 {
-    QSet<QString> supported;
-    QMimeDatabase db;
-    foreach (Plugin *plugin, availableWritePlugins()) {
-        foreach (const auto& mimeType, plugin->metaData().mimeTypes()) {
-            if (db.mimeTypeForName(mimeType).isValid()) {
-                supported.insert(mimeType);
-            }
-        }
-    }
-
-    // Remove entry for lrzipped tar if lrzip executable not found in path.
-    if (QStandardPaths::findExecutable(QStringLiteral("lrzip")).isEmpty()) {
-        supported.remove(QStringLiteral("application/x-lrzip-compressed-tar"));
-    }
-
-    // Remove entry for lz4-compressed tar if lz4 executable not found in path.
-    if (QStandardPaths::findExecutable(QStringLiteral("lz4")).isEmpty()) {
-        supported.remove(QStringLiteral("application/x-lz4-compressed-tar"));
-    }
-
-    // Remove entry for lzo-compressed tar if libarchive not linked against lzo and lzop executable not found in path.
-    if (!libarchiveHasLzo() && QStandardPaths::findExecutable(QStringLiteral("lzop")).isEmpty()) {
-        supported.remove(QStringLiteral("application/x-tzo"));
-    }
-
     if (mode == SortByComment) {
-        return sortByComment(supported);
+        return sortByComment(supportedMimeTypeSet(true));
     }
 
-    return supported.toList();
+    return supportedMimeTypeSet(true).toList();
 }
 
 QVector<Plugin*> PluginManager::filterBy(const QVector<Plugin*> &plugins, const QMimeType &mimeType) const
 {
-    const bool supportedMime = supportedMimeTypes().contains(mimeType.name());
+    const bool supportedMime = supportedMimeTypeSet(false).contains(mimeType.name());
     QVector<Plugin*> filteredPlugins;
     foreach (Plugin *plugin, plugins) {
         if (!supportedMime) {
@@ -220,6 +167,9 @@ void PluginManager::loadPlugins()
 
         Plugin *plugin = new Plugin(this, metaData);
         plugin->setEnabled(!ArkSettings::disabledPlugins().contains(pluginId));
+        connect(plugin, &Plugin::enabledChanged, this, [this]() {
+            clearCaches();
+        });
         addedPlugins << pluginId;
         m_plugins << plugin;
     }
@@ -255,35 +205,55 @@ QStringList PluginManager::sortByComment(const QSet<QString> &mimeTypes)
     return sortedMimeTypes;
 }
 
-bool PluginManager::libarchiveHasLzo()
+const QSet<QString> &PluginManager::supportedMimeTypeSet(bool readWrite) const
 {
-    // Step 1: look for the libarchive plugin, which is built against libarchive.
-    const QString pluginPath = []() {
-        foreach (const QString &path, QCoreApplication::libraryPaths()) {
-            const QString pluginPath = QStringLiteral("%1/kerfuffle/kerfuffle_libarchive.so").arg(path);
-            if (QFileInfo::exists(pluginPath)) {
-                return pluginPath;
+    if (!m_hasSupportedMimeTypes) {
+        m_supportedMimeTypes = computeSupportedMimeTypes(availablePlugins());
+        m_supportedWriteMimeTypes = computeSupportedMimeTypes(availableWritePlugins());
+        m_hasSupportedMimeTypes = true;
+    }
+
+    return readWrite ? m_supportedWriteMimeTypes : m_supportedMimeTypes;
+}
+
+QSet<QString> PluginManager::computeSupportedMimeTypes(const QVector<Plugin*> &plugins)
+{
+    QSet<QString> supported;
+    QMimeDatabase db;
+    foreach (Plugin *plugin, plugins) {
+        foreach (const auto& mimeType, plugin->metaData().mimeTypes()) {
+            if (db.mimeTypeForName(mimeType).isValid()) {
+                supported.insert(mimeType);
             }
         }
+    }
 
-        return QString();
-    }();
-
-    // Step 2: ldd the libarchive plugin to figure out the absolute libarchive path.
-    QProcess ldd;
-    ldd.start(QStringLiteral("ldd"), {pluginPath});
-    ldd.waitForFinished();
-    const QString output = QString::fromUtf8(ldd.readAllStandardOutput());
-    QRegularExpression regex(QStringLiteral("/.*/libarchive.so"));
-    if (!regex.match(output).hasMatch()) {
-        return false;
+    CapabilityCache *capabilities = CapabilityCache::self();
+
+    // Remove entry for lrzipped tar if lrzip executable not found in path.
+    if (!capabilities->hasExecutable(QStringLiteral("lrzip"))) {
+        supported.remove(QStringLiteral("application/x-lrzip-compressed-tar"));
     }
 
-    // Step 3: check whether libarchive links against liblzo.
-    const QString libarchivePath = regex.match(output).captured(0);
-    ldd.start(QStringLiteral("ldd"), {libarchivePath});
-    ldd.waitForFinished();
-    return ldd.readAllStandardOutput().contains(QByteArrayLiteral("lzo"));
+    // Remove entry for lz4-compressed tar if lz4 executable not found in path.
+    if (!capabilities->hasExecutable(QStringLiteral("lz4"))) {
+        supported.remove(QStringLiteral("application/x-lz4-compressed-tar"));
+    }
+
+    // Remove entry for lzo-compressed tar if libarchive not linked against lzo and lzop executable not found in path.
+    // Inspecting libarchive is the most expensive check, so it is skipped when possible.
+    if (supported.contains(QStringLiteral("application/x-tzo")) &&
+        !capabilities->libarchiveHasLzo() && !capabilities->hasExecutable(QStringLiteral("lzop"))) {
+        supported.remove(QStringLiteral("application/x-tzo"));
+    }
+
+    return supported;
+}
+
+void PluginManager::clearCaches()
+{
+    m_preferredPluginsCache.clear();
+    m_hasSupportedMimeTypes = false;
 }
 
 }
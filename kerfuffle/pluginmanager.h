@@ -31,6 +31,7 @@
 #include "plugin.h"
 
 #include <QMimeType>
+#include <QSet>
 
 namespace Kerfuffle
 {
@@ -131,12 +132,18 @@ private:
     static QStringList sortByComment(const QSet<QString> &mimeTypes);
 
     /**
-     * Workaround for libarchive >= 3.3 not linking against liblzo.
+     * @return The mimetypes supported by the available plugins, or only by the read-write ones.
+     * Both sets are computed once, until a plugin is enabled or disabled.
      */
-    static bool libarchiveHasLzo();
+    const QSet<QString> &supportedMimeTypeSet(bool readWrite) const;
+    static QSet<QString> computeSupportedMimeTypes(const QVector<Plugin*> &plugins);
+    void clearCaches();
 
     QVector<Plugin*> m_plugins;
     QHash<QString, QVector<Plugin*>> m_preferredPluginsCache;
+    mutable QSet<QString> m_supportedMimeTypes;
+    mutable QSet<QString> m_supportedWriteMimeTypes;
+    mutable bool m_hasSupportedMimeTypes = false;
 };
 
 }
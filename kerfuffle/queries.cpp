@@ -27,6 +27,7 @@
 
 #include "queries.h"
 #include "ark_debug.h"
+#include "tracer.h"
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -53,6 +54,7 @@ QVariant Query::response() const
 
 void Query::waitForResponse()
 {
+    ARK_TRACE_SCOPE("user-query-wait", "query");
     QMutexLocker locker(&m_responseMutex);
     //if there is no response set yet, wait
     if (!m_data.contains(QStringLiteral("response"))) {
@@ -62,6 +64,8 @@ void Query::waitForResponse()
 
 void Query::setResponse(const QVariant &response)
 {
+    // The waiting thread might be checking for a response right now.
+    QMutexLocker locker(&m_responseMutex);
     m_data[QStringLiteral( "response" )] = response;
     m_responseCondition.wakeAll();
 }
@@ -75,6 +79,7 @@ OverwriteQuery::OverwriteQuery(const QString &filename) :
 
 void OverwriteQuery::execute()
 {
+    ARK_TRACE_SCOPE("user-query", "query");
     // If we are being called from the KPart, the cursor is probably Qt::WaitCursor
     // at the moment (#231974)
     QApplication::setOverrideCursor(QCursor(Qt::ArrowCursor));
@@ -107,6 +112,11 @@ void OverwriteQuery::execute()
     QApplication::restoreOverrideCursor();
 }
 
+void OverwriteQuery::cancel()
+{
+    setResponse(KIO::R_CANCEL);
+}
+
 bool OverwriteQuery::responseCancelled()
 {
     return m_data.value(QStringLiteral( "response" )).toInt() == KIO::R_CANCEL;
@@ -135,6 +145,11 @@ bool OverwriteQuery::responseAutoSkip()
     return m_data.value(QStringLiteral( "response" )).toInt() == KIO::R_AUTO_SKIP;
 }
 
+QString OverwriteQuery::filename()
+{
+    return m_data.value(QStringLiteral( "filename" )).toString();
+}
+
 QString OverwriteQuery::newFilename()
 {
     return m_data.value(QStringLiteral( "newFilename" )).toString();
@@ -168,6 +183,7 @@ PasswordNeededQuery::PasswordNeededQuery(const QString& archiveFilename, bool in
 
 void PasswordNeededQuery::execute()
 {
+    ARK_TRACE_SCOPE("user-query", "query");
     qCDebug(ARK) << "Executing password prompt";
 
     // If we are being called from the KPart, the cursor is probably Qt::WaitCursor
@@ -193,6 +209,11 @@ void PasswordNeededQuery::execute()
     delete dlg.data();
 }
 
+void PasswordNeededQuery::cancel()
+{
+    setResponse(false);
+}
+
 QString PasswordNeededQuery::password()
 {
     return m_data.value(QStringLiteral( "password" )).toString();
@@ -210,6 +231,7 @@ LoadCorruptQuery::LoadCorruptQuery(const QString& archiveFilename)
 
 void LoadCorruptQuery::execute()
 {
+    ARK_TRACE_SCOPE("user-query", "query");
     qCDebug(ARK) << "Executing LoadCorrupt prompt";
     QApplication::setOverrideCursor(QCursor(Qt::ArrowCursor));
 
@@ -222,6 +244,11 @@ void LoadCorruptQuery::execute()
     QApplication::restoreOverrideCursor();
 }
 
+void LoadCorruptQuery::cancel()
+{
+    setResponse(KMessageBox::No);
+}
+
 bool LoadCorruptQuery::responseYes() {
     return (m_data.value(QStringLiteral("response")).toInt() == KMessageBox::Yes);
 }
@@ -235,6 +262,7 @@ ContinueExtractionQuery::ContinueExtractionQuery(const QString& error, const QSt
 
 void ContinueExtractionQuery::execute()
 {
+    ARK_TRACE_SCOPE("user-query", "query");
     qCDebug(ARK) << "Executing ContinueExtraction prompt";
     QApplication::setOverrideCursor(QCursor(Qt::ArrowCursor));
 
@@ -251,6 +279,11 @@ void ContinueExtractionQuery::execute()
     QApplication::restoreOverrideCursor();
 }
 
+void ContinueExtractionQuery::cancel()
+{
+    setResponse(QMessageBox::Cancel);
+}
+
 bool ContinueExtractionQuery::responseCancelled() {
     return (m_data.value(QStringLiteral("response")).toInt() == QMessageBox::Cancel);
 }
@@ -50,6 +50,12 @@ public:
      */
     virtual void execute() = 0;
 
+    /**
+     * Sets the response of a user cancelling the query, without asking.
+     * Used when nobody can execute the query.
+     */
+    virtual void cancel() = 0;
+
     /**
      * Will block until the response have been set.
      * Useful for worker threads that need to show a dialog.
@@ -58,6 +64,11 @@ public:
 
     QVariant response() const;
 
+    /**
+     * Answers the query without asking the user.
+     */
+    void setResponse(const QVariant &response);
+
 protected:
     /**
      * Protected constructor
@@ -65,8 +76,6 @@ protected:
     Query();
     virtual ~Query() {}
 
-    void setResponse(const QVariant &response);
-
     QueryData m_data;
 
 private:
@@ -83,12 +92,14 @@ class KERFUFFLE_EXPORT OverwriteQuery : public Query
 public:
     explicit OverwriteQuery(const QString& filename);
     void execute() override;
+    void cancel() override;
     bool responseCancelled();
     bool responseOverwriteAll();
     bool responseOverwrite();
     bool responseRename();
     bool responseSkip();
     bool responseAutoSkip();
+    QString filename();
     QString newFilename();
 
     void setNoRenameMode(bool enableNoRenameMode);
@@ -109,6 +120,7 @@ class KERFUFFLE_EXPORT PasswordNeededQuery : public Query
 public:
     explicit PasswordNeededQuery(const QString& archiveFilename, bool incorrectTryAgain = false);
     void execute() override;
+    void cancel() override;
 
     bool responseCancelled();
     QString password();
@@ -123,6 +135,7 @@ class KERFUFFLE_EXPORT LoadCorruptQuery : public Query
 public:
     explicit LoadCorruptQuery(const QString& archiveFilename);
     void execute() override;
+    void cancel() override;
 
     bool responseYes();
 };
@@ -132,6 +145,7 @@ class KERFUFFLE_EXPORT ContinueExtractionQuery : public Query
 public:
     explicit ContinueExtractionQuery(const QString& error, const QString& archiveEntry);
     void execute() override;
+    void cancel() override;
 
     bool responseCancelled();
     bool dontAskAgain();
@@ -0,0 +1,234 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "tracer.h"
+#include "ark_debug.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+namespace Kerfuffle
+{
+
+namespace
+{
+
+class TraceWriter
+{
+public:
+    TraceWriter()
+    {
+        m_clock.start();
+
+        const QString fileName = QFile::decodeName(qgetenv("ARK_TRACE_FILE"));
+        if (!fileName.isEmpty()) {
+            open(fileName);
+        }
+    }
+
+    ~TraceWriter()
+    {
+        close();
+    }
+
+    void open(const QString &fileName)
+    {
+        QMutexLocker locker(&m_mutex);
+        closeLocked();
+
+        m_file.setFileName(fileName);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCWarning(ARK) << "Could not open the trace file" << fileName;
+            return;
+        }
+
+        qCDebug(ARK) << "Writing trace events to" << fileName;
+        // The JSON array format does not need the closing bracket, so the trace is usable even after a crash.
+        m_buffer = QByteArrayLiteral("[\n");
+        m_enabled.store(1);
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        closeLocked();
+    }
+
+    void write(const QByteArray &event)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_file.isOpen()) {
+            return;
+        }
+
+        m_buffer += event;
+        m_buffer += ",\n";
+        if (m_buffer.size() > 64 * 1024) {
+            m_file.write(m_buffer);
+            m_buffer.clear();
+        }
+    }
+
+    bool isEnabled() const
+    {
+        return m_enabled.load();
+    }
+
+    qint64 now() const
+    {
+        return m_clock.nsecsElapsed() / 1000;
+    }
+
+private:
+    void closeLocked()
+    {
+        m_enabled.store(0);
+        if (!m_file.isOpen()) {
+            return;
+        }
+
+        m_buffer += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(QCoreApplication::applicationPid())
+                  + ",\"args\":{\"name\":\"ark\"}}\n]\n";
+        m_file.write(m_buffer);
+        m_file.close();
+        m_buffer.clear();
+    }
+
+    QMutex m_mutex;
+    QFile m_file;
+    QByteArray m_buffer;
+    QElapsedTimer m_clock;
+    QAtomicInt m_enabled;
+};
+
+Q_GLOBAL_STATIC(TraceWriter, s_writer)
+
+QByteArray escaped(const QString &string)
+{
+    QByteArray result;
+    foreach (char c, string.toUtf8()) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<uchar>(c) < 0x20) {
+            result += "\\u00" + QByteArray::number(static_cast<uchar>(c), 16).rightJustified(2, '0');
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+QByteArray event(const char *name, const char *category, char phase, qint64 timestamp, const QString &detail)
+{
+    QByteArray result = QByteArrayLiteral("{\"name\":\"") + name
+                      + "\",\"cat\":\"" + category
+                      + "\",\"ph\":\"" + phase
+                      + "\",\"ts\":" + QByteArray::number(timestamp)
+                      + ",\"pid\":" + QByteArray::number(QCoreApplication::applicationPid())
+                      + ",\"tid\":" + QByteArray::number(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    if (!detail.isEmpty()) {
+        result += ",\"args\":{\"detail\":\"" + escaped(detail) + "\"}";
+    }
+    return result;
+}
+
+}
+
+bool Tracer::isEnabled()
+{
+    // Events might be recorded while the static objects are being destroyed.
+    return !s_writer.isDestroyed() && s_writer->isEnabled();
+}
+
+void Tracer::start(const QString &fileName)
+{
+    s_writer->open(fileName);
+}
+
+void Tracer::stop()
+{
+    s_writer->close();
+}
+
+qint64 Tracer::now()
+{
+    return s_writer.isDestroyed() ? 0 : s_writer->now();
+}
+
+void Tracer::complete(const char *name, const char *category, qint64 start, const QString &detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    const qint64 duration = now() - start;
+    s_writer->write(event(name, category, 'X', start, detail) + ",\"dur\":" + QByteArray::number(duration) + '}');
+}
+
+void Tracer::asyncBegin(const char *name, const char *category, const void *id, const QString &detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    s_writer->write(event(name, category, 'b', now(), detail) + ",\"id\":\"" + QByteArray::number(reinterpret_cast<quintptr>(id), 16) + "\"}");
+}
+
+void Tracer::asyncEnd(const char *name, const char *category, const void *id)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    s_writer->write(event(name, category, 'e', now(), QString()) + ",\"id\":\"" + QByteArray::number(reinterpret_cast<quintptr>(id), 16) + "\"}");
+}
+
+TraceScope::TraceScope(const char *name, const char *category)
+    : m_name(name)
+    , m_category(category)
+    , m_start(Tracer::isEnabled() ? Tracer::now() : -1)
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (m_start >= 0) {
+        Tracer::complete(m_name, m_category, m_start, m_detail);
+    }
+}
+
+void TraceScope::setDetail(const QString &detail)
+{
+    m_detail = detail;
+}
+
+}
@@ -0,0 +1,113 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "kerfuffle_export.h"
+
+#include <QString>
+
+namespace Kerfuffle
+{
+
+/**
+ * Records timed events in the Chrome trace event format, which can be opened
+ * in chrome://tracing or in the Perfetto UI.
+ *
+ * Tracing is disabled by default. It is enabled by setting the ARK_TRACE_FILE
+ * environment variable to the path of the trace file, or by calling start().
+ * When disabled, recording an event costs a single atomic load.
+ */
+class KERFUFFLE_EXPORT Tracer
+{
+public:
+
+    static bool isEnabled();
+
+    /**
+     * Start writing the trace events to @p fileName.
+     * The file is completed when stop() is called or when the application quits.
+     */
+    static void start(const QString &fileName);
+    static void stop();
+
+    /**
+     * @return The current time of the trace clock, in microseconds.
+     */
+    static qint64 now();
+
+    /**
+     * Record an event that started at @p start and lasted until now().
+     */
+    static void complete(const char *name, const char *category, qint64 start, const QString &detail = QString());
+
+    /**
+     * Record the begin and the end of an event which does not fit in a single scope,
+     * e.g. because it starts and ends in different slots. @p id identifies the event.
+     */
+    static void asyncBegin(const char *name, const char *category, const void *id, const QString &detail = QString());
+    static void asyncEnd(const char *name, const char *category, const void *id);
+};
+
+/**
+ * Records an event lasting as long as this object.
+ * Use the ARK_TRACE_SCOPE() macro instead of this class.
+ */
+class KERFUFFLE_EXPORT TraceScope
+{
+public:
+    TraceScope(const char *name, const char *category);
+    ~TraceScope();
+
+    /**
+     * Attach @p detail (e.g. a file name) to the event.
+     * Check Tracer::isEnabled() first if computing @p detail is not free.
+     */
+    void setDetail(const QString &detail);
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+
+    const char *m_name;
+    const char *m_category;
+    qint64 m_start;
+    QString m_detail;
+};
+
+}
+
+#define ARK_TRACE_CONCAT_IMPL(a, b) a ## b
+#define ARK_TRACE_CONCAT(a, b) ARK_TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * Record an event named @p name lasting until the end of the current scope.
+ */
+#define ARK_TRACE_SCOPE(name, category) Kerfuffle::TraceScope ARK_TRACE_CONCAT(arkTraceScope, __LINE__)(name, category)
+
+#endif // TRACER_H
@@ -0,0 +1,317 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "zipextractionplanner.h"
+#include "ark_debug.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
+namespace Kerfuffle
+{
+
+namespace
+{
+
+// Members closer than this are read through rather than seeked over.
+const qint64 s_maximumGap = 64 * 1024;
+// Ranges are read ahead one at a time, so they are kept small enough for the page cache.
+const qint64 s_maximumRangeSize = 16 * 1024 * 1024;
+// Larger central directories are not worth reading only to plan the extraction.
+const qint64 s_maximumDirectorySize = 256 * 1024 * 1024;
+
+const quint32 s_directoryHeaderSignature = 0x02014b50;
+const quint32 s_endRecordSignature = 0x06054b50;
+const quint32 s_zip64EndRecordSignature = 0x06064b50;
+const quint32 s_zip64LocatorSignature = 0x07064b50;
+
+const int s_directoryHeaderSize = 46;
+const int s_endRecordSize = 22;
+const int s_zip64EndRecordSize = 56;
+const int s_zip64LocatorSize = 20;
+
+quint16 read16(const char *data)
+{
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data));
+}
+
+quint32 read32(const char *data)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data));
+}
+
+quint64 read64(const char *data)
+{
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(data));
+}
+
+/**
+ * @return The offset stored in the zip64 extra field of the central directory @p header, or -1.
+ */
+qint64 zip64Offset(const char *header, const char *extra, int extraLength)
+{
+    int field = 0;
+    while (field + 4 <= extraLength) {
+        const int id = read16(extra + field);
+        const int size = read16(extra + field + 2);
+        if (field + 4 + size > extraLength) {
+            break;
+        }
+
+        if (id == 0x0001) {
+            // Only the values which overflowed their field are stored, in this order.
+            int position = 0;
+            if (read32(header + 24) == 0xFFFFFFFF) {
+                position += 8;
+            }
+            if (read32(header + 20) == 0xFFFFFFFF) {
+                position += 8;
+            }
+            return (position + 8 <= size) ? static_cast<qint64>(read64(extra + field + 4 + position)) : -1;
+        }
+
+        field += 4 + size;
+    }
+
+    return -1;
+}
+
+}
+
+ZipExtractionPlanner::ZipExtractionPlanner(const QString &fileName)
+    : m_file(fileName)
+    , m_isValid(false)
+{
+    m_isValid = readCentralDirectory();
+    if (!m_isValid) {
+        qCDebug(ARK) << "Could not read the central directory of" << fileName;
+        m_names.clear();
+        m_offsets.clear();
+        m_ends.clear();
+    }
+}
+
+bool ZipExtractionPlanner::isValid() const
+{
+    return m_isValid;
+}
+
+int ZipExtractionPlanner::memberCount() const
+{
+    return m_offsets.size();
+}
+
+int ZipExtractionPlanner::indexOf(const QString &name) const
+{
+    if (m_indexes.isEmpty()) {
+        m_indexes.reserve(m_names.size());
+        // The first member wins if a name is duplicated.
+        for (int i = m_names.size() - 1; i >= 0; --i) {
+            m_indexes.insert(m_names.at(i), i);
+        }
+    }
+
+    return m_indexes.value(name, -1);
+}
+
+qint64 ZipExtractionPlanner::offset(int index) const
+{
+    return m_offsets.at(index);
+}
+
+QVector<int> ZipExtractionPlanner::sortedByOffset(const QVector<int> &indexes) const
+{
+    QVector<int> sorted = indexes;
+    std::stable_sort(sorted.begin(), sorted.end(), [this](int a, int b) {
+        return m_offsets.at(a) < m_offsets.at(b);
+    });
+
+    return sorted;
+}
+
+QVector<ZipExtractionPlanner::Range> ZipExtractionPlanner::ranges(const QVector<int> &indexes) const
+{
+    QVector<Range> ranges;
+    foreach (int index, sortedByOffset(indexes)) {
+        const qint64 begin = m_offsets.at(index);
+        const qint64 end = m_ends.at(index);
+
+        if (!ranges.isEmpty()) {
+            Range &last = ranges.last();
+            if (begin - last.end <= s_maximumGap && end - last.begin <= s_maximumRangeSize) {
+                last.end = qMax(last.end, end);
+                last.members << index;
+                continue;
+            }
+        }
+
+        Range range;
+        range.begin = begin;
+        range.end = end;
+        range.members << index;
+        ranges << range;
+    }
+
+    return ranges;
+}
+
+void ZipExtractionPlanner::readAhead(const Range &range)
+{
+#if defined(Q_OS_UNIX) && defined(POSIX_FADV_WILLNEED)
+    // A null length would mean up to the end of the file.
+    if (m_isValid && range.end > range.begin) {
+        posix_fadvise(m_file.handle(), range.begin, range.end - range.begin, POSIX_FADV_WILLNEED);
+    }
+#else
+    Q_UNUSED(range)
+#endif
+}
+
+bool ZipExtractionPlanner::readCentralDirectory()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < s_endRecordSize) {
+        return false;
+    }
+
+    // The end of central directory record is followed by a comment of up to 64 KiB.
+    const qint64 tailSize = qMin<qint64>(fileSize, s_zip64LocatorSize + s_endRecordSize + 0xFFFF);
+    if (!m_file.seek(fileSize - tailSize)) {
+        return false;
+    }
+    const QByteArray tail = m_file.read(tailSize);
+    if (tail.size() != tailSize) {
+        return false;
+    }
+
+    int endRecord = tail.size() - s_endRecordSize;
+    while (endRecord >= 0 && read32(tail.constData() + endRecord) != s_endRecordSignature) {
+        --endRecord;
+    }
+    if (endRecord < 0) {
+        return false;
+    }
+
+    const char *end = tail.constData() + endRecord;
+    quint64 memberCount = read16(end + 10);
+    quint64 directorySize = read32(end + 12);
+    quint64 directoryOffset = read32(end + 16);
+
+    if (memberCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        // Zip64 archives store the actual values in another record, pointed to by a locator.
+        if (endRecord < s_zip64LocatorSize || read32(end - s_zip64LocatorSize) != s_zip64LocatorSignature) {
+            return false;
+        }
+
+        const quint64 zip64EndRecordOffset = read64(end - s_zip64LocatorSize + 8);
+        if (zip64EndRecordOffset > static_cast<quint64>(fileSize - s_zip64EndRecordSize) || !m_file.seek(zip64EndRecordOffset)) {
+            return false;
+        }
+
+        const QByteArray zip64EndRecord = m_file.read(s_zip64EndRecordSize);
+        if (zip64EndRecord.size() != s_zip64EndRecordSize || read32(zip64EndRecord.constData()) != s_zip64EndRecordSignature) {
+            return false;
+        }
+
+        memberCount = read64(zip64EndRecord.constData() + 32);
+        directorySize = read64(zip64EndRecord.constData() + 40);
+        directoryOffset = read64(zip64EndRecord.constData() + 48);
+    }
+
+    // Data prepended to the archive, e.g. by self-extracting stubs, would shift all the offsets.
+    if (directorySize > static_cast<quint64>(s_maximumDirectorySize) ||
+        directoryOffset + directorySize > static_cast<quint64>(fileSize) ||
+        memberCount > directorySize / s_directoryHeaderSize ||
+        !m_file.seek(directoryOffset)) {
+        return false;
+    }
+
+    const QByteArray directory = m_file.read(directorySize);
+    if (directory.size() != static_cast<int>(directorySize)) {
+        return false;
+    }
+
+    m_names.reserve(static_cast<int>(memberCount));
+    m_offsets.reserve(static_cast<int>(memberCount));
+
+    int position = 0;
+    for (quint64 i = 0; i < memberCount; ++i) {
+        if (position + s_directoryHeaderSize > directory.size()) {
+            return false;
+        }
+
+        const char *header = directory.constData() + position;
+        if (read32(header) != s_directoryHeaderSignature) {
+            return false;
+        }
+
+        const int nameLength = read16(header + 28);
+        const int extraLength = read16(header + 30);
+        const int commentLength = read16(header + 32);
+        if (position + s_directoryHeaderSize + nameLength + extraLength + commentLength > directory.size()) {
+            return false;
+        }
+
+        qint64 offset = read32(header + 42);
+        if (offset == 0xFFFFFFFF) {
+            offset = zip64Offset(header, header + s_directoryHeaderSize + nameLength, extraLength);
+        }
+        if (offset < 0 || static_cast<quint64>(offset) >= directoryOffset) {
+            return false;
+        }
+
+        m_names << QString::fromUtf8(header + s_directoryHeaderSize, nameLength);
+        m_offsets << offset;
+
+        position += s_directoryHeaderSize + nameLength + extraLength + commentLength;
+    }
+
+    // Each member runs until the next one, or until the central directory.
+    QVector<int> order(m_offsets.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    order = sortedByOffset(order);
+
+    m_ends.resize(m_offsets.size());
+    for (int i = 0; i < order.size(); ++i) {
+        m_ends[order.at(i)] = (i + 1 < order.size()) ? m_offsets.at(order.at(i + 1)) : static_cast<qint64>(directoryOffset);
+    }
+
+    return true;
+}
+
+}
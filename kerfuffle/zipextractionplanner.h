@@ -0,0 +1,115 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ZIPEXTRACTIONPLANNER_H
+#define ZIPEXTRACTIONPLANNER_H
+
+#include "kerfuffle_export.h"
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace Kerfuffle
+{
+
+/**
+ * Plans the extraction of members of a zip archive in the order they are stored in the file.
+ *
+ * The offsets of the local headers are read from the central directory, so that the members
+ * can be extracted with forward reads only. Members stored close to each other are grouped
+ * into ranges, which can be read ahead while the previous range is being extracted.
+ */
+class KERFUFFLE_EXPORT ZipExtractionPlanner
+{
+public:
+
+    /**
+     * Contiguous bytes of the archive holding some members.
+     */
+    struct Range
+    {
+        qint64 begin;
+        qint64 end;
+        QVector<int> members;   // Central directory indexes, in physical order.
+    };
+
+    explicit ZipExtractionPlanner(const QString &fileName);
+
+    /**
+     * @return Whether the central directory could be read.
+     */
+    bool isValid() const;
+
+    /**
+     * @return The number of members, which are indexed in central directory order like libzip does.
+     */
+    int memberCount() const;
+
+    /**
+     * @return The index of the member named @p name, or -1 if there is none.
+     * Names not flagged as UTF-8 are decoded as UTF-8 anyway.
+     */
+    int indexOf(const QString &name) const;
+
+    /**
+     * @return The offset of the local header of the member at @p index.
+     */
+    qint64 offset(int index) const;
+
+    /**
+     * @return The members at @p indexes, sorted by the offset of their local header.
+     */
+    QVector<int> sortedByOffset(const QVector<int> &indexes) const;
+
+    /**
+     * @return The ranges holding the members at @p indexes, in physical order.
+     * Members separated by small gaps share a range, up to a bounded range size.
+     */
+    QVector<Range> ranges(const QVector<int> &indexes) const;
+
+    /**
+     * Asks the system to read @p range into the page cache in the background.
+     * This does nothing where such hints are not supported.
+     */
+    void readAhead(const Range &range);
+
+private:
+    bool readCentralDirectory();
+
+    QFile m_file;
+    bool m_isValid;
+    QVector<QString> m_names;
+    QVector<qint64> m_offsets;
+    QVector<qint64> m_ends;     // Where the next member or the central directory begins.
+    mutable QHash<QString, int> m_indexes;
+};
+
+}
+
+#endif // ZIPEXTRACTIONPLANNER_H
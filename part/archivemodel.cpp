@@ -24,7 +24,9 @@
 
 #include "archivemodel.h"
 #include "ark_debug.h"
+#include "entrypath.h"
 #include "jobs.h"
+#include "tracer.h"
 
 #include <KIO/Global>
 #include <KLocalizedString>
@@ -32,20 +34,17 @@
 #include <QDBusConnection>
 #include <QMimeData>
 #include <QMimeDatabase>
-#include <QRegularExpression>
 #include <QUrl>
 
-using namespace Kerfuffle;
+#include <algorithm>
 
-// Used to speed up the loading of large archives.
-static Archive::Entry *s_previousMatch = nullptr;
-Q_GLOBAL_STATIC(QStringList, s_previousPieces)
+using namespace Kerfuffle;
 
 ArchiveModel::ArchiveModel(const QString &dbusPathName, QObject *parent)
     : QAbstractItemModel(parent)
     , m_dbusPathName(dbusPathName)
-    , m_numberOfFiles(0)
-    , m_numberOfFolders(0)
+    , m_previousMatch(nullptr)
+    , m_fetching(false)
 {
     initRootEntry();
 
@@ -82,10 +81,8 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                 return entry->name();
             case Size:
                 if (entry->isDir()) {
-                    uint dirs;
-                    uint files;
-                    entry->countChildren(dirs, files);
-                    return KIO::itemsSummaryString(dirs + files, files, dirs, 0, false);
+                    const DirectoryAggregate aggregate = m_aggregates.value(entry);
+                    return KIO::itemsSummaryString(aggregate.childDirs + aggregate.childFiles, aggregate.childFiles, aggregate.childDirs, 0, false);
                 } else if (!entry->property("link").toString().isEmpty()) {
                     return QVariant();
                 } else {
@@ -251,6 +248,35 @@ int ArchiveModel::rowCount(const QModelIndex &parent) const
     return 0;
 }
 
+bool ArchiveModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return false;
+    }
+
+    // Folders which were not fetched yet have children too.
+    const Archive::Entry *parentEntry = parent.isValid()
+                                        ? static_cast<Archive::Entry*>(parent.internalPointer())
+                                        : m_rootEntry.data();
+    return m_unfetchedDirs.contains(parentEntry) || rowCount(parent) > 0;
+}
+
+bool ArchiveModel::canFetchMore(const QModelIndex &parent) const
+{
+    const Archive::Entry *parentEntry = parent.isValid()
+                                        ? static_cast<Archive::Entry*>(parent.internalPointer())
+                                        : m_rootEntry.data();
+    return parent.column() <= 0 && m_unfetchedDirs.contains(parentEntry);
+}
+
+void ArchiveModel::fetchMore(const QModelIndex &parent)
+{
+    Archive::Entry *parentEntry = parent.isValid()
+                                  ? static_cast<Archive::Entry*>(parent.internalPointer())
+                                  : m_rootEntry.data();
+    fetchDirectory(parentEntry, NotifyViews);
+}
+
 int ArchiveModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
@@ -326,46 +352,36 @@ bool ArchiveModel::dropMimeData(const QMimeData *data, Qt::DropAction action, in
 }
 
 // For a rationale, see bugs #194241, #241967 and #355839
-QString ArchiveModel::cleanFileName(const QString& fileName)
-{
-    // Skip entries with filename "/" or "//" or "."
-    // "." is present in ISO files.
-    QRegularExpression pattern(QStringLiteral("/+|\\."));
-    QRegularExpressionMatch match;
-    if (fileName.contains(pattern, &match) && match.captured() == fileName) {
-        qCDebug(ARK) << "Skipping entry with filename" << fileName;
-        return QString();
-    } else if (fileName.startsWith(QLatin1String("./"))) {
-        return fileName.mid(2);
-    }
-
-    return fileName;
-}
-
 void ArchiveModel::initRootEntry()
 {
+    m_entryTable.clear();
+    m_unfetchedDirs.clear();
+    m_aggregates.clear();
+    m_touchedDirs.clear();
+    m_implicitDirs.clear();
+    m_previousMatch = nullptr;
+    m_previousPieces.clear();
     m_rootEntry.reset(new Archive::Entry());
     m_rootEntry->setProperty("isDirectory", true);
 }
 
-Archive::Entry *ArchiveModel::parentFor(const Archive::Entry *entry, InsertBehaviour behaviour)
+Archive::Entry *ArchiveModel::parentFor(const EntryPath &path, InsertBehaviour behaviour)
 {
-    QStringList pieces = entry->fullPath().split(QLatin1Char('/'), QString::SkipEmptyParts);
-    if (pieces.isEmpty()) {
+    if (path.count() == 0) {
         return nullptr;
     }
-    pieces.removeLast();
+    const int piecesCount = path.count() - 1;
 
     // Used to speed up loading of large archives.
-    if (s_previousMatch) {
+    if (m_previousMatch) {
         // The number of path elements must be the same for the shortcut
         // to work.
-        if (s_previousPieces->count() == pieces.count()) {
+        if (m_previousPieces.count() == piecesCount) {
             bool equal = true;
 
             // Check if all pieces match.
-            for (int i = 0; i < s_previousPieces->count(); ++i) {
-                if (s_previousPieces->at(i) != pieces.at(i)) {
+            for (int i = 0; i < piecesCount; ++i) {
+                if (m_previousPieces.at(i) != path.at(i)) {
                     equal = false;
                     break;
                 }
@@ -373,14 +389,18 @@ Archive::Entry *ArchiveModel::parentFor(const Archive::Entry *entry, InsertBehav
 
             // If match return it.
             if (equal) {
-                return s_previousMatch;
+                return m_previousMatch;
             }
         }
     }
 
     Archive::Entry *parent = m_rootEntry.data();
+    QStringList pieces;
+    pieces.reserve(piecesCount);
 
-    foreach(const QString &piece, pieces) {
+    for (int i = 0; i < piecesCount; ++i) {
+        const QString piece = path.at(i).toString();
+        pieces << piece;
         Archive::Entry *entry = parent->find(piece);
         if (!entry) {
             // Directory entry will be traversed later (that happens for some archive formats, 7z for instance).
@@ -392,6 +412,7 @@ Archive::Entry *ArchiveModel::parentFor(const Archive::Entry *entry, InsertBehav
                                            ? piece + QLatin1Char('/')
                                            : parent->fullPath(WithTrailingSlash) + piece + QLatin1Char('/'));
             entry->setProperty("isDirectory", true);
+            m_implicitDirs.insert(entry);
             insertEntry(entry, behaviour);
         }
         if (!entry->isDir()) {
@@ -404,12 +425,27 @@ Archive::Entry *ArchiveModel::parentFor(const Archive::Entry *entry, InsertBehav
         parent = entry;
     }
 
-    s_previousMatch = parent;
-    *s_previousPieces = pieces;
+    m_previousMatch = parent;
+    m_previousPieces = pieces;
 
     return parent;
 }
 
+Archive::Entry *ArchiveModel::findEntry(const EntryPath &path) const
+{
+    Archive::Entry *entry = m_rootEntry.data();
+    for (int i = 0; i < path.count(); ++i) {
+        if (!entry->isDir()) {
+            return nullptr;
+        }
+        entry = entry->find(path.at(i));
+        if (!entry) {
+            return nullptr;
+        }
+    }
+    return (entry == m_rootEntry.data()) ? nullptr : entry;
+}
+
 QModelIndex ArchiveModel::indexForEntry(Archive::Entry *entry)
 {
     Q_ASSERT(entry);
@@ -423,12 +459,13 @@ QModelIndex ArchiveModel::indexForEntry(Archive::Entry *entry)
 
 void ArchiveModel::slotEntryRemoved(const QString & path)
 {
-    const QString entryFileName(cleanFileName(path));
-    if (entryFileName.isEmpty()) {
+    const EntryPath entryPath(path);
+    if (entryPath.isSkipped()) {
         return;
     }
 
-    Archive::Entry *entry = m_rootEntry->findByPath(entryFileName.split(QLatin1Char('/'), QString::SkipEmptyParts));
+    fetchPath(entryPath);
+    Archive::Entry *entry = findEntry(entryPath);
     if (entry) {
         Archive::Entry *parent = entry->getParent();
         QModelIndex index = indexForEntry(entry);
@@ -436,7 +473,10 @@ void ArchiveModel::slotEntryRemoved(const QString & path)
 
         beginRemoveRows(indexForEntry(parent), entry->row(), entry->row());
         m_entryIcons.remove(parent->entries().at(entry->row())->fullPath(NoTrailingSlash));
+        removeFromAggregates(entry);
         parent->removeEntryAt(entry->row());
+        forgetSubtree(entry);
+        m_touchedDirs.insert(parent);
         endRemoveRows();
     }
 }
@@ -453,14 +493,29 @@ void ArchiveModel::slotNewEntry(Archive::Entry *entry)
 
 void ArchiveModel::slotListEntry(Archive::Entry *entry)
 {
-    newEntry(entry, DoNotNotifyViews);
+    ARK_TRACE_SCOPE("model-list", "model");
+
+    // The path is only split here, the pieces are shared by all the steps below.
+    const EntryPath path(entry->fullPath());
+    if (!prepareEntry(entry, path, DoNotNotifyViews)) {
+        return;
+    }
+
+    // The tree is built once listing is complete, see buildEntryTable().
+    TableEntry tableEntry;
+    tableEntry.path = path.normalizedPath();
+    if (entry->isDir() && !path.hasTrailingSlash()) {
+        tableEntry.path += QLatin1Char('/');
+    }
+    tableEntry.entry = entry;
+    m_entryTable << tableEntry;
 }
 
-void ArchiveModel::newEntry(Archive::Entry *receivedEntry, InsertBehaviour behaviour)
+bool ArchiveModel::prepareEntry(Archive::Entry *receivedEntry, const EntryPath &path, InsertBehaviour behaviour)
 {
     if (receivedEntry->fullPath().isEmpty()) {
         qCDebug(ARK) << "Weird, received empty entry (no filename) - skipping";
-        return;
+        return false;
     }
 
     //if there are no addidional columns registered, then have a look at the
@@ -495,59 +550,322 @@ void ArchiveModel::newEntry(Archive::Entry *receivedEntry, InsertBehaviour behav
     // #194241: Filenames such as "./file" should be displayed as "file"
     // #241967: Entries called "/" should be ignored
     // #355839: Entries called "//" should be ignored
-    QString entryFileName = cleanFileName(receivedEntry->fullPath());
-    if (entryFileName.isEmpty()) { // The entry contains only "." or "./"
-        return;
+    if (path.isSkipped()) {
+        qCDebug(ARK) << "Skipping entry with filename" << receivedEntry->fullPath();
+        return false;
+    }
+    if (path.hasDotSlashPrefix()) {
+        receivedEntry->setFullPath(path.cleanPath());
     }
-    receivedEntry->setProperty("fullPath", entryFileName);
 
     // For some archive formats (e.g. AppImage and RPM) paths of folders do not
     // contain a trailing slash, so we append it.
-    if (receivedEntry->property("isDirectory").toBool() &&
-        !receivedEntry->property("fullPath").toString().endsWith(QLatin1Char('/'))) {
-        receivedEntry->setProperty("fullPath", receivedEntry->property("fullPath").toString() + QLatin1Char('/'));
-        qCDebug(ARK) << "Trailing slash appended to entry:" << receivedEntry->property("fullPath");
+    if (receivedEntry->isDir() && !path.hasTrailingSlash()) {
+        receivedEntry->setFullPath(path.cleanPath() + QLatin1Char('/'));
+        qCDebug(ARK) << "Trailing slash appended to entry:" << receivedEntry->fullPath();
+    } else if (path.hasTrailingSlash()) {
+        receivedEntry->setIsDirectory(true);
+    }
+
+    return true;
+}
+
+void ArchiveModel::newEntry(Archive::Entry *receivedEntry, InsertBehaviour behaviour)
+{
+    ARK_TRACE_SCOPE("model-insert", "model");
+
+    const EntryPath path(receivedEntry->fullPath());
+    if (!prepareEntry(receivedEntry, path, behaviour)) {
+        return;
     }
+    const QString entryFileName = receivedEntry->fullPath();
+
+    // The folders of the new entry might not have been fetched yet.
+    fetchPath(path);
 
-    // Skip already created entries.
-    Archive::Entry *existing = m_rootEntry->findByPath(entryFileName.split(QLatin1Char('/')));
+    // Skip already created entries. Folders and paths with empty pieces are never skipped.
+    Archive::Entry *existing = (!receivedEntry->isDir() && path.isNormalized()) ? findEntry(path) : nullptr;
     if (existing) {
         existing->setProperty("fullPath", entryFileName);
         // Multi-volume files are repeated at least in RAR archives.
         // In that case, we need to sum the compressed size for each volume
         qulonglong currentCompressedSize = existing->property("compressedSize").toULongLong();
+        removeFromAggregates(existing);
         existing->setProperty("compressedSize", currentCompressedSize + receivedEntry->property("compressedSize").toULongLong());
+        addToAggregates(existing);
+        if (behaviour == NotifyViews) {
+            emitEntryChanged(existing);
+        }
         return;
     }
 
     // Find parent entry, creating missing directory Archive::Entry's in the process.
-    Archive::Entry *parent = parentFor(receivedEntry, behaviour);
+    Archive::Entry *parent = parentFor(path, behaviour);
 
     // Create an Archive::Entry.
-    const QStringList path = entryFileName.split(QLatin1Char('/'), QString::SkipEmptyParts);
-    Archive::Entry *entry = parent->find(path.last());
+    Archive::Entry *entry = parent->find(path.name());
     if (entry) {
+        removeFromAggregates(entry);
         entry->copyMetaData(receivedEntry);
         entry->setProperty("fullPath", entryFileName);
+        addToAggregates(entry);
+        m_implicitDirs.remove(entry);
+        if (behaviour == NotifyViews) {
+            emitEntryChanged(entry);
+        }
     } else {
         receivedEntry->setParent(parent);
         insertEntry(receivedEntry, behaviour);
     }
 }
 
+void ArchiveModel::emitEntryChanged(Archive::Entry *entry)
+{
+    const QModelIndex index = indexForEntry(entry);
+    emit dataChanged(index, index.sibling(index.row(), qMax(columnCount() - 1, 0)));
+}
+
 void ArchiveModel::slotLoadingFinished(KJob *job)
 {
     if (!job->error()) {
 
         m_archive.reset(qobject_cast<LoadJob*>(job)->archive());
 
+        ARK_TRACE_SCOPE("model-reset", "model");
+        buildEntryTable();
         beginResetModel();
         endResetModel();
+    } else {
+        m_entryTable.clear();
     }
 
     emit loadingFinished(job);
 }
 
+void ArchiveModel::buildEntryTable()
+{
+    std::stable_sort(m_entryTable.begin(), m_entryTable.end(), [](const TableEntry &left, const TableEntry &right) {
+        return left.path < right.path;
+    });
+
+    // Merge the entries listed more than once.
+    int count = 0;
+    for (int i = 0; i < m_entryTable.size(); ++i) {
+        const TableEntry tableEntry = m_entryTable.at(i);
+        if (count == 0 || m_entryTable.at(count - 1).path != tableEntry.path) {
+            m_entryTable[count++] = tableEntry;
+            continue;
+        }
+
+        Archive::Entry *existing = m_entryTable.at(count - 1).entry;
+        if (existing->isDir()) {
+            existing->copyMetaData(tableEntry.entry);
+        } else {
+            // Multi-volume files are repeated at least in RAR archives.
+            // In that case, we need to sum the compressed size for each volume
+            const qulonglong currentCompressedSize = existing->property("compressedSize").toULongLong();
+            existing->setProperty("compressedSize", currentCompressedSize + tableEntry.entry->property("compressedSize").toULongLong());
+        }
+    }
+    m_entryTable.resize(count);
+
+    // Link the entries to their parent folders, creating the folders which were not listed.
+    // Parents are sorted before their children, so the current ancestors are kept in a stack.
+    QVector<TableEntry> ancestors;
+    TableEntry root;
+    root.entry = m_rootEntry.data();
+    ancestors << root;
+
+    QVector<TableEntry> createdDirs;
+    for (int i = 0; i < m_entryTable.size(); ++i) {
+        const TableEntry &tableEntry = m_entryTable.at(i);
+        const QString parentPath = tableEntry.path.left(tableEntry.path.lastIndexOf(QLatin1Char('/'), -2) + 1);
+
+        while (!parentPath.startsWith(ancestors.last().path)) {
+            ancestors.removeLast();
+        }
+        while (ancestors.last().path.size() < parentPath.size()) {
+            TableEntry dir;
+            dir.path = parentPath.left(parentPath.indexOf(QLatin1Char('/'), ancestors.last().path.size()) + 1);
+            dir.entry = new Archive::Entry(ancestors.last().entry);
+            dir.entry->setProperty("fullPath", dir.path);
+            dir.entry->setProperty("isDirectory", true);
+            m_implicitDirs.insert(dir.entry);
+            createdDirs << dir;
+            ancestors << dir;
+        }
+
+        tableEntry.entry->setParent(ancestors.last().entry);
+        if (tableEntry.entry->isDir()) {
+            ancestors << tableEntry;
+        }
+    }
+
+    // The created folders are already sorted.
+    const int listedCount = m_entryTable.size();
+    m_entryTable << createdDirs;
+    std::inplace_merge(m_entryTable.begin(), m_entryTable.begin() + listedCount, m_entryTable.end(),
+                       [](const TableEntry &left, const TableEntry &right) {
+        return left.path < right.path;
+    });
+
+    // Compute the totals of all folders: each entry is counted in its parent first, then the
+    // folders are added to their own parents, children before parents.
+    for (int i = 0; i < m_entryTable.size(); ++i) {
+        const Archive::Entry *entry = m_entryTable.at(i).entry;
+        DirectoryAggregate &parentAggregate = m_aggregates[entry->getParent()];
+        if (entry->isDir()) {
+            parentAggregate.childDirs++;
+        } else {
+            parentAggregate.childFiles++;
+            parentAggregate.add(contributionOf(entry));
+        }
+    }
+    for (int i = m_entryTable.size() - 1; i >= 0; --i) {
+        const Archive::Entry *entry = m_entryTable.at(i).entry;
+        if (entry->isDir()) {
+            const DirectoryAggregate contribution = contributionOf(entry);
+            m_aggregates[entry->getParent()].add(contribution);
+        }
+    }
+
+    // Only the top-level entries are inserted in the tree, the folders are fetched on demand.
+    for (int i = 0; i < m_entryTable.size(); ++i) {
+        const Archive::Entry *entry = m_entryTable.at(i).entry;
+        const DirectoryAggregate aggregate = m_aggregates.value(entry);
+        if (entry->isDir() && aggregate.childDirs + aggregate.childFiles > 0) {
+            m_unfetchedDirs.insert(entry, i);
+        }
+    }
+    m_unfetchedDirs.insert(m_rootEntry.data(), -1);
+    fetchDirectory(m_rootEntry.data(), DoNotNotifyViews);
+
+    qCDebug(ARK) << "Listed" << m_entryTable.size() << "entries," << m_unfetchedDirs.size() << "folders to be fetched on demand";
+}
+
+int ArchiveModel::subtreeEnd(int position) const
+{
+    if (position < 0) {
+        return m_entryTable.size();
+    }
+
+    const QString &prefix = m_entryTable.at(position).path;
+    const auto end = std::partition_point(m_entryTable.constBegin() + position + 1, m_entryTable.constEnd(),
+                                          [&prefix](const TableEntry &tableEntry) {
+        return tableEntry.path.startsWith(prefix);
+    });
+    return end - m_entryTable.constBegin();
+}
+
+void ArchiveModel::fetchDirectory(Archive::Entry *dir, InsertBehaviour behaviour)
+{
+    const auto unfetched = m_unfetchedDirs.find(dir);
+    if (unfetched == m_unfetchedDirs.end()) {
+        return;
+    }
+    const int position = unfetched.value();
+    m_unfetchedDirs.erase(unfetched);
+
+    ARK_TRACE_SCOPE("model-fetch", "model");
+
+    // The direct children are the first entry of the table range of the folder,
+    // and the entries following the subtree of each child.
+    QVector<Archive::Entry*> children;
+    const int end = subtreeEnd(position);
+    for (int i = position + 1; i < end;) {
+        Archive::Entry *child = m_entryTable.at(i).entry;
+        Q_ASSERT(child->getParent() == dir);
+        children << child;
+        i = child->isDir() ? subtreeEnd(i) : i + 1;
+    }
+
+    if (children.isEmpty()) {
+        return;
+    }
+
+    const int first = dir->entries().count();
+    if (behaviour == NotifyViews) {
+        beginInsertRows(indexForEntry(dir), first, first + children.size() - 1);
+    }
+    QMimeDatabase db;
+    foreach (Archive::Entry *child, children) {
+        dir->appendEntry(child);
+        cacheIcon(child, db);
+    }
+    if (behaviour == NotifyViews) {
+        m_fetching = true;
+        endInsertRows();
+        m_fetching = false;
+    }
+}
+
+void ArchiveModel::fetchEntry(const Archive::Entry *entry)
+{
+    // A folder can only be fetched once its own parent has been.
+    QVector<Archive::Entry*> unfetchedParents;
+    for (Archive::Entry *parent = entry->getParent(); parent && m_unfetchedDirs.contains(parent); parent = parent->getParent()) {
+        unfetchedParents << parent;
+    }
+    for (int i = unfetchedParents.size() - 1; i >= 0; --i) {
+        fetchDirectory(unfetchedParents.at(i), NotifyViews);
+    }
+}
+
+bool ArchiveModel::isFetching() const
+{
+    return m_fetching;
+}
+
+void ArchiveModel::fetchPath(const EntryPath &path)
+{
+    const QString key = path.normalizedPath();
+
+    // Fetch the deepest folder containing the path which was not fetched yet.
+    int slash = key.lastIndexOf(QLatin1Char('/'), key.endsWith(QLatin1Char('/')) ? -2 : -1);
+    for (; slash > 0; slash = key.lastIndexOf(QLatin1Char('/'), slash - 1)) {
+        TableEntry dir;
+        dir.path = key.left(slash + 1);
+        const auto found = std::lower_bound(m_entryTable.constBegin(), m_entryTable.constEnd(), dir,
+                                            [](const TableEntry &left, const TableEntry &right) {
+            return left.path < right.path;
+        });
+        // Removed and empty folders are not in m_unfetchedDirs, so their parents are looked up instead.
+        if (found != m_entryTable.constEnd() && found->path == dir.path && m_unfetchedDirs.contains(found->entry)) {
+            fetchEntry(found->entry);
+            fetchDirectory(found->entry, NotifyViews);
+            return;
+        }
+    }
+}
+
+QVector<const Archive::Entry*> ArchiveModel::allEntries() const
+{
+    QVector<const Archive::Entry*> entries;
+    entries.reserve(m_entryTable.size());
+    collectEntries(m_rootEntry.data(), entries);
+    return entries;
+}
+
+void ArchiveModel::collectEntries(const Archive::Entry *dir, QVector<const Archive::Entry*> &entries) const
+{
+    const auto unfetched = m_unfetchedDirs.constFind(dir);
+    if (unfetched != m_unfetchedDirs.constEnd()) {
+        // The whole subtree is still only in the entry table.
+        const int end = subtreeEnd(unfetched.value());
+        for (int i = unfetched.value() + 1; i < end; ++i) {
+            entries << m_entryTable.at(i).entry;
+        }
+        return;
+    }
+
+    foreach (const Archive::Entry *entry, dir->entries()) {
+        entries << entry;
+        if (entry->isDir()) {
+            collectEntries(entry, entries);
+        }
+    }
+}
+
 void ArchiveModel::insertEntry(Archive::Entry *entry, InsertBehaviour behaviour)
 {
     Q_ASSERT(entry);
@@ -557,12 +875,18 @@ void ArchiveModel::insertEntry(Archive::Entry *entry, InsertBehaviour behaviour)
         beginInsertRows(indexForEntry(parent), parent->entries().count(), parent->entries().count());
     }
     parent->appendEntry(entry);
+    addToAggregates(entry);
     if (behaviour == NotifyViews) {
         endInsertRows();
     }
 
     // Save an icon for each newly added entry.
     QMimeDatabase db;
+    cacheIcon(entry, db);
+}
+
+void ArchiveModel::cacheIcon(const Archive::Entry *entry, const QMimeDatabase &db)
+{
     QIcon icon;
     entry->isDir()
     ? icon = QIcon::fromTheme(db.mimeTypeForName(QStringLiteral("inode/directory")).iconName()).pixmap(IconSize(KIconLoader::Small),
@@ -579,14 +903,13 @@ Kerfuffle::Archive* ArchiveModel::archive() const
 
 void ArchiveModel::reset()
 {
+    // The listed entries are released along with the archive, so the views must let go of them first.
+    beginResetModel();
     m_archive.reset(nullptr);
-    s_previousMatch = nullptr;
-    s_previousPieces->clear();
     initRootEntry();
 
     // TODO: make sure if it's ok to not have calls to beginRemoveColumns here
     m_showColumns.clear();
-    beginResetModel();
     endResetModel();
 }
 
@@ -597,10 +920,14 @@ void ArchiveModel::createEmptyArchive(const QString &path, const QString &mimeTy
 }
 
 KJob *ArchiveModel::loadArchive(const QString &path, const QString &mimeType, QObject *parent)
+{
+    return loadArchive(Archive::load(path, mimeType, parent));
+}
+
+KJob *ArchiveModel::loadArchive(LoadJob *loadJob)
 {
     reset();
 
-    auto loadJob = Archive::load(path, mimeType, parent);
     connect(loadJob, &KJob::result, this, &ArchiveModel::slotLoadingFinished);
     connect(loadJob, &Job::newEntry, this, &ArchiveModel::slotListEntry);
     connect(loadJob, &Job::userQuery, this, &ArchiveModel::slotUserQuery);
@@ -724,12 +1051,14 @@ void ArchiveModel::encryptArchive(const QString &password, bool encryptHeader)
     m_archive->encrypt(password, encryptHeader);
 }
 
-bool ArchiveModel::conflictingEntries(QList<const Archive::Entry*> &conflictingEntries, const QStringList &entries, bool allowMerging) const
+bool ArchiveModel::conflictingEntries(QList<const Archive::Entry*> &conflictingEntries, const QStringList &entries, bool allowMerging)
 {
     bool error = false;
 
+    fetchPath(EntryPath(entries.first()));
+
     // We can't accept destination as an argument, because it can be a new entry path for renaming.
-    const Archive::Entry *destination;
+    Archive::Entry *destination;
     {
         QStringList destinationParts = entries.first().split(QLatin1Char('/'), QString::SkipEmptyParts);
         destinationParts.removeLast();
@@ -739,7 +1068,7 @@ bool ArchiveModel::conflictingEntries(QList<const Archive::Entry*> &conflictingE
             destination = m_rootEntry.data();
         }
     }
-    const Archive::Entry *lastDirEntry = destination;
+    Archive::Entry *lastDirEntry = destination;
     QString skippedDirPath;
 
     foreach (const QString &entry, entries) {
@@ -754,7 +1083,8 @@ bool ArchiveModel::conflictingEntries(QList<const Archive::Entry*> &conflictingE
         }
 
         bool isDir = entry.right(1) == QLatin1String("/");
-        const Archive::Entry *archiveEntry = lastDirEntry->find(entry.split(QLatin1Char('/'), QString::SkipEmptyParts).last());
+        fetchDirectory(lastDirEntry, NotifyViews);
+        Archive::Entry *archiveEntry = lastDirEntry->find(entry.split(QLatin1Char('/'), QString::SkipEmptyParts).last());
 
         if (archiveEntry != nullptr) {
             if (archiveEntry->isDir() != isDir || !allowMerging) {
@@ -811,87 +1141,154 @@ const QHash<QString, QIcon> ArchiveModel::entryIcons() const
 
 void ArchiveModel::slotCleanupEmptyDirs()
 {
-    QList<QPersistentModelIndex> queue;
-    QList<QPersistentModelIndex> nodesToDelete;
-
-    // Add root nodes.
-    for (int i = 0; i < rowCount(); ++i) {
-        queue.append(QPersistentModelIndex(index(i, 0)));
-    }
+    // Only the folders which lost children since the last cleanup can have become empty.
+    QSet<Archive::Entry*> queue = m_touchedDirs;
+    m_touchedDirs.clear();
 
-    // Breadth-first traverse.
     while (!queue.isEmpty()) {
-        QPersistentModelIndex node = queue.takeFirst();
-        Archive::Entry *entry = entryForIndex(node);
+        const auto first = queue.begin();
+        Archive::Entry *entry = *first;
+        queue.erase(first);
 
-        if (!hasChildren(node)) {
-            if (entry->fullPath().isEmpty()) {
-                nodesToDelete << node;
-            }
-        } else {
-            for (int i = 0; i < rowCount(node); ++i) {
-                queue.append(QPersistentModelIndex(index(i, 0, node)));
-            }
+        Archive::Entry *parent = entry->getParent();
+        // Only the folders created for their children are removed, listed ones are in the archive.
+        if (!parent || !m_implicitDirs.contains(entry) || !entry->entries().isEmpty() || m_unfetchedDirs.contains(entry)) {
+            continue;
         }
-    }
 
-    foreach(const QPersistentModelIndex& node, nodesToDelete) {
-        Archive::Entry *rawEntry = static_cast<Archive::Entry*>(node.internalPointer());
-        qCDebug(ARK) << "Delete with parent entries " << rawEntry->getParent()->entries() << " and row " << rawEntry->row();
-        beginRemoveRows(parent(node), rawEntry->row(), rawEntry->row());
-        m_entryIcons.remove(rawEntry->getParent()->entries().at(rawEntry->row())->fullPath(NoTrailingSlash));
-        rawEntry->getParent()->removeEntryAt(rawEntry->row());
+        const int row = entry->row();
+        qCDebug(ARK) << "Delete with parent entries " << parent->entries() << " and row " << row;
+        beginRemoveRows(indexForEntry(parent), row, row);
+        m_entryIcons.remove(entry->fullPath(NoTrailingSlash));
+        removeFromAggregates(entry);
+        parent->removeEntryAt(row);
+        forgetSubtree(entry);
         endRemoveRows();
+
+        // The parent might be empty now.
+        queue.insert(parent);
+    }
+}
+
+void ArchiveModel::DirectoryAggregate::add(const DirectoryAggregate &other)
+{
+    dirs += other.dirs;
+    files += other.files;
+    size += other.size;
+    compressedSize += other.compressedSize;
+}
+
+void ArchiveModel::DirectoryAggregate::subtract(const DirectoryAggregate &other)
+{
+    dirs -= other.dirs;
+    files -= other.files;
+    size -= other.size;
+    compressedSize -= other.compressedSize;
+}
+
+ArchiveModel::DirectoryAggregate ArchiveModel::aggregateFor(const Archive::Entry *dir) const
+{
+    return m_aggregates.value(dir ? dir : m_rootEntry.data());
+}
+
+ArchiveModel::DirectoryAggregate ArchiveModel::contributionOf(const Archive::Entry *entry) const
+{
+    DirectoryAggregate contribution;
+    if (entry->isDir()) {
+        contribution = m_aggregates.value(entry);
+        contribution.dirs++;
+    } else {
+        contribution.files = 1;
+        contribution.size = entry->property("size").toULongLong();
+        contribution.compressedSize = entry->property("compressedSize").toULongLong();
     }
+    return contribution;
 }
 
-void ArchiveModel::countEntriesAndSize()
+void ArchiveModel::addToAggregates(const Archive::Entry *entry)
 {
-    // This function is used to count the number of folders/files and
-    // the total compressed size. This is needed for PropertiesDialog
-    // to update the corresponding values after adding/deleting files.
+    const Archive::Entry *parent = entry->getParent();
+    if (!parent) {
+        return;
+    }
 
-    // When ArchiveModel has been properly fixed, this code can likely
-    // be removed.
+    DirectoryAggregate &parentAggregate = m_aggregates[parent];
+    if (entry->isDir()) {
+        parentAggregate.childDirs++;
+    } else {
+        parentAggregate.childFiles++;
+    }
 
-    m_numberOfFiles = 0;
-    m_numberOfFolders = 0;
-    m_uncompressedSize = 0;
+    const DirectoryAggregate contribution = contributionOf(entry);
+    for (; parent; parent = parent->getParent()) {
+        m_aggregates[parent].add(contribution);
+    }
+}
 
-    QElapsedTimer timer;
-    timer.start();
+void ArchiveModel::removeFromAggregates(const Archive::Entry *entry)
+{
+    const Archive::Entry *parent = entry->getParent();
+    if (!parent) {
+        return;
+    }
 
-    traverseAndCountDirNode(m_rootEntry.data());
+    DirectoryAggregate &parentAggregate = m_aggregates[parent];
+    if (entry->isDir()) {
+        parentAggregate.childDirs--;
+    } else {
+        parentAggregate.childFiles--;
+    }
 
-    qCDebug(ARK) << "Time to count entries and size:" << timer.elapsed() << "ms";
+    const DirectoryAggregate contribution = contributionOf(entry);
+    for (; parent; parent = parent->getParent()) {
+        m_aggregates[parent].subtract(contribution);
+    }
 }
 
-void ArchiveModel::traverseAndCountDirNode(Archive::Entry *dir)
+void ArchiveModel::forgetSubtree(Archive::Entry *entry)
 {
-    foreach(Archive::Entry *entry, dir->entries()) {
-        if (entry->isDir()) {
-            traverseAndCountDirNode(entry);
-            m_numberOfFolders++;
-        } else {
-            m_numberOfFiles++;
-            m_uncompressedSize += entry->property("size").toULongLong();
+    m_touchedDirs.remove(entry);
+    m_implicitDirs.remove(entry);
+
+    // Entries added at the path of a removed folder need a new one.
+    if (entry == m_previousMatch) {
+        m_previousMatch = nullptr;
+    }
+
+    const auto unfetched = m_unfetchedDirs.constFind(entry);
+    if (unfetched != m_unfetchedDirs.constEnd()) {
+        // None of its children were inserted, so its subtree is only in the entry table.
+        const int position = unfetched.value();
+        const int end = subtreeEnd(position);
+        for (int i = position; i < end; ++i) {
+            m_unfetchedDirs.remove(m_entryTable.at(i).entry);
+            m_implicitDirs.remove(m_entryTable.at(i).entry);
+            m_aggregates.remove(m_entryTable.at(i).entry);
         }
+        return;
+    }
+
+    if (!entry->isDir() || !m_aggregates.remove(entry)) {
+        return;
+    }
+    foreach (Archive::Entry *child, entry->entries()) {
+        forgetSubtree(child);
     }
 }
 
 qulonglong ArchiveModel::numberOfFiles() const
 {
-    return m_numberOfFiles;
+    return aggregateFor(nullptr).files;
 }
 
 qulonglong ArchiveModel::numberOfFolders() const
 {
-    return m_numberOfFolders;
+    return aggregateFor(nullptr).dirs;
 }
 
 qulonglong ArchiveModel::uncompressedSize() const
 {
-    return m_uncompressedSize;
+    return aggregateFor(nullptr).size;
 }
 
 QList<int> ArchiveModel::shownColumns() const
@@ -29,14 +29,20 @@
 
 #include <QAbstractItemModel>
 #include <QScopedPointer>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
 
 using Kerfuffle::Archive;
 
 namespace Kerfuffle
 {
+    class EntryPath;
     class Query;
 }
 
+class QMimeDatabase;
+
 /**
  * Meta data related to one entry in a compressed archive.
  *
@@ -73,6 +79,9 @@ public:
     QModelIndex parent(const QModelIndex &index) const override;
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
     //drag and drop related
     Qt::DropActions supportedDropActions() const override;
@@ -83,12 +92,35 @@ public:
     void reset();
     void createEmptyArchive(const QString &path, const QString &mimeType, QObject *parent);
     KJob* loadArchive(const QString &path, const QString &mimeType, QObject *parent);
+
+    /**
+     * Lists the archive of @p loadJob into the model once the job is started.
+     * @return The job.
+     */
+    KJob* loadArchive(Kerfuffle::LoadJob *loadJob);
     Kerfuffle::Archive *archive() const;
 
     QList<int> shownColumns() const;
     QMap<int, QByteArray> propertiesMap() const;
 
     Archive::Entry *entryForIndex(const QModelIndex &index);
+    QModelIndex indexForEntry(Archive::Entry *entry);
+
+    /**
+     * Inserts the parent folders of @p entry into the model, if they were not fetched yet.
+     */
+    void fetchEntry(const Archive::Entry *entry);
+
+    /**
+     * @return Whether rows are being inserted because a folder is fetched, rather than added.
+     */
+    bool isFetching() const;
+
+    /**
+     * @return All the entries of the archive, including those of folders which were not
+     * fetched yet. Folders come before their children.
+     */
+    QVector<const Archive::Entry*> allEntries() const;
 
     Kerfuffle::ExtractJob* extractFile(Archive::Entry *file, const QString& destinationDir, const Kerfuffle::ExtractionOptions& options = Kerfuffle::ExtractionOptions()) const;
     Kerfuffle::ExtractJob* extractFiles(const QVector<Archive::Entry*>& files, const QString& destinationDir, const Kerfuffle::ExtractionOptions& options = Kerfuffle::ExtractionOptions()) const;
@@ -108,7 +140,27 @@ public:
      */
     void encryptArchive(const QString &password, bool encryptHeader);
 
-    void countEntriesAndSize();
+    /**
+     * Totals of a folder, kept up-to-date as entries are inserted and removed.
+     */
+    struct DirectoryAggregate
+    {
+        uint childDirs = 0;     // Direct children only.
+        uint childFiles = 0;
+        qulonglong dirs = 0;    // The whole subtree.
+        qulonglong files = 0;
+        qulonglong size = 0;
+        qulonglong compressedSize = 0;
+
+        void add(const DirectoryAggregate &other);
+        void subtract(const DirectoryAggregate &other);
+    };
+
+    /**
+     * @return The totals of the folder @p dir, or of the whole archive if @p dir is null.
+     */
+    DirectoryAggregate aggregateFor(const Archive::Entry *dir) const;
+
     qulonglong numberOfFiles() const;
     qulonglong numberOfFolders() const;
     qulonglong uncompressedSize() const;
@@ -127,7 +179,7 @@ public:
      * entries for both new and existing paths, the method will return false. Also, if merging is not allowed,
      * this method will return false for entries with the same path and types.
      */
-    bool conflictingEntries(QList<const Archive::Entry*> &conflictingEntries, const QStringList &entries, bool allowMerging) const;
+    bool conflictingEntries(QList<const Archive::Entry*> &conflictingEntries, const QStringList &entries, bool allowMerging);
 
     static bool hasDuplicatedEntries(const QStringList &entries);
 
@@ -155,22 +207,15 @@ private slots:
     void slotCleanupEmptyDirs();
 
 private:
-    /**
-     * Strips file names that start with './'.
-     *
-     * For more information, see bug 194241.
-     *
-     * @param fileName The file name that will be stripped.
-     *
-     * @return @p fileName without the leading './'
-     */
-    QString cleanFileName(const QString& fileName);
-
     void initRootEntry();
 
     enum InsertBehaviour { NotifyViews, DoNotNotifyViews };
-    Archive::Entry *parentFor(const Kerfuffle::Archive::Entry *entry, InsertBehaviour behaviour = NotifyViews);
-    QModelIndex indexForEntry(Archive::Entry *entry);
+    Archive::Entry *parentFor(const Kerfuffle::EntryPath &path, InsertBehaviour behaviour = NotifyViews);
+
+    /**
+     * @return The entry at @p path, or null if it is not in the model.
+     */
+    Archive::Entry *findEntry(const Kerfuffle::EntryPath &path) const;
     static bool compareAscending(const QModelIndex& a, const QModelIndex& b);
     static bool compareDescending(const QModelIndex& a, const QModelIndex& b);
     /**
@@ -180,8 +225,56 @@ private:
 
     void insertEntry(Archive::Entry *entry, InsertBehaviour behaviour = NotifyViews);
     void newEntry(Kerfuffle::Archive::Entry *receivedEntry, InsertBehaviour behaviour);
+    bool prepareEntry(Archive::Entry *entry, const Kerfuffle::EntryPath &path, InsertBehaviour behaviour);
+    void cacheIcon(const Archive::Entry *entry, const QMimeDatabase &db);
+
+    /**
+     * Notifies the views that the properties of @p entry changed.
+     */
+    void emitEntryChanged(Archive::Entry *entry);
 
-    void traverseAndCountDirNode(Archive::Entry *dir);
+    /**
+     * An entry listed while loading, keyed by its normalized path.
+     */
+    struct TableEntry
+    {
+        QString path;
+        Archive::Entry *entry;
+    };
+
+    /**
+     * Sorts the listed entries by path, links them to their parent folders and computes
+     * the folder totals. Only the root folder is inserted into the model.
+     */
+    void buildEntryTable();
+
+    /**
+     * @return The position following the subtree of the folder at @p position of the entry table.
+     */
+    int subtreeEnd(int position) const;
+
+    /**
+     * Inserts the children of the folder @p dir, if it was not fetched yet.
+     */
+    void fetchDirectory(Archive::Entry *dir, InsertBehaviour behaviour);
+
+    /**
+     * Fetches the folders leading to @p path, so that it can be looked up in the model.
+     */
+    void fetchPath(const Kerfuffle::EntryPath &path);
+    void collectEntries(const Archive::Entry *dir, QVector<const Archive::Entry*> &entries) const;
+
+    /**
+     * Adds the totals of @p entry to those of its parent folders, or removes them.
+     */
+    void addToAggregates(const Archive::Entry *entry);
+    void removeFromAggregates(const Archive::Entry *entry);
+    DirectoryAggregate contributionOf(const Archive::Entry *entry) const;
+
+    /**
+     * Drops what is known about the removed @p entry and its children.
+     */
+    void forgetSubtree(Archive::Entry *entry);
 
     QList<int> m_showColumns;
     QScopedPointer<Kerfuffle::Archive> m_archive;
@@ -191,9 +284,24 @@ private:
 
     QString m_dbusPathName;
 
-    qulonglong m_numberOfFiles;
-    qulonglong m_numberOfFolders;
-    qulonglong m_uncompressedSize;
+    // The parent folder found by the last call to parentFor(), and its path.
+    Archive::Entry *m_previousMatch;
+    QStringList m_previousPieces;
+
+    QHash<const Archive::Entry*, DirectoryAggregate> m_aggregates;
+
+    // Folders which lost children, checked by slotCleanupEmptyDirs().
+    QSet<Archive::Entry*> m_touchedDirs;
+
+    // Folders which were not listed but created for their entries, removed once they are empty.
+    QSet<const Archive::Entry*> m_implicitDirs;
+
+    // Entries listed while loading, sorted by path. Never modified once loading finished.
+    QVector<TableEntry> m_entryTable;
+
+    // Folders whose children were not inserted yet, with their position in the entry table.
+    QHash<const Archive::Entry*, int> m_unfetchedDirs;
+    bool m_fetching;
 };
 
 #endif // ARCHIVEMODEL_H
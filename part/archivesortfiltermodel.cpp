@@ -23,23 +23,272 @@
 #include "archiveentry.h"
 #include "archivemodel.h"
 
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
 using namespace Kerfuffle;
 
+namespace
+{
+
+// The text sort keys of archives with more entries are computed in another thread.
+const int s_backgroundSortThreshold = 20000;
+
+bool isNumericType(int metaDataType)
+{
+    return metaDataType == Size || metaDataType == CompressedSize || metaDataType == Timestamp;
+}
+
+qint64 numericValue(const Archive::Entry *entry, int metaDataType)
+{
+    if (metaDataType == Timestamp) {
+        return entry->property("timestamp").toDateTime().toMSecsSinceEpoch();
+    }
+    return entry->property(metaDataType == Size ? "size" : "compressedSize").toLongLong();
+}
+
+QString textValue(const Archive::Entry *entry, const QByteArray &property)
+{
+    // Siblings share the same parent path, so only the name matters.
+    return property == "fullPath" ? entry->name() : entry->property(property.constData()).toString();
+}
+
+ArchiveSortFilterModel::SortKeys rankTexts(const QVector<const Archive::Entry*> &entries, const QStringList &texts)
+{
+    const QCollator collator = ArchiveSortFilterModel::entryCollator();
+
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(texts.size());
+    foreach (const QString &text, texts) {
+        keys.push_back(collator.sortKey(text));
+    }
+
+    std::vector<int> order(texts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keys](int left, int right) {
+        return keys[left].compare(keys[right]) < 0;
+    });
+
+    ArchiveSortFilterModel::SortKeys ranks;
+    ranks.reserve(texts.size());
+    qint64 rank = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i > 0 && keys[order[i - 1]].compare(keys[order[i]]) < 0) {
+            rank++;
+        }
+        ranks.insert(entries.at(order[i]), rank);
+    }
+
+    return ranks;
+}
+
+}
+
 ArchiveSortFilterModel::ArchiveSortFilterModel(QObject *parent)
     : KRecursiveFilterProxyModel(parent)
+    , m_collator(entryCollator())
+    , m_sortKeysType(-1)
+    , m_sortKeysOutdated(false)
+    , m_sortType(-1)
+    , m_sortKeysWatcher(nullptr)
+    , m_pendingSortType(-1)
+    , m_pendingSortColumn(-1)
+    , m_pendingSortOrder(Qt::AscendingOrder)
+    , m_isSearching(false)
+{
+}
+
+QCollator ArchiveSortFilterModel::entryCollator()
 {
+    // Sort like file managers do: "file2" before "file10", case-insensitively.
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    return collator;
 }
 
 ArchiveSortFilterModel::~ArchiveSortFilterModel()
 {
+    if (m_sortKeysWatcher) {
+        m_sortKeysWatcher->waitForFinished();
+    }
+}
+
+void ArchiveSortFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (this->sourceModel()) {
+        disconnect(this->sourceModel(), nullptr, this, nullptr);
+    }
+
+    KRecursiveFilterProxyModel::setSourceModel(sourceModel);
+
+    if (sourceModel) {
+        connect(sourceModel, &QAbstractItemModel::modelReset, this, &ArchiveSortFilterModel::slotEntriesReset);
+        connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &ArchiveSortFilterModel::slotEntriesChanged);
+        connect(sourceModel, &QAbstractItemModel::rowsRemoved, this, &ArchiveSortFilterModel::slotEntriesChanged);
+        connect(sourceModel, &QAbstractItemModel::dataChanged, this, &ArchiveSortFilterModel::slotEntriesChanged);
+    }
+    slotEntriesReset();
+}
+
+void ArchiveSortFilterModel::slotEntriesChanged()
+{
+    // Fetched folders got their keys already.
+    ArchiveModel *srcModel = qobject_cast<ArchiveModel*>(sourceModel());
+    if (srcModel && srcModel->isFetching()) {
+        return;
+    }
+
+    // Changed entries keep their outdated keys, and new entries might reuse the address of removed ones.
+    // All entries are compared directly until the next sort computes the keys again.
+    m_sortKeysOutdated = true;
+}
+
+void ArchiveSortFilterModel::slotEntriesReset()
+{
+    // The entries have been deleted, and their addresses might be reused.
+    m_sortKeys.clear();
+    m_sortKeysType = -1;
+    m_pendingSortType = -1;
+    m_searchResults.clear();
+}
+
+void ArchiveSortFilterModel::sort(int column, Qt::SortOrder order)
+{
+    ArchiveModel *srcModel = qobject_cast<ArchiveModel*>(sourceModel());
+    if (!srcModel || column < 0 || column >= srcModel->shownColumns().size()) {
+        KRecursiveFilterProxyModel::sort(column, order);
+        return;
+    }
+
+    const int metaDataType = srcModel->shownColumns().at(column);
+    if (metaDataType == m_sortKeysType && !m_sortKeysOutdated) {
+        applySort(metaDataType, column, order);
+        return;
+    }
+
+    // Replaces any sort still waiting for its keys.
+    m_pendingSortType = -1;
+
+    // Folders which were not fetched yet get their keys too.
+    const QVector<const Archive::Entry*> entries = srcModel->allEntries();
+
+    if (isNumericType(metaDataType)) {
+        m_sortKeys.clear();
+        m_sortKeys.reserve(entries.size());
+        foreach (const Archive::Entry *entry, entries) {
+            m_sortKeys.insert(entry, numericValue(entry, metaDataType));
+        }
+        m_sortKeysType = metaDataType;
+        m_sortKeysOutdated = false;
+        applySort(metaDataType, column, order);
+        return;
+    }
+
+    const QByteArray property = srcModel->propertiesMap().value(metaDataType);
+    QStringList texts;
+    texts.reserve(entries.size());
+    foreach (const Archive::Entry *entry, entries) {
+        texts << textValue(entry, property);
+    }
+
+    if (entries.size() < s_backgroundSortThreshold) {
+        m_sortKeys = rankTexts(entries, texts);
+        m_sortKeysType = metaDataType;
+        m_sortKeysOutdated = false;
+        applySort(metaDataType, column, order);
+        return;
+    }
+
+    // The current order is kept until the keys are ready, then the view is sorted at once.
+    m_pendingSortType = metaDataType;
+    m_pendingSortColumn = column;
+    m_pendingSortOrder = order;
+    m_sortKeysOutdated = false;
+
+    if (!m_sortKeysWatcher) {
+        m_sortKeysWatcher = new QFutureWatcher<SortKeys>(this);
+        connect(m_sortKeysWatcher, &QFutureWatcher<SortKeys>::finished, this, &ArchiveSortFilterModel::slotSortKeysReady);
+    }
+    m_sortKeysWatcher->setFuture(QtConcurrent::run(rankTexts, entries, texts));
+}
+
+bool ArchiveSortFilterModel::isSortPending() const
+{
+    return m_pendingSortType >= 0;
+}
+
+void ArchiveSortFilterModel::setSearchResults(const QSet<const Archive::Entry*> &entries)
+{
+    // The matches have to be in the source model to be shown.
+    ArchiveModel *srcModel = qobject_cast<ArchiveModel*>(sourceModel());
+    if (srcModel) {
+        foreach (const Archive::Entry *entry, entries) {
+            srcModel->fetchEntry(entry);
+        }
+    }
+
+    m_searchResults = entries;
+    m_isSearching = true;
+    invalidateFilter();
+}
+
+void ArchiveSortFilterModel::clearSearchResults()
+{
+    if (!m_isSearching) {
+        return;
+    }
+    m_searchResults.clear();
+    m_isSearching = false;
+    invalidateFilter();
+}
+
+bool ArchiveSortFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (!m_isSearching) {
+        return true;
+    }
+
+    // The search results already contain the parent folders, so there is no need to look at the children.
+    ArchiveModel *srcModel = qobject_cast<ArchiveModel*>(sourceModel());
+    return m_searchResults.contains(srcModel->entryForIndex(srcModel->index(sourceRow, 0, sourceParent)));
+}
+
+void ArchiveSortFilterModel::slotSortKeysReady()
+{
+    if (m_pendingSortType < 0) {
+        return;
+    }
+
+    m_sortKeys = m_sortKeysWatcher->result();
+    m_sortKeysType = m_pendingSortType;
+    m_pendingSortType = -1;
+
+    applySort(m_sortKeysType, m_pendingSortColumn, m_pendingSortOrder);
+}
+
+void ArchiveSortFilterModel::applySort(int metaDataType, int column, Qt::SortOrder order)
+{
+    ArchiveModel *srcModel = qobject_cast<ArchiveModel*>(sourceModel());
+    m_sortType = metaDataType;
+    m_sortProperty = srcModel->propertiesMap().value(metaDataType);
+
+    if (sortColumn() == column && sortOrder() == order) {
+        // The keys might have changed even if the column did not, so sort again.
+        invalidate();
+    } else {
+        KRecursiveFilterProxyModel::sort(column, order);
+    }
 }
 
 bool ArchiveSortFilterModel::lessThan(const QModelIndex &leftIndex,
                                       const QModelIndex &rightIndex) const
 {
     ArchiveModel *srcModel = qobject_cast<ArchiveModel*>(sourceModel());
-    const int col = srcModel->shownColumns().at(leftIndex.column());
-    const QByteArray property = srcModel->propertiesMap().value(col);
 
     const Archive::Entry *left = srcModel->entryForIndex(leftIndex);
     const Archive::Entry *right = srcModel->entryForIndex(rightIndex);
@@ -48,19 +297,29 @@ bool ArchiveSortFilterModel::lessThan(const QModelIndex &leftIndex,
         return true;
     } else if (!left->isDir() && right->isDir()) {
         return false;
-    } else {
-        switch (col) {
-        case Size:
-        case CompressedSize:
-            if (left->property(property).toULongLong() < right->property(property).toULongLong()) {
-                return true;
-            }
-            break;
-        default:
-            if (left->property(property).toString() < right->property(property).toString()) {
-                return true;
-            }
+    }
+
+    if (m_sortType < 0) {
+        return lessThanWithoutKeys(left, right, srcModel->shownColumns().at(leftIndex.column()));
+    }
+
+    if (m_sortType == m_sortKeysType && !m_sortKeysOutdated) {
+        const auto leftKey = m_sortKeys.constFind(left);
+        const auto rightKey = m_sortKeys.constFind(right);
+        if (leftKey != m_sortKeys.constEnd() && rightKey != m_sortKeys.constEnd()) {
+            return leftKey.value() < rightKey.value();
         }
     }
-    return false;
+
+    return lessThanWithoutKeys(left, right, m_sortType);
+}
+
+bool ArchiveSortFilterModel::lessThanWithoutKeys(const Archive::Entry *left, const Archive::Entry *right, int metaDataType) const
+{
+    if (isNumericType(metaDataType)) {
+        return numericValue(left, metaDataType) < numericValue(right, metaDataType);
+    }
+
+    const QByteArray property = (metaDataType == m_sortType) ? m_sortProperty : qobject_cast<ArchiveModel*>(sourceModel())->propertiesMap().value(metaDataType);
+    return m_collator.compare(textValue(left, property), textValue(right, property)) < 0;
 }
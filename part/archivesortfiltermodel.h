@@ -21,8 +21,16 @@
 #ifndef ARCHIVESORTFILTERMODEL_H
 #define ARCHIVESORTFILTERMODEL_H
 
+#include "archive_kerfuffle.h"
+
 #include <KRecursiveFilterProxyModel>
 
+#include <QCollator>
+#include <QHash>
+#include <QSet>
+
+template <typename T> class QFutureWatcher;
+
 class ArchiveSortFilterModel: public KRecursiveFilterProxyModel
 {
     Q_OBJECT
@@ -32,6 +40,60 @@ public:
     ~ArchiveSortFilterModel() override;
 
     bool lessThan(const QModelIndex &leftIndex, const QModelIndex &rightIndex) const override;
+
+    /**
+     * Computes typed sort keys for the entries before sorting.
+     * For text columns of large archives, the keys are computed in another thread
+     * and the view is sorted in one go once they are ready.
+     */
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    /**
+     * @return Whether a sort is waiting for its keys to be computed.
+     */
+    bool isSortPending() const;
+
+    /**
+     * Only shows the given entries, which must include the parent folders of the matching ones.
+     */
+    void setSearchResults(const QSet<const Kerfuffle::Archive::Entry*> &entries);
+    void clearSearchResults();
+
+    /**
+     * @return The collator used to sort the names of the entries.
+     */
+    static QCollator entryCollator();
+
+    // Entry -> sort key. The key is the value itself for numeric columns, the collation rank for text ones.
+    typedef QHash<const Kerfuffle::Archive::Entry*, qint64> SortKeys;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private slots:
+    void slotSortKeysReady();
+    void slotEntriesChanged();
+    void slotEntriesReset();
+
+private:
+    void applySort(int metaDataType, int column, Qt::SortOrder order);
+    bool lessThanWithoutKeys(const Kerfuffle::Archive::Entry *left, const Kerfuffle::Archive::Entry *right, int metaDataType) const;
+
+    QCollator m_collator;
+    SortKeys m_sortKeys;
+    int m_sortKeysType;
+    bool m_sortKeysOutdated;
+    int m_sortType;
+    QByteArray m_sortProperty;
+
+    QFutureWatcher<SortKeys> *m_sortKeysWatcher;
+    int m_pendingSortType;
+    int m_pendingSortColumn;
+    Qt::SortOrder m_pendingSortOrder;
+
+    QSet<const Kerfuffle::Archive::Entry*> m_searchResults;
+    bool m_isSearching;
 };
 
 #endif // ARCHIVESORTFILTERMODEL_H
@@ -0,0 +1,687 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "flatentrymodel.h"
+#include "archiveentry.h"
+#include "archivemodel.h"
+#include "archivesortfiltermodel.h"
+#include "ark_debug.h"
+#include "tracer.h"
+
+#include <KIO/Global>
+#include <KLocalizedString>
+
+#include <QCollator>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QLocale>
+#include <QMimeData>
+#include <QMimeDatabase>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+using namespace Kerfuffle;
+
+namespace
+{
+
+// Lists with more files are sorted in another thread.
+const int s_backgroundSortThreshold = 20000;
+
+// Stored for the files without a timestamp.
+const qint64 s_noTimestamp = std::numeric_limits<qint64>::min();
+
+// The metadata of a file, copied on the GUI thread for building the store in another one.
+struct FileRecord
+{
+    const Archive::Entry *entry;
+    QString path;
+    qulonglong size;
+    qulonglong compressedSize;
+    QDateTime timestamp;
+    QString crc;
+};
+
+bool isShownInFlatList(int metaDataType)
+{
+    return metaDataType == FullPath || metaDataType == Size || metaDataType == CompressedSize ||
+           metaDataType == Timestamp || metaDataType == CRC;
+}
+
+template <typename Key>
+void sortByKeys(QVector<int> &records, const QVector<Key> &keys, Qt::SortOrder order)
+{
+    // The keys are copied next to their record, so the comparisons don't jump around in memory.
+    std::vector<std::pair<Key, int> > pairs;
+    pairs.reserve(records.size());
+    foreach (int record, records) {
+        pairs.emplace_back(keys.at(record), record);
+    }
+
+    if (order == Qt::AscendingOrder) {
+        std::stable_sort(pairs.begin(), pairs.end(), [](const std::pair<Key, int> &left, const std::pair<Key, int> &right) {
+            return left.first < right.first;
+        });
+    } else {
+        std::stable_sort(pairs.begin(), pairs.end(), [](const std::pair<Key, int> &left, const std::pair<Key, int> &right) {
+            return right.first < left.first;
+        });
+    }
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        records[i] = pairs[i].second;
+    }
+}
+
+QVector<int> sortRecords(const QSharedPointer<const FlatEntryModel::Store> &store, int metaDataType, Qt::SortOrder order)
+{
+    ARK_TRACE_SCOPE("flat-sort", "model");
+
+    QVector<int> records(store->count());
+    std::iota(records.begin(), records.end(), 0);
+
+    switch (metaDataType) {
+    case Size:
+        sortByKeys(records, store->sizes, order);
+        break;
+    case CompressedSize:
+        sortByKeys(records, store->compressedSizes, order);
+        break;
+    case Timestamp:
+        sortByKeys(records, store->timestamps, order);
+        break;
+    case CRC:
+        sortByKeys(records, store->crcs, order);
+        break;
+    default: {
+        // The same order as the tree view.
+        const QCollator collator = ArchiveSortFilterModel::entryCollator();
+        std::vector<QCollatorSortKey> keys;
+        keys.reserve(records.size());
+        for (int record = 0; record < store->count(); ++record) {
+            keys.push_back(collator.sortKey(store->path(record).toString()));
+        }
+
+        const int sign = (order == Qt::AscendingOrder) ? 1 : -1;
+        std::stable_sort(records.begin(), records.end(), [&keys, sign](int left, int right) {
+            return sign * keys[left].compare(keys[right]) < 0;
+        });
+        break;
+    }
+    }
+
+    return records;
+}
+
+FlatEntryModel::Build buildStore(const QVector<FileRecord> &files, int sortType, Qt::SortOrder sortOrder)
+{
+    ARK_TRACE_SCOPE("flat-build", "model");
+
+    QSharedPointer<FlatEntryModel::Store> store(new FlatEntryModel::Store);
+    store->entries.reserve(files.size());
+    store->pathOffsets.reserve(files.size() + 1);
+    store->sizes.reserve(files.size());
+    store->compressedSizes.reserve(files.size());
+    store->timestamps.reserve(files.size());
+    store->crcs.reserve(files.size());
+
+    foreach (const FileRecord &file, files) {
+        store->entries << file.entry;
+        store->pathOffsets << store->paths.size();
+        store->paths += file.path;
+        store->sizes << file.size;
+        store->compressedSizes << file.compressedSize;
+        store->timestamps << (file.timestamp.isValid() ? file.timestamp.toMSecsSinceEpoch() : s_noTimestamp);
+        store->crcs << file.crc;
+    }
+    store->pathOffsets << store->paths.size();
+    store->paths.squeeze();
+
+    FlatEntryModel::Build build;
+    build.store = store;
+    build.sortType = sortType;
+    build.sortOrder = sortOrder;
+    if (sortType >= 0) {
+        build.order = sortRecords(build.store, sortType, sortOrder);
+    } else {
+        build.order.resize(store->count());
+        std::iota(build.order.begin(), build.order.end(), 0);
+    }
+
+    return build;
+}
+
+}
+
+int FlatEntryModel::Store::count() const
+{
+    return entries.size();
+}
+
+QStringRef FlatEntryModel::Store::path(int record) const
+{
+    return paths.midRef(pathOffsets.at(record), pathOffsets.at(record + 1) - pathOffsets.at(record));
+}
+
+FlatEntryModel::FlatEntryModel(ArchiveModel *model, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_model(model)
+    , m_rebuildTimer(new QTimer(this))
+    , m_buildWatcher(new QFutureWatcher<Build>(this))
+    , m_sortWatcher(new QFutureWatcher<QVector<int> >(this))
+    , m_active(false)
+    , m_rebuildRequested(false)
+    , m_buildOutdated(false)
+    , m_sortColumn(-1)
+    , m_sortOrder(Qt::AscendingOrder)
+    , m_sortPending(false)
+    , m_isSearching(false)
+{
+    // Entries are often removed one by one, so the list is rebuilt once they stop changing.
+    m_rebuildTimer->setSingleShot(true);
+    m_rebuildTimer->setInterval(0);
+    connect(m_rebuildTimer, &QTimer::timeout, this, &FlatEntryModel::rebuild);
+
+    connect(m_buildWatcher, &QFutureWatcher<Build>::finished, this, &FlatEntryModel::slotBuildReady);
+    connect(m_sortWatcher, &QFutureWatcher<QVector<int> >::finished, this, &FlatEntryModel::slotSortReady);
+
+    connect(m_model, &QAbstractItemModel::modelAboutToBeReset, this, &FlatEntryModel::slotEntriesAboutToBeReset);
+    connect(m_model, &QAbstractItemModel::modelReset, this, &FlatEntryModel::slotEntriesChanged);
+    connect(m_model, &QAbstractItemModel::rowsInserted, this, &FlatEntryModel::slotEntriesChanged);
+    connect(m_model, &QAbstractItemModel::rowsRemoved, this, &FlatEntryModel::slotEntriesChanged);
+    connect(m_model, &QAbstractItemModel::columnsInserted, this, &FlatEntryModel::slotEntriesChanged);
+    connect(m_model, &QAbstractItemModel::dataChanged, this, &FlatEntryModel::slotEntriesChanged);
+}
+
+FlatEntryModel::~FlatEntryModel()
+{
+    m_buildWatcher->waitForFinished();
+    m_sortWatcher->waitForFinished();
+}
+
+QVariant FlatEntryModel::data(const QModelIndex &index, int role) const
+{
+    // Only the store is read here: its entries might have been deleted until the next rebuild.
+    if (!index.isValid() || !m_store) {
+        return QVariant();
+    }
+
+    const int record = m_rows.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (m_columns.at(index.column())) {
+        case FullPath:
+            return m_store->path(record).toString();
+        case Size:
+            return KIO::convertSize(m_store->sizes.at(record));
+        case CompressedSize: {
+            const qulonglong compressedSize = m_store->compressedSizes.at(record);
+            return compressedSize != 0 ? KIO::convertSize(compressedSize) : QVariant();
+        }
+        case Timestamp: {
+            const qint64 timestamp = m_store->timestamps.at(record);
+            if (timestamp == s_noTimestamp) {
+                return QVariant();
+            }
+            return QLocale().toString(QDateTime::fromMSecsSinceEpoch(timestamp), QLocale::ShortFormat);
+        }
+        case CRC:
+            return m_store->crcs.at(record);
+        default:
+            return QVariant();
+        }
+    case Qt::DecorationRole:
+        if (index.column() == 0) {
+            // The mimetype is only looked up once per suffix, names without one are kept whole.
+            const QStringRef path = m_store->path(record);
+            const QStringRef name = path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+            const int dot = name.indexOf(QLatin1Char('.'));
+            const QString suffix = (dot > 0 ? name.mid(dot) : name).toString();
+            auto icon = m_icons.constFind(suffix);
+            if (icon == m_icons.constEnd()) {
+                const QMimeType mimeType = QMimeDatabase().mimeTypeForFile(name.toString(), QMimeDatabase::MatchExtension);
+                icon = m_icons.insert(suffix, QIcon::fromTheme(mimeType.iconName()));
+            }
+            return icon.value();
+        }
+        return QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+Qt::ItemFlags FlatEntryModel::flags(const QModelIndex &index) const
+{
+    if (index.isValid()) {
+        return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled | QAbstractTableModel::flags(index);
+    }
+
+    return Qt::ItemIsDropEnabled;
+}
+
+QVariant FlatEntryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole || section >= m_columns.size()) {
+        return QVariant();
+    }
+
+    const int metaDataType = m_columns.at(section);
+    if (metaDataType == FullPath) {
+        return i18nc("Full path of a file inside an archive", "Path");
+    }
+    return m_model->headerData(m_model->shownColumns().indexOf(metaDataType), orientation, role);
+}
+
+int FlatEntryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int FlatEntryModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_columns.size();
+}
+
+void FlatEntryModel::sort(int column, Qt::SortOrder order)
+{
+    m_sortColumn = column;
+    m_sortOrder = order;
+
+    if (!m_store || column < 0 || column >= m_columns.size()) {
+        return;
+    }
+
+    const int metaDataType = m_columns.at(column);
+    if (m_store->count() < s_backgroundSortThreshold) {
+        m_sortPending = false;
+        applyOrder(sortRecords(m_store, metaDataType, order));
+        return;
+    }
+
+    // The current order is kept until the sort is done, then the rows are reordered at once.
+    m_sortPending = true;
+    m_sortingStore = m_store;
+    m_sortWatcher->setFuture(QtConcurrent::run(sortRecords, m_store, metaDataType, order));
+}
+
+bool FlatEntryModel::isSortPending() const
+{
+    return m_sortPending;
+}
+
+bool FlatEntryModel::isBuildPending() const
+{
+    return m_buildWatcher->isRunning();
+}
+
+void FlatEntryModel::slotSortReady()
+{
+    if (!m_sortPending || m_sortingStore != m_store) {
+        return;
+    }
+
+    m_sortPending = false;
+    applyOrder(m_sortWatcher->result());
+}
+
+void FlatEntryModel::applyOrder(const QVector<int> &order)
+{
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+
+    // The selection follows its files.
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QVector<int> records;
+    records.reserve(oldIndexes.size());
+    foreach (const QModelIndex &index, oldIndexes) {
+        records << m_rows.at(index.row());
+    }
+
+    m_order = order;
+    updateRows();
+
+    if (!oldIndexes.isEmpty()) {
+        QVector<int> rowOfRecord(m_store->count(), -1);
+        for (int row = 0; row < m_rows.size(); ++row) {
+            rowOfRecord[m_rows.at(row)] = row;
+        }
+
+        QModelIndexList newIndexes;
+        newIndexes.reserve(oldIndexes.size());
+        for (int i = 0; i < oldIndexes.size(); ++i) {
+            const int row = rowOfRecord.at(records.at(i));
+            newIndexes << (row >= 0 ? index(row, oldIndexes.at(i).column()) : QModelIndex());
+        }
+        changePersistentIndexList(oldIndexes, newIndexes);
+    }
+
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+Qt::DropActions FlatEntryModel::supportedDropActions() const
+{
+    return m_model->supportedDropActions();
+}
+
+QStringList FlatEntryModel::mimeTypes() const
+{
+    return m_model->mimeTypes();
+}
+
+QMimeData *FlatEntryModel::mimeData(const QModelIndexList &indexes) const
+{
+    QModelIndexList sourceIndexes;
+    foreach (const QModelIndex &index, indexes) {
+        if (index.column() == 0) {
+            sourceIndexes << mapToSource(index);
+        }
+    }
+    return m_model->mimeData(sourceIndexes);
+}
+
+bool FlatEntryModel::dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent)
+{
+    // There are no folders to drop onto, so the files are added to the root of the archive.
+    Q_UNUSED(row)
+    Q_UNUSED(column)
+    Q_UNUSED(parent)
+    return m_model->dropMimeData(data, action, -1, -1, QModelIndex());
+}
+
+void FlatEntryModel::setActive(bool active)
+{
+    m_active = active;
+    if (m_active && !m_store) {
+        rebuild();
+    }
+}
+
+QModelIndex FlatEntryModel::mapToSource(const QModelIndex &index) const
+{
+    // The entries of the store stay valid until the archive model is reset, even once removed.
+    if (!index.isValid() || !m_store) {
+        return QModelIndex();
+    }
+
+    Archive::Entry *entry = const_cast<Archive::Entry*>(m_store->entries.at(m_rows.at(index.row())));
+    m_model->fetchEntry(entry);
+    return m_model->indexForEntry(entry);
+}
+
+void FlatEntryModel::setSearchResults(const QSet<const Archive::Entry*> &entries)
+{
+    m_searchResults = entries;
+    m_isSearching = true;
+    if (m_store) {
+        setRows(m_store, m_order);
+    }
+}
+
+void FlatEntryModel::clearSearchResults()
+{
+    if (!m_isSearching) {
+        return;
+    }
+
+    m_searchResults.clear();
+    m_isSearching = false;
+    if (m_store) {
+        setRows(m_store, m_order);
+    }
+}
+
+void FlatEntryModel::slotEntriesChanged()
+{
+    // Fetching folders doesn't change the files.
+    if (m_model->isFetching()) {
+        return;
+    }
+
+    if (m_active) {
+        m_rebuildTimer->start();
+        return;
+    }
+
+    // Nothing shows the list, so it is only rebuilt once it is shown again.
+    m_buildOutdated = m_buildWatcher->isRunning();
+    if (m_store) {
+        beginResetModel();
+        m_store.clear();
+        m_sortingStore.clear();
+        m_sortPending = false;
+        m_order.clear();
+        m_rows.clear();
+        endResetModel();
+    }
+}
+
+void FlatEntryModel::slotEntriesAboutToBeReset()
+{
+    // The entries are about to be destroyed, including those of the list being built.
+    m_buildOutdated = m_buildWatcher->isRunning();
+    if (m_store) {
+        beginResetModel();
+        m_store.clear();
+        m_sortingStore.clear();
+        m_sortPending = false;
+        m_order.clear();
+        m_rows.clear();
+        endResetModel();
+    }
+}
+
+QList<int> FlatEntryModel::flatColumns() const
+{
+    QList<int> columns;
+    foreach (int metaDataType, m_model->shownColumns()) {
+        if (isShownInFlatList(metaDataType)) {
+            columns << metaDataType;
+        }
+    }
+    return columns;
+}
+
+void FlatEntryModel::rebuild()
+{
+    m_rebuildTimer->stop();
+
+    // The changes made meanwhile are picked up once the current build is shown.
+    if (m_buildWatcher->isRunning()) {
+        m_rebuildRequested = true;
+        return;
+    }
+    m_rebuildRequested = false;
+
+    ARK_TRACE_SCOPE("flat-snapshot", "model");
+
+    // The other thread only reads these copies: the entries can change while it builds the store.
+    const QVector<const Archive::Entry*> entries = m_model->allEntries();
+    QVector<FileRecord> files;
+    files.reserve(entries.size());
+    foreach (const Archive::Entry *entry, entries) {
+        if (!entry->isDir()) {
+            files.append({entry, entry->fullPath(), entry->size(), entry->compressedSize(), entry->timestamp(), entry->crc()});
+        }
+    }
+
+    const QList<int> columns = flatColumns();
+    const int sortType = (m_sortColumn >= 0 && m_sortColumn < columns.size()) ? columns.at(m_sortColumn) : -1;
+    m_buildWatcher->setFuture(QtConcurrent::run(buildStore, files, sortType, m_sortOrder));
+}
+
+void FlatEntryModel::slotBuildReady()
+{
+    const bool outdated = m_buildOutdated;
+    m_buildOutdated = false;
+
+    if (!m_active) {
+        return;
+    }
+
+    if (!outdated) {
+        applyBuild(m_buildWatcher->result());
+    }
+
+    if (m_rebuildRequested || outdated) {
+        rebuild();
+    }
+}
+
+void FlatEntryModel::applyBuild(const Build &build)
+{
+    qCDebug(ARK) << "Flat list of" << build.store->count() << "files built";
+
+    const QList<int> columns = flatColumns();
+    if (columns != m_columns) {
+        // The columns only change along with the archive, so the rows are inserted again.
+        beginResetModel();
+        m_columns = columns;
+        m_store.clear();
+        m_order.clear();
+        m_rows.clear();
+        endResetModel();
+    }
+
+    // A sort requested meanwhile is done again on the new store.
+    m_sortingStore.clear();
+    m_sortPending = false;
+    setRows(build.store, build.order);
+
+    const int sortType = (m_sortColumn >= 0 && m_sortColumn < m_columns.size()) ? m_columns.at(m_sortColumn) : -1;
+    if (sortType != build.sortType || (sortType >= 0 && m_sortOrder != build.sortOrder)) {
+        sort(m_sortColumn, m_sortOrder);
+    }
+}
+
+void FlatEntryModel::setRows(const QSharedPointer<const Store> &store, const QVector<int> &order)
+{
+    const QVector<int> rows = filteredRows(*store, order);
+
+    QSet<const Archive::Entry*> shownEntries;
+    shownEntries.reserve(rows.size());
+    foreach (int record, rows) {
+        shownEntries.insert(store->entries.at(record));
+    }
+
+    // Removes the files which are no longer shown, one block of rows at a time.
+    for (int last = m_rows.size() - 1; last >= 0; --last) {
+        if (shownEntries.contains(m_store->entries.at(m_rows.at(last)))) {
+            continue;
+        }
+        int first = last;
+        while (first > 0 && !shownEntries.contains(m_store->entries.at(m_rows.at(first - 1)))) {
+            --first;
+        }
+        beginRemoveRows(QModelIndex(), first, last);
+        m_rows.remove(first, last - first + 1);
+        endRemoveRows();
+        last = first;
+    }
+
+    // Moves the remaining rows to the records of the new store.
+    QHash<const Archive::Entry*, int> keptRowOfEntry;
+    keptRowOfEntry.reserve(m_rows.size());
+    for (int row = 0; row < m_rows.size(); ++row) {
+        keptRowOfEntry.insert(m_store->entries.at(m_rows.at(row)), row);
+    }
+
+    QVector<int> keptRows;
+    keptRows.reserve(keptRowOfEntry.size());
+    QVector<bool> isKept(store->count(), false);
+    foreach (int record, rows) {
+        if (keptRowOfEntry.contains(store->entries.at(record))) {
+            keptRows << record;
+            isKept[record] = true;
+        }
+    }
+
+    if (m_rows.isEmpty() || (store == m_store && keptRows == m_rows)) {
+        m_store = store;
+        m_order = order;
+        m_rows = keptRows;
+    } else {
+        emit layoutAboutToBeChanged();
+
+        QHash<const Archive::Entry*, int> newRowOfEntry;
+        newRowOfEntry.reserve(keptRows.size());
+        for (int row = 0; row < keptRows.size(); ++row) {
+            newRowOfEntry.insert(store->entries.at(keptRows.at(row)), row);
+        }
+
+        const QModelIndexList oldIndexes = persistentIndexList();
+        QModelIndexList newIndexes;
+        newIndexes.reserve(oldIndexes.size());
+        foreach (const QModelIndex &oldIndex, oldIndexes) {
+            const int row = newRowOfEntry.value(m_store->entries.at(m_rows.at(oldIndex.row())), -1);
+            newIndexes << (row >= 0 ? createIndex(row, oldIndex.column()) : QModelIndex());
+        }
+
+        m_store = store;
+        m_order = order;
+        m_rows = keptRows;
+        changePersistentIndexList(oldIndexes, newIndexes);
+
+        emit layoutChanged();
+    }
+
+    // Inserts the newly shown files, one block of rows at a time.
+    int position = 0;
+    while (position < rows.size()) {
+        if (isKept.at(rows.at(position))) {
+            ++position;
+            continue;
+        }
+        int end = position;
+        while (end < rows.size() && !isKept.at(rows.at(end))) {
+            ++end;
+        }
+        beginInsertRows(QModelIndex(), position, end - 1);
+        m_rows.insert(position, end - position, 0);
+        std::copy(rows.constBegin() + position, rows.constBegin() + end, m_rows.begin() + position);
+        endInsertRows();
+        position = end;
+    }
+}
+
+QVector<int> FlatEntryModel::filteredRows(const Store &store, const QVector<int> &order) const
+{
+    if (!m_isSearching) {
+        return order;
+    }
+
+    QVector<int> rows;
+    foreach (int record, order) {
+        if (m_searchResults.contains(store.entries.at(record))) {
+            rows << record;
+        }
+    }
+    return rows;
+}
+
+void FlatEntryModel::updateRows()
+{
+    m_rows = filteredRows(*m_store, m_order);
+}
@@ -0,0 +1,162 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef FLATENTRYMODEL_H
+#define FLATENTRYMODEL_H
+
+#include "archive_kerfuffle.h"
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QIcon>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+
+class ArchiveModel;
+class QTimer;
+
+template <typename T> class QFutureWatcher;
+
+/**
+ * Flat list of all the files of an ArchiveModel, whatever folder they are in.
+ *
+ * The metadata of the files is copied into one array per column, so that
+ * sorting and filtering only read contiguous memory. The arrays are built and
+ * sorted in another thread, from a copy of the metadata taken on the GUI thread.
+ * Large lists are also sorted in another thread when the sort column changes,
+ * and the rows are only reordered once the sort is done.
+ */
+class FlatEntryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    struct Store
+    {
+        QVector<const Kerfuffle::Archive::Entry*> entries;
+        QString paths;              // The full paths of all the files, one after another.
+        QVector<int> pathOffsets;   // Start of each path in paths, followed by the end of the last one.
+        QVector<qulonglong> sizes;
+        QVector<qulonglong> compressedSizes;
+        QVector<qint64> timestamps; // Milliseconds since the epoch.
+        QVector<QString> crcs;
+
+        int count() const;
+        QStringRef path(int record) const;
+    };
+
+    // A store built in another thread, along with its records in sort order.
+    struct Build
+    {
+        QSharedPointer<const Store> store;
+        QVector<int> order;
+        int sortType = -1;
+        Qt::SortOrder sortOrder = Qt::AscendingOrder;
+    };
+
+    explicit FlatEntryModel(ArchiveModel *model, QObject *parent = nullptr);
+    ~FlatEntryModel() override;
+
+    QVariant data(const QModelIndex &index, int role) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    // Drag and drop are handled by the archive model.
+    Qt::DropActions supportedDropActions() const override;
+    QStringList mimeTypes() const override;
+    QMimeData *mimeData(const QModelIndexList &indexes) const override;
+    bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent) override;
+
+    /**
+     * The list is only kept up-to-date while it is shown.
+     */
+    void setActive(bool active);
+
+    /**
+     * @return The index of the archive model for @p index, whose parent folders are fetched if needed.
+     * Until a new list is built, the files of the previous one are mapped.
+     */
+    QModelIndex mapToSource(const QModelIndex &index) const;
+
+    /**
+     * Only shows the files among @p entries.
+     */
+    void setSearchResults(const QSet<const Kerfuffle::Archive::Entry*> &entries);
+    void clearSearchResults();
+
+    bool isSortPending() const;
+
+    /**
+     * @return Whether the list is being built in another thread.
+     */
+    bool isBuildPending() const;
+
+private slots:
+    void slotEntriesChanged();
+    void slotEntriesAboutToBeReset();
+    void rebuild();
+    void slotBuildReady();
+    void slotSortReady();
+
+private:
+    QList<int> flatColumns() const;
+    void applyBuild(const Build &build);
+    void applyOrder(const QVector<int> &order);
+
+    /**
+     * Shows the files of @p order matching the search, by removing and inserting rows
+     * so that the views keep their selection and scroll position.
+     */
+    void setRows(const QSharedPointer<const Store> &store, const QVector<int> &order);
+    QVector<int> filteredRows(const Store &store, const QVector<int> &order) const;
+    void updateRows();
+
+    ArchiveModel *m_model;
+    QTimer *m_rebuildTimer;
+    QFutureWatcher<Build> *m_buildWatcher;
+    QFutureWatcher<QVector<int> > *m_sortWatcher;
+    bool m_active;
+    bool m_rebuildRequested;    // The entries changed while the list was built.
+    bool m_buildOutdated;       // The entries of the list being built were destroyed.
+
+    // The type of each column, see EntryMetaDataType.
+    QList<int> m_columns;
+
+    QSharedPointer<const Store> m_store;
+    QSharedPointer<const Store> m_sortingStore;
+    QVector<int> m_order;   // The records in sort order.
+    QVector<int> m_rows;    // The records matching the search, in sort order.
+
+    int m_sortColumn;
+    Qt::SortOrder m_sortOrder;
+    bool m_sortPending;
+
+    QSet<const Kerfuffle::Archive::Entry*> m_searchResults;
+    bool m_isSearching;
+
+    mutable QHash<QString, QIcon> m_icons;  // By file name suffix.
+};
+
+#endif // FLATENTRYMODEL_H
@@ -27,6 +27,7 @@
 
 #include <QFileInfo>
 #include <QMimeDatabase>
+#include <QSet>
 
 using namespace Kerfuffle;
 
@@ -109,10 +110,8 @@ void InfoPanel::setIndex(const QModelIndex& index)
 
         iconLabel->setPixmap(getDesktopIconForName(mimeType.iconName()));
         if (entry->isDir()) {
-            uint dirs;
-            uint files;
-            entry->countChildren(dirs, files);
-            additionalInfo->setText(KIO::itemsSummaryString(dirs + files, files, dirs, 0, false));
+            const ArchiveModel::DirectoryAggregate aggregate = m_model->aggregateFor(entry);
+            additionalInfo->setText(KIO::itemsSummaryString(aggregate.files + aggregate.dirs, aggregate.files, aggregate.dirs, aggregate.size, true));
         } else if (!entry->property("link").toString().isEmpty()) {
             additionalInfo->setText(i18n("Symbolic Link"));
         } else {
@@ -141,10 +140,25 @@ void InfoPanel::setIndexes(const QModelIndexList &list)
     } else {
         iconLabel->setPixmap(getDesktopIconForName(QStringLiteral("utilities-file-archiver")));
         fileName->setText(i18np("One file selected", "%1 files selected", list.size()));
-        quint64 totalSize = 0;
+        QSet<const Archive::Entry*> selectedEntries;
         foreach(const QModelIndex& index, list) {
-            const Archive::Entry *entry = m_model->entryForIndex(index);
-            totalSize += entry->property("size").toULongLong();
+            selectedEntries.insert(m_model->entryForIndex(index));
+        }
+
+        // Folders count with their whole content, unless one of their parent folders is selected too.
+        quint64 totalSize = 0;
+        foreach(const Archive::Entry *entry, selectedEntries) {
+            bool parentSelected = false;
+            for (const Archive::Entry *parent = entry->getParent(); parent; parent = parent->getParent()) {
+                if (selectedEntries.contains(parent)) {
+                    parentSelected = true;
+                    break;
+                }
+            }
+            if (parentSelected) {
+                continue;
+            }
+            totalSize += entry->isDir() ? m_model->aggregateFor(entry).size : entry->property("size").toULongLong();
         }
         additionalInfo->setText(KIO::convertSize(totalSize));
         hideMetaData();
@@ -32,6 +32,7 @@
 #include "archiveview.h"
 #include "arkviewer.h"
 #include "dnddbusinterfaceadaptor.h"
+#include "flatentrymodel.h"
 #include "infopanel.h"
 #include "jobtracker.h"
 #include "generalsettingspage.h"
@@ -43,6 +44,7 @@
 #include "propertiesdialog.h"
 #include "pluginsettingspage.h"
 #include "pluginmanager.h"
+#include "searchindex.h"
 
 #include <KAboutData>
 #include <KActionCollection>
@@ -61,7 +63,9 @@
 #include <KXMLGUIFactory>
 
 #include <QAction>
+#include <QComboBox>
 #include <QCursor>
+#include <QEventLoop>
 #include <QHeaderView>
 #include <QMenu>
 #include <QMimeData>
@@ -75,6 +79,7 @@
 #include <QIcon>
 #include <QInputDialog>
 #include <QFileSystemWatcher>
+#include <QHash>
 #include <QGroupBox>
 #include <QPlainTextEdit>
 #include <QPushButton>
@@ -112,6 +117,8 @@ Part::Part(QWidget *parentWidget, QObject *parent, const QVariantList& args)
     m_vlayout = new QVBoxLayout;
     m_model = new ArchiveModel(pathName, this);
     m_filterModel = new ArchiveSortFilterModel(this);
+    m_flatModel = new FlatEntryModel(m_model, this);
+    m_searchIndex = new SearchIndex(m_model, this);
     m_splitter = new QSplitter(Qt::Horizontal, parentWidget);
     m_view = new ArchiveView;
     m_infoPanel = new InfoPanel(m_model);
@@ -160,14 +167,24 @@ Part::Part(QWidget *parentWidget, QObject *parent, const QVariantList& args)
     m_searchLineEdit = new QLineEdit(m_searchWidget);
     m_searchLineEdit->setClearButtonEnabled(true);
     m_searchLineEdit->setPlaceholderText(i18n("Type to search..."));
+    m_searchTypeCombo = new QComboBox(m_searchWidget);
+    m_searchTypeCombo->addItem(i18nc("@item:inlistbox search type", "Contains"), SearchIndex::Substring);
+    m_searchTypeCombo->addItem(i18nc("@item:inlistbox search type", "Wildcard"), SearchIndex::Wildcard);
+    m_searchTypeCombo->addItem(i18nc("@item:inlistbox search type", "Regular expression"), SearchIndex::RegularExpression);
     mainWidget->installEventFilter(this);
     searchLayout->addWidget(m_searchCloseButton);
     searchLayout->addWidget(m_searchLineEdit);
+    searchLayout->addWidget(m_searchTypeCombo);
     connect(m_searchCloseButton, &QPushButton::clicked, this, [=]() {
         m_searchWidget->hide();
         m_searchLineEdit->clear();
     });
     connect(m_searchLineEdit, &QLineEdit::textChanged, this, &Part::searchEdited);
+    connect(m_searchTypeCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, [=]() {
+        searchEdited(m_searchLineEdit->text());
+    });
+    connect(m_searchIndex, &SearchIndex::resultsReady, this, &Part::slotSearchResultsReady);
+    connect(m_searchIndex, &SearchIndex::searchCleared, this, &Part::slotSearchCleared);
 
     // Configure the QVBoxLayout and add widgets
     m_vlayout->setContentsMargins(0,0,0,0);
@@ -209,6 +226,13 @@ Part::Part(QWidget *parentWidget, QObject *parent, const QVariantList& args)
     connect(m_model, &ArchiveModel::messageWidget,
             this, &Part::displayMsgWidget);
 
+    // Changes made in quick succession are written with a single rewrite of the archive.
+    m_applyChangesTimer = new QTimer(this);
+    m_applyChangesTimer->setSingleShot(true);
+    m_applyChangesTimer->setInterval(3000);
+    connect(m_applyChangesTimer, &QTimer::timeout,
+            this, &Part::slotApplyPendingChanges);
+
     connect(this, &Part::busy,
             this, &Part::setBusyGui);
     connect(this, &Part::ready,
@@ -223,6 +247,11 @@ Part::Part(QWidget *parentWidget, QObject *parent, const QVariantList& args)
 
 Part::~Part()
 {
+    // The queued changes are written by closeUrl(), while the widget still exists.
+    if (m_model->archive() && m_model->archive()->hasPendingChanges()) {
+        qCWarning(ARK) << "Discarding the changes which were not written to" << localFilePath();
+    }
+
     qDeleteAll(m_tmpExtractDirList);
 
     // Only save splitterSizes if infopanel is visible,
@@ -263,6 +292,96 @@ void Part::registerJob(KJob* job)
     connect(job, &KJob::result, this, &Part::ready);
 }
 
+void Part::beginTransaction()
+{
+    if (m_model->archive()->beginTransaction()) {
+        m_applyChangesTimer->stop();
+    }
+}
+
+bool Part::applyPendingChanges()
+{
+    m_applyChangesTimer->stop();
+
+    if (!isBusy() && (!m_model->archive() || !m_model->archive()->hasPendingChanges())) {
+        return true;
+    }
+
+    // The running job owns the archive interface, so the changes are written once it is done.
+    // Both are waited for in a single event loop.
+    QEventLoop loop;
+    QString errorString;
+    auto commit = [&]() {
+        if (!m_model->archive() || !m_model->archive()->hasPendingChanges()) {
+            loop.quit();
+            return;
+        }
+
+        CommitJob *job = m_model->archive()->commitTransaction();
+        connect(job, &KJob::result, &loop, [&loop, &errorString, job]() {
+            errorString = job->errorString();
+            loop.quit();
+        });
+        job->start();
+    };
+
+    if (isBusy()) {
+        const QMetaObject::Connection connection = connect(this, &Part::ready, &loop, commit);
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+        disconnect(connection);
+    } else {
+        commit();
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+
+    // The changes are kept when they could not be written.
+    if (m_model->archive() && m_model->archive()->hasPendingChanges()) {
+        if (!errorString.isEmpty()) {
+            KMessageBox::error(widget(), errorString);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+void Part::slotApplyPendingChanges()
+{
+    if (isBusy()) {
+        m_applyChangesTimer->start();
+        return;
+    }
+
+    if (!m_model->archive() || !m_model->archive()->hasPendingChanges()) {
+        return;
+    }
+
+    CommitJob *job = m_model->archive()->commitTransaction();
+    connect(job, &KJob::result,
+            this, &Part::slotApplyPendingChangesDone);
+    registerJob(job);
+    job->start();
+}
+
+void Part::slotApplyPendingChangesDone(KJob *job)
+{
+    if (job->error() && job->error() != KJob::KilledJobError) {
+        // The changes are still pending, so they can be written again or dropped.
+        const int answer = KMessageBox::warningYesNo(widget(),
+                                                     xi18nc("@info", "The changes could not be written to the archive:<nl/>%1<nl/>Do you want to try again?",
+                                                            job->errorString()),
+                                                     QString(),
+                                                     KGuiItem(i18nc("@action:button", "Retry"), QStringLiteral("view-refresh")),
+                                                     KStandardGuiItem::discard());
+        if (answer == KMessageBox::Yes) {
+            slotApplyPendingChanges();
+        } else {
+            // Show the archive as it is on disk.
+            loadArchive();
+        }
+    }
+}
+
 // TODO: KIO::mostLocalHere is used here to resolve some KIO URLs to local
 // paths (e.g. desktop:/), but more work is needed to support extraction
 // to non-local destinations. See bugs #189322 and #204323.
@@ -318,18 +437,26 @@ void Part::setupView()
     m_view->setContextMenuPolicy(Qt::CustomContextMenu);
 
     m_filterModel->setSourceModel(m_model);
-    m_view->setModel(m_filterModel);
-    m_filterModel->setFilterKeyColumn(0);
-    m_filterModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    setViewModel(m_filterModel);
+
+    connect(m_view, &QTreeView::activated, this, &Part::slotActivated);
+
+    connect(m_view, &QWidget::customContextMenuRequested, this, &Part::slotShowContextMenu);
+}
+
+void Part::setViewModel(QAbstractItemModel *model)
+{
+    // The view creates a new selection model for each model, but doesn't delete the old one.
+    QItemSelectionModel *oldSelectionModel = m_view->selectionModel();
+    m_view->setModel(model);
+    if (oldSelectionModel) {
+        oldSelectionModel->deleteLater();
+    }
 
     connect(m_view->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &Part::updateActions);
     connect(m_view->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &Part::selectionChanged);
-
-    connect(m_view, &QTreeView::activated, this, &Part::slotActivated);
-
-    connect(m_view, &QWidget::customContextMenuRequested, this, &Part::slotShowContextMenu);
 }
 
 void Part::slotActivated(const QModelIndex &index)
@@ -357,6 +484,12 @@ void Part::setupActions()
     connect(m_showInfoPanelAction, &QAction::triggered,
             this, &Part::slotToggleInfoPanel);
 
+    m_showFlatListAction = new KToggleAction(i18nc("@action:inmenu", "Show All Files in a Flat List"), this);
+    actionCollection()->addAction(QStringLiteral("show-flatlist"), m_showFlatListAction);
+    m_showFlatListAction->setToolTip(i18nc("@info:tooltip", "Click to list the files of all the folders together, to sort them by size or date"));
+    connect(m_showFlatListAction, &QAction::triggered,
+            this, &Part::slotToggleFlatList);
+
     m_saveAsAction = actionCollection()->addAction(KStandardAction::SaveAs, QStringLiteral("ark_file_save_as"), this, SLOT(slotSaveAs()));
 
     m_openFileAction = actionCollection()->addAction(QStringLiteral("openfile"));
@@ -475,7 +608,7 @@ void Part::setupActions()
 void Part::updateActions()
 {
     bool isWritable = m_model->archive() && !m_model->archive()->isReadOnly();
-    const Archive::Entry *entry = m_model->entryForIndex(m_filterModel->mapToSource(m_view->selectionModel()->currentIndex()));
+    const Archive::Entry *entry = m_model->entryForIndex(sourceIndex(m_view->selectionModel()->currentIndex()));
     int selectedEntriesCount = m_view->selectionModel()->selectedRows().count();
 
     // We disable adding files if the archive is encrypted but the password is
@@ -530,9 +663,11 @@ void Part::updateActions()
     m_propertiesAction->setEnabled(!isBusy() &&
                                    m_model->archive());
 
+    // The flat list shows full paths, which can't be edited as names.
     m_renameFileAction->setEnabled(!isBusy() &&
                                    isWritable &&
-                                   (selectedEntriesCount == 1));
+                                   (selectedEntriesCount == 1) &&
+                                   m_view->model() != m_flatModel);
     m_cutFilesAction->setEnabled(!isBusy() &&
                                  isWritable &&
                                  (selectedEntriesCount > 0));
@@ -748,11 +883,19 @@ void Part::selectionChanged()
     m_infoPanel->setIndexes(getSelectedIndexes());
 }
 
+QModelIndex Part::sourceIndex(const QModelIndex &viewIndex) const
+{
+    if (m_view->model() == m_flatModel) {
+        return m_flatModel->mapToSource(viewIndex);
+    }
+    return m_filterModel->mapToSource(viewIndex);
+}
+
 QModelIndexList Part::getSelectedIndexes()
 {
     QModelIndexList list;
     foreach (const QModelIndex &i, m_view->selectionModel()->selectedRows()) {
-        list.append(m_filterModel->mapToSource(i));
+        list.append(sourceIndex(i));
     }
     return list;
 }
@@ -783,6 +926,25 @@ bool Part::saveFile()
     return true;
 }
 
+bool Part::closeUrl(bool promptToSave)
+{
+    if (!applyPendingChanges()) {
+        if (!promptToSave) {
+            return false;
+        }
+
+        const int answer = KMessageBox::warningContinueCancel(widget(),
+                                                              xi18nc("@info", "The changes could not be written to the archive. Do you want to close it anyway?"),
+                                                              QString(),
+                                                              KStandardGuiItem::discard());
+        if (answer != KMessageBox::Continue) {
+            return false;
+        }
+    }
+
+    return KParts::ReadWritePart::closeUrl(promptToSave);
+}
+
 bool Part::isBusy() const
 {
     return m_busy;
@@ -966,7 +1128,7 @@ void Part::slotOpenEntry(int mode)
 {
     qCDebug(ARK) << "Opening with mode" << mode;
 
-    QModelIndex index = m_filterModel->mapToSource(m_view->selectionModel()->currentIndex());
+    QModelIndex index = sourceIndex(m_view->selectionModel()->currentIndex());
     Archive::Entry *entry = m_model->entryForIndex(index);
 
     // Don't open directories.
@@ -1178,15 +1340,32 @@ QModelIndexList Part::addChildren(const QModelIndexList &list) const
 {
     Q_ASSERT(m_model);
 
-    QModelIndexList ret = list;
+    QModelIndexList ret;
+    ret.reserve(list.size());
+
+    // Every entry is visited once, even if both a folder and some of its children are selected.
+    QSet<const Archive::Entry*> visited;
+    visited.reserve(list.size());
+    foreach (const QModelIndex &index, list) {
+        if (!visited.contains(m_model->entryForIndex(index))) {
+            visited.insert(m_model->entryForIndex(index));
+            ret << index;
+        }
+    }
 
     // Iterate over indexes in list and add all children.
     for (int i = 0; i < ret.size(); ++i) {
-        QModelIndex index = ret.at(i);
+        const QModelIndex index = ret.at(i);
+        if (m_model->canFetchMore(index)) {
+            m_model->fetchMore(index);
+        }
+        const int rows = m_model->rowCount(index);
 
-        for (int j = 0; j < m_model->rowCount(index); ++j) {
-            QModelIndex child = m_model->index(j, 0, index);
-            if (!ret.contains(child)) {
+        for (int j = 0; j < rows; ++j) {
+            const QModelIndex child = m_model->index(j, 0, index);
+            const Archive::Entry *childEntry = m_model->entryForIndex(child);
+            if (!visited.contains(childEntry)) {
+                visited.insert(childEntry);
                 ret << child;
             }
         }
@@ -1209,36 +1388,54 @@ QVector<Archive::Entry*> Part::filesForIndexes(const QModelIndexList& list) cons
 QVector<Kerfuffle::Archive::Entry*> Part::filesAndRootNodesForIndexes(const QModelIndexList& list) const
 {
     QVector<Kerfuffle::Archive::Entry*> fileList;
-    QStringList fullPathsList;
+    fileList.reserve(list.size());
+    QSet<QString> fullPaths;
 
+    QSet<const Archive::Entry*> selectedEntries;
+    selectedEntries.reserve(list.size());
     foreach (const QModelIndex& index, list) {
-
-        // Find the topmost unselected parent. This is done by iterating up
-        // through the directory hierarchy and see if each parent is included
-        // in the selection OR if the parent is already part of list.
-        // The latter is needed for unselected folders which are subfolders of
-        // a selected parent folder.
-        QModelIndex selectionRoot = index.parent();
-        while (m_view->selectionModel()->isSelected(selectionRoot) ||
-               list.contains(selectionRoot)) {
-            selectionRoot = selectionRoot.parent();
+        selectedEntries.insert(m_model->entryForIndex(index));
+    }
+
+    // Parent folder -> root node of its children. Siblings share it, so the
+    // directory hierarchy is only walked up once per folder.
+    QHash<const Archive::Entry*, QString> rootNodes;
+
+    // Find the topmost unselected parent. This is done by iterating up
+    // through the directory hierarchy and see if each parent is part of list.
+    // This is needed for unselected folders which are subfolders of
+    // a selected parent folder.
+    auto rootNodeFor = [&](const Archive::Entry *parent) {
+        QVector<const Archive::Entry*> selectedParents;
+        QString rootNode;
+        for (; parent; parent = parent->getParent()) {
+            const auto cached = rootNodes.constFind(parent);
+            if (cached != rootNodes.constEnd()) {
+                rootNode = cached.value();
+                break;
+            }
+            if (!selectedEntries.contains(parent)) {
+                rootNode = parent->fullPath();
+                rootNodes.insert(parent, rootNode);
+                break;
+            }
+            selectedParents << parent;
         }
+        foreach (const Archive::Entry *selectedParent, selectedParents) {
+            rootNodes.insert(selectedParent, rootNode);
+        }
+        return rootNode;
+    };
 
-        // Fetch the root node for the unselected parent.
-        const QString rootFileName = selectionRoot.isValid()
-            ? m_model->entryForIndex(selectionRoot)->fullPath()
-            : QString();
-
+    foreach (const QModelIndex& index, list) {
+        Archive::Entry *entry = m_model->entryForIndex(index);
 
         // Append index with root node to fileList.
-        QModelIndexList alist = QModelIndexList() << index;
-        foreach (Archive::Entry *entry, filesForIndexes(alist)) {
-            const QString fullPath = entry->fullPath();
-            if (!fullPathsList.contains(fullPath)) {
-                entry->rootNode = rootFileName;
-                fileList.append(entry);
-                fullPathsList.append(fullPath);
-            }
+        const QString fullPath = entry->fullPath();
+        if (!fullPaths.contains(fullPath)) {
+            entry->rootNode = rootNodeFor(entry->getParent());
+            fileList.append(entry);
+            fullPaths.insert(fullPath);
         }
     }
     return fileList;
@@ -1337,6 +1534,7 @@ void Part::slotAddFiles(const QStringList& filesToAdd, const Archive::Entry *des
     qCDebug(ARK) << "Detected GlobalWorkDir to be " << globalWorkDir;
     compOptions.setGlobalWorkDir(globalWorkDir);
 
+    beginTransaction();
     AddJob *job = m_model->addFiles(m_jobTempEntries, destination, compOptions);
     if (!job) {
         qDeleteAll(m_jobTempEntries);
@@ -1375,7 +1573,7 @@ void Part::slotAddFiles()
     QString dialogTitle = i18nc("@title:window", "Add Files");
     const Archive::Entry *destination = nullptr;
     if (m_view->selectionModel()->selectedRows().count() == 1) {
-        destination = m_model->entryForIndex(m_filterModel->mapToSource(m_view->selectionModel()->currentIndex()));
+        destination = m_model->entryForIndex(sourceIndex(m_view->selectionModel()->currentIndex()));
         if (destination->isDir()) {
             dialogTitle = i18nc("@title:window", "Add Files to %1", destination->fullPath());;
         } else {
@@ -1453,7 +1651,7 @@ void Part::slotRenameFile(const QString &name)
         displayMsgWidget(KMessageWidget::Error, i18n("Filename can't contain slashes and can't be equal to \".\" or \"..\""));
         return;
     }
-    const Archive::Entry *entry = m_model->entryForIndex(m_filterModel->mapToSource(m_view->selectionModel()->currentIndex()));
+    const Archive::Entry *entry = m_model->entryForIndex(sourceIndex(m_view->selectionModel()->currentIndex()));
     QVector<Archive::Entry*> entriesToMove = filesForIndexes(addChildren(getSelectedIndexes()));
 
     m_destination = new Archive::Entry();
@@ -1471,7 +1669,7 @@ void Part::slotRenameFile(const QString &name)
 void Part::slotPasteFiles()
 {
     m_destination = (m_view->selectionModel()->selectedRows().count() > 0)
-                    ? m_model->entryForIndex(m_filterModel->mapToSource(m_view->selectionModel()->currentIndex()))
+                    ? m_model->entryForIndex(sourceIndex(m_view->selectionModel()->currentIndex()))
                     : nullptr;
     if (m_destination == nullptr) {
         m_destination = new Archive::Entry(nullptr, QString());
@@ -1547,6 +1745,7 @@ void Part::slotPasteFiles(QVector<Kerfuffle::Archive::Entry*> &files, Kerfuffle:
         qCDebug(ARK) << "Copying " << files << "to" << destination;
     }
 
+    beginTransaction();
     KJob *job;
     if (entriesWithoutChildren != 0) {
         job = m_model->moveFiles(files, destination, CompressionOptions());
@@ -1588,6 +1787,7 @@ void Part::slotAddFilesDone(KJob* job)
     m_cutIndexes.clear();
     m_model->filesToMove.clear();
     m_model->filesToCopy.clear();
+    m_applyChangesTimer->start();
 }
 
 void Part::slotPasteFilesDone(KJob *job)
@@ -1598,6 +1798,7 @@ void Part::slotPasteFilesDone(KJob *job)
     m_cutIndexes.clear();
     m_model->filesToMove.clear();
     m_model->filesToCopy.clear();
+    m_applyChangesTimer->start();
 }
 
 void Part::slotDeleteFilesDone(KJob* job)
@@ -1608,6 +1809,7 @@ void Part::slotDeleteFilesDone(KJob* job)
     m_cutIndexes.clear();
     m_model->filesToMove.clear();
     m_model->filesToCopy.clear();
+    m_applyChangesTimer->start();
 }
 
 void Part::slotDeleteFiles()
@@ -1629,6 +1831,7 @@ void Part::slotDeleteFiles()
         return;
     }
 
+    beginTransaction();
     DeleteJob *job = m_model->deleteFiles(filesForIndexes(addChildren(getSelectedIndexes())));
     connect(job, &KJob::result,
             this, &Part::slotDeleteFilesDone);
@@ -1638,7 +1841,6 @@ void Part::slotDeleteFiles()
 
 void Part::slotShowProperties()
 {
-    m_model->countEntriesAndSize();
     QPointer<Kerfuffle::PropertiesDialog> dialog(new Kerfuffle::PropertiesDialog(0,
                                                                                  m_model->archive(),
                                                                                  m_model->numberOfFiles(),
@@ -1660,6 +1862,25 @@ void Part::slotToggleInfoPanel(bool visible)
     }
 }
 
+void Part::slotToggleFlatList(bool flat)
+{
+    m_flatModel->setActive(flat);
+    setViewModel(flat ? static_cast<QAbstractItemModel*>(m_flatModel) : m_filterModel);
+    m_view->setRootIsDecorated(!flat);
+    m_view->sortByColumn(0, Qt::AscendingOrder);
+    if (!flat) {
+        m_view->expandIfSingleFolder();
+    }
+    m_view->header()->resizeSections(QHeaderView::ResizeToContents);
+
+    // The shown model has to filter the search results too.
+    if (!m_searchLineEdit->text().isEmpty()) {
+        searchEdited(m_searchLineEdit->text());
+    }
+
+    updateActions();
+}
+
 void Part::slotSaveAs()
 {
     QUrl saveUrl = QFileDialog::getSaveFileUrl(widget(), i18nc("@title:window", "Save Archive As"), url());
@@ -1678,6 +1899,10 @@ void Part::slotSaveAs()
             }
         }
 
+        if (!applyPendingChanges()) {
+            return;
+        }
+
         QUrl srcUrl = QUrl::fromLocalFile(localFilePath());
 
         if (!QFile::exists(localFilePath())) {
@@ -1739,16 +1964,35 @@ void Part::slotShowFind()
 
 void Part::searchEdited(const QString &text)
 {
-    m_view->collapseAll();
+    // The results are reported asynchronously, see slotSearchResultsReady().
+    const auto type = static_cast<SearchIndex::QueryType>(m_searchTypeCombo->currentData().toInt());
+    m_searchIndex->search(text, type);
+}
 
-    m_filterModel->setFilterFixedString(text);
+void Part::slotSearchResultsReady(const QSet<const Archive::Entry*> &entries)
+{
+    if (m_view->model() == m_flatModel) {
+        m_flatModel->setSearchResults(entries);
+        return;
+    }
 
-    if(text.isEmpty()) {
-        m_view->collapseAll();
-        m_view->expandIfSingleFolder();
-    } else {
-        m_view->expandAll();
+    m_view->collapseAll();
+    m_filterModel->setSearchResults(entries);
+    m_view->expandAll();
+}
+
+void Part::slotSearchCleared()
+{
+    m_flatModel->clearSearchResults();
+    if (m_view->model() == m_flatModel) {
+        m_filterModel->clearSearchResults();
+        return;
     }
+
+    m_view->collapseAll();
+    m_filterModel->clearSearchResults();
+    m_view->collapseAll();
+    m_view->expandIfSingleFolder();
 }
 
 void Part::displayMsgWidget(KMessageWidget::MessageType type, const QString& msg)
@@ -33,11 +33,14 @@
 #include <KMessageWidget>
 
 #include <QModelIndex>
+#include <QSet>
 
 class ArchiveModel;
 class ArchiveSortFilterModel;
 class ArchiveView;
+class FlatEntryModel;
 class InfoPanel;
+class SearchIndex;
 
 class KAboutData;
 class KAbstractWidgetJobTracker;
@@ -45,6 +48,7 @@ class KJob;
 class KToggleAction;
 
 class QAction;
+class QComboBox;
 class QLineEdit;
 class QSplitter;
 class QTreeView;
@@ -52,6 +56,7 @@ class QTemporaryDir;
 class QVBoxLayout;
 class QSignalMapper;
 class QFileSystemWatcher;
+class QTimer;
 class QGroupBox;
 class QPlainTextEdit;
 class QPushButton;
@@ -76,6 +81,9 @@ public:
     bool openFile() override;
     bool saveFile() override;
 
+    using KParts::ReadWritePart::closeUrl;
+    bool closeUrl(bool promptToSave) override;
+
     bool isBusy() const override;
     KConfigSkeleton *config() const override;
     QList<Kerfuffle::SettingsPage*> settingsPages(QWidget *parent) const override;
@@ -144,10 +152,18 @@ private slots:
     void slotTestingDone(KJob*);
     void slotDeleteFiles();
     void slotDeleteFilesDone(KJob*);
+
+    /**
+     * Writes the add, move, copy and delete operations queued in the archive transaction,
+     * unless another job is running.
+     */
+    void slotApplyPendingChanges();
+    void slotApplyPendingChangesDone(KJob*);
     void slotShowProperties();
     void slotShowContextMenu();
     void slotActivated(const QModelIndex &index);
     void slotToggleInfoPanel(bool);
+    void slotToggleFlatList(bool);
     void slotSaveAs();
     void updateActions();
     void updateQuickExtractMenu(QAction *extractAction);
@@ -163,6 +179,8 @@ private slots:
     void slotShowFind();
     void displayMsgWidget(KMessageWidget::MessageType type, const QString& msg);
     void searchEdited(const QString &text);
+    void slotSearchResultsReady(const QSet<const Kerfuffle::Archive::Entry*> &entries);
+    void slotSearchCleared();
 
 signals:
     void busy();
@@ -174,14 +192,31 @@ private:
     void loadArchive();
     void resetGui();
     void setupView();
+    void setViewModel(QAbstractItemModel *model);
     void setupActions();
     QString detectSubfolder() const;
     QVector<Kerfuffle::Archive::Entry*> filesForIndexes(const QModelIndexList& list) const;
     QVector<Kerfuffle::Archive::Entry*> filesAndRootNodesForIndexes(const QModelIndexList& list) const;
     QModelIndexList addChildren(const QModelIndexList &list) const;
     void registerJob(KJob *job);
+
+    /**
+     * Queue the following add, move, copy and delete jobs, if the archive supports it.
+     */
+    void beginTransaction();
+
+    /**
+     * Synchronously write the queued operations, once the running job is done.
+     * @return Whether the archive on disk is up-to-date.
+     */
+    bool applyPendingChanges();
     QModelIndexList getSelectedIndexes();
 
+    /**
+     * @return The index of the archive model shown by @p viewIndex, in the tree or in the flat list.
+     */
+    QModelIndex sourceIndex(const QModelIndex &viewIndex) const;
+
     ArchiveModel         *m_model;
     ArchiveView          *m_view;
     QAction *m_previewAction;
@@ -201,6 +236,7 @@ private:
     QAction *m_testArchiveAction;
     QAction *m_searchAction;
     KToggleAction *m_showInfoPanelAction;
+    KToggleAction *m_showFlatListAction;
     InfoPanel            *m_infoPanel;
     QSplitter            *m_splitter;
     QList<QTemporaryDir*>      m_tmpExtractDirList;
@@ -217,6 +253,7 @@ private:
     QVBoxLayout *m_vlayout;
     QSignalMapper *m_signalMapper;
     QFileSystemWatcher *m_fileWatcher;
+    QTimer *m_applyChangesTimer;
     QSplitter *m_commentSplitter;
     QGroupBox *m_commentBox;
     QPlainTextEdit *m_commentView;
@@ -224,8 +261,11 @@ private:
     KMessageWidget *m_messageWidget;
     Kerfuffle::CompressionOptions m_compressionOptions;
     ArchiveSortFilterModel *m_filterModel;
+    FlatEntryModel *m_flatModel;
     QWidget *m_searchWidget;
     QLineEdit *m_searchLineEdit;
+    QComboBox *m_searchTypeCombo;
+    SearchIndex *m_searchIndex;
     QPushButton *m_searchCloseButton;
 };
 
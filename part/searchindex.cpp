@@ -0,0 +1,369 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "searchindex.h"
+#include "archiveentry.h"
+#include "archivemodel.h"
+#include "ark_debug.h"
+#include "tracer.h"
+
+#include <QFutureWatcher>
+#include <QRegExp>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <iterator>
+
+using namespace Kerfuffle;
+
+namespace
+{
+
+// Added and removed entries are indexed once they stop changing.
+const int s_rebuildDelay = 500;
+
+quint64 trigram(const QString &text, int position)
+{
+    return (quint64(text.at(position).unicode()) << 32) |
+           (quint64(text.at(position + 1).unicode()) << 16) |
+           quint64(text.at(position + 2).unicode());
+}
+
+/**
+ * What the index needs from an entry, copied on the GUI thread.
+ * The pointers are only used as keys, so the entries may change or go away meanwhile.
+ */
+struct IndexedEntry
+{
+    const Archive::Entry *entry;
+    const Archive::Entry *parent;
+    QString fullPath;
+    bool isDir;
+};
+
+QVector<IndexedEntry> snapshotEntries(ArchiveModel *model)
+{
+    // Parent folders come before their entries, and folders which were not fetched are indexed too.
+    const QVector<const Archive::Entry*> entries = model->allEntries();
+
+    QVector<IndexedEntry> snapshot;
+    snapshot.reserve(entries.size());
+    foreach (const Archive::Entry *entry, entries) {
+        // The path is shared, not copied.
+        snapshot << IndexedEntry{entry, entry->getParent(), entry->fullPath(), entry->isDir()};
+    }
+    return snapshot;
+}
+
+QSharedPointer<const SearchIndex::Data> buildIndex(const QVector<IndexedEntry> &entries)
+{
+    ARK_TRACE_SCOPE("search-index", "search");
+
+    QSharedPointer<SearchIndex::Data> index(new SearchIndex::Data);
+    index->documents.reserve(entries.size());
+    QHash<const Archive::Entry*, int> ids;
+
+    foreach (const IndexedEntry &entry, entries) {
+        const int id = index->documents.size();
+
+        SearchIndex::Document document;
+        document.entry = entry.entry;
+        document.parent = ids.value(entry.parent, -1);
+        document.path = entry.fullPath.toCaseFolded();
+        if (document.path.endsWith(QLatin1Char('/'))) {
+            document.path.chop(1);
+        }
+        document.nameStart = document.path.lastIndexOf(QLatin1Char('/')) + 1;
+        if (entry.isDir) {
+            ids.insert(entry.entry, id);
+        }
+
+        // Documents are visited in order, so the posting lists stay sorted.
+        for (int i = 0; i + 2 < document.path.size(); ++i) {
+            QVector<int> &postings = index->trigrams[trigram(document.path, i)];
+            if (postings.isEmpty() || postings.last() != id) {
+                postings.append(id);
+            }
+        }
+
+        index->documents << document;
+    }
+
+    return index;
+}
+
+/**
+ * @return The literal parts of @p text that any matching path contains.
+ */
+QStringList literalFragments(const QString &text, SearchIndex::QueryType type)
+{
+    if (type == SearchIndex::Substring) {
+        return QStringList(text);
+    }
+    if (type == SearchIndex::RegularExpression) {
+        return QStringList();
+    }
+
+    QStringList fragments;
+    QString fragment;
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c == QLatin1Char('*') || c == QLatin1Char('?') || c == QLatin1Char('[') || c == QLatin1Char('\\')) {
+            fragments << fragment;
+            fragment.clear();
+            if (c == QLatin1Char('[')) {
+                const int end = text.indexOf(QLatin1Char(']'), i + 1);
+                i = (end < 0) ? text.size() : end;
+            }
+        } else {
+            fragment.append(c);
+        }
+    }
+    fragments << fragment;
+    return fragments;
+}
+
+SearchIndex::Result runQuery(const QSharedPointer<const SearchIndex::Data> &index, const SearchIndex::Query &query,
+                             const QVector<int> &candidates, bool narrowed)
+{
+    ARK_TRACE_SCOPE("search-query", "search");
+
+    SearchIndex::Result result;
+    result.index = index;
+
+    const QString foldedText = query.text.toCaseFolded();
+    const bool matchFullPath = query.text.contains(QLatin1Char('/'));
+
+    QRegExp wildcard;
+    QRegularExpression regExp;
+    if (query.type == SearchIndex::Wildcard) {
+        wildcard = QRegExp(foldedText, Qt::CaseInsensitive, QRegExp::Wildcard);
+    } else if (query.type == SearchIndex::RegularExpression) {
+        regExp = QRegularExpression(query.text, QRegularExpression::CaseInsensitiveOption);
+        if (!regExp.isValid()) {
+            qCDebug(ARK) << "Invalid regular expression:" << regExp.errorString();
+            return result;
+        }
+    }
+
+    // Narrow the candidates down to the documents containing every trigram of the literal parts.
+    QVector<int> selected = candidates;
+    bool useSelected = narrowed;
+    if (!narrowed) {
+        foreach (const QString &fragment, literalFragments(foldedText, query.type)) {
+            for (int i = 0; i + 2 < fragment.size(); ++i) {
+                const auto postings = index->trigrams.constFind(trigram(fragment, i));
+                if (postings == index->trigrams.constEnd()) {
+                    return result;
+                }
+                if (!useSelected) {
+                    selected = postings.value();
+                    useSelected = true;
+                } else {
+                    QVector<int> intersection;
+                    std::set_intersection(selected.constBegin(), selected.constEnd(),
+                                          postings.value().constBegin(), postings.value().constEnd(),
+                                          std::back_inserter(intersection));
+                    selected = intersection;
+                }
+                if (selected.isEmpty()) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    auto matches = [&](const SearchIndex::Document &document) -> bool {
+        const QStringRef target = matchFullPath ? QStringRef(&document.path) : document.path.midRef(document.nameStart);
+        switch (query.type) {
+        case SearchIndex::Substring:
+            return target.contains(foldedText);
+        case SearchIndex::Wildcard:
+            return wildcard.exactMatch(target.toString());
+        case SearchIndex::RegularExpression:
+            return regExp.match(target.toString()).hasMatch();
+        }
+        return false;
+    };
+
+    const int count = useSelected ? selected.size() : index->documents.size();
+    for (int i = 0; i < count; ++i) {
+        const int id = useSelected ? selected.at(i) : i;
+        if (matches(index->documents.at(id))) {
+            result.matches << id;
+        }
+    }
+
+    // The parent folders are shown as well, so that the matches can be reached in the tree.
+    result.acceptedEntries.reserve(result.matches.size());
+    foreach (int id, result.matches) {
+        for (int i = id; i >= 0; i = index->documents.at(i).parent) {
+            const Archive::Entry *entry = index->documents.at(i).entry;
+            if (result.acceptedEntries.contains(entry)) {
+                break;
+            }
+            result.acceptedEntries.insert(entry);
+        }
+    }
+
+    return result;
+}
+
+}
+
+SearchIndex::SearchIndex(ArchiveModel *model, QObject *parent)
+    : QObject(parent)
+    , m_model(model)
+    , m_rebuildTimer(new QTimer(this))
+    , m_buildWatcher(new QFutureWatcher<QSharedPointer<const Data> >(this))
+    , m_queryWatcher(new QFutureWatcher<Result>(this))
+    , m_queryPending(false)
+    , m_rebuildPending(false)
+{
+    m_query.type = Substring;
+    m_lastQuery.type = Substring;
+
+    m_rebuildTimer->setSingleShot(true);
+    m_rebuildTimer->setInterval(s_rebuildDelay);
+    connect(m_rebuildTimer, &QTimer::timeout, this, &SearchIndex::rebuild);
+
+    connect(m_buildWatcher, &QFutureWatcher<QSharedPointer<const Data> >::finished, this, &SearchIndex::slotIndexBuilt);
+    connect(m_queryWatcher, &QFutureWatcher<Result>::finished, this, &SearchIndex::slotQueryFinished);
+
+    // Entries are listed without notifying the views, and the model is reset once listing is complete.
+    connect(m_model, &QAbstractItemModel::modelReset, this, &SearchIndex::slotEntriesReset);
+    // Fetched folders were indexed already.
+    connect(m_model, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (!m_model->isFetching()) {
+            m_rebuildTimer->start();
+        }
+    });
+    connect(m_model, &QAbstractItemModel::rowsRemoved, m_rebuildTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+}
+
+SearchIndex::~SearchIndex()
+{
+    m_buildWatcher->waitForFinished();
+    m_queryWatcher->waitForFinished();
+}
+
+void SearchIndex::search(const QString &text, QueryType type)
+{
+    m_query.text = text;
+    m_query.type = type;
+
+    if (text.isEmpty()) {
+        m_queryPending = false;
+        emit searchCleared();
+        return;
+    }
+
+    startQuery();
+}
+
+bool SearchIndex::isBusy() const
+{
+    return m_buildWatcher->isRunning() || m_queryWatcher->isRunning() || m_queryPending;
+}
+
+void SearchIndex::slotEntriesReset()
+{
+    // The indexed entries might have been deleted.
+    m_index.clear();
+    m_lastResult = Result();
+    rebuild();
+}
+
+void SearchIndex::rebuild()
+{
+    m_rebuildTimer->stop();
+
+    if (m_buildWatcher->isRunning()) {
+        // The running build is outdated, another one starts once it finishes.
+        m_rebuildPending = true;
+        return;
+    }
+    m_rebuildPending = false;
+
+    m_buildWatcher->setFuture(QtConcurrent::run(buildIndex, snapshotEntries(m_model)));
+}
+
+void SearchIndex::slotIndexBuilt()
+{
+    if (m_rebuildPending) {
+        rebuild();
+        return;
+    }
+
+    m_index = m_buildWatcher->result();
+
+    // The document ids of the previous index are meaningless now.
+    m_lastResult = Result();
+
+    if (!m_query.text.isEmpty()) {
+        startQuery();
+    }
+}
+
+void SearchIndex::startQuery()
+{
+    if (!m_index) {
+        // The query runs once the index is built.
+        return;
+    }
+
+    if (m_queryWatcher->isRunning()) {
+        m_queryPending = true;
+        return;
+    }
+    m_queryPending = false;
+
+    // While typing, a longer substring only matches entries which matched the previous one.
+    const bool narrowed = m_lastResult.index == m_index &&
+                          m_query.type == Substring && m_lastQuery.type == Substring &&
+                          m_query.text.contains(QLatin1Char('/')) == m_lastQuery.text.contains(QLatin1Char('/')) &&
+                          m_query.text.contains(m_lastQuery.text, Qt::CaseInsensitive);
+
+    m_runningQuery = m_query;
+    m_queryWatcher->setFuture(QtConcurrent::run(runQuery, m_index, m_query,
+                                                narrowed ? m_lastResult.matches : QVector<int>(), narrowed));
+}
+
+void SearchIndex::slotQueryFinished()
+{
+    if (m_query.text.isEmpty()) {
+        return;
+    }
+
+    const Result result = m_queryWatcher->result();
+    if (m_queryPending || result.index != m_index) {
+        // The text or the entries changed meanwhile.
+        m_queryPending = false;
+        startQuery();
+        return;
+    }
+
+    m_lastQuery = m_runningQuery;
+    m_lastResult = result;
+    emit resultsReady(result.acceptedEntries);
+}
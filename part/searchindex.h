@@ -0,0 +1,131 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Copyright (C) 2017 The Ark developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include "archive_kerfuffle.h"
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+
+class ArchiveModel;
+class QTimer;
+
+template <typename T> class QFutureWatcher;
+
+/**
+ * Trigram index over the full paths of the entries of an ArchiveModel.
+ *
+ * The index is built in another thread from a snapshot of the entries once the archive
+ * has been listed, and rebuilt when entries are added or removed. Queries are answered in another thread too:
+ * only the newest one is reported, so typing in the search field never blocks.
+ *
+ * Queries without a slash match the entry names, the others match the full paths.
+ */
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum QueryType {
+        Substring,
+        Wildcard,
+        RegularExpression
+    };
+
+    struct Document
+    {
+        const Kerfuffle::Archive::Entry *entry;
+        int parent;         // Index of the parent folder's document, or -1.
+        QString path;       // Case-folded full path, without trailing slash.
+        int nameStart;
+    };
+
+    struct Data
+    {
+        QVector<Document> documents;
+        QHash<quint64, QVector<int> > trigrams;
+    };
+
+    struct Query
+    {
+        QString text;
+        QueryType type;
+    };
+
+    struct Result
+    {
+        QSharedPointer<const Data> index;
+        QVector<int> matches;
+        QSet<const Kerfuffle::Archive::Entry*> acceptedEntries;
+    };
+
+    explicit SearchIndex(ArchiveModel *model, QObject *parent = nullptr);
+    ~SearchIndex() override;
+
+    /**
+     * Searches for @p text among the entries. The result is reported by resultsReady().
+     * An empty text cancels the search and emits searchCleared() right away.
+     */
+    void search(const QString &text, QueryType type);
+
+    /**
+     * @return Whether the index or a query is being computed.
+     */
+    bool isBusy() const;
+
+signals:
+    /**
+     * @param entries The entries matching the current search, along with their parent folders.
+     */
+    void resultsReady(const QSet<const Kerfuffle::Archive::Entry*> &entries);
+    void searchCleared();
+
+private slots:
+    void slotEntriesReset();
+    void rebuild();
+    void slotIndexBuilt();
+    void slotQueryFinished();
+
+private:
+    void startQuery();
+
+    ArchiveModel *m_model;
+    QTimer *m_rebuildTimer;
+    QSharedPointer<const Data> m_index;
+    QFutureWatcher<QSharedPointer<const Data> > *m_buildWatcher;
+    QFutureWatcher<Result> *m_queryWatcher;
+
+    Query m_query;
+    Query m_runningQuery;
+    bool m_queryPending;
+    bool m_rebuildPending;
+
+    // The last reported query, whose matches can be narrowed down while typing.
+    Query m_lastQuery;
+    Result m_lastResult;
+};
+
+#endif // SEARCHINDEX_H
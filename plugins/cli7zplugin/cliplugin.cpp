@@ -50,6 +50,7 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList & args)
 
 CliPlugin::~CliPlugin()
 {
+    stopProcessThread();
 }
 
 void CliPlugin::resetParsing()
@@ -64,6 +65,7 @@ void CliPlugin::setupCliProperties()
     qCDebug(ARK) << "Setting up parameters...";
 
     m_cliProps->setProperty("captureProgress", false);
+    m_cliProps->setProperty("parallelExtraction", true);
 
     m_cliProps->setProperty("addProgram", QStringLiteral("7z"));
     m_cliProps->setProperty("addSwitch", QStringList{QStringLiteral("a"),
@@ -178,6 +180,10 @@ bool CliPlugin::readListLine(const QString& line)
                 qCWarning(ARK) << "Unsupported archive type";
                 return false;
             }
+        } else if (line == QLatin1String("Solid = +")) {
+            qCDebug(ARK) << "Solid archive detected";
+            setSolid(true);
+
         } else if (line.startsWith(QStringLiteral("Volumes = "))) {
             m_numberOfVolumes = line.section(QLatin1Char('='), 1).trimmed().toInt();
 
@@ -207,7 +213,7 @@ bool CliPlugin::readListLine(const QString& line)
 
         if (m_isFirstInformationEntry) {
             m_isFirstInformationEntry = false;
-            m_currentArchiveEntry = new Archive::Entry(this);
+            m_currentArchiveEntry = createEntry();
             m_currentArchiveEntry->compressedSizeIsSet = false;
         }
         if (line.startsWith(QStringLiteral("Path = "))) {
@@ -241,11 +247,11 @@ bool CliPlugin::readListLine(const QString& line)
                 }
             }
 
-            m_currentArchiveEntry->setProperty("permissions", attributes.mid(1));
+            m_currentArchiveEntry->setProperty("permissions", sharedString(attributes.mid(1)));
         } else if (line.startsWith(QStringLiteral("CRC = "))) {
             m_currentArchiveEntry->setProperty("CRC", line.mid(6).trimmed());
         } else if (line.startsWith(QStringLiteral("Method = "))) {
-            m_currentArchiveEntry->setProperty("method", line.mid(9).trimmed());
+            m_currentArchiveEntry->setProperty("method", sharedString(line.mid(9).trimmed()));
 
             // For zip archives we need to check method for each entry.
             if (m_archiveType == ArchiveTypeZip) {
@@ -260,10 +266,10 @@ bool CliPlugin::readListLine(const QString& line)
                    line.startsWith(QStringLiteral("Version = "))) {
             m_isFirstInformationEntry = true;
             if (!m_currentArchiveEntry->fullPath().isEmpty()) {
-                emit entry(m_currentArchiveEntry);
+                emitEntry(m_currentArchiveEntry);
             }
             else {
-                delete m_currentArchiveEntry;
+                discardEntry(m_currentArchiveEntry);
             }
             m_currentArchiveEntry = nullptr;
         }
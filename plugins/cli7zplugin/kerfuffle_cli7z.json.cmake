@@ -62,10 +62,12 @@
     "X-KDE-Kerfuffle-ReadOnlyExecutables": [
         "7z"
     ],
+    "X-KDE-Kerfuffle-ReadPriority": 170,
     "X-KDE-Kerfuffle-ReadWrite": true,
     "X-KDE-Kerfuffle-ReadWriteExecutables": [
         "7z"
     ],
+    "X-KDE-Kerfuffle-WritePriority": 180,
     "X-KDE-Priority": 180,
     "application/x-7z-compressed": {
         "CompressionLevelDefault": 5,
@@ -43,6 +43,7 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList &args)
 
 CliPlugin::~CliPlugin()
 {
+    stopProcessThread();
 }
 
 ParameterList CliPlugin::parameterList() const
@@ -127,7 +128,7 @@ bool CliPlugin::readListLine(const QString &line)
     }
 
     qCDebug(ARK) << m_entryFilename << " : " << fileprops;
-    Archive::Entry *e = new Archive::Entry();
+    Archive::Entry *e = createEntry();
     e->setProperty("fullPath", m_entryFilename);
     e->setProperty("size", fileprops[ 0 ]);
     e->setProperty("compressedSize", fileprops[ 1 ]);
@@ -141,7 +142,7 @@ bool CliPlugin::readListLine(const QString &line)
     e->setProperty("ssPasswordProtected", m_isPasswordProtected);
     qCDebug(ARK) << "Added entry: " << e;
 
-    emit entry(e);
+    emitEntry(e);
     m_isFirstLine = true;
     return true;
 }
@@ -40,7 +40,6 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList& args)
         , m_parseState(ParseStateTitle)
         , m_isUnrar5(false)
         , m_isPasswordProtected(false)
-        , m_isSolid(false)
         , m_isRAR5(false)
         , m_remainingIgnoreLines(1) //The first line of UNRAR output is empty.
         , m_linesComment(0)
@@ -55,6 +54,7 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList& args)
 
 CliPlugin::~CliPlugin()
 {
+    stopProcessThread();
 }
 
 void CliPlugin::resetParsing()
@@ -71,6 +71,7 @@ void CliPlugin::setupCliProperties()
     qCDebug(ARK) << "Setting up parameters...";
 
     m_cliProps->setProperty("captureProgress", true);
+    m_cliProps->setProperty("parallelExtraction", true);
 
     m_cliProps->setProperty("addProgram", QStringLiteral("rar"));
     m_cliProps->setProperty("addSwitch", QStringList({QStringLiteral("a")}));
@@ -215,8 +216,8 @@ bool CliPlugin::handleUnrar5Line(const QString &line)
                     qCDebug(ARK) << "Multi-volume archive detected";
                 }
             }
-            if (line.contains(QLatin1String("solid")) && !m_isSolid) {
-                m_isSolid = true;
+            if (line.contains(QLatin1String("solid")) && !isSolid()) {
+                setSolid(true);
                 qCDebug(ARK) << "Solid archive detected";
             }
             if (line.contains(QLatin1String("RAR 4"))) {
@@ -263,7 +264,7 @@ bool CliPlugin::handleUnrar5Line(const QString &line)
 
 void CliPlugin::handleUnrar5Entry()
 {
-    Archive::Entry *e = new Archive::Entry(this);
+    Archive::Entry *e = createEntry();
 
     QString compressionRatio = m_unrar5Details.value(QStringLiteral("ratio"));
     compressionRatio.chop(1); // Remove the '%'
@@ -283,12 +284,12 @@ void CliPlugin::handleUnrar5Entry()
     QString compression = m_unrar5Details.value(QStringLiteral("compression"));
     int optionPos = compression.indexOf(QLatin1Char('-'));
     if (optionPos != -1) {
-        e->setProperty("method", compression.mid(optionPos));
-        e->setProperty("version", compression.left(optionPos).trimmed());
+        e->setProperty("method", sharedString(compression.mid(optionPos)));
+        e->setProperty("version", sharedString(compression.left(optionPos).trimmed()));
     } else {
         // No method specified.
         e->setProperty("method", QStringLiteral(""));
-        e->setProperty("version", compression);
+        e->setProperty("version", sharedString(compression));
     }
 
     m_isPasswordProtected = m_unrar5Details.value(QStringLiteral("flags")).contains(QStringLiteral("encrypted"));
@@ -300,7 +301,7 @@ void CliPlugin::handleUnrar5Entry()
     e->setProperty("fullPath", m_unrar5Details.value(QStringLiteral("name")));
     e->setProperty("size", m_unrar5Details.value(QStringLiteral("size")));
     e->setProperty("compressedSize", m_unrar5Details.value(QStringLiteral("packed size")));
-    e->setProperty("permissions", m_unrar5Details.value(QStringLiteral("attributes")));
+    e->setProperty("permissions", sharedString(m_unrar5Details.value(QStringLiteral("attributes"))));
     e->setProperty("CRC", m_unrar5Details.value(QStringLiteral("crc32")));
 
     if (e->property("permissions").toString().startsWith(QLatin1Char('l'))) {
@@ -308,7 +309,7 @@ void CliPlugin::handleUnrar5Entry()
     }
 
     m_unrar5Details.clear();
-    emit entry(e);
+    emitEntry(e);
 }
 
 bool CliPlugin::handleUnrar4Line(const QString &line)
@@ -353,8 +354,8 @@ bool CliPlugin::handleUnrar4Line(const QString &line)
                     qCDebug(ARK) << "Multi-volume archive detected";
                 }
             }
-            if (line.startsWith(QLatin1String("Solid archive")) && !m_isSolid) {
-                m_isSolid = true;
+            if (line.startsWith(QLatin1String("Solid archive")) && !isSolid()) {
+                setSolid(true);
                 qCDebug(ARK) << "Solid archive detected";
             }
 
@@ -499,7 +500,7 @@ bool CliPlugin::handleUnrar4Line(const QString &line)
 
 void CliPlugin::handleUnrar4Entry()
 {
-    Archive::Entry *e = new Archive::Entry(this);
+    Archive::Entry *e = createEntry();
 
     QDateTime ts = QDateTime::fromString(QString(m_unrar4Details.at(4) + QLatin1Char(' ') + m_unrar4Details.at(5)),
                                          QStringLiteral("dd-MM-yy hh:mm"));
@@ -539,10 +540,10 @@ void CliPlugin::handleUnrar4Entry()
     e->setProperty("fullPath", m_unrar4Details.at(0));
     e->setProperty("size", m_unrar4Details.at(1));
     e->setProperty("compressedSize", m_unrar4Details.at(2));
-    e->setProperty("permissions", m_unrar4Details.at(6));
+    e->setProperty("permissions", sharedString(m_unrar4Details.at(6)));
     e->setProperty("CRC", m_unrar4Details.at(7));
-    e->setProperty("method", m_unrar4Details.at(8));
-    e->setProperty("version", m_unrar4Details.at(9));
+    e->setProperty("method", sharedString(m_unrar4Details.at(8)));
+    e->setProperty("version", sharedString(m_unrar4Details.at(9)));
     e->setProperty("isPasswordProtected", m_isPasswordProtected);
 
     if (e->property("permissions").toString().startsWith(QLatin1Char('l'))) {
@@ -550,7 +551,7 @@ void CliPlugin::handleUnrar4Entry()
     }
 
     m_unrar4Details.clear();
-    emit entry(e);
+    emitEntry(e);
 }
 
 bool CliPlugin::readExtractLine(const QString &line)
@@ -65,7 +65,6 @@ private:
     QString m_unrarVersion;
     bool m_isUnrar5;
     bool m_isPasswordProtected;
-    bool m_isSolid;
     bool m_isRAR5;
 
     int m_remainingIgnoreLines;
@@ -62,10 +62,12 @@
     "X-KDE-Kerfuffle-ReadOnlyExecutables": [
         "unrar"
     ],
+    "X-KDE-Kerfuffle-ReadPriority": 120,
     "X-KDE-Kerfuffle-ReadWrite": true,
     "X-KDE-Kerfuffle-ReadWriteExecutables": [
         "rar"
     ],
+    "X-KDE-Kerfuffle-WritePriority": 120,
     "X-KDE-Priority": 120,
     "application/vnd.rar": {
         "CompressionLevelDefault": 3,
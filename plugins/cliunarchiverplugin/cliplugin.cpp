@@ -44,6 +44,7 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList &args)
 
 CliPlugin::~CliPlugin()
 {
+    stopProcessThread();
 }
 
 bool CliPlugin::list()
@@ -156,8 +157,7 @@ bool CliPlugin::handleLine(const QString& line)
             qCDebug(ARK) << "Detected header-encrypted RAR archive";
 
             Kerfuffle::PasswordNeededQuery query(filename());
-            emit userQuery(&query);
-            query.waitForResponse();
+            executeQuery(&query);
 
             if (query.responseCancelled()) {
                 emit cancelled();
@@ -166,8 +166,8 @@ bool CliPlugin::handleLine(const QString& line)
                 return true;
             }
 
+            // The archive is listed again by processFinished(), from the GUI thread.
             setPassword(query.password());
-            CliPlugin::list();
         }
     }
 
@@ -179,10 +179,8 @@ void CliPlugin::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
     qCDebug(ARK) << "Process finished, exitcode:" << exitCode << "exitstatus:" << exitStatus;
 
     if (m_process) {
-        //handle all the remaining data in the process
-        readStdout(true);
-
-        delete m_process;
+        // The remaining data was handled in the thread of the process.
+        m_process->deleteLater();
         m_process = nullptr;
     }
 
@@ -208,6 +206,9 @@ void CliPlugin::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
     // At this point we are asking a password to the user and we are going to list() again after we get one.
     // This means that we cannot emit finished here.
     if (exitCode == 2) {
+        if (!password().isEmpty()) {
+            list();
+        }
         return;
     }
 
@@ -245,7 +246,7 @@ void CliPlugin::readJsonOutput()
     foreach (const QJsonValue& value, entries) {
         const QJsonObject currentEntryJson = value.toObject();
 
-        Archive::Entry *currentEntry = new Archive::Entry(this);
+        Archive::Entry *currentEntry = createEntry();
 
         QString filename = currentEntryJson.value(QStringLiteral("XADFileName")).toString();
 
@@ -269,7 +270,7 @@ void CliPlugin::readJsonOutput()
         }
         // TODO: missing fields
 
-        emit entry(currentEntry);
+        emitEntry(currentEntry);
     }
 }
 
@@ -47,6 +47,7 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList & args)
 
 CliPlugin::~CliPlugin()
 {
+    stopProcessThread();
 }
 
 void CliPlugin::resetParsing()
@@ -84,6 +85,7 @@ void CliPlugin::setupCliProperties()
     qCDebug(ARK) << "Setting up parameters...";
 
     m_cliProps->setProperty("captureProgress", false);
+    m_cliProps->setProperty("parallelExtraction", true);
 
     m_cliProps->setProperty("addProgram", QStringLiteral("zip"));
     m_cliProps->setProperty("addSwitch", QStringList({QStringLiteral("-r")}));
@@ -157,8 +159,8 @@ bool CliPlugin::readListLine(const QString &line)
     case ParseStateEntry:
         QRegularExpressionMatch rxMatch = entryPattern.match(line);
         if (rxMatch.hasMatch()) {
-            Archive::Entry *e = new Archive::Entry(this);
-            e->setProperty("permissions", rxMatch.captured(1));
+            Archive::Entry *e = createEntry();
+            e->setProperty("permissions", sharedString(rxMatch.captured(1)));
 
             // #280354: infozip may not show the right attributes for a given directory, so an entry
             //          ending with '/' is actually more reliable than 'd' bein in the attributes.
@@ -170,7 +172,7 @@ bool CliPlugin::readListLine(const QString &line)
                 e->setProperty("isPasswordProtected", true);
             }
             e->setProperty("compressedSize", rxMatch.captured(6).toInt());
-            e->setProperty("method", rxMatch.captured(7));
+            e->setProperty("method", sharedString(rxMatch.captured(7)));
 
             QString method = convertCompressionMethod(rxMatch.captured(7));
             emit compressionMethodFound(method);
@@ -180,7 +182,7 @@ bool CliPlugin::readListLine(const QString &line)
             e->setProperty("timestamp", ts);
 
             e->setProperty("fullPath", rxMatch.captured(10));
-            emit entry(e);
+            emitEntry(e);
         }
         break;
     }
@@ -300,7 +302,7 @@ bool CliPlugin::setMovingAddedFiles()
 void CliPlugin::finishMoving(bool result)
 {
     disconnect(this, &CliPlugin::finished, this, &CliPlugin::continueMoving);
-    emit progress(1.0);
+    setProcessedFraction(1.0);
     emit finished(result);
     cleanUp();
 }
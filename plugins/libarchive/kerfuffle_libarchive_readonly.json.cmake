@@ -59,6 +59,13 @@
         ],
         "Version": "@KDE_APPLICATIONS_VERSION@"
     },
+    "X-KDE-Kerfuffle-ReadPriority": 200,
     "X-KDE-Kerfuffle-ReadWrite": false,
+    "X-KDE-Kerfuffle-SplitVolumeMimeTypes": [
+        "application/zip",
+        "application/x-7z-compressed",
+        "application/vnd.rar",
+        "application/x-rar"
+    ],
     "X-KDE-Priority": 100
 }
@@ -29,20 +29,154 @@
 #include "libarchiveplugin.h"
 #include "ark_debug.h"
 #include "queries.h"
+#include "tracer.h"
 
 #include <KLocalizedString>
 
 #include <QDirIterator>
+#include <QHash>
+#include <QRegularExpression>
+#include <QSet>
 #include <QThread>
 
 #include <archive_entry.h>
 
+namespace
+{
+
+// Little-endian integers and RAR 5 variable-length integers of the headers.
+quint64 readInteger(const QByteArray &data, int position, int size)
+{
+    quint64 value = 0;
+    for (int i = size - 1; i >= 0; --i) {
+        value = (value << 8) | static_cast<uchar>(data.at(position + i));
+    }
+    return value;
+}
+
+bool readVariableInteger(const QByteArray &data, int *position, quint64 *value)
+{
+    *value = 0;
+    for (int shift = 0; *position < data.size() && shift < 64; shift += 7) {
+        const uchar byte = static_cast<uchar>(data.at((*position)++));
+        *value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return Whether the headers of the rar archive @p fileName, which come before the first file, include a comment.
+ */
+bool hasRarComment(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray signature = file.read(8);
+    const bool isRar5 = signature == QByteArray("Rar!\x1a\x07\x01\x00", 8);
+    if (!isRar5 && !signature.startsWith(QByteArray("Rar!\x1a\x07\x00", 7))) {
+        return false;
+    }
+
+    qint64 position = isRar5 ? 8 : 7;
+    for (int block = 0; block < 16 && file.seek(position); ++block) {
+        if (isRar5) {
+            // CRC32, header size, type, flags, [extra area size], [data size], then the type-specific fields.
+            QByteArray header = file.read(7);
+            int offset = 4;
+            quint64 headerSize;
+            if (!readVariableInteger(header, &offset, &headerSize) || headerSize > 0x10000) {
+                return false;
+            }
+            file.seek(position);
+            header = file.read(offset + headerSize);
+            if (header.size() != offset + int(headerSize)) {
+                return false;
+            }
+
+            quint64 type, flags, value, dataSize = 0;
+            if (!readVariableInteger(header, &offset, &type) || !readVariableInteger(header, &offset, &flags) ||
+                ((flags & 0x1) && !readVariableInteger(header, &offset, &value)) ||
+                ((flags & 0x2) && !readVariableInteger(header, &offset, &dataSize))) {
+                return false;
+            }
+
+            if (type == 3) {
+                // Service header: file flags, unpacked size, attributes, [mtime], [CRC32], compression, host OS, name.
+                quint64 fileFlags, nameSize;
+                if (!readVariableInteger(header, &offset, &fileFlags) || !readVariableInteger(header, &offset, &value) ||
+                    !readVariableInteger(header, &offset, &value)) {
+                    return false;
+                }
+                offset += ((fileFlags & 0x2) ? 4 : 0) + ((fileFlags & 0x4) ? 4 : 0);
+                if (!readVariableInteger(header, &offset, &value) || !readVariableInteger(header, &offset, &value) ||
+                    !readVariableInteger(header, &offset, &nameSize)) {
+                    return false;
+                }
+                if (header.mid(offset, nameSize) == "CMT") {
+                    return true;
+                }
+            } else if (type != 1) {
+                // Files, the end of the archive, or encrypted headers.
+                return false;
+            }
+
+            position += header.size() + dataSize;
+        } else {
+            // CRC16, type, flags, header size, [data size].
+            const QByteArray header = file.read(32);
+            if (header.size() < 7) {
+                return false;
+            }
+            const uchar type = static_cast<uchar>(header.at(2));
+            const quint64 flags = readInteger(header, 3, 2);
+            const quint64 headerSize = readInteger(header, 5, 2);
+            const quint64 dataSize = (flags & 0x8000) && header.size() >= 11 ? readInteger(header, 7, 4) : 0;
+            if (headerSize < 7) {
+                return false;
+            }
+
+            if (type == 0x73) {
+                // Main header, with the comment flag of the old versions.
+                if (flags & 0x0002) {
+                    return true;
+                }
+            } else if (type == 0x75) {
+                // Old comment header.
+                return true;
+            } else if (type == 0x7a && header.size() == 32) {
+                // Service header, laid out like a file header.
+                const int nameSize = readInteger(header, 26, 2);
+                const int nameOffset = (flags & 0x100) ? 40 : 32;
+                file.seek(position + nameOffset);
+                if (file.read(nameSize) == "CMT") {
+                    return true;
+                }
+            } else {
+                return false;
+            }
+
+            position += headerSize + dataSize;
+        }
+    }
+
+    return false;
+}
+
+}
+
 LibarchivePlugin::LibarchivePlugin(QObject *parent, const QVariantList &args)
     : ReadWriteArchiveInterface(parent, args)
     , m_archiveReadDisk(archive_read_disk_new())
     , m_cachedArchiveEntryCount(0)
     , m_emitNoEntries(false)
     , m_extractedFilesSize(0)
+    , m_volumesSize(0)
 {
     qCDebug(ARK) << "Initializing libarchive plugin";
     archive_read_disk_set_standard_lookup(m_archiveReadDisk.data());
@@ -50,10 +184,6 @@ LibarchivePlugin::LibarchivePlugin(QObject *parent, const QVariantList &args)
 
 LibarchivePlugin::~LibarchivePlugin()
 {
-    foreach (const auto e, m_emittedEntries) {
-        // Entries might be passed to pending slots, so we just schedule their deletion.
-        e->deleteLater();
-    }
 }
 
 bool LibarchivePlugin::list()
@@ -73,26 +203,40 @@ bool LibarchivePlugin::list()
     m_cachedArchiveEntryCount = 0;
     m_extractedFilesSize = 0;
     m_numberOfEntries = 0;
-    auto compressedArchiveSize = QFileInfo(filename()).size();
+    m_hardLinks.clear();
+    // The bytes read by libarchive are counted across all the volumes.
+    setProcessedBytes(0);
+    setTotalBytes(m_volumesSize);
 
     struct archive_entry *aentry;
     int result = ARCHIVE_RETRY;
 
     bool firstEntry = true;
     while (!QThread::currentThread()->isInterruptionRequested() && (result = archive_read_next_header(m_archiveReader.data(), &aentry)) == ARCHIVE_OK) {
+        ARK_TRACE_SCOPE("list-entry", "libarchive");
 
         if (firstEntry) {
             qDebug(ARK) << "Detected format for first entry:" << archive_format_name(m_archiveReader.data());
             firstEntry = false;
         }
 
-        if (!m_emitNoEntries) {
+        if (isStatisticsOnlyListing()) {
+            addEntryStatistics(entryPath(aentry),
+                               S_ISDIR(archive_entry_mode(aentry)),
+                               (qlonglong)archive_entry_size(aentry),
+                               archive_entry_is_encrypted(aentry));
+        } else if (!m_emitNoEntries) {
             emitEntryFromArchiveEntry(aentry);
         }
 
+        const char *hardLink = archive_entry_hardlink(aentry);
+        if (hardLink) {
+            m_hardLinks[QFile::decodeName(hardLink)] << QFile::decodeName(archive_entry_pathname(aentry));
+        }
+
         m_extractedFilesSize += (qlonglong)archive_entry_size(aentry);
 
-        emit progress(float(archive_filter_bytes(m_archiveReader.data(), -1))/float(compressedArchiveSize));
+        setProcessedBytes(archive_filter_bytes(m_archiveReader.data(), -1));
 
         m_cachedArchiveEntryCount++;
         archive_read_data_skip(m_archiveReader.data());
@@ -170,8 +314,15 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
     // To avoid traversing the entire archive when extracting a limited set of
     // entries, we maintain a list of remaining entries and stop when it's
     // empty.
-    QStringList fullPaths = entryFullPaths(files);
-    QStringList remainingFiles = entryFullPaths(files);
+    const QStringList fullPaths = entryFullPaths(files);
+    QSet<QString> remainingFiles = fullPaths.toSet();
+
+    // Large selections contain whole subtrees, so look the entries up by path.
+    QHash<QString, int> fileIndexes;
+    fileIndexes.reserve(fullPaths.size());
+    for (int i = fullPaths.size() - 1; i >= 0; --i) {
+        fileIndexes.insert(fullPaths.at(i), i);
+    }
 
     if (!initializeReader()) {
         return false;
@@ -209,14 +360,39 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
     bool overwriteAll = false; // Whether to overwrite all files
     bool skipAll = false; // Whether to skip all files
     bool dontPromptErrors = false; // Whether to prompt for errors
-    m_currentExtractedFilesSize = 0;
     int no_entries = 0;
 
+    if (extractAll) {
+        // copyData() will update the processed bytes.
+        setProcessedBytes(0);
+        setTotalBytes(m_extractedFilesSize);
+    }
+
+    // Hard links only name the entry holding their data. When that entry is not selected,
+    // it is extracted as the first selected link instead.
+    QHash<QString, QString> linksWithData;
+    if (!extractAll) {
+        for (auto it = m_hardLinks.constBegin(); it != m_hardLinks.constEnd(); ++it) {
+            if (remainingFiles.contains(it.key())) {
+                continue;
+            }
+            foreach (const QString &link, it.value()) {
+                if (remainingFiles.contains(link)) {
+                    linksWithData.insert(it.key(), link);
+                    break;
+                }
+            }
+        }
+    }
+    // Extracted link targets -> the paths they were written to, which the links must point to.
+    QHash<QString, QString> extractedTargets;
+
     struct archive_entry *entry;
     QString fileBeingRenamed;
 
     // Iterate through all entries in archive.
     while (!QThread::currentThread()->isInterruptionRequested() && (archive_read_next_header(m_archiveReader.data(), &entry) == ARCHIVE_OK)) {
+        ARK_TRACE_SCOPE("extract-entry", "libarchive");
 
         if (!extractAll && remainingFiles.isEmpty()) {
             break;
@@ -225,6 +401,12 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
         fileBeingRenamed.clear();
         int index = -1;
 
+        const QString archivePath = QFile::decodeName(archive_entry_pathname(entry));
+        const auto linkWithData = linksWithData.constFind(archivePath);
+        if (linkWithData != linksWithData.constEnd()) {
+            archive_entry_copy_pathname(entry, QFile::encodeName(linkWithData.value()).constData());
+        }
+
         // Retry with renamed entry, fire an overwrite query again
         // if the new entry also exists.
     retry:
@@ -267,12 +449,21 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
 
             // Find the index of entry.
             if (entryName != fileBeingRenamed) {
-                index = fullPaths.indexOf(entryName);
+                index = fileIndexes.value(entryName, -1);
             }
             if (!extractAll && index == -1) {
                 // If entry is not found in files, skip entry.
                 continue;
             }
+            const QString selectedName = entryName;
+
+            const char *hardLink = archive_entry_hardlink(entry);
+            if (hardLink) {
+                const auto target = extractedTargets.constFind(QFile::decodeName(hardLink));
+                if (target != extractedTargets.constEnd()) {
+                    archive_entry_copy_hardlink(entry, QFile::encodeName(target.value()).constData());
+                }
+            }
 
             // entryFI is the fileinfo pointing to where the file will be
             // written from the archive.
@@ -356,6 +547,9 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
                 // If the whole archive is extracted and the total filesize is
                 // available, we use partial progress.
                 copyData(entryName, m_archiveReader.data(), writer.data(), (extractAll && m_extractedFilesSize));
+                if (m_hardLinks.contains(archivePath)) {
+                    extractedTargets.insert(archivePath, QFile::decodeName(archive_entry_pathname(entry)));
+                }
                 break;
 
             case ARCHIVE_FAILED:
@@ -396,11 +590,12 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
             // number of items extracted.
             if (!extractAll && m_cachedArchiveEntryCount) {
                 ++entryNr;
-                emit progress(float(entryNr) / totalCount);
+                setProcessedFraction(float(entryNr) / totalCount);
             }
             no_entries++;
+            addProcessedEntries();
 
-            remainingFiles.removeOne(entryName);
+            remainingFiles.remove(selectedName);
 
         } else {
 
@@ -418,6 +613,8 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
 
 bool LibarchivePlugin::initializeReader()
 {
+    ARK_TRACE_SCOPE("open", "libarchive");
+
     m_archiveReader.reset(archive_read_new());
 
     if (!(m_archiveReader.data())) {
@@ -425,15 +622,19 @@ bool LibarchivePlugin::initializeReader()
         return false;
     }
 
-    if (archive_read_support_filter_all(m_archiveReader.data()) != ARCHIVE_OK) {
-        return false;
+    const QStringList volumes = volumeFileNames();
+    m_volumesSize = 0;
+    foreach (const QString &volume, volumes) {
+        m_volumesSize += QFileInfo(volume).size();
     }
 
-    if (archive_read_support_format_all(m_archiveReader.data()) != ARCHIVE_OK) {
-        return false;
+    if (volumes.size() > 1) {
+        qCDebug(ARK) << "Reading" << volumes.size() << "volumes";
+        setMultiVolume(true);
+        m_numberOfVolumes = volumes.size();
     }
 
-    if (archive_read_open_filename(m_archiveReader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    if (!openReader(m_archiveReader.data(), volumes)) {
         qCWarning(ARK) << "Could not open the archive:" << archive_error_string(m_archiveReader.data());
         emit error(i18nc("@info", "Archive corrupted or insufficient permissions."));
         return false;
@@ -442,39 +643,151 @@ bool LibarchivePlugin::initializeReader()
     return true;
 }
 
-void LibarchivePlugin::emitEntryFromArchiveEntry(struct archive_entry *aentry)
+bool LibarchivePlugin::openReader(struct archive *reader, const QStringList &volumes)
 {
-    auto e = new Archive::Entry();
+    if (archive_read_support_filter_all(reader) != ARCHIVE_OK ||
+        archive_read_support_format_all(reader) != ARCHIVE_OK) {
+        return false;
+    }
+
+    if (volumes.size() == 1) {
+        return archive_read_open_filename(reader, QFile::encodeName(volumes.first()), 10240) == ARCHIVE_OK;
+    }
 
+    // libarchive copies the names, and goes on with the next volume once the previous one is exhausted.
+    QList<QByteArray> encodedVolumes;
+    QVector<const char*> volumeNames;
+    foreach (const QString &volume, volumes) {
+        encodedVolumes << QFile::encodeName(volume);
+        volumeNames << encodedVolumes.last().constData();
+    }
+    volumeNames << nullptr;
+
+    return archive_read_open_filenames(reader, volumeNames.data(), 10240) == ARCHIVE_OK;
+}
+
+bool LibarchivePlugin::canReadArchive()
+{
+    ARK_TRACE_SCOPE("probe", "libarchive");
+
+    const QStringList volumes = volumeFileNames();
+    ArchiveRead reader(archive_read_new());
+    if (!reader.data() || !openReader(reader.data(), volumes)) {
+        return false;
+    }
+
+    // Headers libarchive cannot read (e.g. encrypted 7z headers or newer RAR versions) fail here.
+    struct archive_entry *aentry;
+    const int result = archive_read_next_header(reader.data(), &aentry);
+    if (result == ARCHIVE_EOF) {
+        return true;
+    }
+    if (result != ARCHIVE_OK) {
+        qCDebug(ARK) << "Cannot read the first header:" << archive_error_string(reader.data());
+        return false;
+    }
+
+    // There is no way to ask for a password, and the encrypted 7z and rar entries cannot be read anyway.
+    if (archive_entry_is_encrypted(aentry) || archive_read_has_encrypted_entries(reader.data()) > 0) {
+        qCDebug(ARK) << "The archive is encrypted";
+        return false;
+    }
+
+    // libarchive skips the comments of rar archives.
+    const int format = archive_format(reader.data()) & ARCHIVE_FORMAT_BASE_MASK;
+#ifdef ARCHIVE_FORMAT_RAR_V5
+    if (format == ARCHIVE_FORMAT_RAR || format == ARCHIVE_FORMAT_RAR_V5) {
+#else
+    if (format == ARCHIVE_FORMAT_RAR) {
+#endif
+        if (hasRarComment(volumes.first())) {
+            qCDebug(ARK) << "The archive has a comment";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QStringList LibarchivePlugin::volumeFileNames() const
+{
+    const QString fileName = filename();
+
+    // Split archives are named name.ext.001, name.ext.002... and RAR volumes name.part1.rar, name.part2.rar...
+    static const QRegularExpression splitVolume(QStringLiteral("^(.*\\.)(\\d{3,})()$"));
+    static const QRegularExpression rarVolume(QStringLiteral("^(.*\\.part)(\\d+)(\\.rar)$"), QRegularExpression::CaseInsensitiveOption);
+
+    QRegularExpressionMatch match = splitVolume.match(fileName);
+    if (!match.hasMatch()) {
+        match = rarVolume.match(fileName);
+        if (!match.hasMatch()) {
+            return QStringList(fileName);
+        }
+    }
+
+    const QString prefix = match.captured(1);
+    const int digits = match.capturedLength(2);
+    const QString suffix = match.captured(3);
+
+    // The volumes are read from the first one, whichever was opened.
+    QStringList volumes;
+    for (int number = 1; ; ++number) {
+        const QString volume = prefix + QStringLiteral("%1").arg(number, digits, 10, QLatin1Char('0')) + suffix;
+        if (!QFileInfo::exists(volume)) {
+            break;
+        }
+        volumes << volume;
+    }
+
+    if (!volumes.contains(fileName)) {
+        return QStringList(fileName);
+    }
+
+    return volumes;
+}
+
+QString LibarchivePlugin::entryPath(struct archive_entry *aentry)
+{
 #ifdef Q_OS_WIN
-    e->setProperty("fullPath", QDir::fromNativeSeparators(QString::fromUtf16((ushort*)archive_entry_pathname_w(aentry))));
+    return QDir::fromNativeSeparators(QString::fromUtf16((ushort*)archive_entry_pathname_w(aentry)));
 #else
-    e->setProperty("fullPath", QDir::fromNativeSeparators(QString::fromWCharArray(archive_entry_pathname_w(aentry))));
+    return QDir::fromNativeSeparators(QString::fromWCharArray(archive_entry_pathname_w(aentry)));
 #endif
+}
+
+void LibarchivePlugin::emitEntryFromArchiveEntry(struct archive_entry *aentry)
+{
+    auto e = createEntry();
+    e->setProperty("fullPath", entryPath(aentry));
 
-    const QString owner = QString::fromLatin1(archive_entry_uname(aentry));
-    if (!owner.isEmpty()) {
-        e->setProperty("owner", owner);
+    // This is called for every entry that is rewritten, so avoid building strings for missing fields.
+    const char *owner = archive_entry_uname(aentry);
+    if (owner && *owner) {
+        e->setProperty("owner", sharedString(QString::fromLatin1(owner)));
     }
 
-    const QString group = QString::fromLatin1(archive_entry_gname(aentry));
-    if (!group.isEmpty()) {
-        e->setProperty("group", group);
+    const char *group = archive_entry_gname(aentry);
+    if (group && *group) {
+        e->setProperty("group", sharedString(QString::fromLatin1(group)));
     }
 
     e->compressedSizeIsSet = false;
     e->setProperty("size", (qlonglong)archive_entry_size(aentry));
     e->setProperty("isDirectory", S_ISDIR(archive_entry_mode(aentry)));
 
-    if (archive_entry_symlink(aentry)) {
-        e->setProperty("link", QLatin1String( archive_entry_symlink(aentry) ));
+    if (archive_entry_is_encrypted(aentry)) {
+        e->setProperty("isPasswordProtected", true);
+    }
+
+    const char *link = archive_entry_symlink(aentry);
+    if (link) {
+        e->setProperty("link", QLatin1String(link));
     }
 
     auto time = static_cast<uint>(archive_entry_mtime(aentry));
     e->setProperty("timestamp", QDateTime::fromTime_t(time));
 
     emit entry(e);
-    m_emittedEntries << e;
 }
 
 int LibarchivePlugin::extractionFlags() const
@@ -498,6 +811,7 @@ int LibarchivePlugin::extractionFlags() const
 
 void LibarchivePlugin::copyData(const QString& filename, struct archive *dest, bool partialprogress)
 {
+    ARK_TRACE_SCOPE("write-data", "libarchive");
     char buff[10240];
     QFile file(filename);
 
@@ -515,8 +829,7 @@ void LibarchivePlugin::copyData(const QString& filename, struct archive *dest, b
         }
 
         if (partialprogress) {
-            m_currentExtractedFilesSize += readBytes;
-            emit progress(float(m_currentExtractedFilesSize) / m_extractedFilesSize);
+            addProcessedBytes(readBytes);
         }
 
         readBytes = file.read(buff, sizeof(buff));
@@ -527,6 +840,7 @@ void LibarchivePlugin::copyData(const QString& filename, struct archive *dest, b
 
 void LibarchivePlugin::copyData(const QString& filename, struct archive *source, struct archive *dest, bool partialprogress)
 {
+    ARK_TRACE_SCOPE("decode-data", "libarchive");
     char buff[10240];
 
     auto readBytes = archive_read_data(source, buff, sizeof(buff));
@@ -539,8 +853,7 @@ void LibarchivePlugin::copyData(const QString& filename, struct archive *source,
         }
 
         if (partialprogress) {
-            m_currentExtractedFilesSize += readBytes;
-            emit progress(float(m_currentExtractedFilesSize) / m_extractedFilesSize);
+            addProcessedBytes(readBytes);
         }
 
         readBytes = archive_read_data(source, buff, sizeof(buff));
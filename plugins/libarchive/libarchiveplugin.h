@@ -32,7 +32,9 @@
 
 #include <archive.h>
 
+#include <QHash>
 #include <QScopedPointer>
+#include <QStringList>
 
 using namespace Kerfuffle;
 
@@ -55,6 +57,7 @@ public:
     bool addComment(const QString &comment) override;
     bool testArchive() override;
     bool hasBatchExtractionProgress() const override;
+    bool canReadArchive() override;
 
 protected:
     struct ArchiveReadCustomDeleter
@@ -81,6 +84,17 @@ protected:
     typedef QScopedPointer<struct archive, ArchiveWriteCustomDeleter> ArchiveWrite;
 
     bool initializeReader();
+
+    /**
+     * Open @p reader on @p volumes, with all the formats and filters enabled.
+     */
+    static bool openReader(struct archive *reader, const QStringList &volumes);
+
+    /**
+     * @return The volumes of a split archive in order, or only the archive itself.
+     */
+    QStringList volumeFileNames() const;
+    static QString entryPath(struct archive_entry *entry);
     void emitEntryFromArchiveEntry(struct archive_entry *entry);
     void copyData(const QString& filename, struct archive *dest, bool partialprogress = true);
     void copyData(const QString& filename, struct archive *source, struct archive *dest, bool partialprogress = true);
@@ -88,15 +102,17 @@ protected:
     ArchiveRead m_archiveReader;
     ArchiveRead m_archiveReadDisk;
 
+    // Entry holding the data of hard links -> the links to it, in the order of the archive.
+    QHash<QString, QStringList> m_hardLinks;
+
 private:
     int extractionFlags() const;
     QString convertCompressionName(const QString &method);
 
     int m_cachedArchiveEntryCount;
-    qlonglong m_currentExtractedFilesSize;
     bool m_emitNoEntries;
     qlonglong m_extractedFilesSize;
-    QVector<Archive::Entry*> m_emittedEntries;
+    qlonglong m_volumesSize;
 };
 
 #endif // LIBARCHIVEPLUGIN_H
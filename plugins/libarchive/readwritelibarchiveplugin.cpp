@@ -32,8 +32,11 @@
 #include <KLocalizedString>
 #include <KPluginFactory>
 
-#include <QDirIterator>
+#include <QCryptographicHash>
+#include <QHash>
 #include <QSaveFile>
+#include <QSet>
+#include <QTemporaryFile>
 #include <QThread>
 
 #include <archive_entry.h>
@@ -54,10 +57,22 @@ bool ReadWriteLibarchivePlugin::addFiles(const QVector<Archive::Entry*> &files,
 {
     qCDebug(ARK) << "Adding" << files.size() << "entries with CompressionOptions" << options;
 
+    const FileManifest scannedFiles = takeScannedFiles(files);
+
     const bool creatingNewFile = !QFileInfo::exists(filename());
+    if (isInTransaction() && !creatingNewFile) {
+        queueAddFiles(scannedFiles, destination);
+        return true;
+    }
+
     const uint totalCount = m_numberOfEntries + numberOfEntriesToAdd;
 
     m_writtenFiles.clear();
+    m_writtenContents.clear();
+    m_deduplicateFiles = options.deduplicateFiles();
+    m_updateMode = options.updateMode();
+    m_updatedFiles.clear();
+    m_storedFiles.clear();
 
     if (!creatingNewFile && !initializeReader()) {
         return false;
@@ -67,62 +82,57 @@ bool ReadWriteLibarchivePlugin::addFiles(const QVector<Archive::Entry*> &files,
         return false;
     }
 
-    // First write the new files.
-    qCDebug(ARK) << "Writing new entries";
     uint no_entries = 0;
     // Recreate destination directory structure.
     const QString destinationPath = (destination == nullptr)
                                     ? QString()
                                     : destination->fullPath();
 
-    foreach(Archive::Entry *selectedFile, files) {
-        if (QThread::currentThread()->isInterruptionRequested()) {
-            break;
+    // When only changed files are written, the old entries are copied first: their headers tell
+    // which files changed, so the archive is read only once.
+    if (!creatingNewFile && m_updateMode != CompressionOptions::AddAllFiles) {
+        foreach (const FileScanner::ScannedFile &file, scannedFiles) {
+            QString path = destinationPath + file.path;
+            if (path.endsWith(QLatin1Char('/'))) {
+                path.chop(1);
+            }
+            m_updatedFiles.insert(path, file);
         }
 
-        if (!writeFile(selectedFile->fullPath(), destinationPath)) {
+        qCDebug(ARK) << "Copying the old entries which are kept";
+        m_filesPaths.clear();
+        if (!processOldEntries(no_entries, Add, totalCount)) {
+            qCDebug(ARK) << "Adding entries failed";
             finish(false);
             return false;
         }
-        no_entries++;
-        emit progress(float(no_entries)/float(totalCount));
-
-        // For directories, write all subfiles/folders.
-        const QString &fullPath = selectedFile->fullPath();
-        if (QFileInfo(fullPath).isDir()) {
-            QDirIterator it(fullPath,
-                            QDir::AllEntries | QDir::Readable |
-                            QDir::Hidden | QDir::NoDotAndDotDot,
-                            QDirIterator::Subdirectories);
-
-            while (!QThread::currentThread()->isInterruptionRequested() && it.hasNext()) {
-                QString path = it.next();
-
-                if ((it.fileName() == QLatin1String("..")) ||
-                    (it.fileName() == QLatin1String("."))) {
-                    continue;
-                }
+        qCDebug(ARK) << "Kept" << no_entries << "old entries";
+    }
 
-                const bool isRealDir = it.fileInfo().isDir() && !it.fileInfo().isSymLink();
+    // Then write the new files.
+    qCDebug(ARK) << "Writing new entries";
+    foreach (const FileScanner::ScannedFile &file, scannedFiles) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            break;
+        }
 
-                if (isRealDir) {
-                    path.append(QLatin1Char('/'));
-                }
+        QString path = file.path;
+        if (file.isDir() && !path.endsWith(QLatin1Char('/'))) {
+            path.append(QLatin1Char('/'));
+        }
 
-                if (!writeFile(path, destinationPath)) {
-                    finish(false);
-                    return false;
-                }
-                no_entries++;
-                emit progress(float(no_entries)/float(totalCount));
-            }
+        if (needsWriting(destinationPath + path) && !writeFile(path, destinationPath)) {
+            finish(false);
+            return false;
         }
+        no_entries++;
+        setProcessedFraction(float(no_entries)/float(totalCount));
     }
     qCDebug(ARK) << "Added" << no_entries << "new entries to archive";
 
     bool isSuccessful = true;
     // If we have old archive entries.
-    if (!creatingNewFile) {
+    if (!creatingNewFile && m_updateMode == CompressionOptions::AddAllFiles) {
         qCDebug(ARK) << "Copying any old entries";
         m_filesPaths = m_writtenFiles;
         isSuccessful = processOldEntries(no_entries, Add, totalCount);
@@ -133,6 +143,12 @@ bool ReadWriteLibarchivePlugin::addFiles(const QVector<Archive::Entry*> &files,
         }
     }
 
+    m_deduplicateFiles = false;
+    m_writtenContents.clear();
+    m_updateMode = CompressionOptions::AddAllFiles;
+    m_updatedFiles.clear();
+    m_storedFiles.clear();
+
     finish(isSuccessful);
     return isSuccessful;
 }
@@ -143,6 +159,11 @@ bool ReadWriteLibarchivePlugin::moveFiles(const QVector<Archive::Entry*> &files,
 
     qCDebug(ARK) << "Moving" << files.size() << "entries";
 
+    if (isInTransaction()) {
+        queueMoveOrCopyFiles(files, destination, Move);
+        return true;
+    }
+
     if (!initializeReader()) {
         return false;
     }
@@ -173,6 +194,11 @@ bool ReadWriteLibarchivePlugin::copyFiles(const QVector<Archive::Entry*> &files,
 
     qCDebug(ARK) << "Copying" << files.size() << "entries";
 
+    if (isInTransaction()) {
+        queueMoveOrCopyFiles(files, destination, Copy);
+        return true;
+    }
+
     if (!initializeReader()) {
         return false;
     }
@@ -200,6 +226,11 @@ bool ReadWriteLibarchivePlugin::deleteFiles(const QVector<Archive::Entry*> &file
 {
     qCDebug(ARK) << "Deleting" << files.size() << "entries";
 
+    if (isInTransaction()) {
+        queueDeleteFiles(files);
+        return true;
+    }
+
     if (!initializeReader()) {
         return false;
     }
@@ -222,6 +253,289 @@ bool ReadWriteLibarchivePlugin::deleteFiles(const QVector<Archive::Entry*> &file
     return isSuccessful;
 }
 
+bool ReadWriteLibarchivePlugin::list()
+{
+    // The archive on disk must contain the queued changes before it is read again.
+    if (hasPendingChanges() && !commitTransaction()) {
+        return false;
+    }
+
+    return LibarchivePlugin::list();
+}
+
+bool ReadWriteLibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const QString &destinationDirectory, const ExtractionOptions &options)
+{
+    if (hasPendingChanges() && !commitTransaction()) {
+        return false;
+    }
+
+    return LibarchivePlugin::extractFiles(files, destinationDirectory, options);
+}
+
+bool ReadWriteLibarchivePlugin::testArchive()
+{
+    if (hasPendingChanges() && !commitTransaction()) {
+        return false;
+    }
+
+    return LibarchivePlugin::testArchive();
+}
+
+bool ReadWriteLibarchivePlugin::supportsTransactions() const
+{
+    return true;
+}
+
+bool ReadWriteLibarchivePlugin::hasPendingChanges() const
+{
+    return !m_pendingEntries.isEmpty() || !m_removedEntries.isEmpty();
+}
+
+bool ReadWriteLibarchivePlugin::commitTransaction()
+{
+    if (hasPendingChanges()) {
+        qCDebug(ARK) << "Writing" << m_pendingEntries.size() << "queued and" << m_removedEntries.size() << "removed entries";
+        const uint numberOfEntries = m_numberOfEntries;
+        if (!writePendingChanges()) {
+            // The archive on disk is unchanged, so the changes are kept to be written again or discarded.
+            m_numberOfEntries = numberOfEntries;
+            return false;
+        }
+
+        m_pendingEntries.clear();
+        m_removedEntries.clear();
+    }
+
+    return ReadWriteArchiveInterface::commitTransaction();
+}
+
+void ReadWriteLibarchivePlugin::queueAddFiles(const FileManifest &files, const Archive::Entry *destination)
+{
+    const QString destinationPath = (destination == nullptr)
+                                    ? QString()
+                                    : destination->fullPath();
+
+    // The paths are relative to the current directory, which is only valid during this job.
+    auto queueFile = [&](const QString &relativeName, const FileScanner::ScannedFile &file) {
+        const QString fileName = QFileInfo(relativeName).absoluteFilePath();
+        const QString entryName = destinationPath + relativeName;
+        m_pendingEntries.insert(entryName, PendingSource{QString(), fileName, file.type == FileScanner::File,
+                                                         file.size, file.modificationTime});
+
+        struct archive_entry *entry = entryFromFile(fileName, entryName);
+        emitEntryFromArchiveEntry(entry);
+        archive_entry_free(entry);
+    };
+
+    foreach (const FileScanner::ScannedFile &file, files) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            break;
+        }
+
+        if (file.isDir() && !file.path.endsWith(QLatin1Char('/'))) {
+            queueFile(file.path + QLatin1Char('/'), file);
+        } else {
+            queueFile(file.path, file);
+        }
+    }
+}
+
+void ReadWriteLibarchivePlugin::queueMoveOrCopyFiles(const QVector<Archive::Entry*> &files, const Archive::Entry *destination, OperationMode mode)
+{
+    Q_ASSERT(mode == Move || mode == Copy);
+
+    // Sort the entries the same way as their new paths.
+    QMap<QString, const Archive::Entry*> sortedEntries;
+    foreach (const Archive::Entry *file, files) {
+        sortedEntries.insert(file->fullPath(), file);
+    }
+    const QStringList paths = sortedEntries.keys();
+    const int topLevelCount = (mode == Move) ? entriesWithoutChildren(files).count() : 0;
+    const QStringList newPaths = entryPathsFromDestination(paths, destination, topLevelCount);
+    Q_ASSERT(paths.count() == newPaths.count());
+
+    // Resolve all the sources and create the new entries before touching anything,
+    // since the views might delete the passed entries once they are removed.
+    QVector<PendingSource> sources;
+    QVector<Archive::Entry*> newEntries;
+    sources.reserve(paths.count());
+    newEntries.reserve(paths.count());
+    int i = 0;
+    foreach (const Archive::Entry *file, sortedEntries) {
+        sources << m_pendingEntries.value(paths.at(i), PendingSource{paths.at(i), QString()});
+
+        auto e = createEntry();
+        e->copyMetaData(file);
+        e->setProperty("fullPath", newPaths.at(i));
+        newEntries << e;
+        i++;
+    }
+
+    if (mode == Move) {
+        foreach (const QString &path, paths) {
+            m_pendingEntries.remove(path);
+            m_removedEntries.insert(path);
+            emit entryRemoved(path);
+        }
+    }
+
+    for (i = 0; i < newPaths.count(); ++i) {
+        m_pendingEntries.insert(newPaths.at(i), sources.at(i));
+        emit entry(newEntries.at(i));
+    }
+}
+
+void ReadWriteLibarchivePlugin::queueDeleteFiles(const QVector<Archive::Entry*> &files)
+{
+    const QStringList paths = entryFullPaths(files);
+    foreach (const QString &path, paths) {
+        m_pendingEntries.remove(path);
+        m_removedEntries.insert(path);
+        emit entryRemoved(path);
+    }
+}
+
+bool ReadWriteLibarchivePlugin::writePendingChanges()
+{
+    if (!initializeReader()) {
+        return false;
+    }
+
+    if (!initializeWriter()) {
+        return false;
+    }
+
+    const uint totalCount = m_numberOfEntries;
+    uint no_entries = 0;
+    auto updateProgress = [&]() {
+        setProcessedFraction(totalCount > 0 ? double(no_entries) / totalCount : 0);
+    };
+
+    // Old entry path -> the paths it is moved or copied to.
+    QHash<QString, QStringList> targets;
+    // New entry path -> file to add. Sorted, so that folders are written before their contents.
+    QMap<QString, PendingSource> newFiles;
+    for (auto it = m_pendingEntries.constBegin(); it != m_pendingEntries.constEnd(); ++it) {
+        if (it.value().fileName.isEmpty()) {
+            targets[it.value().entryPath] << it.key();
+        } else {
+            newFiles.insert(it.key(), it.value());
+        }
+    }
+
+    // The paths an old entry is written to: its own unless it is removed or overwritten, then its copies.
+    auto newPaths = [&](const QString &path) {
+        QStringList paths = targets.value(path);
+        if (!m_removedEntries.contains(path) && !m_pendingEntries.contains(path)) {
+            paths.prepend(path);
+        }
+        return paths;
+    };
+
+    // The paths the old hard links are written to, one of which keeps the data of a removed target.
+    QHash<QString, QStringList> linkPaths;
+    foreach (const QStringList &links, m_hardLinks) {
+        foreach (const QString &link, links) {
+            linkPaths.insert(link, newPaths(link));
+        }
+    }
+
+    // First write the new files, like addFiles() does.
+    for (auto it = newFiles.constBegin(); it != newFiles.constEnd(); ++it) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            break;
+        }
+
+        // The entry was shown as added already, so a different content must not be written silently.
+        if (!isQueuedFileUnchanged(it.value())) {
+            qCWarning(ARK) << it.value().fileName << "changed since it was queued";
+            emit error(xi18nc("@info", "The file <filename>%1</filename> was changed or removed after it was added, so the changes could not be written.",
+                              it.value().fileName));
+            finish(false);
+            return false;
+        }
+
+        if (!writeFileAs(it.value().fileName, it.key(), false)) {
+            finish(false);
+            return false;
+        }
+        no_entries++;
+        updateProgress();
+    }
+
+    struct archive_entry *entry;
+    while (!QThread::currentThread()->isInterruptionRequested() && archive_read_next_header(m_archiveReader.data(), &entry) == ARCHIVE_OK) {
+
+        const QString file = QFile::decodeName(archive_entry_pathname(entry));
+
+        QStringList paths = newPaths(file);
+        if (!m_removedEntries.contains(file) && m_pendingEntries.contains(file)) {
+            // The entry was emitted again when queueing the new one.
+            m_numberOfEntries--;
+        }
+
+        if (paths.isEmpty()) {
+            const QString dataPath = pathKeepingLinkData(file, linkPaths);
+            if (dataPath.isEmpty()) {
+                archive_read_data_skip(m_archiveReader.data());
+                continue;
+            }
+            paths << dataPath;
+        } else if (paths.first() != file && m_hardLinks.contains(file)) {
+            m_movedLinkTargets.insert(file, paths.first());
+        }
+
+        if (m_linksWithData.contains(file)) {
+            // Its first path was written with the data of the removed link target.
+            paths.removeFirst();
+            if (paths.isEmpty()) {
+                archive_read_data_skip(m_archiveReader.data());
+                continue;
+            }
+        }
+
+        if (paths.count() == 1) {
+            if (paths.first() != file) {
+                archive_entry_set_pathname(entry, QFile::encodeName(paths.first()).constData());
+            }
+            if (!writeEntry(entry)) {
+                finish(false);
+                return false;
+            }
+        } else {
+            // The data can only be read once, so keep a copy for the other paths.
+            QTemporaryFile buffer;
+            if (!buffer.open() || archive_read_data_into_fd(m_archiveReader.data(), buffer.handle()) != ARCHIVE_OK) {
+                emit error(i18nc("@info", "Could not copy entry, operation aborted."));
+                finish(false);
+                return false;
+            }
+            buffer.close();
+
+            retargetHardLink(entry);
+            foreach (const QString &path, paths) {
+                archive_entry_set_pathname(entry, QFile::encodeName(path).constData());
+                if (archive_write_header(m_archiveWriter.data(), entry) != ARCHIVE_OK) {
+                    qCCritical(ARK) << "archive_write_header() failed with errno" << archive_errno(m_archiveWriter.data());
+                    emit error(i18nc("@info", "Could not compress entry, operation aborted."));
+                    finish(false);
+                    return false;
+                }
+                recordHardLink(entry);
+                copyData(buffer.fileName(), m_archiveWriter.data(), false);
+            }
+        }
+
+        no_entries += paths.count();
+        addProcessedEntries(paths.count());
+        updateProgress();
+    }
+
+    const bool isSuccessful = !QThread::currentThread()->isInterruptionRequested();
+    finish(isSuccessful);
+    return isSuccessful;
+}
+
 bool ReadWriteLibarchivePlugin::initializeWriter(const bool creatingNewFile, const CompressionOptions &options)
 {
     // |tempFile| needs to be created before |arch_writer| so that when we go
@@ -243,6 +557,12 @@ bool ReadWriteLibarchivePlugin::initializeWriter(const bool creatingNewFile, con
     // pax_restricted is the libarchive default, let's go with that.
     archive_write_set_format_pax_restricted(m_archiveWriter.data());
 
+    m_linkResolver.reset(archive_entry_linkresolver_new());
+    archive_entry_linkresolver_set_strategy(m_linkResolver.data(), archive_format(m_archiveWriter.data()));
+    m_movedLinkTargets.clear();
+    m_linksWithData.clear();
+    m_writtenHardLinks.clear();
+
     if (creatingNewFile) {
         if (!initializeNewFileWriterFilters(options)) {
             return false;
@@ -380,6 +700,9 @@ void ReadWriteLibarchivePlugin::finish(const bool isSuccessful)
 {
     if (!isSuccessful || QThread::currentThread()->isInterruptionRequested()) {
         m_tempFile.cancelWriting();
+    } else {
+        // The next operations work on the archive just written.
+        m_hardLinks = m_writtenHardLinks;
     }
     archive_write_close(m_archiveWriter.data());
     m_tempFile.commit();
@@ -394,24 +717,52 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
     uint iteratedEntries = 0;
 
     // Create a map that contains old path as key and new path as value.
-    QMap<QString, QString> pathMap;
+    QHash<QString, QString> pathMap;
+    // Paths of the entries to be skipped (Add and Delete modes).
+    QSet<QString> filesPaths;
     if (mode == Move || mode == Copy) {
         m_filesPaths.sort();
         QStringList resultList = entryPathsFromDestination(m_filesPaths, m_destination, m_entriesWithoutChildren);
         const int listSize = m_filesPaths.count();
         Q_ASSERT(listSize == resultList.count());
+        pathMap.reserve(listSize);
         for (int i = 0; i < listSize; ++i) {
             pathMap.insert(m_filesPaths.at(i), resultList.at(i));
         }
+    } else {
+        filesPaths.reserve(m_filesPaths.count());
+        foreach (const QString &path, m_filesPaths) {
+            filesPaths.insert(path);
+        }
+    }
+
+    // The paths the old hard links are written to, one of which keeps the data of a removed target.
+    QHash<QString, QStringList> linkPaths;
+    foreach (const QStringList &links, m_hardLinks) {
+        foreach (const QString &link, links) {
+            QStringList paths;
+            if (mode == Move) {
+                const QString movedPath = pathMap.value(link);
+                paths << (movedPath.isEmpty() ? link : movedPath);
+            } else if (!filesPaths.contains(link) && !(mode == Add && m_updatedFiles.contains(link))) {
+                paths << link;
+            }
+            linkPaths.insert(link, paths);
+        }
     }
 
+    // Sampled by the job, instead of emitting a queued signal for each entry.
+    auto updateProgress = [&]() {
+        setProcessedFraction(totalCount > 0 ? double(newEntries + entriesCounter + iteratedEntries) / totalCount : 0);
+    };
+
     while (!QThread::currentThread()->isInterruptionRequested() && archive_read_next_header(m_archiveReader.data(), &entry) == ARCHIVE_OK) {
 
         const QString file = QFile::decodeName(archive_entry_pathname(entry));
 
         if (mode == Move || mode == Copy) {
-            const QString newPathname = pathMap.value(file);
-            if (!newPathname.isEmpty()) {
+            const auto it = pathMap.constFind(file);
+            if (it != pathMap.constEnd() && !it.value().isEmpty()) {
                 if (mode == Copy) {
                     // Write the old entry.
                     if (!writeEntry(entry)) {
@@ -419,22 +770,33 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
                     }
                 } else {
                     emit entryRemoved(file);
+                    if (m_hardLinks.contains(file)) {
+                        m_movedLinkTargets.insert(file, it.value());
+                    }
                 }
 
                 entriesCounter++;
                 iteratedEntries--;
 
                 // Change entry path.
-                archive_entry_set_pathname(entry, newPathname.toUtf8());
+                archive_entry_set_pathname(entry, it.value().toUtf8().constData());
                 emitEntryFromArchiveEntry(entry);
             }
-        } else if (m_filesPaths.contains(file)) {
-            archive_read_data_skip(m_archiveReader.data());
+        } else if (filesPaths.contains(file) || (mode == Add && isReplacedByUpdate(entry))) {
+            const QString dataPath = pathKeepingLinkData(file, linkPaths);
+            if (dataPath.isEmpty()) {
+                archive_read_data_skip(m_archiveReader.data());
+            } else {
+                archive_entry_set_pathname(entry, QFile::encodeName(dataPath).constData());
+                if (!writeEntry(entry)) {
+                    return false;
+                }
+            }
             switch (mode) {
             case Delete:
                 entriesCounter++;
                 emit entryRemoved(file);
-                emit progress(float(newEntries + entriesCounter + iteratedEntries)/float(totalCount));
+                updateProgress();
                 break;
 
             case Add:
@@ -451,7 +813,12 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
             continue;
         }
 
-        // Write old entries.
+        // Write old entries, unless they were written with the data of their removed link target.
+        if (m_linksWithData.contains(file)) {
+            archive_read_data_skip(m_archiveReader.data());
+            updateProgress();
+            continue;
+        }
         if (writeEntry(entry)) {
             if (mode == Add) {
                 entriesCounter++;
@@ -460,10 +827,11 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
             } else if (mode == Delete) {
                 iteratedEntries++;
             }
+            addProcessedEntries();
         } else {
             return false;
         }
-        emit progress(float(newEntries + entriesCounter + iteratedEntries)/float(totalCount));
+        updateProgress();
     }
 
     return true;
@@ -471,9 +839,12 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
 
 bool ReadWriteLibarchivePlugin::writeEntry(struct archive_entry *entry)
 {
+    retargetHardLink(entry);
+
     const int returnCode = archive_write_header(m_archiveWriter.data(), entry);
     switch (returnCode) {
     case ARCHIVE_OK:
+        recordHardLink(entry);
         // If the whole archive is extracted and the total filesize is
         // available, we use partial progress.
         copyData(QLatin1String(archive_entry_pathname(entry)), m_archiveReader.data(), m_archiveWriter.data(), false);
@@ -493,31 +864,83 @@ bool ReadWriteLibarchivePlugin::writeEntry(struct archive_entry *entry)
     return true;
 }
 
-// TODO: if we merge this with copyData(), we can pass more data
-//       such as an fd to archive_read_disk_entry_from_file()
+QString ReadWriteLibarchivePlugin::pathKeepingLinkData(const QString &target, const QHash<QString, QStringList> &linkPaths)
+{
+    foreach (const QString &link, m_hardLinks.value(target)) {
+        const QStringList paths = linkPaths.value(link);
+        if (!paths.isEmpty()) {
+            qCDebug(ARK) << "Storing the data of" << target << "with its hard link" << paths.first();
+            m_linksWithData.insert(link);
+            m_movedLinkTargets.insert(target, paths.first());
+            return paths.first();
+        }
+    }
+
+    return QString();
+}
+
+void ReadWriteLibarchivePlugin::retargetHardLink(struct archive_entry *entry)
+{
+    const char *hardLink = archive_entry_hardlink(entry);
+    if (!hardLink || m_movedLinkTargets.isEmpty()) {
+        return;
+    }
+
+    const auto it = m_movedLinkTargets.constFind(QFile::decodeName(hardLink));
+    if (it != m_movedLinkTargets.constEnd()) {
+        archive_entry_set_hardlink(entry, QFile::encodeName(it.value()).constData());
+    }
+}
+
+void ReadWriteLibarchivePlugin::recordHardLink(struct archive_entry *entry)
+{
+    const char *hardLink = archive_entry_hardlink(entry);
+    if (hardLink) {
+        m_writtenHardLinks[QFile::decodeName(hardLink)] << QFile::decodeName(archive_entry_pathname(entry));
+    }
+}
+
 bool ReadWriteLibarchivePlugin::writeFile(const QString &relativeName, const QString &destination)
 {
-    int header_response;
-    const QString absoluteFilename = QFileInfo(relativeName).absoluteFilePath();
     const QString destinationFilename = destination + relativeName;
+    if (!writeFileAs(QFileInfo(relativeName).absoluteFilePath(), destinationFilename, true)) {
+        return false;
+    }
 
-    // #253059: Even if we use archive_read_disk_entry_from_file,
-    //          libarchive may have been compiled without HAVE_LSTAT,
-    //          or something may have caused it to follow symlinks, in
-    //          which case stat() will be called. To avoid this, we
-    //          call lstat() ourselves.
-    struct stat st;
-    lstat(QFile::encodeName(absoluteFilename).constData(), &st);
+    m_writtenFiles.push_back(destinationFilename);
+    return true;
+}
 
-    struct archive_entry *entry = archive_entry_new();
-    archive_entry_set_pathname(entry, QFile::encodeName(destinationFilename).constData());
-    archive_entry_copy_sourcepath(entry, QFile::encodeName(absoluteFilename).constData());
-    archive_read_disk_entry_from_file(m_archiveReadDisk.data(), entry, -1, &st);
+bool ReadWriteLibarchivePlugin::writeFileAs(const QString &fileName, const QString &entryName, bool emitEntry)
+{
+    int header_response;
+    struct archive_entry *entry = entryFromFile(fileName, entryName);
+
+    // Files sharing an inode with a file written before are stored as hard links to it.
+    // The tar strategy never holds entries back, unlike the cpio ones.
+    struct archive_entry *sparse = nullptr;
+    archive_entry_linkify(m_linkResolver.data(), &entry, &sparse);
+    Q_ASSERT(entry && !sparse);
+
+    // Files with the same content as a file written before can be stored as hard links too.
+    if (m_deduplicateFiles && !archive_entry_hardlink(entry) &&
+        archive_entry_filetype(entry) == AE_IFREG && archive_entry_size(entry) > 0) {
+        const QString target = identicalWrittenEntry(fileName, archive_entry_size(entry), entryName);
+        if (!target.isEmpty()) {
+            qCDebug(ARK) << "Storing" << entryName << "as a link to the identical" << target;
+            archive_entry_set_hardlink(entry, QFile::encodeName(target).constData());
+            archive_entry_set_size(entry, 0);
+        }
+    }
 
     if ((header_response = archive_write_header(m_archiveWriter.data(), entry)) == ARCHIVE_OK) {
-        // If the whole archive is extracted and the total filesize is
-        // available, we use partial progress.
-        copyData(absoluteFilename, m_archiveWriter.data(), false);
+        recordHardLink(entry);
+        // The data of hard links is stored with their target.
+        if (!archive_entry_hardlink(entry)) {
+            // If the whole archive is extracted and the total filesize is
+            // available, we use partial progress.
+            copyData(fileName, m_archiveWriter.data(), false);
+        }
     } else {
         qCCritical(ARK) << "Writing header failed with error code " << header_response;
         qCCritical(ARK) << "Error while writing..." << archive_error_string(m_archiveWriter.data()) << "(error no =" << archive_errno(m_archiveWriter.data()) << ')';
@@ -530,13 +953,148 @@ bool ReadWriteLibarchivePlugin::writeFile(const QString &relativeName, const QSt
         return false;
     }
 
-    m_writtenFiles.push_back(destinationFilename);
-
-    emitEntryFromArchiveEntry(entry);
+    if (emitEntry) {
+        emitEntryFromArchiveEntry(entry);
+    }
 
     archive_entry_free(entry);
 
     return true;
 }
 
+bool ReadWriteLibarchivePlugin::isQueuedFileUnchanged(const PendingSource &source)
+{
+    if (!source.isFile) {
+        return true;
+    }
+
+    struct stat st;
+    return lstat(QFile::encodeName(source.fileName).constData(), &st) == 0 && S_ISREG(st.st_mode) &&
+           st.st_size == source.size && st.st_mtime == source.modificationTime;
+}
+
+bool ReadWriteLibarchivePlugin::isReplacedByUpdate(struct archive_entry *entry)
+{
+    if (m_updatedFiles.isEmpty()) {
+        return false;
+    }
+
+    QString path = QFile::decodeName(archive_entry_pathname(entry));
+    if (path.endsWith(QLatin1Char('/'))) {
+        path.chop(1);
+    }
+
+    const auto it = m_updatedFiles.constFind(path);
+    if (it == m_updatedFiles.constEnd()) {
+        return false;
+    }
+
+    bool isUnchangedEntry;
+    if (archive_entry_filetype(entry) == AE_IFDIR) {
+        // The folder is kept, its content is checked file by file.
+        isUnchangedEntry = it.value().isDir();
+    } else {
+        // Hard links have no data of their own, so they are always written again.
+        isUnchangedEntry = !archive_entry_hardlink(entry) &&
+                           isUnchanged(it.value(), archive_entry_size(entry), archive_entry_mtime(entry));
+    }
+
+    if (isUnchangedEntry) {
+        qCDebug(ARK) << path << "is unchanged, keeping the stored entry";
+    }
+    m_storedFiles.insert(path, isUnchangedEntry);
+    return !isUnchangedEntry;
+}
+
+bool ReadWriteLibarchivePlugin::needsWriting(const QString &entryName) const
+{
+    if (m_updateMode == CompressionOptions::AddAllFiles) {
+        return true;
+    }
+
+    QString path = entryName;
+    if (path.endsWith(QLatin1Char('/'))) {
+        path.chop(1);
+    }
+
+    const auto it = m_storedFiles.constFind(path);
+    if (it == m_storedFiles.constEnd()) {
+        return m_updateMode == CompressionOptions::UpdateChangedFiles;
+    }
+
+    return !it.value();
+}
+
+QString ReadWriteLibarchivePlugin::identicalWrittenEntry(const QString &fileName, qint64 size, const QString &entryName)
+{
+    // Only files of the same size are hashed, so most files are never read twice.
+    QVector<WrittenContent> &candidates = m_writtenContents[size];
+    QByteArray hash;
+    for (int i = 0; i < candidates.size(); ++i) {
+        WrittenContent &candidate = candidates[i];
+        if (candidate.hash.isEmpty()) {
+            candidate.hash = contentHash(candidate.fileName);
+        }
+        if (hash.isEmpty()) {
+            hash = contentHash(fileName);
+            if (hash.isEmpty()) {
+                return QString();
+            }
+        }
+        if (candidate.hash == hash) {
+            return candidate.entryName;
+        }
+    }
+
+    WrittenContent content;
+    content.fileName = fileName;
+    content.entryName = entryName;
+    content.hash = hash;
+    candidates << content;
+
+    return QString();
+}
+
+QByteArray ReadWriteLibarchivePlugin::contentHash(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+
+    return hash.result();
+}
+
+void ReadWriteLibarchivePlugin::LinkResolverCustomDeleter::cleanup(struct archive_entry_linkresolver *resolver)
+{
+    if (resolver) {
+        archive_entry_linkresolver_free(resolver);
+    }
+}
+
+// TODO: if we merge this with copyData(), we can pass more data
+//       such as an fd to archive_read_disk_entry_from_file()
+struct archive_entry *ReadWriteLibarchivePlugin::entryFromFile(const QString &fileName, const QString &entryName)
+{
+    // #253059: Even if we use archive_read_disk_entry_from_file,
+    //          libarchive may have been compiled without HAVE_LSTAT,
+    //          or something may have caused it to follow symlinks, in
+    //          which case stat() will be called. To avoid this, we
+    //          call lstat() ourselves.
+    struct stat st;
+    lstat(QFile::encodeName(fileName).constData(), &st);
+
+    struct archive_entry *entry = archive_entry_new();
+    archive_entry_set_pathname(entry, QFile::encodeName(entryName).constData());
+    archive_entry_copy_sourcepath(entry, QFile::encodeName(fileName).constData());
+    archive_read_disk_entry_from_file(m_archiveReadDisk.data(), entry, -1, &st);
+
+    return entry;
+}
+
 #include "readwritelibarchiveplugin.moc"
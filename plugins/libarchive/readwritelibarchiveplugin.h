@@ -31,8 +31,13 @@
 #include "libarchiveplugin.h"
 
 #include <QDir>
-#include <QStringList>
+#include <QHash>
 #include <QSaveFile>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+struct archive_entry_linkresolver;
 
 using namespace Kerfuffle;
 
@@ -49,6 +54,14 @@ public:
     bool copyFiles(const QVector<Archive::Entry*> &files, Archive::Entry *destination, const CompressionOptions &options) override;
     bool deleteFiles(const QVector<Archive::Entry*> &files) override;
 
+    bool list() override;
+    bool extractFiles(const QVector<Archive::Entry*> &files, const QString &destinationDirectory, const ExtractionOptions &options) override;
+    bool testArchive() override;
+
+    bool supportsTransactions() const override;
+    bool hasPendingChanges() const override;
+    bool commitTransaction() override;
+
 protected:
     bool initializeWriter(const bool creatingNewFile = false, const CompressionOptions &options = CompressionOptions());
     bool initializeWriterFilters();
@@ -66,6 +79,21 @@ private:
      */
     bool processOldEntries(uint &entriesCounter, OperationMode mode, uint totalCount);
 
+    /**
+     * Queue the operation of the given @p mode, to be written by commitTransaction().
+     * The entries are emitted or removed right away.
+     */
+    void queueAddFiles(const FileManifest &files, const Archive::Entry *destination);
+    void queueMoveOrCopyFiles(const QVector<Archive::Entry*> &files, const Archive::Entry *destination, OperationMode mode);
+    void queueDeleteFiles(const QVector<Archive::Entry*> &files);
+
+    /**
+     * Writes the old entries and the queued files to their final paths.
+     *
+     * @return bool indicating whether the operation was successful.
+     */
+    bool writePendingChanges();
+
     /**
      * Writes entry being read into memory.
      *
@@ -73,6 +101,25 @@ private:
      */
     bool writeEntry(struct archive_entry *entry);
 
+    /**
+     * To be called when the old entry @p target is not written again. If hard links to it are kept,
+     * its data is stored with the first of them instead, and the other links point to it.
+     *
+     * @param linkPaths The paths the old hard links are written to, empty for removed links.
+     * @return The path the data of @p target must be written to, or an empty string.
+     */
+    QString pathKeepingLinkData(const QString &target, const QHash<QString, QStringList> &linkPaths);
+
+    /**
+     * Points the old hard link @p entry to the path its target was moved to, if any.
+     */
+    void retargetHardLink(struct archive_entry *entry);
+
+    /**
+     * Remembers @p entry if it is a hard link, once it has been written.
+     */
+    void recordHardLink(struct archive_entry *entry);
+
     /**
      * Writes entry from physical disk.
      *
@@ -80,17 +127,107 @@ private:
      */
     bool writeFile(const QString &relativeName, const QString &destination);
 
+    /**
+     * Records whether the old @p entry is one of the files being updated, and whether it changed.
+     *
+     * @return Whether the entry is written again from the file on disk, so the old one is skipped.
+     */
+    bool isReplacedByUpdate(struct archive_entry *entry);
+
+    /**
+     * @return Whether the scanned file for @p entryName must be written according to the update mode.
+     * The old entries must have been processed before.
+     */
+    bool needsWriting(const QString &entryName) const;
+
+    /**
+     * Writes the file @p fileName from physical disk as the entry @p entryName.
+     *
+     * @return bool indicating whether the operation was successful.
+     */
+    bool writeFileAs(const QString &fileName, const QString &entryName, bool emitEntry);
+
+    /**
+     * @return A new entry named @p entryName with the metadata of the file @p fileName.
+     */
+    struct archive_entry *entryFromFile(const QString &fileName, const QString &entryName);
+
+    /**
+     * @return The entry written before with the same content as the file @p fileName, or an empty string.
+     * The file is remembered as written to @p entryName otherwise.
+     */
+    QString identicalWrittenEntry(const QString &fileName, qint64 size, const QString &entryName);
+
+    /**
+     * @return The hash of the content of @p fileName, or an empty array if it cannot be read.
+     */
+    static QByteArray contentHash(const QString &fileName);
+
+    struct LinkResolverCustomDeleter
+    {
+        static void cleanup(struct archive_entry_linkresolver *resolver);
+    };
+
     QSaveFile m_tempFile;
     ArchiveWrite m_archiveWriter;
 
+    // Turns the files sharing an inode into hard links to the first one written.
+    QScopedPointer<struct archive_entry_linkresolver, LinkResolverCustomDeleter> m_linkResolver;
+
+    // Hard links while rewriting the archive: old link targets -> the paths they were moved to,
+    // old links which were written with the data of their removed target, and the links written.
+    QHash<QString, QString> m_movedLinkTargets;
+    QSet<QString> m_linksWithData;
+    QHash<QString, QStringList> m_writtenHardLinks;
+
+    // Regular files written by the current addFiles() by size, when identical files are stored only once.
+    struct WrittenContent
+    {
+        QString fileName;
+        QString entryName;
+        QByteArray hash;    // Only computed once another file has the same size.
+    };
+    QHash<qint64, QVector<WrittenContent> > m_writtenContents;
+    bool m_deduplicateFiles = false;
+
+    // Scanned files by entry path without trailing slash, when only changed files are written,
+    // and those found among the old entries, mapped to whether they are unchanged.
+    QHash<QString, FileScanner::ScannedFile> m_updatedFiles;
+    QHash<QString, bool> m_storedFiles;
+    CompressionOptions::UpdateMode m_updateMode = CompressionOptions::AddAllFiles;
+
     // New added files by addFiles methods. It's assigned to m_filesPaths
     // and then is used by processOldEntries method (in Add mode) for skipping already written entries.
     QStringList m_writtenFiles;
 
     // Passed argument from job which is used by processOldEntries method.
+    // processOldEntries hashes it once per operation before looking up the old entries.
     QStringList m_filesPaths;
     int m_entriesWithoutChildren = 0;
     const Archive::Entry *m_destination = nullptr;
+
+    // Where the data of an entry queued in a transaction comes from:
+    // either an entry of the archive on disk or a file to be added.
+    // Files are only read when the transaction is committed, so their scanned metadata is kept
+    // to make sure they did not change in the meantime.
+    struct PendingSource
+    {
+        QString entryPath;
+        QString fileName;
+        bool isFile;
+        qint64 size;
+        qint64 modificationTime;
+    };
+
+    /**
+     * @return Whether the file of @p source still has the size and modification time it had when it was queued.
+     */
+    static bool isQueuedFileUnchanged(const PendingSource &source);
+
+    // Final path -> source of the entries added, moved or copied in the current transaction.
+    QHash<QString, PendingSource> m_pendingEntries;
+    // Entries of the archive on disk which were deleted or moved away in the current transaction.
+    QSet<QString> m_removedEntries;
 };
 
 #endif // READWRITELIBARCHIVEPLUGIN_H
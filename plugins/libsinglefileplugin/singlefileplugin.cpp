@@ -104,8 +104,12 @@ bool LibSingleFileInterface::list()
 {
     qCDebug(ARK) << "Listing archive contents";
 
-    Kerfuffle::Archive::Entry *e = new Kerfuffle::Archive::Entry();
-    connect(this, &QObject::destroyed, e, &QObject::deleteLater);
+    if (isStatisticsOnlyListing()) {
+        addEntryStatistics(uncompressedFileName(), false, 0, false);
+        return true;
+    }
+
+    Kerfuffle::Archive::Entry *e = createEntry();
     e->setProperty("fullPath", uncompressedFileName());
     e->setProperty("compressedSize", QFileInfo(filename()).size());
     emit entry(e);
@@ -26,6 +26,8 @@
 #include "libzipplugin.h"
 #include "ark_debug.h"
 #include "queries.h"
+#include "tracer.h"
+#include "zipextractionplanner.h"
 
 #include <KLocalizedString>
 #include <KPluginFactory>
@@ -33,10 +35,12 @@
 #include <QDataStream>
 #include <QDateTime>
 #include <QDir>
-#include <QDirIterator>
 #include <QFile>
+#include <QHash>
 #include <QThread>
 
+#include <zlib.h>
+
 K_PLUGIN_FACTORY_WITH_JSON(LibZipPluginFactory, "kerfuffle_libzip.json", registerPlugin<LibzipPlugin>();)
 
 // This is needed for hooking a C callback to a C++ non-static member
@@ -64,10 +68,6 @@ LibzipPlugin::LibzipPlugin(QObject *parent, const QVariantList & args)
 
 LibzipPlugin::~LibzipPlugin()
 {
-    foreach (const auto e, m_emittedEntries) {
-        // Entries might be passed to pending slots, so we just schedule their deletion.
-        e->deleteLater();
-    }
 }
 
 bool LibzipPlugin::list()
@@ -102,12 +102,14 @@ bool LibzipPlugin::list()
             break;
         }
 
+        ARK_TRACE_SCOPE("list-entry", "libzip");
         emitEntryForIndex(archive, i);
+        addProcessedEntries();
         if (m_listAfterAdd) {
             // Start at 50%.
-            emit progress(0.5 + (0.5 * float(i + 1) / nofEntries));
+            setProcessedFraction(0.5 + (0.5 * float(i + 1) / nofEntries));
         } else {
-            emit progress(float(i + 1) / nofEntries);
+            setProcessedFraction(float(i + 1) / nofEntries);
         }
     }
 
@@ -120,6 +122,8 @@ bool LibzipPlugin::addFiles(const QVector<Archive::Entry*> &files, const Archive
 {
     Q_UNUSED(numberOfEntriesToAdd)
 
+    const FileManifest scannedFiles = takeScannedFiles(files);
+
     int errcode;
     zip_error_t err;
 
@@ -133,42 +137,16 @@ bool LibzipPlugin::addFiles(const QVector<Archive::Entry*> &files, const Archive
     }
 
     uint i = 0;
-    foreach (const Archive::Entry* e, files) {
+    foreach (const FileScanner::ScannedFile &file, scannedFiles) {
 
         if (QThread::currentThread()->isInterruptionRequested()) {
             break;
         }
 
-        // If entry is a directory, traverse and add all its files and subfolders.
-        if (QFileInfo(e->fullPath()).isDir()) {
-
-            if (!writeEntry(archive, e->fullPath(), destination, options, true)) {
-                return false;
-            }
-
-            QDirIterator it(e->fullPath(),
-                            QDir::AllEntries | QDir::Readable |
-                            QDir::Hidden | QDir::NoDotAndDotDot,
-                            QDirIterator::Subdirectories);
-
-            while (!QThread::currentThread()->isInterruptionRequested() && it.hasNext()) {
-                QString path = it.next();
-
-                if (QFileInfo(path).isDir()) {
-                    if (!writeEntry(archive, path, destination, options, true)) {
-                        return false;
-                    }
-                } else {
-                    if (!writeEntry(archive, path, destination, options)) {
-                        return false;
-                    }
-                }
-                i++;
-            }
-        } else {
-            if (!writeEntry(archive, e->fullPath(), destination, options)) {
-                return false;
-            }
+        // Symlinks are stored as the file or the folder they point to.
+        const bool isDir = file.isDir() || (file.type == FileScanner::SymLink && QFileInfo(file.path).isDir());
+        if (!writeEntry(archive, file, destination, options, isDir)) {
+            return false;
         }
         i++;
     }
@@ -180,6 +158,7 @@ bool LibzipPlugin::addFiles(const QVector<Archive::Entry*> &files, const Archive
     zip_register_progress_callback(archive, c_func);
 
     qCDebug(ARK) << "Writing entries to disk...";
+    ARK_TRACE_SCOPE("write-archive", "libzip");
     if (zip_close(archive)) {
         qCCritical(ARK) << "Failed to write archive";
         emit error(xi18n("Failed to write archive."));
@@ -197,13 +176,15 @@ bool LibzipPlugin::addFiles(const QVector<Archive::Entry*> &files, const Archive
 void LibzipPlugin::progressEmitted(double pct)
 {
     // Go from 0 to 50%. The second half is the subsequent listing.
-    emit progress(0.5 * pct);
+    setProcessedFraction(0.5 * pct);
 }
 
-bool LibzipPlugin::writeEntry(zip_t *archive, const QString &file, const Archive::Entry* destination, const CompressionOptions& options, bool isDir)
+bool LibzipPlugin::writeEntry(zip_t *archive, const FileScanner::ScannedFile &scannedFile, const Archive::Entry* destination, const CompressionOptions& options, bool isDir)
 {
     Q_ASSERT(archive);
+    ARK_TRACE_SCOPE("write-entry", "libzip");
 
+    const QString &file = scannedFile.path;
     QByteArray destFile;
     if (destination) {
         destFile = QString(destination->fullPath() + file).toUtf8();
@@ -211,6 +192,10 @@ bool LibzipPlugin::writeEntry(zip_t *archive, const QString &file, const Archive
         destFile = file.toUtf8();
     }
 
+    if (!needsWriting(archive, scannedFile, destFile, options, isDir)) {
+        return true;
+    }
+
     qlonglong index;
     if (isDir) {
         index = zip_dir_add(archive, destFile, ZIP_FL_ENC_GUESS);
@@ -245,6 +230,72 @@ bool LibzipPlugin::writeEntry(zip_t *archive, const QString &file, const Archive
     return true;
 }
 
+bool LibzipPlugin::needsWriting(zip_t *archive, const FileScanner::ScannedFile &file, const QByteArray &entryName, const CompressionOptions& options, bool isDir)
+{
+    if (options.updateMode() == CompressionOptions::AddAllFiles) {
+        return true;
+    }
+
+    QByteArray name = entryName;
+    if (isDir && !name.endsWith('/')) {
+        name.append('/');
+    }
+
+    const qlonglong index = zip_name_locate(archive, name.constData(), ZIP_FL_ENC_GUESS);
+    if (index == -1) {
+        return options.updateMode() == CompressionOptions::UpdateChangedFiles;
+    }
+    if (isDir) {
+        return false;
+    }
+
+    zip_stat_t sb;
+    if (zip_stat_index(archive, index, ZIP_FL_UNCHANGED, &sb) != 0 ||
+        !(sb.valid & ZIP_STAT_SIZE) || !(sb.valid & ZIP_STAT_MTIME)) {
+        return true;
+    }
+
+    // Unchanged members are not touched, so zip_close() copies their compressed data as is.
+    // DOS timestamps have a precision of two seconds.
+    if (isUnchanged(file, sb.size, sb.mtime, 2)) {
+        qCDebug(ARK) << file.path << "is unchanged, keeping the stored entry";
+        return false;
+    }
+
+    // Files which were only touched still have the checksum of the stored entry.
+    if (options.compareChecksums() && (sb.valid & ZIP_STAT_CRC) &&
+        file.type == FileScanner::File && file.size == qint64(sb.size)) {
+        quint32 crc;
+        if (fileCrc(file.path, &crc) && crc == sb.crc) {
+            qCDebug(ARK) << file.path << "has the checksum of the stored entry, keeping it";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LibzipPlugin::fileCrc(const QString &fileName, quint32 *crc)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    uLong value = crc32(0L, Z_NULL, 0);
+    QByteArray buffer(1024 * 1024, Qt::Uninitialized);
+    qint64 readBytes;
+    while ((readBytes = f.read(buffer.data(), buffer.size())) > 0) {
+        value = crc32(value, reinterpret_cast<const Bytef*>(buffer.constData()), static_cast<uInt>(readBytes));
+    }
+    if (readBytes < 0) {
+        return false;
+    }
+
+    *crc = static_cast<quint32>(value);
+    return true;
+}
+
 bool LibzipPlugin::emitEntryForIndex(zip_t *archive, qlonglong index)
 {
     Q_ASSERT(archive);
@@ -255,7 +306,16 @@ bool LibzipPlugin::emitEntryForIndex(zip_t *archive, qlonglong index)
         return false;
     }
 
-    auto e = new Archive::Entry();
+    if (isStatisticsOnlyListing()) {
+        const QString fullPath = (sb.valid & ZIP_STAT_NAME) ? QString::fromUtf8(sb.name) : QString();
+        addEntryStatistics(fullPath,
+                           fullPath.endsWith(QLatin1Char('/')),
+                           (sb.valid & ZIP_STAT_SIZE) ? (qlonglong)sb.size : 0,
+                           (sb.valid & ZIP_STAT_ENCRYPTION_METHOD) && sb.encryption_method != ZIP_EM_NONE);
+        return true;
+    }
+
+    auto e = createEntry();
 
     if (sb.valid & ZIP_STAT_NAME) {
         e->setFullPath(QString::fromUtf8(sb.name));
@@ -328,7 +388,6 @@ bool LibzipPlugin::emitEntryForIndex(zip_t *archive, qlonglong index)
     }
 
     emit entry(e);
-    m_emittedEntries << e;
 
     return true;
 }
@@ -366,7 +425,8 @@ bool LibzipPlugin::deleteFiles(const QVector<Archive::Entry*> &files)
             return false;
         }
         emit entryRemoved(e->fullPath());
-        emit progress(float(++i) / files.size());
+        addProcessedEntries();
+        setProcessedFraction(float(++i) / files.size());
     }
     qCDebug(ARK) << "Deleted" << i << "entries";
 
@@ -458,46 +518,89 @@ bool LibzipPlugin::extractFiles(const QVector<Archive::Entry*> &files, const QSt
     }
 
     // Get number of archive entries.
-    qlonglong nofEntries;
-    extractAll ? nofEntries = zip_get_num_entries(archive, 0) : nofEntries = files.size();
+    const qlonglong archiveEntries = zip_get_num_entries(archive, 0);
 
-    // Extract entries.
-    m_overwriteAll = false; // Whether to overwrite all files
-    m_skipAll = false; // Whether to skip all files
+    // Look up the members to extract. Folders without a member of their own are only created.
+    QVector<int> indexes;
+    QHash<int, const Archive::Entry*> entriesByIndex;
+    QVector<const Archive::Entry*> unlocatedEntries;
     if (extractAll) {
-        // We extract all entries.
-        for (qlonglong i = 0; i < nofEntries; i++) {
-            if (QThread::currentThread()->isInterruptionRequested()) {
-                break;
-            }
-            if (!extractEntry(archive,
-                              QDir::fromNativeSeparators(QString::fromUtf8(zip_get_name(archive, i, ZIP_FL_ENC_GUESS))),
-                              QString(),
-                              destinationDirectory,
-                              options.preservePaths(),
-                              removeRootNode)) {
-                qCDebug(ARK) << "Extraction failed";
-                return false;
+        indexes.reserve(archiveEntries);
+        for (int i = 0; i < archiveEntries; i++) {
+            indexes << i;
+        }
+    } else {
+        indexes.reserve(files.size());
+        foreach (const Archive::Entry *e, files) {
+            const int index = zip_name_locate(archive, e->fullPath().toUtf8(), ZIP_FL_ENC_GUESS);
+            if (index < 0) {
+                unlocatedEntries << e;
+                continue;
             }
-            emit progress(float(i + 1) / nofEntries);
+            indexes << index;
+            entriesByIndex.insert(index, e);
         }
+    }
+    const qlonglong nofEntries = indexes.size() + unlocatedEntries.size();
+
+    // Extract the members in the order they are stored, rather than seeking back and forth.
+    ZipExtractionPlanner planner(filename());
+    QVector<ZipExtractionPlanner::Range> ranges;
+    if (planner.isValid() && planner.memberCount() == archiveEntries) {
+        ranges = planner.ranges(indexes);
     } else {
-        // We extract only the entries in files.
-        qulonglong i = 0;
-        foreach (const Archive::Entry* e, files) {
+        ZipExtractionPlanner::Range range;
+        range.begin = range.end = 0;
+        range.members = indexes;
+        ranges << range;
+    }
+
+    // Extract entries.
+    m_overwriteAll = false; // Whether to overwrite all files
+    m_skipAll = false; // Whether to skip all files
+    qlonglong i = 0;
+    foreach (const Archive::Entry *e, unlocatedEntries) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            break;
+        }
+        if (!extractEntry(archive,
+                          e->fullPath(),
+                          e->rootNode,
+                          destinationDirectory,
+                          options.preservePaths(),
+                          removeRootNode)) {
+            qCDebug(ARK) << "Extraction failed";
+            return false;
+        }
+        addProcessedEntries();
+        setProcessedFraction(float(++i) / nofEntries);
+    }
+
+    for (int r = 0; r < ranges.size(); ++r) {
+        // The next range is fetched while this one is extracted.
+        if (r == 0) {
+            planner.readAhead(ranges.at(r));
+        }
+        if (r + 1 < ranges.size()) {
+            planner.readAhead(ranges.at(r + 1));
+        }
+
+        foreach (int index, ranges.at(r).members) {
             if (QThread::currentThread()->isInterruptionRequested()) {
                 break;
             }
+            const Archive::Entry *e = entriesByIndex.value(index);
             if (!extractEntry(archive,
-                              e->fullPath(),
-                              e->rootNode,
+                              e ? e->fullPath() : QDir::fromNativeSeparators(QString::fromUtf8(zip_get_name(archive, index, ZIP_FL_ENC_GUESS))),
+                              e ? e->rootNode : QString(),
                               destinationDirectory,
                               options.preservePaths(),
                               removeRootNode)) {
                 qCDebug(ARK) << "Extraction failed";
                 return false;
             }
-            emit progress(float(++i) / nofEntries);
+            addProcessedEntries();
+            setProcessedFraction(float(++i) / nofEntries);
         }
     }
 
@@ -507,6 +610,7 @@ bool LibzipPlugin::extractFiles(const QVector<Archive::Entry*> &files, const QSt
 
 bool LibzipPlugin::extractEntry(zip_t *archive, const QString &entry, const QString &rootNode, const QString &destDir, bool preservePaths, bool removeRootNode)
 {
+    ARK_TRACE_SCOPE("extract-entry", "libzip");
     const bool isDirectory = entry.endsWith(QDir::separator());
 
     // Add trailing slash to destDir if not present.
@@ -680,7 +784,8 @@ bool LibzipPlugin::moveFiles(const QVector<Archive::Entry*> &files, Archive::Ent
 
         emit entryRemoved(filePaths.at(i));
         emitEntryForIndex(archive, index);
-        emit progress(i/filePaths.count());
+        addProcessedEntries();
+        setProcessedFraction(float(i + 1) / filePaths.count());
     }
     if (zip_close(archive)) {
         qCCritical(ARK) << "Failed to write archive";
@@ -746,7 +851,8 @@ bool LibzipPlugin::copyFiles(const QVector<Archive::Entry*> &files, Archive::Ent
         }
 
         emitEntryForIndex(archive, destIndex);
-        emit progress(i/filePaths.count());
+        addProcessedEntries();
+        setProcessedFraction(float(i + 1) / filePaths.count());
     }
     if (zip_close(archive)) {
         qCCritical(ARK) << "Failed to write archive";
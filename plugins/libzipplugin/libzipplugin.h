@@ -53,11 +53,12 @@ public:
 
 private:
     bool extractEntry(zip_t *archive, const QString &entry, const QString &rootNode, const QString &destDir, bool preservePaths, bool removeRootNode);
-    bool writeEntry(zip_t *archive, const QString &entry, const Archive::Entry* destination, const CompressionOptions& options, bool isDir = false);
+    bool writeEntry(zip_t *archive, const FileScanner::ScannedFile &file, const Archive::Entry* destination, const CompressionOptions& options, bool isDir);
+    bool needsWriting(zip_t *archive, const FileScanner::ScannedFile &file, const QByteArray &entryName, const CompressionOptions& options, bool isDir);
+    static bool fileCrc(const QString &fileName, quint32 *crc);
     bool emitEntryForIndex(zip_t *archive, qlonglong index);
     void progressEmitted(double pct);
 
-    QVector<Archive::Entry*> m_emittedEntries;
     bool m_overwriteAll;
     bool m_skipAll;
     bool m_listAfterAdd;